@@ -1,6 +1,7 @@
 #ifndef asset_io_hpp
 #define asset_io_hpp
 
+#include <algorithm>
 #include "file_io.hpp"
 #include "gl-api.hpp"
 #include "third_party/stb/stb_image.h" 
@@ -20,17 +21,24 @@ inline std::vector<uint8_t> load_image_data(const std::string & path)
     return d;
 }
 
+// stb's flip-on-load flag is a process-wide global that image decoding on worker threads would race with, so it is
+// never set; images are flipped after decoding instead
+inline void flip_image_rows(uint8_t * pixels, const int width, const int height, const int bytesPerPixel)
+{
+    const size_t stride = size_t(width) * bytesPerPixel;
+    for (int y = 0; y < height / 2; ++y) std::swap_ranges(pixels + y * stride, pixels + (y + 1) * stride, pixels + (height - 1 - y) * stride);
+}
+
 // fixme - these functions belong in a gl-xyz.hpp file
 
 inline GlTexture2D load_image(const std::string & path, bool flip = false)
 {
     auto binaryFile = avl::read_file_binary(path);
 
-    if (flip) stbi_set_flip_vertically_on_load(1);
-    else stbi_set_flip_vertically_on_load(0);
-
     int width, height, nBytes;
     auto data = stbi_load_from_memory(binaryFile.data(), (int)binaryFile.size(), &width, &height, &nBytes, 0);
+    if (!data) throw std::runtime_error("could not decode " + path);
+    if (flip) flip_image_rows(data, width, height, nBytes);
 
     GlTexture2D tex;
     switch (nBytes)
@@ -0,0 +1,34 @@
+// Clustered light lookup. Must match uniforms::clustered_lighting / uniforms::clustered_light in lib-render.
+
+struct ClusteredLight
+{
+    vec4 positionRange;
+    vec4 colorType;
+    vec4 attenuation;
+    vec4 spotDirectionCutoff;
+};
+
+layout(binding = 3, std140) uniform ClusteredLighting
+{
+    mat4 u_clusterViewMatrix;
+    mat4 u_clusterViewProjMatrix;
+    vec4 u_clusterDepthParams;
+    ivec4 u_clusterDims;
+};
+
+layout(binding = 0, std430) readonly buffer ClusterLightBuffer { ClusteredLight u_lights[]; };
+layout(binding = 1, std430) readonly buffer ClusterCellBuffer { uvec2 u_clusterCells[]; };
+layout(binding = 2, std430) readonly buffer ClusterIndexBuffer { uint u_clusterLightIndices[]; };
+
+// Returns (offset, count) into u_clusterLightIndices for the cell containing a world-space position
+uvec2 get_cluster(vec3 worldPosition)
+{
+    vec4 clip = u_clusterViewProjMatrix * vec4(worldPosition, 1.0);
+    vec2 ndc = clip.xy / max(clip.w, 1e-5);
+    float depth = max(-(u_clusterViewMatrix * vec4(worldPosition, 1.0)).z, u_clusterDepthParams.x);
+
+    ivec3 cell;
+    cell.xy = clamp(ivec2(floor((ndc * 0.5 + 0.5) * vec2(u_clusterDims.xy))), ivec2(0), u_clusterDims.xy - 1);
+    cell.z = clamp(int(floor(log(depth) * u_clusterDepthParams.z + u_clusterDepthParams.w)), 0, u_clusterDims.z - 1);
+    return u_clusterCells[(cell.z * u_clusterDims.y + cell.y) * u_clusterDims.x + cell.x];
+}
@@ -1,14 +1,13 @@
 #include "renderer_common.glsl"
 
+// Drawn with GlMesh::draw_positions(), so only the position stream is bound
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inNormal;
-layout(location = 2) in vec3 inColor;
-layout(location = 3) in vec2 inTexCoord;
-layout(location = 4) in vec3 inTangent;
-layout(location = 5) in vec3 inBitangent;
 
 void main()
 {
+    int eye = is_stereo_instanced() ? (gl_InstanceID & 1) : 0;
     vec4 worldPosition = u_modelMatrix * vec4(inPosition, 1.0);
-    gl_Position = u_viewProjMatrix * worldPosition;
+    vec4 clipPosition = get_view_proj_matrix(eye) * worldPosition;
+    gl_Position = stereo_clip_position(clipPosition, eye);
+    gl_ClipDistance[0] = stereo_clip_distance(clipPosition, eye);
 }
\ No newline at end of file
@@ -17,6 +17,7 @@
 #include "renderer_common.glsl"
 #include "colorspace_conversions.glsl"
 #include "cascaded_shadows.glsl"
+#include "clustered_lighting.glsl"
 
 in vec3 v_world_position;
 in vec3 v_view_space_position;
@@ -24,6 +25,7 @@ in vec3 v_normal;
 in vec2 v_texcoord;
 in vec3 v_tangent;
 in vec3 v_bitangent;
+flat in int v_eye;
 
 // Material Uniforms
 uniform float u_roughness = 1;
@@ -230,7 +232,7 @@ void main()
     const float alphaRoughness = roughness * roughness;
 
     // View direction
-    vec3 V = normalize(u_eyePos.xyz - v_world_position);
+    vec3 V = normalize(get_eye_position(v_eye) - v_world_position);
     float NdotV = abs(dot(N, V)) + 0.001;
 
     vec3 F0 = vec3(u_specularLevel);
@@ -286,10 +288,31 @@ void main()
         Lo += NdotL * u_directionalLight.color * (diffuseContrib + specContrib);
     }
 
-    // Compute point lights
-    for (int i = 0; i < u_activePointLights; ++i)
+    // Compute point and spot lights assigned to this fragment's cluster
+    uvec2 cluster = get_cluster(v_world_position);
+    for (uint i = 0; i < cluster.y; ++i)
     {
-        vec3 L = normalize(u_pointLights[i].position - v_world_position); 
+        ClusteredLight light = u_lights[u_clusterLightIndices[cluster.x + i]];
+
+        vec3 toLight = light.positionRange.xyz - v_world_position;
+        float dist = length(toLight);
+        if (dist >= light.positionRange.w) continue;
+
+        vec3 L = toLight / dist;
+        float attenuation;
+        if (light.colorType.w == 0.0)
+        {
+            attenuation = point_light_attenuation(light.attenuation.x, 2.0, 0.1, dist); // reasonable intensity is 0.01 to 8
+        }
+        else
+        {
+            float spotFactor = dot(-L, light.spotDirectionCutoff.xyz);
+            if (spotFactor <= light.spotDirectionCutoff.w) continue;
+            float fade = 1.0 - (1.0 - spotFactor) / (1.0 - light.spotDirectionCutoff.w);
+            float falloff = 1.0 / dot(light.attenuation.xyz, vec3(1.0, dist, dist * dist));
+            attenuation = max((falloff - 0.01) / (1.0 - 0.01), 0.0) * fade;
+        }
+
         vec3 H = normalize(L + V);  
 
         float NdotL = clamp(dot(N, L), 0.001, 1.0);
@@ -303,13 +326,10 @@ void main()
             diffuseColor, specularColor
         );
 
-        float dist = length(u_pointLights[i].position - v_world_position);
-        float attenuation = point_light_attenuation(u_pointLights[i].radius, 2.0, 0.1, dist); // reasonable intensity is 0.01 to 8
-
         vec3 diffuseContrib, specContrib;
         compute_cook_torrance(data, attenuation, diffuseContrib, specContrib);
 
-        Lo += NdotL * u_pointLights[i].color * (diffuseContrib + specContrib) * attenuation;
+        Lo += NdotL * light.colorType.rgb * (diffuseContrib + specContrib) * attenuation;
     }
 
     #ifdef USE_IMAGE_BASED_LIGHTING
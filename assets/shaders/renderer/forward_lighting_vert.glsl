@@ -1,11 +1,11 @@
 #include "renderer_common.glsl"
 
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inNormal;
+layout(location = 1) in vec4 inNormal;
 layout(location = 2) in vec3 inColor;
 layout(location = 3) in vec2 inTexCoord;
-layout(location = 4) in vec3 inTangent;
-layout(location = 5) in vec3 inBitangent;
+layout(location = 4) in vec4 inTangent;
+layout(location = 5) in vec4 inBitangent;
 
 out vec3 v_normal;
 out vec3 v_world_position;
@@ -13,17 +13,23 @@ out vec3 v_view_space_position;
 out vec2 v_texcoord;
 out vec3 v_tangent;
 out vec3 v_bitangent;
+flat out int v_eye;
 
 uniform vec2 u_texCoordScale = vec2(1, 1);
 
 void main()
 {
+    int eye = is_stereo_instanced() ? (gl_InstanceID & 1) : 0;
     vec4 worldPosition = u_modelMatrix * vec4(inPosition, 1.0);
-    gl_Position = u_viewProjMatrix * worldPosition;
-    v_view_space_position = (u_modelViewMatrix * vec4(inPosition, 1.0)).xyz;
-    v_normal = normalize((u_modelMatrixIT * vec4(inNormal, 0)).xyz);
+    vec4 clipPosition = get_view_proj_matrix(eye) * worldPosition;
+    gl_Position = stereo_clip_position(clipPosition, eye);
+    gl_ClipDistance[0] = stereo_clip_distance(clipPosition, eye);
+    v_eye = eye;
+    v_view_space_position = is_stereo_instanced() ? (get_view_matrix(eye) * worldPosition).xyz : (u_modelViewMatrix * vec4(inPosition, 1.0)).xyz;
+    vec3 normal = decode_vertex_direction(inNormal);
+    v_normal = normalize((u_modelMatrixIT * vec4(normal, 0)).xyz);
     v_world_position = worldPosition.xyz;
     v_texcoord = inTexCoord * u_texCoordScale;
-    v_tangent = (u_modelMatrixIT * vec4(inTangent, 0)).xyz;
-    v_bitangent = (u_modelMatrixIT * vec4(inBitangent, 0)).xyz;
+    v_tangent = (u_modelMatrixIT * vec4(decode_vertex_direction(inTangent), 0)).xyz;
+    v_bitangent = (u_modelMatrixIT * vec4(decode_vertex_bitangent(normal, inTangent, inBitangent), 0)).xyz;
 }
\ No newline at end of file
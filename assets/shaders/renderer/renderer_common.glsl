@@ -6,7 +6,6 @@
 #define RCP_4PI 1.0 / (4 * PI)
 #define DEFAULT_GAMMA 2.2
 
-const int MAX_POINT_LIGHTS = 4;
 const int NUM_CASCADES = 2;
 
 struct DirectionalLight
@@ -16,19 +15,11 @@ struct DirectionalLight
     float amount;
 }; 
 
-struct PointLight
-{
-    vec3 color;
-    vec3 position;
-    float radius;
-};
-
 layout(binding = 0, std140) uniform PerScene
 {
     DirectionalLight u_directionalLight;
-    PointLight u_pointLights[MAX_POINT_LIGHTS];
     float u_time;
-    int u_activePointLights;
+    int u_activeLights;
     vec2 resolution;
     vec2 invResolution;
     vec4 u_cascadesPlane[NUM_CASCADES];
@@ -42,8 +33,33 @@ layout(binding = 1, std140) uniform PerView
     mat4 u_viewMatrix;
     mat4 u_viewProjMatrix;
     vec4 u_eyePos;
+    mat4 u_stereoViewMatrix[2];
+    mat4 u_stereoViewProjMatrix[2];
+    vec4 u_stereoEyePos[2];
+    vec4 u_stereoParams;
 };
 
+// Single-pass (instanced) stereo: each draw is issued with twice the instances and both eyes are rendered side-by-side
+// into one target. Vertex shaders pick the eye from gl_InstanceID, squeeze clip-space x into that eye's half and clip
+// at the seam. When stereo is inactive these reduce to the regular per-view values.
+bool is_stereo_instanced() { return u_stereoParams.x > 0.0; }
+mat4 get_view_matrix(int eye) { return is_stereo_instanced() ? u_stereoViewMatrix[eye] : u_viewMatrix; }
+mat4 get_view_proj_matrix(int eye) { return is_stereo_instanced() ? u_stereoViewProjMatrix[eye] : u_viewProjMatrix; }
+vec3 get_eye_position(int eye) { return is_stereo_instanced() ? u_stereoEyePos[eye].xyz : u_eyePos.xyz; }
+
+vec4 stereo_clip_position(vec4 clip, int eye)
+{
+    if (!is_stereo_instanced()) return clip;
+    clip.x = clip.x * 0.5 + (eye == 0 ? -0.5 : 0.5) * clip.w;
+    return clip;
+}
+
+float stereo_clip_distance(vec4 clip, int eye)
+{
+    if (!is_stereo_instanced()) return 1.0;
+    return (eye == 0) ? (clip.w - clip.x) : (clip.w + clip.x);
+}
+
 layout(binding = 2, std140) uniform PerObject
 {
     mat4 u_modelMatrix;
@@ -51,3 +67,35 @@ layout(binding = 2, std140) uniform PerObject
     mat4 u_modelViewMatrix;
     float u_receiveShadow;
 };
+
+// Vertex attributes as laid out by make_mesh_from_geometry (see VertexFormat in gl-mesh.hpp). Declare normal, tangent
+// and bitangent inputs as vec4 and decode them here; the defines come from VertexFormat::shader_defines().
+vec3 octahedral_decode(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0) v.xy = (1.0 - abs(v.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(v);
+}
+
+vec3 decode_vertex_direction(vec4 attribute)
+{
+#ifdef VERTEX_OCTAHEDRAL_NORMALS
+    return octahedral_decode(attribute.xy);
+#else
+    return attribute.xyz;
+#endif
+}
+
+vec3 decode_vertex_bitangent(vec3 normal, vec4 tangent, vec4 bitangent)
+{
+#ifdef VERTEX_DERIVED_BITANGENT
+    #ifdef VERTEX_OCTAHEDRAL_NORMALS
+    float handedness = tangent.z;
+    #else
+    float handedness = tangent.w;
+    #endif
+    return cross(normal, decode_vertex_direction(tangent)) * handedness;
+#else
+    return decode_vertex_direction(bitangent);
+#endif
+}
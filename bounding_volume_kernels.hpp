@@ -0,0 +1,480 @@
+#pragma once
+
+#ifndef bounding_volume_kernels_hpp
+#define bounding_volume_kernels_hpp
+
+// Batched frustum, sphere, box and ray tests over structure-of-arrays bounding volumes. The per-volume tests are the
+// same ones math-euclidean.hpp and math-ray.hpp perform on single objects, rewritten against simd_lanes.hpp so one
+// kernel runs on 1, 4 or 8 volumes at a time. Every entry point works on an index range [begin, end) and appends the
+// indices that pass to an output list, so callers can split a stream into chunks and cull them in parallel.
+
+#include "math-core.hpp"
+#include "oriented_bounding_box.hpp"
+#include "simd_lanes.hpp"
+#include "util.hpp"
+#include <vector>
+#include <random>
+
+using namespace avl;
+
+// Sphere centers and radii as parallel arrays
+struct SphereStream
+{
+    std::vector<float> x, y, z, r;
+
+    SphereStream(size_t count = 0) { resize(count); }
+    void resize(size_t count) { x.resize(count); y.resize(count); z.resize(count); r.resize(count); }
+    size_t size() const { return x.size(); }
+
+    void set(size_t i, const Sphere & s) { x[i] = s.center.x; y[i] = s.center.y; z[i] = s.center.z; r[i] = s.radius; }
+    Sphere get(size_t i) const { return Sphere({ x[i], y[i], z[i] }, r[i]); }
+};
+
+// Axis-aligned boxes as centers and half-extents, the form the plane and slab tests consume directly
+struct BoxStream
+{
+    std::vector<float> cx, cy, cz;
+    std::vector<float> ex, ey, ez;
+
+    BoxStream(size_t count = 0) { resize(count); }
+    void resize(size_t count) { cx.resize(count); cy.resize(count); cz.resize(count); ex.resize(count); ey.resize(count); ez.resize(count); }
+    size_t size() const { return cx.size(); }
+
+    void set(size_t i, const float3 & center, const float3 & halfExtents)
+    {
+        cx[i] = center.x; cy[i] = center.y; cz[i] = center.z;
+        ex[i] = halfExtents.x; ey[i] = halfExtents.y; ez[i] = halfExtents.z;
+    }
+    void set(size_t i, const Bounds3D & b) { set(i, b.center(), b.size() * 0.5f); }
+
+    float3 center(size_t i) const { return{ cx[i], cy[i], cz[i] }; }
+    float3 half_extents(size_t i) const { return{ ex[i], ey[i], ez[i] }; }
+    Bounds3D get(size_t i) const { return{ center(i) - half_extents(i), center(i) + half_extents(i) }; }
+};
+
+// Oriented boxes with their rotation expanded to three unit axes, so the kernels never touch quaternions
+struct OrientedBoxStream
+{
+    std::vector<float> cx, cy, cz;
+    std::vector<float> ex, ey, ez;
+    std::vector<float> axis[3][3]; // axis[a][c] = component c of local axis a
+
+    OrientedBoxStream(size_t count = 0) { resize(count); }
+    void resize(size_t count)
+    {
+        cx.resize(count); cy.resize(count); cz.resize(count); ex.resize(count); ey.resize(count); ez.resize(count);
+        for (auto & a : axis) for (auto & c : a) c.resize(count);
+    }
+    size_t size() const { return cx.size(); }
+
+    void set(size_t i, const OrientedBoundingBox & b)
+    {
+        cx[i] = b.center.x; cy[i] = b.center.y; cz[i] = b.center.z;
+        ex[i] = b.halfExtents.x; ey[i] = b.halfExtents.y; ez[i] = b.halfExtents.z;
+        const float3 axes[3] = { qxdir(b.orientation), qydir(b.orientation), qzdir(b.orientation) };
+        for (int a = 0; a < 3; ++a) for (int c = 0; c < 3; ++c) axis[a][c][i] = axes[a][c];
+    }
+};
+
+// Frustum planes split into one array per component, so a batch kernel broadcasts plane p with six scalar loads
+struct TransposedFrustum
+{
+    float nx[6], ny[6], nz[6], d[6];
+    float ax[6], ay[6], az[6]; // |n|, for projecting axis-aligned half-extents onto the normal
+
+    TransposedFrustum(const Frustum & f)
+    {
+        for (int p = 0; p < 6; ++p)
+        {
+            const float4 & q = f.planes[p].equation;
+            nx[p] = q.x; ny[p] = q.y; nz[p] = q.z; d[p] = q.w;
+            ax[p] = std::abs(q.x); ay[p] = std::abs(q.y); az[p] = std::abs(q.z);
+        }
+    }
+};
+
+namespace bounding_volume_impl
+{
+    // Runs `kernel` over [begin, end) W lanes at a time, finishing the remainder one element at a time, and appends
+    // the indices of passing lanes in order
+    template<typename T, typename Kernel>
+    inline void append_passing(const Kernel & kernel, size_t begin, size_t end, std::vector<uint32_t> & out)
+    {
+        const size_t W = simd::lane_traits<T>::width;
+        size_t i = begin;
+        for (; i + W <= end; i += W)
+        {
+            int mask = simd::movemask(kernel.template test<T>(i));
+            for (int lane = 0; mask; ++lane, mask >>= 1)
+            {
+                if (mask & 1) out.push_back(static_cast<uint32_t>(i + lane));
+            }
+        }
+        for (; i < end; ++i)
+        {
+            if (kernel.template test<float>(i)) out.push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    // Outside if the center is further than the radius behind any plane (Frustum::intersects(Sphere))
+    struct frustum_sphere_kernel
+    {
+        const TransposedFrustum & f;
+        const SphereStream & s;
+
+        template<typename T>
+        typename simd::lane_traits<T>::mask_type test(size_t i) const
+        {
+            const T x = simd::load<T>(&s.x[i]), y = simd::load<T>(&s.y[i]), z = simd::load<T>(&s.z[i]);
+            const T negR = -simd::load<T>(&s.r[i]);
+            auto inside = simd::greater(T(f.nx[0]) * x + T(f.ny[0]) * y + T(f.nz[0]) * z + T(f.d[0]), negR);
+            for (int p = 1; p < 6; ++p)
+            {
+                inside = inside & simd::greater(T(f.nx[p]) * x + T(f.ny[p]) * y + T(f.nz[p]) * z + T(f.d[p]), negR);
+            }
+            return inside;
+        }
+    };
+
+    // Outside if the box lies entirely behind any plane: dot(n, c) + d + dot(|n|, e) < 0 (Frustum::intersects(center, size))
+    struct frustum_box_kernel
+    {
+        const TransposedFrustum & f;
+        const BoxStream & b;
+
+        template<typename T>
+        typename simd::lane_traits<T>::mask_type test(size_t i) const
+        {
+            const T x = simd::load<T>(&b.cx[i]), y = simd::load<T>(&b.cy[i]), z = simd::load<T>(&b.cz[i]);
+            const T hx = simd::load<T>(&b.ex[i]), hy = simd::load<T>(&b.ey[i]), hz = simd::load<T>(&b.ez[i]);
+            auto inside = simd::greater_equal(T(f.nx[0]) * x + T(f.ny[0]) * y + T(f.nz[0]) * z + T(f.d[0]) + T(f.ax[0]) * hx + T(f.ay[0]) * hy + T(f.az[0]) * hz, T(0.f));
+            for (int p = 1; p < 6; ++p)
+            {
+                inside = inside & simd::greater_equal(T(f.nx[p]) * x + T(f.ny[p]) * y + T(f.nz[p]) * z + T(f.d[p]) + T(f.ax[p]) * hx + T(f.ay[p]) * hy + T(f.az[p]) * hz, T(0.f));
+            }
+            return inside;
+        }
+    };
+
+    // As above, with the half-extents projected along the box's own axes: e.x|n.u| + e.y|n.v| + e.z|n.w|
+    struct frustum_oriented_box_kernel
+    {
+        const TransposedFrustum & f;
+        const OrientedBoxStream & b;
+
+        template<typename T>
+        typename simd::lane_traits<T>::mask_type test(size_t i) const
+        {
+            const T x = simd::load<T>(&b.cx[i]), y = simd::load<T>(&b.cy[i]), z = simd::load<T>(&b.cz[i]);
+            const T hx = simd::load<T>(&b.ex[i]), hy = simd::load<T>(&b.ey[i]), hz = simd::load<T>(&b.ez[i]);
+            T u[3], v[3], w[3];
+            for (int c = 0; c < 3; ++c)
+            {
+                u[c] = simd::load<T>(&b.axis[0][c][i]);
+                v[c] = simd::load<T>(&b.axis[1][c][i]);
+                w[c] = simd::load<T>(&b.axis[2][c][i]);
+            }
+
+            auto inside = simd::greater_equal(T(1.f), T(0.f));
+            for (int p = 0; p < 6; ++p)
+            {
+                const T nx(f.nx[p]), ny(f.ny[p]), nz(f.nz[p]);
+                const T radius = hx * simd::abs(nx * u[0] + ny * u[1] + nz * u[2])
+                               + hy * simd::abs(nx * v[0] + ny * v[1] + nz * v[2])
+                               + hz * simd::abs(nx * w[0] + ny * w[1] + nz * w[2]);
+                inside = inside & simd::greater_equal(nx * x + ny * y + nz * z + T(f.d[p]) + radius, T(0.f));
+            }
+            return inside;
+        }
+    };
+
+    // Squared distance from the sphere center to each box, clamped per axis: max(|c_box - c| - e, 0)
+    struct sphere_box_kernel
+    {
+        float3 c;
+        float radiusSquared;
+        const BoxStream & b;
+
+        template<typename T>
+        typename simd::lane_traits<T>::mask_type test(size_t i) const
+        {
+            const T dx = simd::max(simd::abs(simd::load<T>(&b.cx[i]) - T(c.x)) - simd::load<T>(&b.ex[i]), T(0.f));
+            const T dy = simd::max(simd::abs(simd::load<T>(&b.cy[i]) - T(c.y)) - simd::load<T>(&b.ey[i]), T(0.f));
+            const T dz = simd::max(simd::abs(simd::load<T>(&b.cz[i]) - T(c.z)) - simd::load<T>(&b.ez[i]), T(0.f));
+            return simd::less_equal(dx * dx + dy * dy + dz * dz, T(radiusSquared));
+        }
+    };
+
+    // Slab test with the reciprocal direction hoisted out of the loop. Entry distances are clamped to 0, so rays that
+    // start inside a box report 0. A ray lying exactly in a slab plane with a zero direction component may miss.
+    struct ray_box_kernel
+    {
+        float3 origin, invDirection;
+        float maxT;
+        const BoxStream & b;
+
+        template<typename T>
+        typename simd::lane_traits<T>::mask_type test(size_t i, T & tEnter) const
+        {
+            T tNear(0.f), tFar(maxT);
+            const float * centers[3] = { &b.cx[i], &b.cy[i], &b.cz[i] };
+            const float * extents[3] = { &b.ex[i], &b.ey[i], &b.ez[i] };
+            for (int a = 0; a < 3; ++a)
+            {
+                const T c = simd::load<T>(centers[a]) - T(origin[a]), e = simd::load<T>(extents[a]);
+                const T t0 = (c - e) * T(invDirection[a]), t1 = (c + e) * T(invDirection[a]);
+                tNear = simd::max(tNear, simd::min(t0, t1));
+                tFar = simd::min(tFar, simd::max(t0, t1));
+            }
+            tEnter = tNear;
+            return simd::less_equal(tNear, tFar);
+        }
+    };
+
+    template<typename T>
+    inline void ray_boxes_range(const ray_box_kernel & kernel, size_t begin, size_t end, std::vector<uint32_t> & hits, std::vector<float> * distances)
+    {
+        const size_t W = simd::lane_traits<T>::width;
+        size_t i = begin;
+        for (; i + W <= end; i += W)
+        {
+            T t;
+            int mask = simd::movemask(kernel.test<T>(i, t));
+            if (!mask) continue;
+            float lanes[simd::lane_traits<T>::width];
+            simd::store(lanes, t);
+            for (int lane = 0; mask; ++lane, mask >>= 1)
+            {
+                if (!(mask & 1)) continue;
+                hits.push_back(static_cast<uint32_t>(i + lane));
+                if (distances) distances->push_back(lanes[lane]);
+            }
+        }
+        for (; i < end; ++i)
+        {
+            float t;
+            if (!kernel.test<float>(i, t)) continue;
+            hits.push_back(static_cast<uint32_t>(i));
+            if (distances) distances->push_back(t);
+        }
+    }
+
+    inline size_t clamp_end(size_t end, size_t size) { return std::min(end, size); }
+}
+
+/////////////////////////////
+//   Public batch entry    //
+/////////////////////////////
+
+// Each function appends the indices in [begin, end) that pass the test to `out`; `end` defaults to the stream size.
+// The lane type defaults to the widest available; pass float (or simd::float_x4) to pin a narrower path.
+
+template<typename T = simd::float_xN>
+inline void frustum_cull_spheres(const TransposedFrustum & f, const SphereStream & spheres, std::vector<uint32_t> & out, size_t begin = 0, size_t end = SIZE_MAX)
+{
+    bounding_volume_impl::append_passing<T>(bounding_volume_impl::frustum_sphere_kernel{ f, spheres }, begin, bounding_volume_impl::clamp_end(end, spheres.size()), out);
+}
+
+template<typename T = simd::float_xN>
+inline void frustum_cull_boxes(const TransposedFrustum & f, const BoxStream & boxes, std::vector<uint32_t> & out, size_t begin = 0, size_t end = SIZE_MAX)
+{
+    bounding_volume_impl::append_passing<T>(bounding_volume_impl::frustum_box_kernel{ f, boxes }, begin, bounding_volume_impl::clamp_end(end, boxes.size()), out);
+}
+
+template<typename T = simd::float_xN>
+inline void frustum_cull_oriented_boxes(const TransposedFrustum & f, const OrientedBoxStream & boxes, std::vector<uint32_t> & out, size_t begin = 0, size_t end = SIZE_MAX)
+{
+    bounding_volume_impl::append_passing<T>(bounding_volume_impl::frustum_oriented_box_kernel{ f, boxes }, begin, bounding_volume_impl::clamp_end(end, boxes.size()), out);
+}
+
+// Boxes that touch or contain the sphere
+template<typename T = simd::float_xN>
+inline void sphere_overlap_boxes(const Sphere & s, const BoxStream & boxes, std::vector<uint32_t> & out, size_t begin = 0, size_t end = SIZE_MAX)
+{
+    bounding_volume_impl::append_passing<T>(bounding_volume_impl::sphere_box_kernel{ s.center, s.radius * s.radius, boxes }, begin, bounding_volume_impl::clamp_end(end, boxes.size()), out);
+}
+
+// Boxes hit by `ray` within [0, maxT], with the entry distance of each hit in `distances` when it is non-null
+template<typename T = simd::float_xN>
+inline void intersect_ray_boxes(const Ray & ray, const BoxStream & boxes, std::vector<uint32_t> & hits, std::vector<float> * distances = nullptr,
+    float maxT = std::numeric_limits<float>::max(), size_t begin = 0, size_t end = SIZE_MAX)
+{
+    const bounding_volume_impl::ray_box_kernel kernel{ ray.origin, 1.f / ray.direction, maxT, boxes };
+    bounding_volume_impl::ray_boxes_range<T>(kernel, begin, bounding_volume_impl::clamp_end(end, boxes.size()), hits, distances);
+}
+
+namespace bounding_volume_kernels_tests
+{
+    inline Frustum make_test_frustum()
+    {
+        const float4x4 proj = make_projection_matrix(to_radians(60.f), 1.5f, 0.1f, 50.f);
+        const float4x4 view = inverse(Pose(make_rotation_quat_axis_angle(normalize(float3(0.3f, 1.f, 0.1f)), 0.7f), float3(1, 2, 3)).matrix());
+        return Frustum(mul(proj, view));
+    }
+
+    inline OrientedBoundingBox random_oriented_box(std::mt19937 & gen)
+    {
+        std::uniform_real_distribution<float> pos(-60.f, 60.f), ext(0.05f, 4.f), q(-1.f, 1.f);
+        return OrientedBoundingBox({ pos(gen), pos(gen), pos(gen) }, { ext(gen), ext(gen), ext(gen) }, normalize(float4(q(gen), q(gen), q(gen), q(gen))));
+    }
+
+    // Counts that are not a multiple of 8 exercise the scalar tails
+    inline void execute()
+    {
+        std::mt19937 gen(2468);
+        const Frustum frustum = make_test_frustum();
+        const TransposedFrustum tf(frustum);
+        const size_t count = 1003;
+
+        SphereStream spheres(count);
+        BoxStream boxes(count);
+        OrientedBoxStream obbs(count);
+        std::vector<OrientedBoundingBox> obbList;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const OrientedBoundingBox b = random_oriented_box(gen);
+            spheres.set(i, Sphere(b.center, b.calc_radius()));
+            boxes.set(i, b.center, b.halfExtents);
+            obbs.set(i, b);
+            obbList.push_back(b);
+        }
+
+        // Scalar and wide paths agree with the single-object tests in math-euclidean.hpp
+        {
+            std::vector<uint32_t> expected, scalar, wide;
+            for (size_t i = 0; i < count; ++i) if (frustum.intersects(spheres.get(i).center, spheres.get(i).radius)) expected.push_back(uint32_t(i));
+            frustum_cull_spheres<float>(tf, spheres, scalar);
+            frustum_cull_spheres(tf, spheres, wide);
+            assert(expected == scalar);
+            assert(expected == wide);
+        }
+        {
+            std::vector<uint32_t> expected, scalar, wide;
+            for (size_t i = 0; i < count; ++i) if (frustum.intersects(boxes.center(i), boxes.half_extents(i) * 2.f)) expected.push_back(uint32_t(i));
+            frustum_cull_boxes<float>(tf, boxes, scalar);
+            frustum_cull_boxes(tf, boxes, wide);
+            assert(expected == scalar);
+            assert(expected == wide);
+            assert(!expected.empty() && expected.size() < count);
+        }
+
+        // An OBB never passes when its bounding sphere is rejected
+        {
+            std::vector<uint32_t> scalar, wide, sphereVisible;
+            frustum_cull_oriented_boxes<float>(tf, obbs, scalar);
+            frustum_cull_oriented_boxes(tf, obbs, wide);
+            assert(scalar == wide);
+            frustum_cull_spheres(tf, spheres, sphereVisible);
+            for (const uint32_t i : wide) assert(std::binary_search(sphereVisible.begin(), sphereVisible.end(), i));
+
+            // Axis-aligned orientation must reduce to the box test exactly
+            OrientedBoxStream aligned(count);
+            for (size_t i = 0; i < count; ++i) aligned.set(i, OrientedBoundingBox(obbList[i].center, obbList[i].halfExtents, float4(0, 0, 0, 1)));
+            std::vector<uint32_t> alignedVisible, boxVisible;
+            frustum_cull_oriented_boxes(tf, aligned, alignedVisible);
+            frustum_cull_boxes(tf, boxes, boxVisible);
+            assert(alignedVisible == boxVisible);
+        }
+
+        // Sub-ranges append in order and cover exactly the same set
+        {
+            std::vector<uint32_t> whole, pieces;
+            frustum_cull_boxes(tf, boxes, whole);
+            for (size_t begin = 0; begin < count; begin += 100) frustum_cull_boxes(tf, boxes, pieces, begin, begin + 100);
+            assert(whole == pieces);
+        }
+
+        // Sphere vs box
+        {
+            const Sphere probe({ 2, -1, 5 }, 20.f);
+            std::vector<uint32_t> expected, wide;
+            for (size_t i = 0; i < count; ++i)
+            {
+                const Bounds3D b = boxes.get(i);
+                const float3 closest = clamp(probe.center, b.min(), b.max());
+                if (length2(closest - probe.center) <= probe.radius * probe.radius) expected.push_back(uint32_t(i));
+            }
+            sphere_overlap_boxes(probe, boxes, wide);
+            assert(expected == wide);
+        }
+
+        // Ray vs box, against intersect_ray_box in math-ray.hpp
+        {
+            const Ray ray({ -70, 0.5f, 0.25f }, normalize(float3(1.f, 0.02f, 0.01f)));
+            std::vector<uint32_t> expected, wide, scalar;
+            std::vector<float> expectedT, wideT;
+            for (size_t i = 0; i < count; ++i)
+            {
+                float tMin, tMax;
+                const Bounds3D b = boxes.get(i);
+                if (intersect_ray_box(ray, b.min(), b.max(), &tMin, &tMax) && tMax >= 0.f)
+                {
+                    expected.push_back(uint32_t(i));
+                    expectedT.push_back(std::max(tMin, 0.f));
+                }
+            }
+            intersect_ray_boxes(ray, boxes, wide, &wideT);
+            intersect_ray_boxes<float>(ray, boxes, scalar);
+            assert(expected == wide);
+            assert(expected == scalar);
+            for (size_t k = 0; k < expected.size(); ++k) assert(std::abs(expectedT[k] - wideT[k]) < 1e-3f);
+
+            std::vector<uint32_t> near;
+            intersect_ray_boxes(ray, boxes, near, nullptr, 60.f);
+            for (const uint32_t i : near) assert(std::binary_search(expected.begin(), expected.end(), i));
+        }
+    }
+
+    inline void benchmark(const size_t count = 1000000)
+    {
+        std::mt19937 gen(1357);
+        const Frustum frustum = make_test_frustum();
+        const TransposedFrustum tf(frustum);
+
+        std::vector<Bounds3D> aosBoxes(count);
+        BoxStream boxes(count);
+        OrientedBoxStream obbs(count);
+        SphereStream spheres(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const OrientedBoundingBox b = random_oriented_box(gen);
+            boxes.set(i, b.center, b.halfExtents);
+            aosBoxes[i] = boxes.get(i);
+            obbs.set(i, b);
+            spheres.set(i, Sphere(b.center, b.calc_radius()));
+        }
+
+        std::vector<uint32_t> out;
+        out.reserve(count);
+        size_t checksum = 0;
+        const std::string wide = std::to_string(simd::lane_traits<simd::float_xN>::width) + "-wide";
+
+        {
+            AVL_SCOPED_TIMER("Frustum::intersects(center, size) (per object)");
+            for (size_t i = 0; i < count; ++i) if (frustum.intersects(aosBoxes[i].center(), aosBoxes[i].size())) checksum++;
+        }
+        { out.clear(); AVL_SCOPED_TIMER("frustum_cull_boxes (scalar)"); frustum_cull_boxes<float>(tf, boxes, out); checksum += out.size(); }
+    #if defined(ANVIL_SIMD_SSE)
+        { out.clear(); AVL_SCOPED_TIMER("frustum_cull_boxes (4-wide)"); frustum_cull_boxes<simd::float_x4>(tf, boxes, out); checksum += out.size(); }
+    #endif
+    #if defined(ANVIL_SIMD_AVX)
+        { out.clear(); AVL_SCOPED_TIMER("frustum_cull_boxes (8-wide)"); frustum_cull_boxes<simd::float_x8>(tf, boxes, out); checksum += out.size(); }
+    #endif
+        { out.clear(); AVL_SCOPED_TIMER("frustum_cull_spheres (scalar)"); frustum_cull_spheres<float>(tf, spheres, out); checksum += out.size(); }
+        { out.clear(); AVL_SCOPED_TIMER("frustum_cull_spheres (" + wide + ")"); frustum_cull_spheres(tf, spheres, out); checksum += out.size(); }
+        { out.clear(); AVL_SCOPED_TIMER("frustum_cull_oriented_boxes (scalar)"); frustum_cull_oriented_boxes<float>(tf, obbs, out); checksum += out.size(); }
+        { out.clear(); AVL_SCOPED_TIMER("frustum_cull_oriented_boxes (" + wide + ")"); frustum_cull_oriented_boxes(tf, obbs, out); checksum += out.size(); }
+
+        const Ray ray({ -70, 0.5f, 0.25f }, normalize(float3(1.f, 0.02f, 0.01f)));
+        {
+            AVL_SCOPED_TIMER("intersect_ray_box (per object)");
+            for (size_t i = 0; i < count; ++i) if (intersect_ray_box(ray, aosBoxes[i].min(), aosBoxes[i].max())) checksum++;
+        }
+        { out.clear(); AVL_SCOPED_TIMER("intersect_ray_boxes (scalar)"); intersect_ray_boxes<float>(ray, boxes, out); checksum += out.size(); }
+        { out.clear(); AVL_SCOPED_TIMER("intersect_ray_boxes (" + wide + ")"); intersect_ray_boxes(ray, boxes, out); checksum += out.size(); }
+
+        std::cout << "checksum: " << checksum << std::endl;
+    }
+}
+
+#endif // end bounding_volume_kernels_hpp
@@ -6,6 +6,8 @@
 #define circular_buffer_h
 
 #include <type_traits>
+#include <random>
+#include <cassert>
 #include "math-core.hpp"
 
 using namespace avl;
@@ -166,8 +168,8 @@ T compute_min(const CircularBuffer<T> & b)
 template<typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value, T>::type>
 T compute_max(const CircularBuffer<T> & b)
 {
-    T max = std::numeric_limits<T>::min();
-    for (size_t i = 0; i < b.get_current_size(); i++) if (buffer[i] > max) max = buffer[i];
+    T max = std::numeric_limits<T>::lowest();
+    for (size_t i = 0; i < b.get_current_size(); i++) if (b[i] > max) max = b[i];
     return max;
 }
 
@@ -210,6 +212,68 @@ double compute_confidence(const CircularBuffer<T> & b)
     return clamp(c, 0.0, 1.0) * (double) b.get_current_size() / (double) b.get_maximum_size();
 }
 
+// Windowed mean and variance in O(1) per sample instead of the O(window) passes of compute_mean / compute_variance.
+// Each put() adds the new sample and, once the window is full, removes the evicted one with Welford's update in double
+// precision. The sums are recomputed exactly from the window every `window size` puts so rounding drift stays bounded.
+template<typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value, T>::type>
+class SlidingWindowStats
+{
+    CircularBuffer<T> window;
+    double mean { 0.0 };
+    double m2 { 0.0 };          // sum of squared deviations from the mean
+    size_t sinceRecompute { 0 };
+
+    void recompute()
+    {
+        const size_t n = window.get_current_size();
+        mean = m2 = 0.0;
+        for (size_t i = 0; i < n; i++) mean += double(window[i]);
+        mean /= double(n);
+        for (size_t i = 0; i < n; i++) m2 += (double(window[i]) - mean) * (double(window[i]) - mean);
+        sinceRecompute = 0;
+    }
+
+public:
+
+    SlidingWindowStats(size_t windowSize) : window(windowSize) { }
+
+    void put(const T & value)
+    {
+        const double x = double(value);
+        if (window.is_full())
+        {
+            const double evicted = double(window[0]);
+            const double previousMean = mean;
+            mean += (x - evicted) / double(window.get_maximum_size());
+            m2 += (x - evicted) * (x - mean + evicted - previousMean);
+        }
+        else
+        {
+            const double delta = x - mean;
+            mean += delta / double(window.get_current_size() + 1);
+            m2 += delta * (x - mean);
+        }
+        window.put(value);
+        if (++sinceRecompute >= window.get_maximum_size()) recompute();
+    }
+
+    void clear()
+    {
+        window.reset();
+        mean = m2 = 0.0;
+        sinceRecompute = 0;
+    }
+
+    double compute_mean() const { return mean; }
+
+    // Population variance, like compute_variance(CircularBuffer)
+    double compute_variance() const { return window.get_current_size() ? std::max(m2, 0.0) / double(window.get_current_size()) : 0.0; }
+
+    double compute_std_dev() const { return std::sqrt(compute_variance()); }
+
+    const CircularBuffer<T> & get_window() const { return window; }
+};
+
 // https://manialabs.wordpress.com/2012/08/06/covariance-matrices-with-a-practical-example/
 // http://www.cse.psu.edu/~rtc12/CSE586Spring2010/lectures/pcaLectureShort_6pp.pdf
 // https://en.wikipedia.org/wiki/Sample_mean_and_covariance#Sample_covariance
@@ -259,4 +323,31 @@ inline linalg::aliases::float3 compute_pearson_coefficient(const CircularBuffer<
     return pearson;
 }
 
+namespace circular_buffer_tests
+{
+    inline void execute()
+    {
+        // SlidingWindowStats tracks the two-pass results while the window fills, once it wraps, and around each
+        // periodic recompute. The large offset makes the incremental path's cancellation error visible if it drifts.
+        const size_t windowSize = 64;
+        SlidingWindowStats<double> stats(windowSize);
+        std::mt19937 gen(5);
+        std::normal_distribution<double> noise(0.0, 3.0);
+
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            for (size_t i = 0; i < windowSize * 10 + 7; ++i)
+            {
+                stats.put(1e4 + noise(gen) + (i > windowSize * 5 ? 50.0 : 0.0)); // a step change must wash out of the window
+                const double mean = compute_mean(stats.get_window()), variance = compute_variance(stats.get_window());
+                assert(stats.get_window().get_current_size() == std::min(i + 1, windowSize));
+                assert(std::abs(stats.compute_mean() - mean) < 1e-9 * std::abs(mean));
+                assert(std::abs(stats.compute_variance() - variance) < 1e-6 * std::max(variance, 1.0));
+            }
+            stats.clear();
+            assert(stats.get_window().get_current_size() == 0 && stats.compute_variance() == 0.0);
+        }
+    }
+}
+
 #endif // circular_buffer_h
@@ -220,6 +220,7 @@ void shader_workbench::on_draw()
             */
 
             clusteredShader.unbind();
+            clusteredLighting->stream.end_frame();
         }
 
         renderTimer.stop();
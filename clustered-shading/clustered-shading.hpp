@@ -173,9 +173,9 @@ struct ClusteredShading
     float vFov;
     float aspect;
 
-    GlBuffer lightingBuffer;
-    GlBuffer lightIndexBuffer;
-    GlTexture2D lightIndexTexture;
+    GlStreamingBuffer stream;           // lighting block and light indices, rewritten every frame
+    GlTexture2D lightIndexTexture;      // views this frame's index range of `stream`
+    GLint textureBufferAlignment{ 16 };
     GlTexture3D clusterTexture;
 
     enum class LightType
@@ -208,14 +208,11 @@ struct ClusteredShading
         glTextureParameteriEXT(clusterTexture, GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
         glTextureParameteriEXT(clusterTexture, GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 
-        // Setup the index light buffer
-        glNamedBufferData(lightIndexBuffer, maxLights * sizeof(uint16_t), nullptr, GL_DYNAMIC_DRAW); // DSA glBufferData
-
-        // Setup the light index texture
+        // Setup the light index texture; its storage is attached per frame in upload()
         GLuint lib;
         glCreateTextures(GL_TEXTURE_BUFFER, 1, &lib);
         lightIndexTexture = GlTexture2D(lib);
-        glTextureBuffer(lightIndexTexture, GL_R16UI, lightIndexBuffer); // DSA for glTexBuffer
+        glGetIntegerv(GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT, &textureBufferAlignment);
 
         gl_check_error(__FILE__, __LINE__);
     }
@@ -328,14 +325,14 @@ struct ClusteredShading
         }
         
         // Update clustered lighting UBO
-        glBindBufferBase(GL_UNIFORM_BUFFER, uniforms::clustered_lighting_buffer::binding, lightingBuffer);
         uniforms::clustered_lighting_buffer lighting = {};
         for (int l = 0, n = std::min<int>(lights.size(), uniforms::MAX_POINT_LIGHTS); l < n; l++) lighting.lights[l] = lights[l];
-        lightingBuffer.set_buffer_data(sizeof(lighting), &lighting, GL_STREAM_DRAW);
+        stream.bind_uniform(uniforms::clustered_lighting_buffer::binding, lighting);
 
-        // Update Index Data
-        glBindBuffer(GL_TEXTURE_BUFFER, lightIndexBuffer);
-        lightIndexBuffer.set_buffer_data(sizeof(uint16_t) * packedLightIndices.size(), packedLightIndices.data(), GL_STREAM_DRAW); // fixme to use subData
+        // Update Index Data (never empty, a zero-sized texture buffer range is invalid)
+        if (packedLightIndices.empty()) packedLightIndices.push_back(0);
+        const GlStreamingRange indexRange = stream.upload(packedLightIndices.data(), sizeof(uint16_t) * packedLightIndices.size(), std::max(16, textureBufferAlignment));
+        glTextureBufferRange(lightIndexTexture, GL_R16UI, indexRange.buffer, indexRange.offset, indexRange.size);
 
         // Update cluster grid
         glTextureSubImage3D(clusterTexture, 0, 0, 0, 0, NumClustersX, NumClustersY, NumClustersZ, GL_RG_INTEGER, GL_UNSIGNED_INT, (void *)clusterTable.data());
@@ -0,0 +1,351 @@
+// Content-addressed cache for imported models. A cooked model (rescaled, with normals and tangents generated) is keyed
+// by a hash of the source file's bytes together with the import settings and the cook/format versions, so dropping
+// an unchanged file again reads the cooked .mesh files instead of re-parsing the source and recomputing everything.
+// Cooking and cache reads both run on worker threads; update() hands finished geometry to the caller on its own
+// thread, where GPU resources can be created. A name index (index.txt) maps published asset names to cooked files,
+// so a scene that was saved with imported meshes resolves them on startup without touching the original sources.
+
+#ifndef derived_data_cache_hpp
+#define derived_data_cache_hpp
+
+#include "geometry.hpp"
+#include "string_utils.hpp"
+#include "util.hpp"
+#include "mpmc_blocking_queue.hpp"
+#include "mpsc_queue.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace avl;
+
+// Everything that changes the cooked output must be in here, since it is part of the cache key
+struct ModelImportSettings
+{
+    float rescaleRadius{ 1.f };         // <= 0 keeps the source scale
+    bool generateNormals{ true };       // only for meshes that have none
+    bool generateTangents{ true };      // likewise
+    NormalWeighting normalWeighting{ NormalWeighting::uniform };
+
+    std::string to_string() const
+    {
+        std::ostringstream s;
+        s << "rescale=" << rescaleRadius << ";normals=" << generateNormals << ";tangents=" << generateTangents << ";weighting=" << int(normalWeighting);
+        return s.str();
+    }
+};
+
+// 64-bit FNV-1a, continuing from `h`
+inline uint64_t hash_bytes(const void * data, const size_t size, uint64_t h = 14695981039346656037ull)
+{
+    const uint8_t * bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; ++i) h = (h ^ bytes[i]) * 1099511628211ull;
+    return h;
+}
+
+// Hashes a file in fixed-size blocks, so large sources are never held in memory just to be keyed
+inline uint64_t hash_file_contents(const std::string & path, uint64_t h = 14695981039346656037ull)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.good()) throw std::runtime_error("couldn't open " + path);
+
+    std::vector<char> block(size_t(1) << 20);
+    while (file)
+    {
+        file.read(block.data(), block.size());
+        h = hash_bytes(block.data(), static_cast<size_t>(file.gcount()), h);
+    }
+    return h;
+}
+
+class DerivedDataCache : public Noncopyable
+{
+public:
+
+    // Receives each imported or reloaded mesh; typically creates the GlMesh and Geometry handles for it
+    typedef std::function<void(const std::string & assetName, Geometry && geometry)> PublishCallback;
+
+    struct Stats
+    {
+        size_t cooked{ 0 };         // meshes imported from source and written to the cache
+        size_t cacheHits{ 0 };      // meshes read from the cache instead of being cooked
+        size_t failed{ 0 };
+        size_t pending{ 0 };        // requests still on the workers
+    };
+
+private:
+
+    constexpr static const int COOK_VERSION = 1; // bump when the cooking steps change
+
+    struct Request
+    {
+        std::string sourcePath;     // cook request
+        ModelImportSettings settings;
+        std::string assetName;      // reload request (with meshFile)
+        std::string meshFile;
+        bool quit{ false };
+    };
+
+    struct Result
+    {
+        std::string sourcePath;
+        std::string assetName;
+        std::string meshFile;
+        Geometry geometry;
+        std::string error;
+        bool cacheHit{ false };
+        bool done{ false };         // last result for its request
+    };
+
+    std::string directory;
+    PublishCallback publish;
+
+    std::unordered_map<std::string, std::string> index; // asset name -> cooked .mesh file
+    bool indexDirty{ false };
+    std::unordered_set<std::string> inFlight;           // source paths and asset names queued on the workers
+
+    std::vector<std::thread> workers;
+    MPMCBlockingQueue<Request> requests;
+    MPSCQueue<Result *> results;
+    std::atomic<size_t> pending{ 0 };
+    Stats stats;
+
+    std::string index_path() const { return directory + "index.txt"; }
+
+    static bool file_exists(const std::string & path) { return std::ifstream(path).good(); }
+
+    static std::string key_to_string(const uint64_t key)
+    {
+        char buffer[17];
+        std::snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(key));
+        return buffer;
+    }
+
+    static void prepare(Geometry & mesh, const ModelImportSettings & settings)
+    {
+        if (settings.rescaleRadius > 0.f) rescale_geometry(mesh, settings.rescaleRadius);
+        if (settings.generateNormals && mesh.normals.size() == 0) compute_normals(mesh, true, settings.normalWeighting);
+        if (settings.generateTangents && mesh.tangents.size() == 0) compute_tangents(mesh);
+    }
+
+    // Runs on a worker. Every submesh is reported as its own result, followed by a `done` result that carries the
+    // error, if any; failures are reported rather than thrown across threads.
+    void cook(const Request & r)
+    {
+        const std::string baseName = get_filename_without_extension(r.sourcePath);
+        Result * done = new Result();
+        done->sourcePath = r.sourcePath;
+        done->done = true;
+
+        try
+        {
+            const std::string settingsKey = r.settings.to_string() + ";cook=" + std::to_string(COOK_VERSION) + ";mesh=" + std::to_string(runtime_mesh_binary_version);
+            const uint64_t key = hash_bytes(settingsKey.data(), settingsKey.size(), hash_file_contents(r.sourcePath));
+            const std::string stem = directory + key_to_string(key);
+            const std::string manifestPath = stem + ".manifest";
+
+            // The manifest is written last, so its presence means every submesh file was complete at some point;
+            // if any has been deleted since, the model is simply cooked again
+            std::vector<std::string> submeshes;
+            std::ifstream manifest(manifestPath);
+            for (std::string line; std::getline(manifest, line);) submeshes.push_back(line);
+
+            bool complete = manifest.eof() && !submeshes.empty();
+            for (size_t i = 0; complete && i < submeshes.size(); ++i) complete = file_exists(stem + "-" + std::to_string(i) + ".mesh");
+
+            if (complete)
+            {
+                for (size_t i = 0; i < submeshes.size(); ++i)
+                {
+                    const std::string meshFile = stem + "-" + std::to_string(i) + ".mesh";
+                    Geometry geometry = import_mesh_binary(meshFile);
+                    Result * result = new Result();
+                    result->sourcePath = r.sourcePath;
+                    result->assetName = baseName + "-" + submeshes[i];
+                    result->meshFile = meshFile;
+                    result->geometry = std::move(geometry);
+                    result->cacheHit = true;
+                    results.produce(result);
+                }
+                results.produce(done);
+                return;
+            }
+
+            std::map<std::string, runtime_mesh> model = import_model(r.sourcePath);
+            std::ostringstream manifestText;
+            int i = 0;
+            for (auto & m : model)
+            {
+                std::unique_ptr<Result> result(new Result());
+                result->sourcePath = r.sourcePath;
+                result->assetName = baseName + "-" + m.first;
+                result->meshFile = stem + "-" + std::to_string(i++) + ".mesh";
+                result->geometry = std::move(m.second);
+                prepare(result->geometry, r.settings);
+                export_mesh_binary(result->meshFile, result->geometry, false);
+                manifestText << m.first << "\n";
+                results.produce(result.release());
+            }
+
+            const std::string staging = manifestPath + ".tmp";
+            write_file_text(staging, manifestText.str());
+            std::remove(manifestPath.c_str());
+            if (std::rename(staging.c_str(), manifestPath.c_str()) != 0) throw std::runtime_error("couldn't write " + manifestPath);
+        }
+        catch (const std::exception & e)
+        {
+            done->error = e.what();
+        }
+        results.produce(done);
+    }
+
+    void reload(const Request & r)
+    {
+        Result * result = new Result();
+        result->assetName = r.assetName;
+        result->meshFile = r.meshFile;
+        result->cacheHit = true;
+        result->done = true;
+        try
+        {
+            if (!file_exists(r.meshFile)) throw std::runtime_error("cooked file is missing");
+            result->geometry = import_mesh_binary(r.meshFile);
+        }
+        catch (const std::exception & e)
+        {
+            result->error = e.what();
+        }
+        results.produce(result);
+    }
+
+    void worker_loop()
+    {
+        while (true)
+        {
+            Request r;
+            requests.wait_and_consume(r);
+            if (r.quit) return;
+            if (!r.sourcePath.empty()) cook(r);
+            else reload(r);
+            pending--;
+        }
+    }
+
+    void load_index()
+    {
+        std::ifstream file(index_path());
+        std::string line;
+        while (std::getline(file, line))
+        {
+            const size_t tab = line.find('\t');
+            if (tab != std::string::npos) index[line.substr(0, tab)] = line.substr(tab + 1);
+        }
+    }
+
+    void save_index()
+    {
+        std::ostringstream s;
+        for (const auto & e : index) s << e.first << "\t" << e.second << "\n";
+        write_file_text(index_path(), s.str());
+        indexDirty = false;
+    }
+
+public:
+
+    // `cacheDirectory` must exist; it holds the cooked meshes, their manifests and the name index
+    DerivedDataCache(const std::string & cacheDirectory, PublishCallback publish, const int numWorkers = 2)
+        : directory(cacheDirectory), publish(publish)
+    {
+        if (!directory.empty() && directory.back() != '/' && directory.back() != '\\') directory += '/';
+        load_index();
+        for (int i = 0; i < std::max(1, numWorkers); ++i) workers.emplace_back(&DerivedDataCache::worker_loop, this);
+    }
+
+    ~DerivedDataCache()
+    {
+        Request quit;
+        quit.quit = true;
+        for (size_t i = 0; i < workers.size(); ++i) requests.produce(quit);
+        for (auto & w : workers) w.join();
+
+        Result * result;
+        while (results.consume(result)) delete result;
+        if (indexDirty) save_index();
+    }
+
+    // Imports a model file; each submesh is published as "<file name>-<submesh name>". Unchanged sources that were
+    // cooked before with the same settings are read straight from the cache.
+    void request_model(const std::string & sourcePath, const ModelImportSettings & settings = {})
+    {
+        if (!inFlight.insert(sourcePath).second) return;
+        Request r;
+        r.sourcePath = sourcePath;
+        r.settings = settings;
+        pending++;
+        requests.produce(r);
+    }
+
+    // Republishes a mesh cooked in an earlier session. False if the index has never seen `assetName`.
+    bool request_cooked(const std::string & assetName)
+    {
+        const auto it = index.find(assetName);
+        if (it == index.end()) return false;
+        if (!inFlight.insert(assetName).second) return true;
+        Request r;
+        r.assetName = assetName;
+        r.meshFile = it->second;
+        pending++;
+        requests.produce(r);
+        return true;
+    }
+
+    bool is_indexed(const std::string & assetName) const { return index.count(assetName) != 0; }
+
+    // Call regularly on the thread that owns the published assets
+    void update()
+    {
+        Result * raw;
+        while (results.consume(raw))
+        {
+            std::unique_ptr<Result> result(raw);
+
+            if (!result->error.empty())
+            {
+                std::cout << "model import failed for " << (result->sourcePath.empty() ? result->assetName : result->sourcePath) << ": " << result->error << std::endl;
+                stats.failed++;
+            }
+            else if (!result->meshFile.empty())
+            {
+                if (result->cacheHit) stats.cacheHits++;
+                else stats.cooked++;
+
+                if (index[result->assetName] != result->meshFile)
+                {
+                    index[result->assetName] = result->meshFile;
+                    indexDirty = true;
+                }
+                publish(result->assetName, std::move(result->geometry));
+            }
+
+            if (result->done)
+            {
+                inFlight.erase(result->sourcePath);
+                inFlight.erase(result->assetName);
+            }
+        }
+
+        stats.pending = pending;
+        if (indexDirty && pending == 0) save_index();
+    }
+
+    Stats get_stats() const { return stats; }
+};
+
+#endif // end derived_data_cache_hpp
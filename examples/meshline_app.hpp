@@ -15,7 +15,8 @@ struct ExperimentalApp : public GLFWApp
     
     std::vector<float3> colors;
     std::vector<float> sizes;
-    std::vector<std::shared_ptr<GlRenderableMeshline>> lines;
+    std::vector<std::vector<float3>> lines;
+    GlPolylineBatch lineBatch;
     
     float rotationAngle = 0.0f;
     
@@ -49,10 +50,7 @@ struct ExperimentalApp : public GLFWApp
         
         for (int i = 0; i < 256; i++)
         {
-            auto line = std::make_shared<GlRenderableMeshline>();
-            auto newSpline = create_curve(8.f, 48.f);
-            line->set_vertices(newSpline);
-            lines.push_back(line);
+            lines.push_back(create_curve(8.f, 48.f));
         }
 
         for (int i = 0; i < 256; ++i)
@@ -91,11 +89,7 @@ struct ExperimentalApp : public GLFWApp
         
         auto sPoints = s.get_spline();
         
-        for (const auto & p : sPoints)
-        {
-            curve.push_back(p);
-            curve.push_back(p);
-        }
+        for (const auto & p : sPoints) curve.push_back(p);
         
         return curve;
     }
@@ -148,9 +142,10 @@ struct ExperimentalApp : public GLFWApp
         
         for (int l = 0; l < lines.size(); l++)
         {
-            auto line = lines[l];
-            line->render(camera, model, float2(width, height), colors[l % colors.size()], sizes[l]);
+            lineBatch.add_polyline(lines[l], sizes[l], float4(colors[l % colors.size()], 1));
         }
+        lineBatch.draw(mul(viewProjectionMatrix, model), float2(width, height));
+        lineBatch.clear();
 
         gl_check_error(__FILE__, __LINE__);
         
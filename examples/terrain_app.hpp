@@ -26,17 +26,20 @@ constexpr const char basic_frag[] = R"(#version 330
 struct CameraPathFollower
 {
     std::vector<float4x4> parallelTransportFrames;
+    TransportFrameStream path{ 128 };
 
     void compute(std::array<Pose, 4> & controlPoints)
     {
         parallelTransportFrames = make_parallel_transport_frame_bezier(controlPoints, 128);
+        path.clear();
+        for (const auto & m : parallelTransportFrames) path.push_back(m[3].xyz());
     }
 
+    // Frames are spaced by arc length and the last one sits on the final control point; playback holds there
     float4x4 get_transform(const size_t idx) const
     {
         assert(parallelTransportFrames.size() > 0);
-        if (idx >= 0) return parallelTransportFrames[idx];
-        else return parallelTransportFrames[parallelTransportFrames.size()];
+        return parallelTransportFrames[std::min(idx, parallelTransportFrames.size() - 1)];
     }
 
     std::vector<GlMesh> debug_draw() const
@@ -61,6 +64,7 @@ struct CameraPathFollower
     void reset()
     {
         parallelTransportFrames.clear();
+        path.clear();
     }
 };
 
@@ -108,6 +112,7 @@ struct ExperimentalApp : public GLFWApp
     UniformRandomGenerator generator;
 
     CameraPathFollower follower;
+    GlTubeBatch pathTube;
     bool cameraFollowing = false;
     int playbackIndex = 0;
 
@@ -465,6 +470,16 @@ struct ExperimentalApp : public GLFWApp
                     }
                 }
 
+                // The path itself as a thin tube. Its vertices carry no color, so inColor takes the current generic value.
+                if (follower.path.size() >= 2)
+                {
+                    basicShader->uniform("u_mvp", viewProj);
+                    glVertexAttrib3f(2, 1.f, 0.8f, 0.2f);
+                    pathTube.add_tube(follower.path, 0.02f);
+                    pathTube.draw();
+                    pathTube.clear();
+                }
+
                 // Draw the camera control points
                 for (auto & m : cameraSpline)
                 {
@@ -480,7 +495,7 @@ struct ExperimentalApp : public GLFWApp
         gl_check_error(__FILE__, __LINE__);
         
         igm->begin_frame();
-        ImGui::SliderInt("Playback Index", &playbackIndex, 0, follower.parallelTransportFrames.size());
+        ImGui::SliderInt("Playback Index", &playbackIndex, 0, std::max(int(follower.parallelTransportFrames.size()) - 1, 0));
         ImGui::Checkbox("Follow", &cameraFollowing);
         igm->end_frame();
 
@@ -0,0 +1,69 @@
+// This is free and unencumbered software released into the public domain.
+// Minimal address-based wait/wake: a thread sleeps until a 32-bit word changes from an expected value.
+// Maps to WaitOnAddress on Windows and the futex syscall on Linux; elsewhere it degrades to yielding.
+
+#ifndef futex_hpp
+#define futex_hpp
+
+#include <atomic>
+#include <thread>
+#include <stdint.h>
+
+#if defined(_WIN32)
+    #ifndef WIN32_LEAN_AND_MEAN
+    #define WIN32_LEAN_AND_MEAN
+    #endif
+    #ifndef NOMINMAX
+    #define NOMINMAX
+    #endif
+    #include <windows.h>
+    #pragma comment(lib, "Synchronization.lib")
+#elif defined(__linux__)
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+    #include <climits>
+#endif
+
+namespace avl
+{
+
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex words must be plain 32-bit integers");
+
+    // Blocks while `word` == `expected`. May return spuriously; callers re-check their condition in a loop.
+    inline void futex_wait(std::atomic<uint32_t> & word, uint32_t expected)
+    {
+    #if defined(_WIN32)
+        WaitOnAddress(reinterpret_cast<volatile VOID *>(&word), &expected, sizeof(uint32_t), INFINITE);
+    #elif defined(__linux__)
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+    #else
+        if (word.load(std::memory_order_acquire) == expected) std::this_thread::yield();
+    #endif
+    }
+
+    inline void futex_wake_one(std::atomic<uint32_t> & word)
+    {
+    #if defined(_WIN32)
+        WakeByAddressSingle(reinterpret_cast<PVOID>(&word));
+    #elif defined(__linux__)
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    #else
+        (void) word;
+    #endif
+    }
+
+    inline void futex_wake_all(std::atomic<uint32_t> & word)
+    {
+    #if defined(_WIN32)
+        WakeByAddressAll(reinterpret_cast<PVOID>(&word));
+    #elif defined(__linux__)
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+    #else
+        (void) word;
+    #endif
+    }
+
+} // end namespace avl
+
+#endif // end futex_hpp
@@ -31,6 +31,7 @@ shader_workbench::shader_workbench() : GLFWApp(1200, 800, "Geometric Decals")
     StaticMesh m;
     m.geom = "torus-geom";
     m.mesh = "torus-mesh";
+    m.update_bounds();
     meshes.push_back(std::move(m));
 
     gizmo.reset(new GlGizmo());
@@ -2,6 +2,8 @@
 #define geometry_hpp
 
 #include "math-core.hpp"
+#include "util.hpp"
+#include <unordered_map>
 #include "../lib-model-io/model-io.hpp"
 
 using namespace avl;
@@ -23,139 +25,232 @@ inline Bounds3D compute_bounds(const Geometry & g)
     return bounds;
 }
 
-// Lengyel, Eric. "Computing Tangent Space Basis Vectors for an Arbitrary Mesh".
-// Terathon Software 3D Graphics Library, 2001.
-inline void compute_tangents(Geometry & g)
+// How face normals are combined at a shared vertex
+enum class NormalWeighting
 {
-    g.tangents.resize(g.vertices.size());
-    g.bitangents.resize(g.vertices.size());
+    uniform,    // every adjacent face counts the same
+    area,       // larger faces count more; cheapest, but skewed by long slivers
+    angle       // faces count by the angle they subtend at the vertex; unaffected by how a surface is triangulated
+};
 
-    // Each face
-    for (size_t i = 0; i < g.faces.size(); ++i)
-    {
-        uint3 face = g.faces[i];
+namespace geometry_impl
+{
+    constexpr static const size_t PARALLEL_GRAIN = 16384;
+    constexpr static const uint32_t INVALID_INDEX = 0xffffffff;
+    constexpr static const float DEGENERATE_SINE = 1e-6f;
 
-        const float3 & v0 = g.vertices[face.x];
-        const float3 & v1 = g.vertices[face.y];
-        const float3 & v2 = g.vertices[face.z];
+    // Interior angles at v0, v1 and v2
+    inline float3 corner_angles(const float3 & v0, const float3 & v1, const float3 & v2)
+    {
+        auto angle = [](const float3 & a, const float3 & b) { return std::acos(clamp(dot(safe_normalize(a), safe_normalize(b)), -1.f, 1.f)); };
+        return{ angle(v1 - v0, v2 - v0), angle(v0 - v1, v2 - v1), angle(v0 - v2, v1 - v2) };
+    }
 
-        const float2 & w0 = g.texcoord0[face.x];
-        const float2 & w1 = g.texcoord0[face.y];
-        const float2 & w2 = g.texcoord0[face.z];
+    // Maps every vertex to the lowest-indexed earlier vertex within `radius` (or to itself). Positions are bucketed
+    // on a grid with cells twice that size, so the ball around a vertex overlaps at most 8 cells instead of every vertex.
+    inline std::vector<uint32_t> weld_vertices(const std::vector<float3> & vertices, const float radius)
+    {
+        const float invCell = 0.5f / radius;
+        const float radius2 = radius * radius;
 
-        float x1 = v1.x - v0.x;
-        float x2 = v2.x - v0.x;
-        float y1 = v1.y - v0.y;
-        float y2 = v2.y - v0.y;
-        float z1 = v1.z - v0.z;
-        float z2 = v2.z - v0.z;
+        auto cell_key = [](int x, int y, int z)
+        {
+            return (uint64_t(uint32_t(x) & 0x1fffff) << 42) | (uint64_t(uint32_t(y) & 0x1fffff) << 21) | uint64_t(uint32_t(z) & 0x1fffff);
+        };
 
-        float s1 = w1.x - w0.x;
-        float s2 = w2.x - w0.x;
-        float t1 = w1.y - w0.y;
-        float t2 = w2.y - w0.y;
+        std::unordered_map<uint64_t, uint32_t> cellHeads; // cell -> most recent representative in it
+        cellHeads.reserve(vertices.size());
+        std::vector<uint32_t> next(vertices.size(), INVALID_INDEX); // chains representatives sharing a cell
+        std::vector<uint32_t> weld(vertices.size());
 
-        float r = (s1 * t2 - s2 * t1);
+        for (uint32_t i = 0; i < vertices.size(); ++i)
+        {
+            const float3 & v = vertices[i];
+            const int3 lo = int3(floor((v - radius) * invCell)), hi = int3(floor((v + radius) * invCell));
 
-        if (r != 0.0f) r = 1.0f / r;
+            uint32_t found = INVALID_INDEX;
+            for (int z = lo.z; z <= hi.z; ++z) for (int y = lo.y; y <= hi.y; ++y) for (int x = lo.x; x <= hi.x; ++x)
+            {
+                const auto it = cellHeads.find(cell_key(x, y, z));
+                if (it == cellHeads.end()) continue;
+                for (uint32_t r = it->second; r != INVALID_INDEX; r = next[r])
+                {
+                    if (r < found && length2(vertices[r] - v) < radius2) found = r;
+                }
+            }
 
-        // Tangent in the S direction
-        const float3 tangent((t2 * x1 - t1 * x2) * r, (t2 * y1 - t1 * y2) * r, (t2 * z1 - t1 * z2) * r);
+            if (found != INVALID_INDEX)
+            {
+                weld[i] = found;
+                continue;
+            }
 
-        // Accumulate
-        g.tangents[face.x] += tangent;
-        g.tangents[face.y] += tangent;
-        g.tangents[face.z] += tangent;
+            weld[i] = i;
+            const int3 c = int3(floor(v * invCell));
+            const auto inserted = cellHeads.emplace(cell_key(c.x, c.y, c.z), i);
+            if (!inserted.second)
+            {
+                next[i] = inserted.first->second;
+                inserted.first->second = i;
+            }
+        }
+        return weld;
     }
 
-    // Tangents
-    for (size_t i = 0; i < g.vertices.size(); ++i)
+    // Face corners (3 * face + k) grouped by the vertex they accumulate into, in face order. Per-vertex sums can then
+    // run in parallel without atomics or per-thread copies, and always add up in the same order.
+    struct corner_adjacency
     {
-        const float3 normal = g.normals[i];
-        const float3 tangent = g.tangents[i];
+        std::vector<uint32_t> offsets; // corners of vertex v are corners[offsets[v], offsets[v + 1])
+        std::vector<uint32_t> corners;
 
-        // Gram-Schmidt orthogonalize
-        g.tangents[i] = (tangent - normal * dot(normal, tangent));
+        corner_adjacency(const std::vector<uint3> & faces, const size_t vertexCount, const uint32_t * remap = nullptr)
+        {
+            offsets.assign(vertexCount + 1, 0);
+            auto target = [&](size_t c) { const uint32_t v = faces[c / 3][c % 3]; return remap ? remap[v] : v; };
 
-        const float len = length(g.tangents[i]);
+            const size_t numCorners = faces.size() * 3;
+            for (size_t c = 0; c < numCorners; ++c) offsets[target(c) + 1]++;
+            for (size_t v = 0; v < vertexCount; ++v) offsets[v + 1] += offsets[v];
 
-        if (len > 0.0f) g.tangents[i] = g.tangents[i] / (float)sqrt(len);
-    }
+            corners.resize(numCorners);
+            std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+            for (size_t c = 0; c < numCorners; ++c) corners[cursor[target(c)]++] = static_cast<uint32_t>(c);
+        }
 
-    // Bitangents 
-    for (size_t i = 0; i < g.vertices.size(); ++i)
-    {
-        g.bitangents[i] = safe_normalize(cross(g.normals[i], g.tangents[i]));
-    }
+        template<typename T>
+        T sum(const size_t v, const std::vector<T> & values) const
+        {
+            T result = T();
+            for (uint32_t k = offsets[v]; k < offsets[v + 1]; ++k) result += values[corners[k]];
+            return result;
+        }
+    };
 }
 
-inline void compute_normals(Geometry & g, bool smooth = true)
+// Smooth normals treat vertices within `weldRadius` of each other as one, so split seams (UV or material) shade
+// continuously; flat normals only average faces that share an index. The default of 0.01 is the distance the
+// original implementation welded at; pass a smaller radius for dense meshes whose distinct vertices lie closer.
+inline void compute_normals(Geometry & g, bool smooth = true, NormalWeighting weighting = NormalWeighting::uniform, float weldRadius = 0.01f)
 {
-    constexpr double NORMAL_EPSILON = 0.0001;
+    using namespace geometry_impl;
 
-    g.normals.resize(g.vertices.size());
+    const size_t numVertices = g.vertices.size(), numFaces = g.faces.size();
+    g.normals.resize(numVertices);
 
-    for (auto & n : g.normals) n = float3(0, 0, 0);
+    std::vector<uint32_t> weld;
+    if (smooth) weld = weld_vertices(g.vertices, weldRadius);
+    const uint32_t * remap = smooth ? weld.data() : nullptr;
 
-    std::vector<uint32_t> uniqueVertIndices(g.vertices.size(), 0);
-    if (smooth)
+    std::vector<float3> cornerNormals(numFaces * 3);
+    parallel_ranges(numFaces, PARALLEL_GRAIN, [&](size_t begin, size_t end)
     {
-        for (uint32_t i = 0; i < uniqueVertIndices.size(); ++i)
+        for (size_t f = begin; f < end; ++f)
         {
-            if (uniqueVertIndices[i] == 0)
+            const uint3 & face = g.faces[f];
+            const float3 & v0 = g.vertices[face.x], & v1 = g.vertices[face.y], & v2 = g.vertices[face.z];
+
+            // Degenerate faces (zero area, or edges parallel to within rounding) have no meaningful normal and
+            // contribute nothing; the test is relative to the edge lengths so it holds at any mesh scale
+            const float3 e0 = v1 - v0, e1 = v2 - v0;
+            const float3 n = cross(e0, e1);
+            const float len = length(n);
+            if (len <= DEGENERATE_SINE * length(e0) * length(e1))
             {
-                uniqueVertIndices[i] = i + 1;
-                const float3 v0 = g.vertices[i];
-                for (auto j = i + 1; j < g.vertices.size(); ++j)
-                {
-                    const float3 v1 = g.vertices[j];
-                    if (length2(v1 - v0) < NORMAL_EPSILON)
-                    {
-                        uniqueVertIndices[j] = uniqueVertIndices[i];
-                    }
-                }
+                for (int k = 0; k < 3; ++k) cornerNormals[f * 3 + k] = float3(0, 0, 0);
+                continue;
             }
+
+            const float3 unit = n / len;
+            const float3 weights = (weighting == NormalWeighting::angle) ? corner_angles(v0, v1, v2) : float3(1, 1, 1);
+            for (int k = 0; k < 3; ++k) cornerNormals[f * 3 + k] = (weighting == NormalWeighting::area) ? n : unit * weights[k];
         }
-    }
+    });
 
-    uint32_t idx0, idx1, idx2;
-    for (size_t i = 0; i < g.faces.size(); ++i)
+    const corner_adjacency adjacency(g.faces, numVertices, remap);
+    parallel_ranges(numVertices, PARALLEL_GRAIN, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (!smooth || weld[i] == i) g.normals[i] = safe_normalize(adjacency.sum(i, cornerNormals));
+        }
+    });
+
+    // Welded vertices take their representative's normal; representatives always precede them, and are final by now
+    if (smooth)
     {
-        const auto & f = g.faces[i];
+        parallel_ranges(numVertices, PARALLEL_GRAIN, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i) if (weld[i] != i) g.normals[i] = g.normals[weld[i]];
+        });
+    }
+}
 
-        idx0 = (smooth) ? uniqueVertIndices[f.x] - 1 : f.x;
-        idx1 = (smooth) ? uniqueVertIndices[f.y] - 1 : f.y;
-        idx2 = (smooth) ? uniqueVertIndices[f.z] - 1 : f.z;
+// Tangent frames in the style of MikkTSpace: each face's UV-derived tangent and bitangent are projected into the plane
+// of the corner's vertex normal and weighted by the corner angle, and the bitangent is rebuilt as +/-cross(n, t) so
+// mirrored UVs keep the correct handedness. Vertices are never split, so UV seams must already be split in the mesh.
+// Based on Lengyel, Eric. "Computing Tangent Space Basis Vectors for an Arbitrary Mesh". Terathon Software, 2001.
+inline void compute_tangents(Geometry & g)
+{
+    using namespace geometry_impl;
 
-        const float3 v0 = g.vertices[idx0];
-        const float3 v1 = g.vertices[idx1];
-        const float3 v2 = g.vertices[idx2];
+    const size_t numVertices = g.vertices.size(), numFaces = g.faces.size();
+    g.tangents.resize(numVertices);
+    g.bitangents.resize(numVertices);
+    if (g.normals.size() != numVertices) compute_normals(g);
+    const bool hasTexcoords = g.texcoord0.size() == numVertices;
 
-        float3 e0 = v1 - v0;
-        float3 e1 = v2 - v0;
-        float3 e2 = v2 - v1;
+    std::vector<float3> cornerTangents(numFaces * 3), cornerBitangents(numFaces * 3);
+    parallel_ranges(numFaces, PARALLEL_GRAIN, [&](size_t begin, size_t end)
+    {
+        for (size_t f = begin; f < end; ++f)
+        {
+            const uint3 & face = g.faces[f];
+            for (int k = 0; k < 3; ++k) cornerTangents[f * 3 + k] = cornerBitangents[f * 3 + k] = float3(0, 0, 0);
+            if (!hasTexcoords) continue;
 
-        if (length2(e0) < NORMAL_EPSILON) continue;
-        if (length2(e1) < NORMAL_EPSILON) continue;
-        if (length2(e2) < NORMAL_EPSILON) continue;
+            const float3 & v0 = g.vertices[face.x], & v1 = g.vertices[face.y], & v2 = g.vertices[face.z];
+            const float2 & w0 = g.texcoord0[face.x], & w1 = g.texcoord0[face.y], & w2 = g.texcoord0[face.z];
 
-        const float3 n = safe_normalize(cross(e0, e1));
+            const float3 e1 = v1 - v0, e2 = v2 - v0;
+            const float s1 = w1.x - w0.x, s2 = w2.x - w0.x;
+            const float t1 = w1.y - w0.y, t2 = w2.y - w0.y;
 
-        g.normals[f.x] += n;
-        g.normals[f.y] += n;
-        g.normals[f.z] += n;
+            const float r = s1 * t2 - s2 * t1;
+            if (r == 0.0f) continue; // degenerate UVs say nothing about the tangent direction
 
-        // Copy normals for non-unique verts
-        if (smooth)
-        {
-            for (uint32_t i = 0; i < g.vertices.size(); ++i)
+            const float3 sdir = (e1 * t2 - e2 * t1) / r; // tangent in the S direction
+            const float3 tdir = (e2 * s1 - e1 * s2) / r; // and in the T direction
+            const float3 angles = corner_angles(v0, v1, v2);
+
+            for (int k = 0; k < 3; ++k)
             {
-                g.normals[i] = g.normals[uniqueVertIndices[i] - 1];
+                const float3 & n = g.normals[face[k]];
+                cornerTangents[f * 3 + k] = safe_normalize(sdir - n * dot(n, sdir)) * angles[k];
+                cornerBitangents[f * 3 + k] = safe_normalize(tdir - n * dot(n, tdir)) * angles[k];
             }
         }
-    }
+    });
+
+    const corner_adjacency adjacency(g.faces, numVertices);
+    parallel_ranges(numVertices, PARALLEL_GRAIN, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const float3 n = g.normals[i];
+            float3 t = adjacency.sum(i, cornerTangents);
+
+            // Gram-Schmidt orthogonalize, falling back to any perpendicular when the UVs gave nothing to work with
+            t = t - n * dot(n, t);
+            t = (length2(t) > 1e-12f) ? normalize(t) : orth(n);
 
-    for (auto & n : g.normals) n = safe_normalize(n);
+            const float3 b = cross(n, t);
+            const float handedness = (dot(b, adjacency.sum(i, cornerBitangents)) < 0.f) ? -1.f : 1.f;
+
+            g.tangents[i] = t;
+            g.bitangents[i] = safe_normalize(b * handedness);
+        }
+    });
 }
 
 inline void rescale_geometry(Geometry & g, float radius = 1.0f)
@@ -221,4 +316,126 @@ inline bool intersect_ray_mesh(const Ray & ray, const Geometry & mesh, float * o
     return true;
 }
 
+namespace geometry_tests
+{
+    // Triangle soup (no shared indices, like scan or STL data) for a UV sphere, with UVs from longitude/latitude
+    inline Geometry make_sphere_soup(const uint32_t segments, const uint32_t rings)
+    {
+        Geometry g;
+        auto vertex = [&](uint32_t s, uint32_t r)
+        {
+            const float u = float(s) / segments, v = float(r) / rings;
+            const float phi = u * float(ANVIL_TAU), theta = v * float(ANVIL_PI);
+            g.vertices.push_back({ std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) });
+            g.texcoord0.push_back({ u, v });
+            return static_cast<uint32_t>(g.vertices.size() - 1);
+        };
+        for (uint32_t r = 0; r < rings; ++r)
+        {
+            for (uint32_t s = 0; s < segments; ++s)
+            {
+                g.faces.push_back({ vertex(s, r), vertex(s + 1, r), vertex(s + 1, r + 1) });
+                g.faces.push_back({ vertex(s, r), vertex(s + 1, r + 1), vertex(s, r + 1) });
+            }
+        }
+        return g;
+    }
+
+    inline bool near_equal(const float3 & a, const float3 & b, const float eps = 1e-4f) { return length(a - b) < eps; }
+
+    inline void execute()
+    {
+        // Three faces meet at the origin; the x = 0 side is split into two triangles. Uniform and area weighting
+        // both count that side twice, angle weighting sees three right angles.
+        {
+            Geometry g;
+            g.vertices = { { 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 }, { 1, 0, 0 }, { 0, 1, 0 }, { 0, 1, 1 }, { 0, 0, 1 } };
+            g.faces = { { 0, 1, 2 }, { 0, 3, 4 }, { 0, 5, 6 }, { 0, 6, 7 } };
+
+            compute_normals(g, false, NormalWeighting::uniform);
+            assert(near_equal(g.normals[0], normalize(float3(2, 1, 1))));
+            compute_normals(g, false, NormalWeighting::area);
+            assert(near_equal(g.normals[0], normalize(float3(2, 1, 1))));
+            compute_normals(g, false, NormalWeighting::angle);
+            assert(near_equal(g.normals[0], normalize(float3(1, 1, 1))));
+
+            // Flat normals leave the split vertices on their own faces; welding shares the result across copies
+            assert(near_equal(g.normals[1], float3(0, 0, 1)) && near_equal(g.normals[4], float3(0, 1, 0)));
+            compute_normals(g, true);
+            assert(near_equal(g.normals[1], g.normals[4]) && near_equal(g.normals[2], g.normals[5]) && near_equal(g.normals[3], g.normals[7]));
+            assert(near_equal(g.normals[1], normalize(float3(0, 1, 1))));
+
+            // By default copies up to 0.01 apart still weld, as they did before the radius was exposed
+            g.vertices[4] += float3(0.005f, 0, 0);
+            compute_normals(g);
+            assert(near_equal(g.normals[1], g.normals[4]));
+        }
+
+        // Tangents follow +U, bitangents +V; mirroring U flips the tangent but keeps the bitangent
+        {
+            Geometry g;
+            g.vertices = { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 } };
+            g.texcoord0 = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+            g.faces = { { 0, 1, 2 }, { 0, 2, 3 } };
+            compute_normals(g);
+            compute_tangents(g);
+            for (size_t i = 0; i < 4; ++i)
+            {
+                assert(near_equal(g.normals[i], float3(0, 0, 1)));
+                assert(near_equal(g.tangents[i], float3(1, 0, 0)) && near_equal(g.bitangents[i], float3(0, 1, 0)));
+            }
+
+            for (auto & uv : g.texcoord0) uv.x = 1.f - uv.x;
+            compute_tangents(g);
+            for (size_t i = 0; i < 4; ++i) assert(near_equal(g.tangents[i], float3(-1, 0, 0)) && near_equal(g.bitangents[i], float3(0, 1, 0)));
+
+            // Without texcoords the frame is still orthonormal
+            g.texcoord0.clear();
+            compute_tangents(g);
+            for (size_t i = 0; i < 4; ++i) assert(std::abs(dot(g.tangents[i], g.normals[i])) < 1e-5f && std::abs(length(g.tangents[i]) - 1.f) < 1e-5f);
+        }
+
+        // Enough faces to go wide: welded normals of a triangle soup match the analytic sphere normals
+        {
+            Geometry g = make_sphere_soup(256, 128);
+            compute_normals(g, true, NormalWeighting::angle, 1e-4f); // rings near the poles are closer than 0.01
+            compute_tangents(g);
+            for (size_t i = 0; i < g.vertices.size(); ++i)
+            {
+                assert(dot(g.normals[i], normalize(g.vertices[i])) > 0.999f);
+                assert(std::abs(dot(g.tangents[i], g.normals[i])) < 1e-4f);
+            }
+        }
+    }
+
+    inline void benchmark(const uint32_t segments = 1024, const uint32_t rings = 512)
+    {
+        Geometry g = make_sphere_soup(segments, rings);
+        std::cout << g.faces.size() << " triangles, " << g.vertices.size() << " vertices" << std::endl;
+
+        float checksum = 0;
+        {
+            AVL_SCOPED_TIMER("compute_normals (flat)");
+            compute_normals(g, false);
+            checksum += g.normals[0].x;
+        }
+        {
+            AVL_SCOPED_TIMER("compute_normals (smooth, uniform)");
+            compute_normals(g, true);
+            checksum += g.normals[0].x;
+        }
+        {
+            AVL_SCOPED_TIMER("compute_normals (smooth, angle)");
+            compute_normals(g, true, NormalWeighting::angle);
+            checksum += g.normals[0].x;
+        }
+        {
+            AVL_SCOPED_TIMER("compute_tangents");
+            compute_tangents(g);
+            checksum += g.tangents[0].x;
+        }
+        std::cout << "checksum: " << checksum << std::endl;
+    }
+}
+
 #endif // end geometry_hpp
\ No newline at end of file
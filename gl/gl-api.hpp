@@ -177,7 +177,7 @@ typedef GlObject<GlTransformFeedbacksFactory> GlTransformFeedbacksObject;
 
 struct GlBuffer : public GlBufferObject
 {
-    GLsizeiptr size;
+    GLsizeiptr size{ 0 };
     GlBuffer() {}
     void set_buffer_data(const GLsizeiptr s, const GLvoid * data, const GLenum usage) { this->size = s; glNamedBufferDataEXT(*this, size, data, usage);  }
     void set_buffer_data(const std::vector<GLubyte> & bytes, const GLenum usage) { set_buffer_data(bytes.size(), bytes.data(), usage); }
@@ -185,6 +185,146 @@ struct GlBuffer : public GlBufferObject
     void set_buffer_sub_data(const std::vector<GLubyte> & bytes, const GLintptr offset, const GLenum usage) { set_buffer_sub_data(bytes.size(), offset, bytes.data()); }
 };
 
+///////////////////////////
+//   GlStreamingBuffer   //
+///////////////////////////
+
+// A sub-range of a GlStreamingBuffer, valid until the owner's next end_frame()
+struct GlStreamingRange
+{
+    GLuint buffer{ 0 };
+    GLintptr offset{ 0 };
+    GLsizeiptr size{ 0 };
+    void * data{ nullptr };
+};
+
+/*
+ * Ring for data rewritten every frame (uniform blocks, storage buffers, dynamic vertices). One persistently mapped,
+ * coherent buffer is split into NUM_REGIONS regions; a frame bump-allocates from its region and end_frame() fences it,
+ * so the CPU only waits when it laps a region the GPU is still reading. Nothing is reallocated or orphaned by the
+ * driver. A frame that outgrows its region doubles the ring and continues in the new buffer; the old one stays mapped
+ * until end_frame(), so ranges handed out earlier in the frame remain writable, and is then released (GL keeps it
+ * alive for draws already issued). Because the buffer can change between allocations, callers take the buffer name
+ * from each GlStreamingRange and respecify bindings per draw rather than caching them.
+ */
+class GlStreamingBuffer
+{
+    constexpr static const int NUM_REGIONS = 3;
+
+    GlBuffer buffer;
+    uint8_t * mapped{ nullptr };
+    std::vector<GlBuffer> retired;      // outgrown this frame, still mapped
+    GLsizeiptr regionSize;
+    GLsizeiptr head{ 0 };
+    int region{ 0 };
+    GLsync fences[NUM_REGIONS] = {};
+    GLint uniformAlignment{ 0 }, storageAlignment{ 0 };
+    uint64_t stalls{ 0 }, resizes{ 0 };
+
+    void release_retired()
+    {
+        for (auto & b : retired) glUnmapNamedBufferEXT(b);
+        retired.clear();
+    }
+
+    void release()
+    {
+        for (auto & f : fences) if (f) { glDeleteSync(f); f = nullptr; }
+        if (mapped) glUnmapNamedBufferEXT(buffer);
+        mapped = nullptr;
+        buffer = {};
+        release_retired();
+    }
+
+    void create(const GLsizeiptr newRegionSize)
+    {
+        // The new buffer has no reads in flight, so the old fences are moot
+        for (auto & f : fences) if (f) { glDeleteSync(f); f = nullptr; }
+        if (mapped) retired.push_back(std::move(buffer));
+        buffer = GlBuffer();
+        regionSize = newRegionSize;
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glNamedBufferStorageEXT(buffer, regionSize * NUM_REGIONS, nullptr, flags);
+        mapped = static_cast<uint8_t *>(glMapNamedBufferRangeEXT(buffer, 0, regionSize * NUM_REGIONS, flags));
+        buffer.size = regionSize * NUM_REGIONS;
+        head = 0;
+        region = 0;
+    }
+
+public:
+
+    GlStreamingBuffer(const GLsizeiptr bytesPerFrame = 1 << 20) : regionSize(bytesPerFrame) {}
+    GlStreamingBuffer(const GlStreamingBuffer &) = delete;
+    GlStreamingBuffer & operator = (const GlStreamingBuffer &) = delete;
+    ~GlStreamingBuffer() { release(); }
+
+    // Reserves `size` bytes at a multiple of `alignment` (a power of two) and returns where to write them
+    GlStreamingRange allocate(const GLsizeiptr size, const GLsizeiptr alignment = 16)
+    {
+        if (!mapped) create(regionSize);
+
+        GLsizeiptr offset = (head + alignment - 1) & ~(alignment - 1);
+        if (offset + size > regionSize)
+        {
+            create(std::max(regionSize * 2, (size + alignment) * 2));
+            resizes++;
+            offset = 0;
+        }
+        head = offset + size;
+
+        GlStreamingRange r;
+        r.buffer = buffer;
+        r.offset = region * regionSize + offset;
+        r.size = size;
+        r.data = mapped + r.offset;
+        return r;
+    }
+
+    GlStreamingRange upload(const void * data, const GLsizeiptr size, const GLsizeiptr alignment = 16)
+    {
+        GlStreamingRange r = allocate(size, alignment);
+        memcpy(r.data, data, size);
+        return r;
+    }
+
+    template<class T> GlStreamingRange upload_uniform(const T & block) { return upload(&block, sizeof(T), std::max<GLsizeiptr>(16, get_uniform_alignment())); }
+    template<class T> GlStreamingRange upload_storage(const T * elements, const size_t count) { return upload(elements, count * sizeof(T), std::max<GLsizeiptr>(16, get_storage_alignment())); }
+    template<class T> GlStreamingRange upload_vertices(const std::vector<T> & vertices) { return upload(vertices.data(), vertices.size() * sizeof(T), 16); }
+
+    // Uploads and binds in one go; uniform and storage blocks must use the matching upload_* for correct alignment
+    template<class T> void bind_uniform(const GLuint index, const T & block) { bind_range(GL_UNIFORM_BUFFER, index, upload_uniform(block)); }
+    template<class T> void bind_storage(const GLuint index, const T * elements, const size_t count) { bind_range(GL_SHADER_STORAGE_BUFFER, index, upload_storage(elements, count)); }
+
+    static void bind_range(const GLenum target, const GLuint index, const GlStreamingRange & r) { glBindBufferRange(target, index, r.buffer, r.offset, r.size); }
+
+    // Call once per frame after the last draw that reads this frame's data
+    void end_frame()
+    {
+        if (!mapped) return;
+        release_retired();
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        region = (region + 1) % NUM_REGIONS;
+        head = 0;
+
+        if (GLsync & f = fences[region])
+        {
+            if (glClientWaitSync(f, 0, 0) == GL_TIMEOUT_EXPIRED)
+            {
+                stalls++;
+                while (glClientWaitSync(f, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+            }
+            glDeleteSync(f);
+            f = nullptr;
+        }
+    }
+
+    GLint get_uniform_alignment() { if (!uniformAlignment) glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment); return uniformAlignment; }
+    GLint get_storage_alignment() { if (!storageAlignment) glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment); return storageAlignment; }
+    GLsizeiptr get_region_size() const { return regionSize; }
+    uint64_t get_stall_count() const { return stalls; }     // frames that waited on the GPU
+    uint64_t get_resize_count() const { return resizes; }
+};
+
 ////////////////////////
 //   GlRenderbuffer   //
 ////////////////////////
@@ -546,11 +686,32 @@ public:
 class GlMesh
 {
     GlVertexArrayObject vao;
-    GlBuffer vertexBuffer, instanceBuffer, indexBuffer;
+    GlVertexArrayObject positionVao;    // positions only, for depth and shadow passes
+    GlBuffer vertexBuffer, positionBuffer, instanceBuffer, indexBuffer;
 
     GLenum drawMode = GL_TRIANGLES;
     GLenum indexType = 0;
-    GLsizei vertexStride = 0, instanceStride = 0, indexCount = 0;
+    GLsizei vertexStride = 0, positionStride = 0, instanceStride = 0, indexCount = 0;
+
+    void draw_vertex_array(const GlVertexArrayObject & array, int instances) const
+    {
+        if (!vertexBuffer.size && !positionBuffer.size) return;
+        const GLsizeiptr vertexCount = positionStride ? positionBuffer.size / positionStride : (vertexStride ? vertexBuffer.size / vertexStride : 0);
+
+        glBindVertexArray(array);
+        if (indexCount)
+        {
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+            if (instances) glDrawElementsInstanced(drawMode, indexCount, indexType, 0, instances);
+            else glDrawElements(drawMode, indexCount, indexType, nullptr);
+        }
+        else
+        {
+            if (instances) glDrawArraysInstanced(drawMode, 0, static_cast<GLsizei>(vertexCount), instances);
+            else glDrawArrays(drawMode, 0, static_cast<GLsizei>(vertexCount));
+        }
+        glBindVertexArray(0);
+    }
 
 public:
      
@@ -576,31 +737,19 @@ public:
         indexCount = 0;
     }
      
-    void draw_elements(int instances = 0) const
-    {
-        if (vertexBuffer.size)
-        {
-            glBindVertexArray(vao);
-            if (indexCount)
-            {
-                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-                if (instances) glDrawElementsInstanced(drawMode, indexCount, indexType, 0, instances);
-                else glDrawElements(drawMode, indexCount, indexType, nullptr);
-            }
-            else
-            {
-                if (instances) glDrawArraysInstanced(drawMode, 0, static_cast<GLsizei>(vertexBuffer.size / vertexStride), instances);
-                else glDrawArrays(drawMode, 0, static_cast<GLsizei>(vertexBuffer.size / vertexStride));
-            }
-            glBindVertexArray(0);
-        }
-    }
+    void draw_elements(int instances = 0) const { draw_vertex_array(vao, instances); }
+
+    // Fetches only the position stream when the mesh has one; otherwise the same as draw_elements()
+    void draw_positions(int instances = 0) const { draw_vertex_array(positionStride ? positionVao : vao, instances); }
 
     void set_vertex_data(GLsizeiptr size, const GLvoid * data, GLenum usage) { vertexBuffer.set_buffer_data(size, data, usage); }
     GlBuffer & get_vertex_data_buffer() { return vertexBuffer; };
 
     void set_instance_data(GLsizeiptr size, const GLvoid * data, GLenum usage) { instanceBuffer.set_buffer_data(size, data, usage); }
 
+    void set_position_data(GLsizeiptr size, const GLvoid * data, GLenum usage) { positionBuffer.set_buffer_data(size, data, usage); }
+    GlBuffer & get_position_data_buffer() { return positionBuffer; };
+
     void set_index_data(GLenum mode, GLenum type, GLsizei count, const GLvoid * data, GLenum usage)
     {
         size_t size = gl_size_bytes(type);
@@ -618,11 +767,25 @@ public:
         vertexStride = stride;
     }
 
+    // Sourced from the position buffer by both the full and the position-only vertex arrays
+    void set_position_attribute(GLuint index, GLint size, GLenum type, GLsizei stride, const GLvoid * offset)
+    {
+        for (const GlVertexArrayObject * array : { &vao, &positionVao })
+        {
+            glEnableVertexArrayAttribEXT(*array, index);
+            glVertexArrayVertexAttribOffsetEXT(*array, positionBuffer, index, size, type, GL_FALSE, stride, (GLintptr)offset);
+        }
+        positionStride = stride;
+    }
+
     void set_instance_attribute(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid * offset)
     {
-        glEnableVertexArrayAttribEXT(vao, index);
-        glVertexArrayVertexAttribOffsetEXT(vao, instanceBuffer, index, size, type, normalized, stride, (GLintptr)offset);
-        glVertexArrayVertexAttribDivisorEXT(vao, index, 1);
+        for (const GlVertexArrayObject * array : { &vao, &positionVao })
+        {
+            glEnableVertexArrayAttribEXT(*array, index);
+            glVertexArrayVertexAttribOffsetEXT(*array, instanceBuffer, index, size, type, normalized, stride, (GLintptr)offset);
+            glVertexArrayVertexAttribDivisorEXT(*array, index, 1);
+        }
         instanceStride = stride;
     }
 
@@ -653,6 +816,5 @@ public:
 // Todo: occlusionQuery
 // Todo: timerQuery
 // Todo: blit/multisample?
-// Todo: mapped buffers
 // Todo: transform feedback
 // Todo: pixel buffers / sync
\ No newline at end of file
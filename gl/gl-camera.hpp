@@ -2,10 +2,9 @@
 #define camera_h
 
 #include "gl-api.hpp"
+#include "gl-frame-capture.hpp"
 #include "math-core.hpp"
 
-#include "stb/stb_image_write.h"
-
 namespace avl
 {
 
@@ -192,18 +191,19 @@ namespace avl
         float resolution;
         bool shouldCapture = false;
 
+        GlFrameCapture capture{ 6, 2 };
+
+        // Queues readbacks of all six faces; the PNGs are encoded on capture workers once the GPU is done
         void save_pngs()
         {
             const std::vector<std::string> faceNames = {{"positive_x"}, {"negative_x"}, {"positive_y"}, {"negative_y"}, {"positive_z"}, {"negative_z"}};
-            std::vector<uint8_t> data(resolution * resolution * 3);
-            glBindTexture(GL_TEXTURE_CUBE_MAP, cubeMapColor);
+            auto sink = std::make_shared<PngSink>("");
+            const int2 size(static_cast<int>(resolution), static_cast<int>(resolution));
             for (int i = 0; i < 6; ++i)
             {
-                glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, GL_UNSIGNED_BYTE, data.data());
-                stbi_write_png( std::string(faceNames[i] + ".png").c_str(), resolution, resolution, 3, data.data(), resolution * 3);
+                capture.capture_texture(cubeMapColor, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, size, GL_RGB, sink, i, faceNames[i]);
                 gl_check_error(__FILE__, __LINE__);
             }
-            glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
             shouldCapture = false;
         }
 
@@ -224,6 +224,8 @@ namespace avl
 
          void update(const float3 worldLocation)
          {
+             capture.update();
+
              if (shouldCapture)
              {
                  GLint drawFboId = 0, readFboId = 0;
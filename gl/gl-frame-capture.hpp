@@ -0,0 +1,399 @@
+// Asynchronous framebuffer and texture readback. glReadPixels / glGetTextureImage write into a ring of persistently
+// mapped pixel pack buffers and are fenced; once a fence signals, a worker thread copies (and flips) the rows out of
+// the mapping and hands them to a sink that encodes or stores them. The GL thread never waits on the GPU and never
+// touches pixel data, so capturing every frame costs a readback command and a fence. When every slot is still in
+// flight the frame is dropped and counted rather than stalling.
+
+#pragma once
+
+#ifndef gl_frame_capture_hpp
+#define gl_frame_capture_hpp
+
+#include "gl-api.hpp"
+#include "mpmc_blocking_queue.hpp"
+#include "stb/stb_image_write.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+#if defined(_WIN32)
+    #ifndef WIN32_LEAN_AND_MEAN
+    #define WIN32_LEAN_AND_MEAN
+    #endif
+    #ifndef NOMINMAX
+    #define NOMINMAX
+    #endif
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+namespace avl
+{
+
+    // Top-down rows, tightly packed. Only valid for the duration of FrameSink::write.
+    struct CapturedFrame
+    {
+        const uint8_t * pixels;
+        int2 size;
+        int channels;
+        uint64_t index;     // caller-supplied sequence number
+        std::string name;   // caller-supplied, may be empty
+    };
+
+    // Receives frames on capture worker threads; implementations must tolerate concurrent calls
+    struct FrameSink
+    {
+        virtual ~FrameSink() {}
+        virtual void write(const CapturedFrame & frame) = 0;
+    };
+
+    // Writes `<prefix><name>.png`, or `<prefix><index>.png` with a zero-padded index when the frame has no name
+    class PngSink : public FrameSink
+    {
+        std::string prefix;
+    public:
+        PngSink(const std::string & prefix) : prefix(prefix) {}
+
+        void write(const CapturedFrame & frame) override
+        {
+            std::string name = frame.name;
+            if (name.empty())
+            {
+                char digits[32];
+                snprintf(digits, sizeof(digits), "%06llu", static_cast<unsigned long long>(frame.index));
+                name = digits;
+            }
+            const std::string path = prefix + name + ".png";
+            if (!stbi_write_png(path.c_str(), frame.size.x, frame.size.y, frame.channels, frame.pixels, frame.size.x * frame.channels))
+            {
+                std::cout << "frame capture: could not write " << path << std::endl;
+            }
+        }
+    };
+
+    /*
+     * Fixed-size frames stored back to back in a memory-mapped file behind a 32 byte header
+     * ("AVLRAW01", width, height, channels, frame count as little-endian uint32). Frame `index` lands in slot `index`,
+     * so workers write in parallel without ordering; frames that don't match the size or overflow the file are skipped.
+     */
+    class RawVideoSink : public FrameSink
+    {
+        struct Header
+        {
+            char magic[8];
+            uint32_t width, height, channels, frameCount;
+            uint32_t reserved[4];
+        };
+
+        int2 size;
+        int channels;
+        size_t frameBytes;
+        uint64_t maxFrames;
+        uint8_t * mapped{ nullptr };
+        size_t mappedBytes{ 0 };
+        std::atomic<uint64_t> frameCount{ 0 };
+        std::atomic<uint64_t> skippedFrames{ 0 };
+
+    #if defined(_WIN32)
+        HANDLE file{ INVALID_HANDLE_VALUE }, mapping{ nullptr };
+    #else
+        int fd{ -1 };
+    #endif
+
+    public:
+
+        RawVideoSink(const std::string & path, const int2 size, const int channels, const uint64_t maxFrames)
+            : size(size), channels(channels), frameBytes(size_t(size.x) * size.y * channels), maxFrames(maxFrames)
+        {
+            mappedBytes = sizeof(Header) + frameBytes * maxFrames;
+
+        #if defined(_WIN32)
+            file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("could not create " + path);
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, DWORD(uint64_t(mappedBytes) >> 32), DWORD(mappedBytes & 0xffffffff), nullptr);
+            if (mapping) mapped = static_cast<uint8_t *>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, mappedBytes));
+        #else
+            fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) throw std::runtime_error("could not create " + path);
+            if (ftruncate(fd, off_t(mappedBytes)) == 0)
+            {
+                void * p = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (p != MAP_FAILED) mapped = static_cast<uint8_t *>(p);
+            }
+        #endif
+
+            if (!mapped)
+            {
+                close_file();
+                throw std::runtime_error("could not map " + path);
+            }
+
+            Header h = {};
+            std::memcpy(h.magic, "AVLRAW01", 8);
+            h.width = size.x; h.height = size.y; h.channels = channels;
+            std::memcpy(mapped, &h, sizeof(h));
+        }
+
+        ~RawVideoSink()
+        {
+            const uint32_t count = static_cast<uint32_t>(frameCount.load());
+            std::memcpy(mapped + offsetof(Header, frameCount), &count, sizeof(count));
+            close_file();
+        }
+
+        void write(const CapturedFrame & frame) override
+        {
+            if (frame.size != size || frame.channels != channels || frame.index >= maxFrames)
+            {
+                skippedFrames++;
+                return;
+            }
+            std::memcpy(mapped + sizeof(Header) + frameBytes * frame.index, frame.pixels, frameBytes);
+
+            // The header records one past the highest frame written
+            uint64_t seen = frameCount.load();
+            while (frame.index + 1 > seen && !frameCount.compare_exchange_weak(seen, frame.index + 1)) {}
+        }
+
+        uint64_t get_frame_count() const { return frameCount.load(); }
+        uint64_t get_skipped_frames() const { return skippedFrames.load(); }
+
+    private:
+
+        void close_file()
+        {
+        #if defined(_WIN32)
+            if (mapped) UnmapViewOfFile(mapped);
+            if (mapping) CloseHandle(mapping);
+            if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        #else
+            if (mapped) munmap(mapped, mappedBytes);
+            if (fd >= 0) close(fd);
+        #endif
+            mapped = nullptr;
+        }
+    };
+
+    class GlFrameCapture
+    {
+        enum SlotState : int { SLOT_FREE, SLOT_READING, SLOT_COPYING };
+
+        struct Slot
+        {
+            std::atomic<int> state{ SLOT_FREE };
+            GLsync fence{ nullptr };
+            size_t offset{ 0 };
+            CapturedFrame frame;
+            bool flip{ false };
+            std::shared_ptr<FrameSink> sink;
+        };
+
+    public:
+
+        struct Stats
+        {
+            uint64_t capturedFrames{ 0 };   // readbacks issued
+            uint64_t droppedFrames{ 0 };    // requests refused because every slot was busy
+            uint64_t pendingFrames{ 0 };    // readbacks the GPU has not finished yet
+        };
+
+    private:
+
+        const int numSlots;
+        std::unique_ptr<Slot[]> slots;
+        std::vector<int> inFlight;          // slots in SLOT_READING, oldest first
+        int nextSlot{ 0 };
+
+        GlBuffer ring;
+        uint8_t * mapped{ nullptr };
+        size_t slotBytes{ 0 };
+
+        std::vector<std::thread> workers;
+        MPMCBlockingQueue<Slot *> jobs;
+        Stats stats;
+
+        void worker_loop()
+        {
+            std::vector<uint8_t> rows;
+            while (true)
+            {
+                Slot * slot;
+                jobs.wait_and_consume(slot);
+                if (!slot) return;
+
+                const CapturedFrame & f = slot->frame;
+                const size_t rowBytes = size_t(f.size.x) * f.channels;
+                rows.resize(rowBytes * f.size.y);
+                const uint8_t * src = mapped + slot->offset;
+                if (slot->flip)
+                {
+                    for (int y = 0; y < f.size.y; ++y) std::memcpy(rows.data() + y * rowBytes, src + (f.size.y - y - 1) * rowBytes, rowBytes);
+                }
+                else std::memcpy(rows.data(), src, rows.size());
+
+                // The mapping is free for the next readback as soon as the rows are out of it
+                CapturedFrame frame = f;
+                std::shared_ptr<FrameSink> sink = std::move(slot->sink);
+                slot->state.store(SLOT_FREE, std::memory_order_release);
+
+                frame.pixels = rows.data();
+                sink->write(frame);
+            }
+        }
+
+        // (Re)creates the ring for slots of at least `bytes`. Only possible when no slot is in use.
+        bool reserve(const size_t bytes)
+        {
+            if (bytes <= slotBytes) return true;
+            for (int i = 0; i < numSlots; ++i) if (slots[i].state.load(std::memory_order_acquire) != SLOT_FREE) return false;
+
+            if (mapped) glUnmapNamedBufferEXT(ring);
+            ring = GlBuffer();
+
+            slotBytes = (bytes + 255) & ~size_t(255);
+            const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glNamedBufferStorageEXT(ring, slotBytes * numSlots, nullptr, flags);
+            mapped = static_cast<uint8_t *>(glMapNamedBufferRangeEXT(ring, 0, slotBytes * numSlots, flags));
+            ring.size = slotBytes * numSlots;
+            for (int i = 0; i < numSlots; ++i) slots[i].offset = slotBytes * i;
+            return mapped != nullptr;
+        }
+
+        // Claims the next slot in ring order, or nullptr (and a dropped frame) when it is still busy
+        Slot * acquire(const size_t bytes)
+        {
+            update();
+            Slot & s = slots[nextSlot];
+            if (s.state.load(std::memory_order_acquire) != SLOT_FREE || !reserve(bytes))
+            {
+                stats.droppedFrames++;
+                return nullptr;
+            }
+            return &s;
+        }
+
+        void submit(Slot & s, const int2 size, const int channels, const bool flip, std::shared_ptr<FrameSink> sink, const uint64_t index, const std::string & name)
+        {
+            s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            s.frame = { nullptr, size, channels, index, name };
+            s.flip = flip;
+            s.sink = std::move(sink);
+            s.state.store(SLOT_READING, std::memory_order_relaxed);
+            inFlight.push_back(nextSlot);
+            nextSlot = (nextSlot + 1) % numSlots;
+            stats.capturedFrames++;
+        }
+
+        static int channels_for_format(const GLenum format)
+        {
+            switch (format)
+            {
+            case GL_RED: return 1;
+            case GL_RG: return 2;
+            case GL_RGB: case GL_BGR: return 3;
+            case GL_RGBA: case GL_BGRA: return 4;
+            default: throw std::invalid_argument("frame capture supports GL_RED, GL_RG, GL_RGB(A) and GL_BGR(A) only");
+            }
+        }
+
+        template<typename ReadFunc>
+        bool read_into_slot(const int2 size, const GLenum format, const bool flip, std::shared_ptr<FrameSink> sink, const uint64_t index, const std::string & name, ReadFunc read)
+        {
+            const int channels = channels_for_format(format);
+            Slot * s = acquire(size_t(size.x) * size.y * channels);
+            if (!s) return false;
+
+            GLint previousAlignment;
+            glGetIntegerv(GL_PACK_ALIGNMENT, &previousAlignment);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, ring);
+            read(reinterpret_cast<GLvoid *>(s->offset));
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            glPixelStorei(GL_PACK_ALIGNMENT, previousAlignment);
+
+            submit(*s, size, channels, flip, std::move(sink), index, name);
+            return true;
+        }
+
+    public:
+
+        GlFrameCapture(const int numSlots = 4, const int numWorkers = 2) : numSlots(std::max(1, numSlots)), slots(new Slot[std::max(1, numSlots)])
+        {
+            for (int i = 0; i < std::max(1, numWorkers); ++i) workers.emplace_back(&GlFrameCapture::worker_loop, this);
+        }
+
+        ~GlFrameCapture()
+        {
+            flush();
+            for (size_t i = 0; i < workers.size(); ++i) jobs.produce(nullptr);
+            for (auto & w : workers) w.join();
+            if (mapped) glUnmapNamedBufferEXT(ring);
+        }
+
+        // Queues a readback of the currently bound read framebuffer. Rows are flipped to top-down before the sink sees them.
+        bool capture_framebuffer(const int2 origin, const int2 size, const GLenum format, std::shared_ptr<FrameSink> sink, const uint64_t index = 0, const std::string & name = {})
+        {
+            return read_into_slot(size, format, true, std::move(sink), index, name, [&](GLvoid * offset)
+            {
+                glReadPixels(origin.x, origin.y, size.x, size.y, format, GL_UNSIGNED_BYTE, offset);
+            });
+        }
+
+        // Queues a readback of one level (or cube face, via `target`) of a texture, rows in GL order
+        bool capture_texture(const GLuint texture, const GLenum target, const int level, const int2 size, const GLenum format, std::shared_ptr<FrameSink> sink, const uint64_t index = 0, const std::string & name = {})
+        {
+            return read_into_slot(size, format, false, std::move(sink), index, name, [&](GLvoid * offset)
+            {
+                glGetTextureImageEXT(texture, target, level, format, GL_UNSIGNED_BYTE, offset);
+            });
+        }
+
+        // Call once per frame on the GL thread: hands finished readbacks to the workers without waiting
+        void update()
+        {
+            size_t done = 0;
+            for (; done < inFlight.size(); ++done)
+            {
+                Slot & s = slots[inFlight[done]];
+                if (glClientWaitSync(s.fence, 0, 0) == GL_TIMEOUT_EXPIRED) break;
+                glDeleteSync(s.fence);
+                s.fence = nullptr;
+                s.state.store(SLOT_COPYING, std::memory_order_relaxed);
+                jobs.produce(&s);
+            }
+            inFlight.erase(inFlight.begin(), inFlight.begin() + done);
+        }
+
+        // Blocks until every queued readback has been handed to a worker. For shutdown and one-off tools.
+        void flush()
+        {
+            for (int i : inFlight)
+            {
+                Slot & s = slots[i];
+                while (glClientWaitSync(s.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+                glDeleteSync(s.fence);
+                s.fence = nullptr;
+                s.state.store(SLOT_COPYING, std::memory_order_relaxed);
+                jobs.produce(&s);
+            }
+            inFlight.clear();
+        }
+
+        Stats get_stats() const
+        {
+            Stats s = stats;
+            s.pendingFrames = inFlight.size();
+            return s;
+        }
+    };
+
+} // end namespace avl
+
+#endif // end gl_frame_capture_hpp
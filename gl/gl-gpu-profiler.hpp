@@ -0,0 +1,146 @@
+#pragma once
+
+#ifndef gl_gpu_profiler_hpp
+#define gl_gpu_profiler_hpp
+
+#include "gl-api.hpp"
+#include "profiler.hpp"
+
+/*
+ * GPU side of avl::Profiler. Regions are bracketed with GL_TIMESTAMP queries taken from a per-frame pool that is
+ * reused FRAME_LATENCY frames later, by which point the results are normally available; reading them never blocks.
+ * Resolved regions are shifted onto the profiler clock (calibrated each frame against glGetInteger64v(GL_TIMESTAMP))
+ * and submitted to a "gpu" track, so they show up in statistics, the flame graph and trace exports next to the
+ * CPU scopes that issued them, FRAME_LATENCY frames late. All calls belong on the GL thread.
+ */
+class GlGpuProfiler
+{
+    constexpr static const int FRAME_LATENCY = 4;
+
+    struct Range
+    {
+        avl::ProfileTag tag;
+        uint32_t beginQuery, endQuery;
+        uint32_t depth;
+    };
+
+    struct FrameQueries
+    {
+        std::vector<GLuint> pool;       // grows to the high-water mark once, then recycles
+        size_t used{ 0 };
+        std::vector<Range> ranges;
+        int64_t gpuToCpuNs{ 0 };
+        bool pending{ false };
+    };
+
+    avl::Profiler & profiler;
+    avl::Profiler::Track * track;
+    FrameQueries frames[FRAME_LATENCY];
+    int current{ 0 };
+    std::vector<uint32_t> open;         // indices into frames[current].ranges
+    bool recording{ false };            // profiler state latched at the start of each frame
+    uint64_t droppedFrames{ 0 };
+
+    uint32_t next_query()
+    {
+        FrameQueries & f = frames[current];
+        if (f.used == f.pool.size())
+        {
+            GLuint q;
+            glGenQueries(1, &q);
+            f.pool.push_back(q);
+        }
+        return static_cast<uint32_t>(f.used++);
+    }
+
+    void resolve(FrameQueries & f)
+    {
+        if (!f.pending) return;
+        f.pending = false;
+        if (f.ranges.empty()) return;
+
+        GLint available = 0;
+        glGetQueryObjectiv(f.pool[f.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+        {
+            droppedFrames++;
+            return;
+        }
+
+        for (const Range & r : f.ranges)
+        {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(f.pool[r.beginQuery], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(f.pool[r.endQuery], GL_QUERY_RESULT, &end);
+            profiler.submit(track, r.tag, int64_t(begin) + f.gpuToCpuNs, int64_t(end) + f.gpuToCpuNs, r.depth);
+        }
+    }
+
+public:
+
+    GlGpuProfiler(const std::string & trackName = "gpu", avl::Profiler & profiler = avl::Profiler::get())
+        : profiler(profiler), track(profiler.create_track(trackName)) {}
+
+    ~GlGpuProfiler()
+    {
+        for (auto & f : frames) if (!f.pool.empty()) glDeleteQueries(static_cast<GLsizei>(f.pool.size()), f.pool.data());
+    }
+
+    void begin(const avl::ProfileTag & tag)
+    {
+        if (!recording) return;
+        FrameQueries & f = frames[current];
+        const uint32_t q = next_query();
+        glQueryCounter(f.pool[q], GL_TIMESTAMP);
+        open.push_back(static_cast<uint32_t>(f.ranges.size()));
+        f.ranges.push_back({ tag, q, q, static_cast<uint32_t>(open.size() - 1) });
+    }
+
+    void end()
+    {
+        if (!recording || open.empty()) return;
+        FrameQueries & f = frames[current];
+        const uint32_t q = next_query();
+        glQueryCounter(f.pool[q], GL_TIMESTAMP);
+        f.ranges[open.back()].endQuery = q;
+        open.pop_back();
+    }
+
+    // Closes the current frame's pool and submits the one recorded FRAME_LATENCY - 1 frames ago
+    void end_frame()
+    {
+        assert(open.empty() && "unbalanced GlGpuProfiler::begin/end");
+        open.clear();
+
+        FrameQueries & f = frames[current];
+        if (recording)
+        {
+            GLint64 gpuNow = 0;
+            glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+            f.gpuToCpuNs = profiler.now_ns() - gpuNow;
+            f.pending = true;
+        }
+
+        current = (current + 1) % FRAME_LATENCY;
+        FrameQueries & next = frames[current];
+        resolve(next);
+        next.used = 0;
+        next.ranges.clear();
+
+        recording = profiler.is_enabled();
+    }
+
+    uint64_t get_dropped_frames() const { return droppedFrames; }
+};
+
+class GlGpuProfileScope
+{
+    GlGpuProfiler & profiler;
+public:
+    GlGpuProfileScope(GlGpuProfiler & profiler, const avl::ProfileTag & tag) : profiler(profiler) { profiler.begin(tag); }
+    ~GlGpuProfileScope() { profiler.end(); }
+};
+
+#define AVL_PROFILE_GPU_SCOPE(PROFILER, NAME) GlGpuProfileScope AVL_PROFILE_CONCAT(gpuProfileScope, __LINE__)(PROFILER, AVL_PROFILE_TAG(NAME))
+
+#endif // end gl_gpu_profiler_hpp
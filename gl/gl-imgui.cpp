@@ -5,6 +5,7 @@
 #include "imgui/imgui_internal.h"
 #include "gl-api.hpp"
 #include "glfw-app.hpp"
+#include "profiler.hpp"
 
 using namespace avl;
 
@@ -443,6 +444,96 @@ namespace gui
         return result;
     }
 
+    //////////////////
+    //   Profiler   //
+    //////////////////
+
+    void profiler_flame_graph(const avl::Profiler & profiler, float rowHeight)
+    {
+        const avl::Profiler::Frame * frame = profiler.get_last_frame();
+        if (!frame || frame->events.empty()) return;
+
+        const auto trackNames = profiler.get_track_names();
+        const size_t numTracks = trackNames.size();
+
+        // GPU tracks are submitted several frames late, so each track is laid out against its own earliest event
+        std::vector<int64_t> origin(numTracks, frame->beginNs);
+        std::vector<uint32_t> rows(numTracks, 0);
+        int64_t span = std::max<int64_t>(1, frame->endNs - frame->beginNs);
+        for (const auto & e : frame->events) origin[e.track] = std::min(origin[e.track], e.beginNs);
+        for (const auto & e : frame->events)
+        {
+            rows[e.track] = std::max(rows[e.track], e.depth + 1);
+            span = std::max(span, e.endNs - origin[e.track]);
+        }
+
+        uint32_t totalRows = 0;
+        std::vector<uint32_t> firstRow(numTracks, 0);
+        for (size_t t = 0; t < numTracks; ++t) { firstRow[t] = totalRows; totalRows += rows[t]; }
+        if (!totalRows) return;
+
+        const float labelWidth = 80.f;
+        const ImVec2 pos = ImGui::GetCursorScreenPos();
+        const ImVec2 size = { std::max(ImGui::GetContentRegionAvail().x, labelWidth + 16.f), rowHeight * totalRows };
+        const float graphWidth = size.x - labelWidth;
+        const float nsToPixels = graphWidth / static_cast<float>(span);
+
+        ImDrawList * draw = ImGui::GetWindowDrawList();
+        draw->AddRectFilled(pos, { pos.x + size.x, pos.y + size.y }, IM_COL32(30, 30, 30, 255));
+        for (size_t t = 0; t < numTracks; ++t)
+        {
+            if (!rows[t]) continue;
+            draw->AddText({ pos.x + 2.f, pos.y + firstRow[t] * rowHeight + 1.f }, IM_COL32(200, 200, 200, 255), trackNames[t].c_str());
+        }
+
+        ImGui::PushClipRect(pos, { pos.x + size.x, pos.y + size.y }, true);
+        for (const auto & e : frame->events)
+        {
+            const float x0 = pos.x + labelWidth + (e.beginNs - origin[e.track]) * nsToPixels;
+            const float x1 = std::max(x0 + 1.f, pos.x + labelWidth + (e.endNs - origin[e.track]) * nsToPixels);
+            const float y0 = pos.y + (firstRow[e.track] + e.depth) * rowHeight;
+            const ImVec2 min = { x0, y0 + 1.f }, max = { x1, y0 + rowHeight - 1.f };
+
+            float r, g, b;
+            ImGui::ColorConvertHSVtoRGB((e.id % 360) / 360.f, 0.55f, 0.8f, r, g, b);
+            draw->AddRectFilled(min, max, ImGui::GetColorU32(ImVec4(r, g, b, 1.f)));
+
+            const float textWidth = ImGui::CalcTextSize(e.name).x;
+            if (textWidth + 4.f < x1 - x0)
+            {
+                draw->PushClipRect(min, max, true);
+                draw->AddText({ x0 + 2.f, y0 + 1.f }, IM_COL32(0, 0, 0, 255), e.name);
+                draw->PopClipRect();
+            }
+
+            if (ImGui::IsMouseHoveringRect(min, max)) ImGui::SetTooltip("%s: %.3f ms", e.name, (e.endNs - e.beginNs) * 1e-6);
+        }
+        ImGui::PopClipRect();
+
+        ImGui::Dummy(size);
+    }
+
+    void profiler_statistics(const avl::Profiler & profiler)
+    {
+        const auto trackNames = profiler.get_track_names();
+
+        ImGui::Columns(6, "profiler-statistics");
+        for (const char * header : { "region", "calls", "min", "avg", "max", "p99" }) { ImGui::Text("%s", header); ImGui::NextColumn(); }
+        ImGui::Separator();
+        for (const auto & s : profiler.get_stats())
+        {
+            ImGui::Text("[%s] %s", s.track < trackNames.size() ? trackNames[s.track].c_str() : "?", s.name); ImGui::NextColumn();
+            ImGui::Text("%u", s.calls); ImGui::NextColumn();
+            ImGui::Text("%.3f", s.minMs); ImGui::NextColumn();
+            ImGui::Text("%.3f", s.avgMs); ImGui::NextColumn();
+            ImGui::Text("%.3f", s.maxMs); ImGui::NextColumn();
+            ImGui::Text("%.3f", s.p99Ms); ImGui::NextColumn();
+        }
+        ImGui::Columns(1);
+
+        if (profiler.get_dropped_events()) ImGui::TextColored({ 1, 0.5f, 0, 1 }, "%llu events dropped", (unsigned long long) profiler.get_dropped_events());
+    }
+
     ////////////////////
     //   Menu Stack   //
     ////////////////////
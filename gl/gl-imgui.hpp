@@ -36,6 +36,7 @@ namespace avl
 {
     class GLFWApp;
     struct InputEvent;
+    class Profiler;
 }
 
 struct GLFWwindow;
@@ -153,6 +154,12 @@ namespace gui
     bool InputTextMultiline(const char* label, std::string* buf, const ImVec2& size = ImVec2(0,0), ImGuiInputTextFlags flags = 0, ImGuiTextEditCallback callback = NULL, void* user_data = NULL);
     bool Combo(const char* label, int* current_item, const std::vector<std::string>& items, int height_in_items = -1);
 
+    // Last profiled frame as one row per track and nesting depth; hover a region for its name and duration
+    void profiler_flame_graph(const avl::Profiler & profiler, float rowHeight = 16.f);
+
+    // Min/avg/max/p99 of per-frame totals for every profiled region
+    void profiler_statistics(const avl::Profiler & profiler);
+
     class imgui_menu_stack
     {
         bool * keys;
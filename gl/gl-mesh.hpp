@@ -12,6 +12,8 @@
 #include <vector>
 #include <fstream>
 #include <algorithm>
+#include <limits>
+#include <cstring>
 #include <assert.h>
 
 #if defined(ANVIL_PLATFORM_WINDOWS)
@@ -22,106 +24,228 @@
 
 namespace avl
 {
-    inline GlMesh make_mesh_from_geometry(const Geometry & geometry, const GLenum usage = GL_STATIC_DRAW)
+    /*
+     * Vertex encodings for make_mesh_from_geometry. The default reproduces the original all-float interleaved layout;
+     * compact() packs a fully attributed vertex into 32 bytes instead of 68. Attribute locations never change
+     * (0 position, 1 normal, 2 color, 3 texcoord, 4 tangent, 5 bitangent). Half-float texcoords and 8-bit colors are
+     * converted by the vertex fetch, but octahedral normals and derived bitangents must be decoded in the shader:
+     * compile it with shader_defines() and use the decode_vertex_* helpers from renderer_common.glsl.
+     */
+    struct VertexFormat
     {
-        assert(geometry.vertices.size() > 0);
-
-        GlMesh m;
-
-        int vertexOffset = 0;
-        int normalOffset = 0;
-        int colorOffset = 0;
-        int texOffset = 0;
-        int tanOffset = 0;
-        int bitanOffset = 0;
-
-        int components = 3;
-
-        if (geometry.normals.size() != 0)
+        bool octahedralNormals{ false };    // normal and tangent as 2x snorm16 octahedral coordinates
+        bool halfTexcoords{ false };        // texcoord0 as 2x half float
+        bool unormColors{ false };          // color as 4x unorm8
+        bool deriveBitangent{ false };      // no bitangent stream; its handedness rides in the tangent's last component
+        bool shortIndices{ false };         // 16-bit indices whenever every vertex is addressable
+        bool positionStream{ false };       // positions in their own buffer, drawn alone by GlMesh::draw_positions()
+
+        static VertexFormat compact()
         {
-            normalOffset = components; components += 3;
+            VertexFormat f;
+            f.octahedralNormals = f.halfTexcoords = f.unormColors = f.deriveBitangent = f.shortIndices = f.positionStream = true;
+            return f;
         }
 
-        if (geometry.colors.size() != 0)
+        std::vector<std::string> shader_defines() const
         {
-            colorOffset = components; components += 3;
+            std::vector<std::string> defines;
+            if (octahedralNormals) defines.push_back("VERTEX_OCTAHEDRAL_NORMALS");
+            if (deriveBitangent) defines.push_back("VERTEX_DERIVED_BITANGENT");
+            return defines;
         }
+    };
 
-        if (geometry.texcoord0.size() != 0)
-        {
-            texOffset = components; components += 2;
-        }
+    inline int16_t pack_snorm16(const float v) { return static_cast<int16_t>(std::round(clamp(v, -1.f, 1.f) * 32767.f)); }
+    inline uint8_t pack_unorm8(const float v) { return static_cast<uint8_t>(std::round(clamp(v, 0.f, 1.f) * 255.f)); }
 
-        if (geometry.tangents.size() != 0)
+    // Round-to-nearest-even float to IEEE half, with overflow to infinity and denormals preserved
+    inline uint16_t pack_half(const float value)
+    {
+        uint32_t u;
+        memcpy(&u, &value, sizeof(u));
+        const uint32_t sign = u & 0x80000000u;
+        u ^= sign;
+
+        uint32_t h;
+        if (u >= (143u << 23)) h = (u > (255u << 23)) ? 0x7e00 : 0x7c00;
+        else if (u < (113u << 23))
         {
-            tanOffset = components; components += 3;
+            // Let the FPU align the mantissa for the denormal result
+            const uint32_t magicBits = 126u << 23;
+            float f, magic;
+            memcpy(&f, &u, sizeof(f));
+            memcpy(&magic, &magicBits, sizeof(magic));
+            f += magic;
+            memcpy(&u, &f, sizeof(u));
+            h = u - magicBits;
         }
-
-        if (geometry.bitangents.size() != 0)
+        else
         {
-            bitanOffset = components; components += 3;
+            const uint32_t mantissaOdd = (u >> 13) & 1;
+            u += (uint32_t(15 - 127) << 23) + 0xfff + mantissaOdd;
+            h = u >> 13;
         }
+        return static_cast<uint16_t>(h | (sign >> 16));
+    }
 
-        std::vector<float> buffer;
-        buffer.reserve(geometry.vertices.size() * components);
+    // Unit vector to the [-1, 1]^2 octahedral parameterization
+    inline float2 octahedral_encode(const float3 & n)
+    {
+        const float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+        if (l1 <= 0.f) return float2(0, 0);
+        float2 e = float2(n.x, n.y) / l1;
+        if (n.z < 0.f) e = float2((1.f - std::abs(e.y)) * (e.x >= 0.f ? 1.f : -1.f), (1.f - std::abs(e.x)) * (e.y >= 0.f ? 1.f : -1.f));
+        return e;
+    }
 
-        for (size_t i = 0; i < geometry.vertices.size(); ++i)
-        {
-            buffer.push_back(geometry.vertices[i].x);
-            buffer.push_back(geometry.vertices[i].y);
-            buffer.push_back(geometry.vertices[i].z);
+    inline float3 octahedral_decode(const float2 & e)
+    {
+        float3 v(e.x, e.y, 1.f - std::abs(e.x) - std::abs(e.y));
+        if (v.z < 0.f) v = float3((1.f - std::abs(e.y)) * (e.x >= 0.f ? 1.f : -1.f), (1.f - std::abs(e.x)) * (e.y >= 0.f ? 1.f : -1.f), v.z);
+        return safe_normalize(v);
+    }
 
-            if (normalOffset)
-            {
-                buffer.push_back(geometry.normals[i].x);
-                buffer.push_back(geometry.normals[i].y);
-                buffer.push_back(geometry.normals[i].z);
-            }
+    inline GlMesh make_mesh_from_geometry(const Geometry & geometry, const VertexFormat & format, const GLenum usage = GL_STATIC_DRAW)
+    {
+        assert(geometry.vertices.size() > 0);
 
-            if (colorOffset)
+        GlMesh m;
+
+        const size_t vertexCount = geometry.vertices.size();
+        const bool hasNormals = geometry.normals.size() != 0;
+        const bool hasColors = geometry.colors.size() != 0;
+        const bool hasTexcoords = geometry.texcoord0.size() != 0;
+        const bool hasTangents = geometry.tangents.size() != 0;
+        const bool hasBitangents = geometry.bitangents.size() != 0 && !format.deriveBitangent;
+        const bool tangentSign = hasTangents && format.deriveBitangent;
+
+        // Byte offsets into the interleaved stream; -1 when the attribute is absent
+        int positionOffset = -1, normalOffset = -1, colorOffset = -1, texOffset = -1, tanOffset = -1, bitanOffset = -1;
+        int stride = 0;
+
+        const int directionSize = format.octahedralNormals ? 2 * sizeof(int16_t) : 3 * sizeof(float);
+        const int tangentSize = format.octahedralNormals ? (tangentSign ? 4 : 2) * sizeof(int16_t) : (tangentSign ? 4 : 3) * sizeof(float);
+
+        if (!format.positionStream) { positionOffset = stride; stride += 3 * sizeof(float); }
+        if (hasNormals) { normalOffset = stride; stride += directionSize; }
+        if (hasColors) { colorOffset = stride; stride += format.unormColors ? 4 * sizeof(uint8_t) : 3 * sizeof(float); }
+        if (hasTexcoords) { texOffset = stride; stride += format.halfTexcoords ? 2 * sizeof(uint16_t) : 2 * sizeof(float); }
+        if (hasTangents) { tanOffset = stride; stride += tangentSize; }
+        if (hasBitangents) { bitanOffset = stride; stride += directionSize; }
+
+        auto write_direction = [&](uint8_t * dst, const float3 & d)
+        {
+            if (format.octahedralNormals)
             {
-                buffer.push_back(geometry.colors[i].x);
-                buffer.push_back(geometry.colors[i].y);
-                buffer.push_back(geometry.colors[i].z);
+                const float2 e = octahedral_encode(d);
+                const int16_t packed[2] = { pack_snorm16(e.x), pack_snorm16(e.y) };
+                memcpy(dst, packed, sizeof(packed));
             }
+            else memcpy(dst, &d, sizeof(float3));
+        };
+
+        std::vector<uint8_t> buffer(vertexCount * stride);
+        for (size_t i = 0; i < vertexCount && stride; ++i)
+        {
+            uint8_t * v = buffer.data() + i * stride;
 
-            if (texOffset)
+            if (positionOffset >= 0) memcpy(v + positionOffset, &geometry.vertices[i], sizeof(float3));
+
+            if (normalOffset >= 0) write_direction(v + normalOffset, geometry.normals[i]);
+
+            if (colorOffset >= 0)
             {
-                buffer.push_back(geometry.texcoord0[i].x);
-                buffer.push_back(geometry.texcoord0[i].y);
+                const float4 & c = geometry.colors[i];
+                if (format.unormColors)
+                {
+                    const uint8_t packed[4] = { pack_unorm8(c.x), pack_unorm8(c.y), pack_unorm8(c.z), 255 };
+                    memcpy(v + colorOffset, packed, sizeof(packed));
+                }
+                else memcpy(v + colorOffset, &c, sizeof(float3));
             }
 
-            if (tanOffset)
+            if (texOffset >= 0)
             {
-                buffer.push_back(geometry.tangents[i].x);
-                buffer.push_back(geometry.tangents[i].y);
-                buffer.push_back(geometry.tangents[i].z);
+                const float2 & t = geometry.texcoord0[i];
+                if (format.halfTexcoords)
+                {
+                    const uint16_t packed[2] = { pack_half(t.x), pack_half(t.y) };
+                    memcpy(v + texOffset, packed, sizeof(packed));
+                }
+                else memcpy(v + texOffset, &t, sizeof(float2));
             }
 
-            if (bitanOffset)
+            if (tanOffset >= 0)
             {
-                buffer.push_back(geometry.bitangents[i].x);
-                buffer.push_back(geometry.bitangents[i].y);
-                buffer.push_back(geometry.bitangents[i].z);
+                write_direction(v + tanOffset, geometry.tangents[i]);
+                if (tangentSign)
+                {
+                    // Handedness of the supplied frame, so the shader can rebuild the bitangent as cross(n, t) * sign
+                    float sign = 1.f;
+                    if (hasNormals && geometry.bitangents.size() == vertexCount)
+                    {
+                        sign = dot(cross(geometry.normals[i], geometry.tangents[i]), geometry.bitangents[i]) < 0.f ? -1.f : 1.f;
+                    }
+                    if (format.octahedralNormals)
+                    {
+                        const int16_t packed[2] = { pack_snorm16(sign), 0 };
+                        memcpy(v + tanOffset + 2 * sizeof(int16_t), packed, sizeof(packed));
+                    }
+                    else memcpy(v + tanOffset + sizeof(float3), &sign, sizeof(float));
+                }
             }
+
+            if (bitanOffset >= 0) write_direction(v + bitanOffset, geometry.bitangents[i]);
+        }
+
+        auto offset_ptr = [](const int offset) { return reinterpret_cast<const GLvoid *>(static_cast<intptr_t>(offset)); };
+        const GLint directionComponents = format.octahedralNormals ? 2 : 3;
+        const GLenum directionType = format.octahedralNormals ? GL_SHORT : GL_FLOAT;
+        const GLboolean directionNormalized = format.octahedralNormals ? GL_TRUE : GL_FALSE;
+
+        if (format.positionStream)
+        {
+            m.set_position_data(vertexCount * sizeof(float3), geometry.vertices.data(), usage);
+            m.set_position_attribute(0, 3, GL_FLOAT, sizeof(float3), nullptr);
         }
 
-        m.set_vertex_data(buffer.size() * sizeof(float), buffer.data(), usage);
-        m.set_attribute(0, 3, GL_FLOAT, GL_FALSE, components * sizeof(float), ((float*)0) + vertexOffset);
-        if (normalOffset) m.set_attribute(1, 3, GL_FLOAT, GL_FALSE, components * sizeof(float), ((float*)0) + normalOffset);
-        if (colorOffset) m.set_attribute(2, 3, GL_FLOAT, GL_FALSE, components * sizeof(float), ((float*)0) + colorOffset);
-        if (texOffset) m.set_attribute(3, 2, GL_FLOAT, GL_FALSE, components * sizeof(float), ((float*)0) + texOffset);
-        if (tanOffset) m.set_attribute(4, 3, GL_FLOAT, GL_FALSE, components * sizeof(float), ((float*)0) + tanOffset);
-        if (bitanOffset) m.set_attribute(5, 3, GL_FLOAT, GL_FALSE, components * sizeof(float), ((float*)0) + bitanOffset);
+        if (stride)
+        {
+            m.set_vertex_data(buffer.size(), buffer.data(), usage);
+            if (positionOffset >= 0) m.set_attribute(0, 3, GL_FLOAT, GL_FALSE, stride, offset_ptr(positionOffset));
+            if (normalOffset >= 0) m.set_attribute(1, directionComponents, directionType, directionNormalized, stride, offset_ptr(normalOffset));
+            if (colorOffset >= 0) m.set_attribute(2, format.unormColors ? 4 : 3, format.unormColors ? GL_UNSIGNED_BYTE : GL_FLOAT, format.unormColors ? GL_TRUE : GL_FALSE, stride, offset_ptr(colorOffset));
+            if (texOffset >= 0) m.set_attribute(3, 2, format.halfTexcoords ? GL_HALF_FLOAT : GL_FLOAT, GL_FALSE, stride, offset_ptr(texOffset));
+            if (tanOffset >= 0) m.set_attribute(4, tangentSign ? 4 : directionComponents, directionType, directionNormalized, stride, offset_ptr(tanOffset));
+            if (bitanOffset >= 0) m.set_attribute(5, directionComponents, directionType, directionNormalized, stride, offset_ptr(bitanOffset));
+        }
 
         if (geometry.faces.size() > 0)
         {
-            m.set_elements(geometry.faces, usage);
+            if (format.shortIndices && vertexCount <= std::numeric_limits<uint16_t>::max())
+            {
+                std::vector<uint16_t> indices;
+                indices.reserve(geometry.faces.size() * 3);
+                for (const uint3 & f : geometry.faces)
+                {
+                    indices.push_back(static_cast<uint16_t>(f.x));
+                    indices.push_back(static_cast<uint16_t>(f.y));
+                    indices.push_back(static_cast<uint16_t>(f.z));
+                }
+                m.set_indices(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), indices.data(), usage);
+            }
+            else m.set_elements(geometry.faces, usage);
         }
 
         return m;
     }
 
+    inline GlMesh make_mesh_from_geometry(const Geometry & geometry, const GLenum usage = GL_STATIC_DRAW)
+    {
+        return make_mesh_from_geometry(geometry, VertexFormat(), usage);
+    }
+
 }
 
 #pragma warning(pop)
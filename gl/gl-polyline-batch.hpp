@@ -0,0 +1,224 @@
+#pragma once
+
+#ifndef gl_polyline_batch_hpp
+#define gl_polyline_batch_hpp
+
+#include "gl-api.hpp"
+#include "gl-mesh.hpp"
+
+/*
+ * Screen-space polylines with per-line width (in pixels) and color, rebuilt every frame and drawn in one call.
+ * Only the raw points are uploaded, one 24-byte record each, into a persistent-mapped GlStreamingBuffer. Every
+ * segment is an instance of a four-vertex strip: the vertex shader reads the segment's two points and their neighbours
+ * as instanced attributes offset by one record each, and expands the quad from gl_VertexID with miter joins (clamped
+ * to a miter limit) and butt or square caps. Segments that cross the eye plane are clipped before projection.
+ */
+class GlPolylineBatch
+{
+    enum : uint32_t { DRAW_NEXT = 1, JOIN_PREV = 2, JOIN_NEXT = 4 };
+
+    // The segment from a point to the following record is drawn when DRAW_NEXT is set. Its start is mitered with the
+    // preceding record when the start point has JOIN_PREV, its end with the following one when the end point has
+    // JOIN_NEXT; otherwise that end is capped
+    struct Point
+    {
+        float3 position;
+        float width;
+        uint8_t color[4];
+        uint32_t flags;
+    };
+
+    constexpr static const char polylineVertexShader[] = R"(#version 330
+        layout(location = 0) in vec3 previous;
+        layout(location = 1) in vec4 a;             // xyz position, w width in pixels
+        layout(location = 2) in vec4 b;
+        layout(location = 3) in vec3 next;
+        layout(location = 4) in vec4 colorA;
+        layout(location = 5) in vec4 colorB;
+        layout(location = 6) in uint flagsA;
+        layout(location = 7) in uint flagsB;
+
+        uniform mat4 u_viewProj;
+        uniform vec2 u_resolution;
+        uniform float u_miterLimit;
+        uniform int u_squareCaps;
+
+        out vec4 v_color;
+
+        const uint DRAW_NEXT = 1u, JOIN_PREV = 2u, JOIN_NEXT = 4u;
+        const float NEAR_W = 1e-4;
+
+        vec2 to_screen(vec4 p) { return p.xy / p.w * 0.5 * u_resolution; }
+
+        void main()
+        {
+            bool atA = gl_VertexID < 2;
+            float side = (gl_VertexID & 1) == 0 ? 1.0 : -1.0;
+
+            vec4 clipA = u_viewProj * vec4(a.xyz, 1.0);
+            vec4 clipB = u_viewProj * vec4(b.xyz, 1.0);
+
+            // Skipped segments and segments entirely behind the eye collapse outside the clip volume
+            if ((flagsA & DRAW_NEXT) == 0u || (clipA.w < NEAR_W && clipB.w < NEAR_W))
+            {
+                gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+                v_color = vec4(0.0);
+                return;
+            }
+
+            // Clip against the eye plane so the projection below stays finite; clipped ends get caps
+            bool clippedA = clipA.w < NEAR_W, clippedB = clipB.w < NEAR_W;
+            if (clippedA) clipA = mix(clipA, clipB, (NEAR_W - clipA.w) / (clipB.w - clipA.w));
+            if (clippedB) clipB = mix(clipB, clipA, (NEAR_W - clipB.w) / (clipA.w - clipB.w));
+
+            vec2 sa = to_screen(clipA), sb = to_screen(clipB);
+            vec2 dir = sb - sa;
+            float len = length(dir);
+            dir = len > 1e-6 ? dir / len : vec2(1.0, 0.0);
+            vec2 normal = vec2(-dir.y, dir.x);
+
+            vec4 clip = atA ? clipA : clipB;
+            float halfWidth = 0.5 * (atA ? a.w : b.w);
+            vec2 offset = normal * halfWidth, along = vec2(0.0);
+
+            bool join = atA ? ((flagsA & JOIN_PREV) != 0u && !clippedA) : ((flagsB & JOIN_NEXT) != 0u && !clippedB);
+            vec4 clipNeighbour = u_viewProj * vec4(atA ? previous : next, 1.0);
+            if (join && clipNeighbour.w >= NEAR_W)
+            {
+                vec2 sn = to_screen(clipNeighbour);
+                vec2 other = atA ? sa - sn : sn - sb;
+                float otherLength = length(other);
+                vec2 tangent = (otherLength > 1e-6 ? other / otherLength : dir) + dir;
+
+                // Both segments meeting here compute the same miter, so the joint is seamless
+                if (dot(tangent, tangent) > 1e-6)
+                {
+                    tangent = normalize(tangent);
+                    vec2 miter = vec2(-tangent.y, tangent.x);
+                    offset = miter * (halfWidth / max(dot(miter, normal), 1.0 / u_miterLimit));
+                }
+            }
+            else if (u_squareCaps != 0)
+            {
+                along = dir * (atA ? -halfWidth : halfWidth);
+            }
+
+            clip.xy += (side * offset + along) / (0.5 * u_resolution) * clip.w;
+            gl_Position = clip;
+            v_color = atA ? colorA : colorB;
+        }
+    )";
+
+    constexpr static const char polylineFragmentShader[] = R"(#version 330
+        in vec4 v_color;
+        out vec4 f_color;
+        void main() { f_color = v_color; }
+    )";
+
+    std::vector<Point> points;
+    GlStreamingBuffer pointStream;
+    GlVertexArrayObject vao;
+    GlShader shader;
+
+    void push(const float3 & position, const float width, const uint8_t (&color)[4], const uint32_t flags)
+    {
+        points.push_back({ position, width, { color[0], color[1], color[2], color[3] }, flags });
+    }
+
+public:
+
+    float miterLimit = 4.f;     // longest miter as a multiple of the half width
+    bool squareCaps = false;    // extend open ends by half the width instead of stopping at the endpoint
+
+    GlPolylineBatch(const GLsizeiptr bytesPerFrame = 1 << 20) : pointStream(bytesPerFrame)
+    {
+        shader = GlShader(polylineVertexShader, polylineFragmentShader);
+    }
+
+    // Closed polylines also join the last point back to the first
+    void add_polyline(const float3 * positions, const size_t count, const float width, const float4 & color, const bool closed = false)
+    {
+        if (count < 2) return;
+        const uint8_t c[4] = { avl::pack_unorm8(color.x), avl::pack_unorm8(color.y), avl::pack_unorm8(color.z), avl::pack_unorm8(color.w) };
+
+        if (!closed)
+        {
+            push(positions[0], width, c, DRAW_NEXT);
+            for (size_t i = 1; i + 1 < count; ++i) push(positions[i], width, c, DRAW_NEXT | JOIN_PREV | JOIN_NEXT);
+            push(positions[count - 1], width, c, 0);
+            return;
+        }
+
+        // Neighbours on both sides of the seam are written as undrawn records so every joint gets a miter
+        push(positions[count - 1], width, c, 0);
+        for (size_t i = 0; i < count; ++i) push(positions[i], width, c, DRAW_NEXT | JOIN_PREV | JOIN_NEXT);
+        push(positions[0], width, c, JOIN_NEXT);
+        push(positions[1], width, c, 0);
+    }
+
+    void add_polyline(const std::vector<float3> & positions, const float width, const float4 & color, const bool closed = false)
+    {
+        add_polyline(positions.data(), positions.size(), width, color, closed);
+    }
+
+    void add_line(const float3 & from, const float3 & to, const float width, const float4 & color)
+    {
+        const float3 ends[2] = { from, to };
+        add_polyline(ends, 2, width, color);
+    }
+
+    // `resolution` is the viewport size in pixels. Each call uploads its own copy of the queued points (a plain memcpy,
+    // cheaper than expanding them), so stereo can call this once per eye with that eye's viewProj.
+    void draw(const float4x4 & viewProj, const float2 & resolution)
+    {
+        if (points.size() < 2) return;
+
+        // A sentinel record on each side lets every instance read its four neighbours from one attribute window
+        const GlStreamingRange range = pointStream.allocate((points.size() + 2) * sizeof(Point), 16);
+        Point * out = static_cast<Point *>(range.data);
+        out[0] = points.front();
+        out[0].flags = 0;
+        memcpy(out + 1, points.data(), points.size() * sizeof(Point));
+        out[points.size() + 1] = out[0];
+
+        // The four neighbour windows point into this call's copy, wherever the stream placed it (see GlStreamingBuffer)
+        const GLsizei stride = sizeof(Point);
+        for (GLuint k = 0; k < 4; ++k)
+        {
+            const GLintptr base = range.offset + k * stride;
+            const bool endpoint = k == 1 || k == 2;
+            glEnableVertexArrayAttribEXT(vao, k);
+            glVertexArrayVertexAttribOffsetEXT(vao, range.buffer, k, endpoint ? 4 : 3, GL_FLOAT, GL_FALSE, stride, base + offsetof(Point, position));
+            glVertexArrayVertexAttribDivisorEXT(vao, k, 1);
+            if (!endpoint) continue;
+            glEnableVertexArrayAttribEXT(vao, k + 3);
+            glVertexArrayVertexAttribOffsetEXT(vao, range.buffer, k + 3, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, base + offsetof(Point, color));
+            glVertexArrayVertexAttribDivisorEXT(vao, k + 3, 1);
+            glEnableVertexArrayAttribEXT(vao, k + 5);
+            glVertexArrayVertexAttribIOffsetEXT(vao, range.buffer, k + 5, 1, GL_UNSIGNED_INT, stride, base + offsetof(Point, flags));
+            glVertexArrayVertexAttribDivisorEXT(vao, k + 5, 1);
+        }
+
+        shader.bind();
+        shader.uniform("u_viewProj", viewProj);
+        shader.uniform("u_resolution", resolution);
+        shader.uniform("u_miterLimit", std::max(miterLimit, 1.f));
+        shader.uniform("u_squareCaps", squareCaps ? 1 : 0);
+        glBindVertexArray(vao);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(points.size() - 1));
+        glBindVertexArray(0);
+        shader.unbind();
+    }
+
+    // Call once per frame after the last draw(); forgets the queued lines and fences this frame's points
+    void clear()
+    {
+        points.clear();
+        pointStream.end_frame();
+    }
+
+    size_t point_count() const { return points.size(); }
+    const GlStreamingBuffer & get_point_stream() const { return pointStream; }
+};
+
+#endif // end gl_polyline_batch_hpp
@@ -125,6 +125,24 @@ namespace avl
     {
         return make_mesh_from_geometry(make_supershape_3d(segments, m, n1, n2, n3, a, b));
     }
+
+    // GPU meshes shared between every owner that asks for the same key; uploaded once, freed with the last owner.
+    // Owners must release their references before the GL context goes away, same as a GlMesh member.
+    inline MemoizedResources<GlMesh> & procedural_mesh_cache()
+    {
+        static MemoizedResources<GlMesh> cache;
+        return cache;
+    }
+
+    template<typename Generator>
+    inline std::shared_ptr<GlMesh> shared_mesh(const std::string & key, Generator && generate)
+    {
+        return procedural_mesh_cache().get(key, std::forward<Generator>(generate));
+    }
+
+    inline std::shared_ptr<GlMesh> shared_fullscreen_quad() { return shared_mesh("fullscreen-quad-ndc", [] { return make_fullscreen_quad_ndc(); }); }
+    inline std::shared_ptr<GlMesh> shared_fullscreen_quad_screenspace() { return shared_mesh("fullscreen-quad-screenspace", [] { return make_fullscreen_quad_screenspace(); }); }
+    inline std::shared_ptr<GlMesh> shared_sphere_mesh(float radius) { return shared_mesh(procedural_key("sphere", radius), [radius] { return make_sphere_mesh(radius); }); }
     
 }
 
@@ -166,7 +166,7 @@ class ProceduralSky
 
 protected:
 
-    GlMesh skyMesh;
+    std::shared_ptr<GlMesh> skyMesh;
     virtual void render_internal(float4x4 viewProj, float3 sunDir, float4x4 world) = 0;
 
 public:
@@ -180,7 +180,7 @@ public:
 
     ProceduralSky()
     {
-        skyMesh = make_sphere_mesh(1.0);
+        skyMesh = shared_sphere_mesh(1.0f);
         set_sun_position(50, 110);
     }
 
@@ -247,7 +247,7 @@ class HosekProceduralSky : public ProceduralSky
         sky->uniform("I", data.I);
         sky->uniform("Z", data.Z);
         sky->uniform("SunDirection", sunDir);
-        skyMesh.draw_elements();
+        skyMesh->draw_elements();
         sky->unbind();
     }
     
@@ -284,7 +284,7 @@ class PreethamProceduralSky : public ProceduralSky
         sky->uniform("E", data.E);
         sky->uniform("Z", data.Z);
         sky->uniform("SunDirection", sunDir);
-        skyMesh.draw_elements();
+        skyMesh->draw_elements();
         sky->unbind();
     }
     
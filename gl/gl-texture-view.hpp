@@ -97,7 +97,7 @@ namespace avl
     struct GLTextureView : public Noncopyable
     {
         GlShader program;
-        GlMesh mesh = make_fullscreen_quad_screenspace();
+        std::shared_ptr<GlMesh> mesh = shared_fullscreen_quad_screenspace();
         bool hasDepth = false;
         float2 nearFarDepth;
 
@@ -130,7 +130,7 @@ namespace avl
                 program.uniform("u_zFar", nearFarDepth.y);
             }
             program.texture("u_texture", 0, tex, GL_TEXTURE_2D);
-            mesh.draw_elements();
+            mesh->draw_elements();
             program.unbind();
         }
         
@@ -139,7 +139,7 @@ namespace avl
     class GLTextureView3D : public Noncopyable
     {
         GlShader program;
-        GlMesh mesh = make_fullscreen_quad_screenspace(); 
+        std::shared_ptr<GlMesh> mesh = shared_fullscreen_quad_screenspace();
     public:
         GLTextureView3D() { program = GlShader(s_textureVert3D, s_textureFrag3D); }
         void draw(const Bounds2D & rect, const float2 windowSize, const GLuint tex, const GLenum target, const int slice)
@@ -151,7 +151,7 @@ namespace avl
             program.uniform("u_mvp", mul(projection, model));
             program.uniform("u_slice", slice);
             program.texture("u_texture", 0, tex, target);
-            mesh.draw_elements();
+            mesh->draw_elements();
             program.unbind();
         }
     };
@@ -0,0 +1,160 @@
+#pragma once
+
+#ifndef gl_tube_batch_hpp
+#define gl_tube_batch_hpp
+
+#include "gl-api.hpp"
+#include "parallel_transport_frames.hpp"
+#include "util.hpp"
+#include "job_system.hpp"
+
+/*
+ * Draws tubes and ribbons swept along TransportFrameStreams, rebuilt every frame. On the first draw() of a frame the
+ * vertices for all queued paths are written straight into one allocation from a persistent-mapped GlStreamingBuffer
+ * (on the shared job pool, no staging copy); each shape kind is then submitted with a single
+ * glMultiDrawElementsBaseVertex over a static index buffer shared by every path. Queued streams must stay alive
+ * until draw(). After warm-up no per-frame allocations remain: the item and draw lists keep their capacity and the
+ * index buffers only grow. Bind a shader with the mesh attribute locations first.
+ */
+class GlTubeBatch
+{
+    enum Kind { TUBE, RIBBON, NUM_KINDS };
+
+    struct Item
+    {
+        const TransportFrameStream * stream;
+        float size;             // radius or half width
+        bool facing;
+        float3 eye;
+    };
+
+    struct Strip
+    {
+        GlBuffer indices;
+        size_t rows{ 0 };       // longest path the index buffer covers
+        uint32_t ringSize{ 0 };
+        std::vector<Item> items;
+        std::vector<size_t> firstVertex;
+        std::vector<GLsizei> counts;
+        std::vector<GLint> baseVertices;
+        std::vector<GLvoid *> offsets;  // all zero; glew declares the parameter as void **
+    };
+
+    GlStreamingBuffer vertexStream;
+    GlStreamingRange range;     // this frame's vertices, valid until clear()
+    bool built{ false };
+    GlVertexArrayObject vao;
+    Strip strips[NUM_KINDS];
+    uint32_t sides;
+
+    void ensure_indices(Strip & strip, const size_t rows)
+    {
+        if (rows <= strip.rows) return;
+        strip.rows = std::max(rows, strip.rows * 2);
+        std::vector<uint32_t> indices(strip_index_count(strip.rows, strip.ringSize));
+        write_strip_indices(strip.rows, strip.ringSize, indices.data());
+        strip.indices.set_buffer_data(indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+    }
+
+    static size_t vertex_count(const Strip & strip, const Item & item) { return item.stream->size() < 2 ? 0 : item.stream->size() * strip.ringSize; }
+
+    // Lays out every queued path in one streaming allocation, fills the draw lists and writes the vertices
+    void build()
+    {
+        built = true;
+        range = {};
+        size_t totalVertices = 0;
+        for (Strip & strip : strips)
+        {
+            strip.firstVertex.resize(strip.items.size());
+            size_t longest = 0;
+            for (size_t i = 0; i < strip.items.size(); ++i)
+            {
+                strip.firstVertex[i] = totalVertices;
+                totalVertices += vertex_count(strip, strip.items[i]);
+                longest = std::max(longest, strip.items[i].stream->size());
+            }
+            ensure_indices(strip, longest);
+
+            strip.counts.resize(strip.items.size());
+            strip.baseVertices.resize(strip.items.size());
+            strip.offsets.resize(strip.items.size(), nullptr);
+            for (size_t i = 0; i < strip.items.size(); ++i)
+            {
+                strip.counts[i] = static_cast<GLsizei>(strip_index_count(strip.items[i].stream->size(), strip.ringSize));
+                strip.baseVertices[i] = static_cast<GLint>(strip.firstVertex[i]);
+            }
+        }
+        if (!totalVertices) return;
+
+        // One allocation for everything, so a ring resize can never strand vertices written earlier in the frame
+        range = vertexStream.allocate(totalVertices * sizeof(TubeVertex), 16);
+        TubeVertex * vertices = static_cast<TubeVertex *>(range.data);
+
+        // Tubes and ribbons are written as one batch of work, tubes first
+        const size_t numTubes = strips[TUBE].items.size();
+        get_shared_job_system().parallel_for(numTubes + strips[RIBBON].items.size(), 64, [&](size_t begin, size_t end)
+        {
+            for (size_t n = begin; n < end; ++n)
+            {
+                const int k = n < numTubes ? TUBE : RIBBON;
+                const size_t i = k == TUBE ? n : n - numTubes;
+                const Item & item = strips[k].items[i];
+                TubeVertex * out = vertices + strips[k].firstVertex[i];
+                if (k == TUBE) write_tube_vertices(*item.stream, item.size, sides, out);
+                else write_ribbon_vertices(*item.stream, item.size, out, item.facing ? &item.eye : nullptr);
+            }
+        });
+    }
+
+public:
+
+    GlTubeBatch(const uint32_t sides = 8, const GLsizeiptr bytesPerFrame = 1 << 22) : vertexStream(bytesPerFrame), sides(sides)
+    {
+        assert(sides >= 3 && sides <= MAX_TUBE_SIDES);
+        strips[TUBE].ringSize = static_cast<uint32_t>(tube_ring_size(sides));
+        strips[RIBBON].ringSize = 2;
+    }
+
+    void add_tube(const TransportFrameStream & stream, const float radius) { assert(!built); if (stream.size() >= 2) strips[TUBE].items.push_back({ &stream, radius, false, {} }); }
+
+    // Ribbons lie in each sample's normal plane, or face `eye` when given (see write_ribbon_vertices)
+    void add_ribbon(const TransportFrameStream & stream, const float halfWidth) { assert(!built); if (stream.size() >= 2) strips[RIBBON].items.push_back({ &stream, halfWidth, false, {} }); }
+    void add_ribbon(const TransportFrameStream & stream, const float halfWidth, const float3 & eye) { assert(!built); if (stream.size() >= 2) strips[RIBBON].items.push_back({ &stream, halfWidth, true, eye }); }
+
+    // Vertices are written on the first call of a frame; later calls (e.g. the second eye) only resubmit them
+    void draw()
+    {
+        if (!built) build();
+        if (!range.data) return;
+
+        // The buffer comes from this frame's range (see GlStreamingBuffer), so the attribute bindings follow it
+        glEnableVertexArrayAttribEXT(vao, 0);
+        glVertexArrayVertexAttribOffsetEXT(vao, range.buffer, 0, 3, GL_FLOAT, GL_FALSE, sizeof(TubeVertex), range.offset + offsetof(TubeVertex, position));
+        glEnableVertexArrayAttribEXT(vao, 1);
+        glVertexArrayVertexAttribOffsetEXT(vao, range.buffer, 1, 3, GL_FLOAT, GL_FALSE, sizeof(TubeVertex), range.offset + offsetof(TubeVertex, normal));
+        glEnableVertexArrayAttribEXT(vao, 3);
+        glVertexArrayVertexAttribOffsetEXT(vao, range.buffer, 3, 2, GL_FLOAT, GL_FALSE, sizeof(TubeVertex), range.offset + offsetof(TubeVertex, texcoord));
+
+        glBindVertexArray(vao);
+        for (Strip & strip : strips)
+        {
+            if (strip.items.empty()) continue;
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, strip.indices);
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, strip.counts.data(), GL_UNSIGNED_INT, strip.offsets.data(), static_cast<GLsizei>(strip.items.size()), strip.baseVertices.data());
+        }
+        glBindVertexArray(0);
+    }
+
+    // Call once per frame after the last draw(); forgets the queued paths and fences this frame's vertices
+    void clear()
+    {
+        for (Strip & strip : strips) strip.items.clear();
+        built = false;
+        vertexStream.end_frame();
+    }
+
+    const GlStreamingBuffer & get_vertex_stream() const { return vertexStream; }
+};
+
+#endif // end gl_tube_batch_hpp
@@ -2,6 +2,8 @@
 #include "util.hpp"
 #include "math-spatial.hpp"
 #include "gl-api.hpp"
+#include "gl-frame-capture.hpp"
+#include "profiler.hpp"
 #include "stb/stb_image_write.h"
 #include "human_time.hpp"
 
@@ -165,6 +167,7 @@ GLFWApp::GLFWApp(int width, int height, const std::string title, int glfwSamples
 
 GLFWApp::~GLFWApp() 
 {
+    frameCapture.reset(); // drains outstanding readbacks while the context is still alive
     if (window) glfwDestroyWindow(window);
 }
 
@@ -224,63 +227,245 @@ void GLFWApp::take_screenshot(const std::string & filename)
     screenshotPath = filename;
 }
 
-void GLFWApp::take_screenshot_impl()
+void GLFWApp::start_recording(std::shared_ptr<FrameSink> sink)
 {
-    int width, height;
-    glfwGetWindowSize(window, &width, &height);
-    int2 size(width, height);
-    HumanTime t;
-    auto timestamp = t.make_timestamp();
-    std::vector<uint8_t> screenShot(size.x * size.y * 4);
-    glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, screenShot.data());
-    auto flipped = screenShot;
-    for (int y = 0; y < size.y; ++y) memcpy(flipped.data() + y * size.x * 4, screenShot.data() + (size.y - y - 1)*size.x * 4, size.x * 4);
-    stbi_write_png(std::string(screenshotPath + "-" + timestamp + ".png").c_str(), size.x, size.y, 4, flipped.data(), 4 * size.x);
-    screenshotPath.clear();
+    recordingSink = sink;
+    recordedFrames = 0;
 }
 
-void GLFWApp::main_loop() 
+void GLFWApp::stop_recording()
 {
-    auto t0 = std::chrono::high_resolution_clock::now();
-    
-    while (!glfwWindowShouldClose(window)) 
+    recordingSink.reset();
+}
+
+// Queues readbacks of the default framebuffer; pixels reach the sinks a few frames later on capture workers
+void GLFWApp::capture_frame()
+{
+    if (screenshotPath.empty() && !recordingSink) return;
+    if (!frameCapture) frameCapture.reset(new GlFrameCapture());
+
+    int2 size;
+    glfwGetFramebufferSize(window, &size.x, &size.y);
+
+    GLint readFboId = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFboId);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    if (screenshotPath.size() > 0)
     {
-        for (auto & e : exceptions) on_uncaught_exception(e);
+        HumanTime t;
+        frameCapture->capture_framebuffer({ 0, 0 }, size, GL_RGBA, std::make_shared<PngSink>(screenshotPath + "-"), 0, t.make_timestamp());
+        screenshotPath.clear();
+    }
 
-        try
+    // A dropped frame keeps its index free so sequences show the gap instead of silently shifting
+    if (recordingSink) frameCapture->capture_framebuffer({ 0, 0 }, size, GL_RGBA, recordingSink, recordedFrames++);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, readFboId);
+}
+
+void GLFWApp::enable_fixed_step(const FixedStepSettings & settings)
+{
+    if (simulationRunning) throw std::runtime_error("enable_fixed_step must be called before main_loop");
+    fixedStep = settings;
+    fixedStep.stepsPerSecond = std::max(1.0, fixedStep.stepsPerSecond);
+    fixedStep.maxStepsPerTick = std::max(1, fixedStep.maxStepsPerTick);
+    fixedStepEnabled = true;
+}
+
+// Sleeps most of the way (OS sleeps overshoot by a millisecond or more), then yields until the deadline
+void GLFWApp::sleep_until_precise(const clock::time_point deadline)
+{
+    const auto slack = std::chrono::microseconds(1500);
+    if (clock::now() + slack < deadline) std::this_thread::sleep_until(deadline - slack);
+    while (clock::now() < deadline) std::this_thread::yield();
+}
+
+// Step n covers simulation time [n * dt, (n + 1) * dt] and runs once the wall clock has passed its end
+void GLFWApp::simulation_loop()
+{
+    const double dt = 1.0 / fixedStep.stepsPerSecond;
+    uint64_t step = 0;
+
+    Profiler::get().set_thread_name("simulation");
+
+    while (simulationRunning.load(std::memory_order_relaxed))
+    {
+        const double now = seconds_since_start() - simulationClockOffset.load();
+        const double due = (step + 1) * dt;
+
+        if (now < due)
         {
-            auto t1 = std::chrono::high_resolution_clock::now();
-            auto timestep = std::chrono::duration<float>(t1 - t0).count();
-            t0 = t1;
-            
-            elapsedFrames++;
-            fpsTime += timestep;
+            const auto wakeup = startTime + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(due + simulationClockOffset.load()));
+            sleep_until_precise(wakeup);
+            continue;
+        }
+
+        uint64_t behind = static_cast<uint64_t>((now - step * dt) / dt);
+        if (behind > uint64_t(fixedStep.maxStepsPerTick))
+        {
+            const uint64_t dropped = behind - fixedStep.maxStepsPerTick;
+            simulationClockOffset.store(simulationClockOffset.load() + dropped * dt);
+            droppedSteps += dropped;
+            behind = fixedStep.maxStepsPerTick;
+        }
 
-            if (fpsTime > 0.5f)
+        for (uint64_t i = 0; i < behind && simulationRunning.load(std::memory_order_relaxed); ++i)
+        {
+            UpdateEvent e;
+            e.elapsed_s = seconds_since_start();
+            e.timestep_ms = static_cast<float>(dt);
+            e.framesPerSecond = static_cast<float>(fixedStep.stepsPerSecond);
+            e.elapsedFrames = step;
+            e.simulationTime_s = (step + 1) * dt;
+            e.fixedTimestep_s = static_cast<float>(dt);
+            e.simulation_ms = simulationMs.load();
+            e.simulationSteps = step;
+            e.droppedSteps = droppedSteps.load();
+
+            // Like a throwing on_update, a throwing step is handed to the main thread and the loop keeps running
+            const auto t0 = clock::now();
+            try
             {
-                fps = elapsedFrames / fpsTime;
-                elapsedFrames = 0;
-                fpsTime = 0;
+                AVL_PROFILE_SCOPE("on_fixed_update");
+                on_fixed_update(e);
             }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(simulationExceptionsMutex);
+                simulationExceptions.push_back(std::current_exception());
+            }
+            simulationMs.store(std::chrono::duration<float, std::milli>(clock::now() - t0).count());
 
-            UpdateEvent e;
-            e.elapsed_s = glfwGetTime();
-            e.timestep_ms = timestep;
-            e.framesPerSecond = fps;
-            e.elapsedFrames = elapsedFrames;
+            simulationSteps.store(++step);
+        }
+    }
+}
+
+// Rethrows (through on_uncaught_exception) whatever the simulation thread caught since the last call
+void GLFWApp::handle_simulation_exceptions()
+{
+    std::vector<std::exception_ptr> fromSimulation;
+    {
+        std::lock_guard<std::mutex> lock(simulationExceptionsMutex);
+        fromSimulation.swap(simulationExceptions);
+    }
+    for (auto & e : fromSimulation) on_uncaught_exception(e);
+}
 
-            on_update(e);
-            on_draw();
+void GLFWApp::start_simulation()
+{
+    if (!fixedStepEnabled || simulationRunning) return;
+    simulationRunning = true;
+    simulationThread = std::thread(&GLFWApp::simulation_loop, this);
+}
 
-            if (screenshotPath.size() > 0)take_screenshot_impl();
+void GLFWApp::stop_simulation()
+{
+    simulationRunning = false;
+    if (simulationThread.joinable()) simulationThread.join();
+}
 
-            glfwPollEvents();
-        }
-        catch(...)
+void GLFWApp::main_loop() 
+{
+    startTime = clock::now();
+    auto t0 = std::chrono::high_resolution_clock::now();
+    float updateMs = 0.f, drawMs = 0.f, pacingMs = 0.f;
+
+    Profiler::get().set_thread_name("main");
+    start_simulation();
+
+    try
+    {
+        while (!glfwWindowShouldClose(window)) 
         {
-            on_uncaught_exception(std::current_exception());
+            for (auto & e : exceptions) on_uncaught_exception(e);
+
+            handle_simulation_exceptions();
+
+            try
+            {
+                auto t1 = std::chrono::high_resolution_clock::now();
+                auto timestep = std::chrono::duration<float>(t1 - t0).count();
+                t0 = t1;
+            
+                elapsedFrames++;
+                fpsTime += timestep;
+
+                if (fpsTime > 0.5f)
+                {
+                    fps = elapsedFrames / fpsTime;
+                    elapsedFrames = 0;
+                    fpsTime = 0;
+                }
+
+                UpdateEvent e;
+                e.elapsed_s = glfwGetTime();
+                e.timestep_ms = timestep;
+                e.framesPerSecond = fps;
+                e.elapsedFrames = elapsedFrames;
+                e.update_ms = updateMs;
+                e.draw_ms = drawMs;
+                e.pacing_ms = pacingMs;
+
+                if (fixedStepEnabled)
+                {
+                    const double dt = 1.0 / fixedStep.stepsPerSecond;
+                    e.fixedTimestep_s = static_cast<float>(dt);
+                    e.simulationSteps = simulationSteps.load();
+                    e.simulationTime_s = e.simulationSteps * dt;
+                    e.renderTime_s = seconds_since_start() - simulationClockOffset.load() - dt;
+                    e.simulation_ms = simulationMs.load();
+                    e.droppedSteps = droppedSteps.load();
+                }
+
+                const auto updateStart = clock::now();
+                {
+                    AVL_PROFILE_SCOPE("on_update");
+                    on_update(e);
+                }
+                const auto drawStart = clock::now();
+                {
+                    AVL_PROFILE_SCOPE("on_draw");
+                    on_draw();
+                }
+                const auto drawEnd = clock::now();
+                updateMs = std::chrono::duration<float, std::milli>(drawStart - updateStart).count();
+                drawMs = std::chrono::duration<float, std::milli>(drawEnd - drawStart).count();
+
+                capture_frame();
+                if (frameCapture) frameCapture->update();
+
+                // Drains every thread's scopes into the frame just finished
+                Profiler::get().end_frame();
+
+                glfwPollEvents();
+
+                // Frame cap on top of (or instead of) vsync; a swap that already blocked long enough leaves nothing to sleep
+                pacingMs = 0.f;
+                if (fixedStepEnabled && fixedStep.maxFramesPerSecond > 0.0)
+                {
+                    const auto deadline = updateStart + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / fixedStep.maxFramesPerSecond));
+                    const auto pacingStart = clock::now();
+                    if (pacingStart < deadline) sleep_until_precise(deadline);
+                    pacingMs = std::chrono::duration<float, std::milli>(clock::now() - pacingStart).count();
+                }
+            }
+            catch(...)
+            {
+                on_uncaught_exception(std::current_exception());
+            }
         }
     }
+    catch (...)
+    {
+        stop_simulation();
+        throw;
+    }
+
+    // Steps that threw after the last frame still reach the app
+    stop_simulation();
+    handle_simulation_exceptions();
 }
 
 void GLFWApp::on_uncaught_exception(std::exception_ptr e)
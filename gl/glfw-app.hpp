@@ -10,6 +10,9 @@
 #include <chrono>
 #include <codecvt>
 #include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
 
 #if defined(ANVIL_PLATFORM_WINDOWS)
 #define GLEW_STATIC
@@ -27,12 +30,35 @@
 
 namespace avl
 {
+    class GlFrameCapture;
+    struct FrameSink;
+
     struct UpdateEvent
     {
         double elapsed_s;
         float timestep_ms;
         float framesPerSecond;
         uint64_t elapsedFrames;
+
+        // Per-stage cost of the previous frame, in milliseconds
+        float update_ms = 0;
+        float draw_ms = 0;              // includes the buffer swap, so vsync waits show up here
+        float pacing_ms = 0;            // time spent sleeping to hold FixedStepSettings::maxFramesPerSecond
+
+        // Fixed-step mode only (see GLFWApp::enable_fixed_step)
+        double simulationTime_s = 0;    // end of the step being run (on_fixed_update) or of the newest finished step
+        double renderTime_s = 0;        // what the render loop should interpolate to: one step behind the simulation clock
+        float fixedTimestep_s = 0;
+        float simulation_ms = 0;        // cost of the most recent fixed step
+        uint64_t simulationSteps = 0;
+        uint64_t droppedSteps = 0;      // steps skipped because the simulation fell more than maxStepsPerTick behind
+    };
+
+    struct FixedStepSettings
+    {
+        double stepsPerSecond = 120.0;
+        int maxStepsPerTick = 4;            // catch-up limit; past it the simulation clock slips instead of spiralling
+        double maxFramesPerSecond = 0.0;    // render loop cap; 0 leaves pacing to vsync
     };
 
     struct InputEvent
@@ -69,7 +95,11 @@ namespace avl
 
         void main_loop();
 
+        // Opt-in: runs on_fixed_update on its own thread at a fixed rate while main_loop renders. Call before main_loop.
+        void enable_fixed_step(const FixedStepSettings & settings);
+
         virtual void on_update(const UpdateEvent & e) {}
+        virtual void on_fixed_update(const UpdateEvent & e) {} // simulation thread: no GL, share state through a SnapshotBuffer; throws reach on_uncaught_exception on the main thread
         virtual void on_draw() {}
         virtual void on_window_focus(bool focused) {}
         virtual void on_window_resize(int2 size) {}
@@ -86,6 +116,12 @@ namespace avl
 
         void take_screenshot(const std::string & filename);
 
+        // Captures every presented frame into `sink` (e.g. a PngSink sequence or a RawVideoSink) until stopped
+        void start_recording(std::shared_ptr<FrameSink> sink);
+        void stop_recording();
+        bool is_recording() const { return recordingSink != nullptr; }
+        GlFrameCapture * get_frame_capture() const { return frameCapture.get(); }
+
         int get_mods() const;
 
         void set_window_title(const std::string & str);
@@ -105,8 +141,11 @@ namespace avl
         void consume_scroll(double xoffset, double yoffset);
         void on_iconify();
 
-        void take_screenshot_impl();
+        void capture_frame();
         std::string screenshotPath;
+        std::shared_ptr<FrameSink> recordingSink;
+        uint64_t recordedFrames = 0;
+        std::unique_ptr<GlFrameCapture> frameCapture;
         
         void preprocess_input(InputEvent & event);
 
@@ -123,6 +162,27 @@ namespace avl
         int2 windowedPos;
 
         std::vector<std::exception_ptr> exceptions;
+
+        typedef std::chrono::steady_clock clock;
+        clock::time_point startTime;
+        double seconds_since_start() const { return std::chrono::duration<double>(clock::now() - startTime).count(); }
+        static void sleep_until_precise(const clock::time_point deadline);
+
+        bool fixedStepEnabled = false;
+        FixedStepSettings fixedStep;
+        std::thread simulationThread;
+        std::atomic<bool> simulationRunning{ false };
+        std::atomic<double> simulationClockOffset{ 0.0 };   // wall seconds the simulation clock has slipped behind
+        std::atomic<uint64_t> simulationSteps{ 0 };
+        std::atomic<uint64_t> droppedSteps{ 0 };
+        std::atomic<float> simulationMs{ 0.f };
+        std::mutex simulationExceptionsMutex;
+        std::vector<std::exception_ptr> simulationExceptions;
+
+        void simulation_loop();
+        void start_simulation();
+        void stop_simulation();
+        void handle_simulation_exceptions();
     };
         
     extern int Main(int argc, char * argv[]);
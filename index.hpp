@@ -39,7 +39,8 @@
 #include "gl-procedural-mesh.hpp"
 #include "gl-procedural-sky.hpp"
 #include "gl-renderable-grid.hpp"
-#include "gl-renderable-meshline.hpp"
+#include "gl-polyline-batch.hpp"
+#include "gl-tube-batch.hpp"
 #include "gl-shader-monitor.hpp"
 #include "gl-texture-view.hpp"
 #include "gl-gizmo.hpp"
@@ -0,0 +1,585 @@
+// This is free and unencumbered software released into the public domain.
+// Structure inspired by the Molecular Matters job system series:
+// https://blog.molecular-matters.com/2015/08/24/job-system-2-0-lock-free-work-stealing-part-1-basics/
+
+#pragma once
+
+#ifndef job_system_hpp
+#define job_system_hpp
+
+#include "util.hpp"
+#include "spmc_stealing_queue.hpp"
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+#include <new>
+#include <memory>
+#include <chrono>
+#include <stdexcept>
+#include <assert.h>
+
+namespace avl
+{
+
+    /*
+     * A job is a small fixed-size record holding a functor inline (no heap allocation). `unfinished` counts the job
+     * itself plus any children created with it as their parent; when it reaches zero the job's own parent is
+     * decremented and its continuations are submitted. Jobs are allocated from a per-worker ring and recycled
+     * once finish() has stopped touching them (RECYCLABLE), so a handle is only meaningful until the job has
+     * finished and been waited on.
+     */
+    struct alignas(64) Job
+    {
+        constexpr static const int MAX_CONTINUATIONS = 4;
+        constexpr static const int32_t CONTINUATIONS_CLOSED = -1;   // set by finish(); later additions run directly
+        constexpr static const int32_t RECYCLABLE = -1;             // `unfinished` once finish() is done with the slot
+
+        void (*function)(Job *) { nullptr };
+        Job * parent{ nullptr };
+        std::atomic<int32_t> unfinished{ RECYCLABLE };
+        std::atomic<int32_t> continuationCount{ 0 };
+        std::atomic<Job *> continuations[MAX_CONTINUATIONS];
+
+        constexpr static const size_t PAYLOAD_SIZE = 128 - sizeof(void *) * (2 + MAX_CONTINUATIONS) - sizeof(int32_t) * 2;
+        typename std::aligned_storage<PAYLOAD_SIZE, alignof(void *)>::type payload;
+
+        template<typename F> F * get_functor() { return reinterpret_cast<F *>(&payload); }
+    };
+
+    static_assert(sizeof(Job) == 128, "jobs should occupy exactly two cache lines");
+
+    struct JobWorkerStats
+    {
+        uint64_t jobsExecuted{ 0 };
+        uint64_t steals{ 0 };        // jobs taken from another worker's deque
+        uint64_t stealAttempts{ 0 };
+        double idleMs{ 0 };          // time spent without work (spinning, yielding or sleeping)
+    };
+
+    class JobSystem : public Noncopyable
+    {
+        constexpr static const size_t MAX_JOBS_PER_WORKER = 4096; // live (unfinished) jobs a single worker may have allocated
+        constexpr static const int SPIN_ITERATIONS = 64;
+
+        struct alignas(64) Worker
+        {
+            SPMCStealingQueue<Job *> deque;
+            std::vector<Job, aligned_allocator<Job>> jobs;
+            size_t nextJob{ 0 };
+            uint32_t rng{ 0 };
+
+            std::atomic<uint64_t> jobsExecuted{ 0 };
+            std::atomic<uint64_t> steals{ 0 };
+            std::atomic<uint64_t> stealAttempts{ 0 };
+            std::atomic<uint64_t> idleNanoseconds{ 0 };
+
+            Worker() : jobs(MAX_JOBS_PER_WORKER) {}
+        };
+
+        // One entry per system the thread belongs to: a thread may construct (and so be worker 0 of) several systems
+        struct ThreadContext { const JobSystem * system; size_t index; };
+
+        static std::vector<ThreadContext> & get_thread_contexts()
+        {
+            static thread_local std::vector<ThreadContext> contexts;
+            return contexts;
+        }
+
+        std::vector<aligned_unique_ptr<Worker>> workers;
+        std::vector<std::thread> threads;
+        aligned_unique_ptr<Worker> foreign;
+        std::thread::id owner;
+
+        // Jobs submitted from threads that do not belong to this system
+        std::deque<Job *> injected;
+        std::mutex injectedMutex;
+        std::atomic<size_t> injectedCount{ 0 };
+
+        std::mutex sleepMutex;
+        std::condition_variable sleepCondition;
+        std::atomic<int> sleepingWorkers{ 0 };
+        std::atomic<bool> running{ true };
+
+        // Index of the calling thread's worker, or -1 if it is not part of this system
+        int get_worker_index() const
+        {
+            for (const auto & context : get_thread_contexts())
+            {
+                if (context.system == this) return static_cast<int>(context.index);
+            }
+            return -1;
+        }
+
+        // When every slot of the ring is in flight the caller helps run queued jobs until one frees up. If nothing
+        // becomes runnable for a while (e.g. thousands of created but unsubmitted jobs) this throws instead of hanging.
+        Job * allocate_job()
+        {
+            const int index = get_worker_index();
+            auto lastProgress = std::chrono::steady_clock::now();
+            while (true)
+            {
+                Job * job = nullptr;
+                if (index < 0)
+                {
+                    // Threads outside the system share one ring, guarded by the injection lock
+                    std::lock_guard<std::mutex> guard(injectedMutex);
+                    job = allocate_from(*foreign);
+                }
+                else job = allocate_from(*workers[index]);
+                if (job) return job;
+
+                if (Job * next = find_job(index))
+                {
+                    execute(next, index);
+                    lastProgress = std::chrono::steady_clock::now();
+                }
+                else if (std::chrono::steady_clock::now() - lastProgress > std::chrono::seconds(2))
+                {
+                    throw std::runtime_error("JobSystem: job pool exhausted; more than MAX_JOBS_PER_WORKER unfinished jobs on one thread");
+                }
+                else std::this_thread::yield();
+            }
+        }
+
+        Job * allocate_from(Worker & w)
+        {
+            // Skip over slots whose previous job is still in flight
+            for (size_t attempt = 0; attempt < MAX_JOBS_PER_WORKER; ++attempt)
+            {
+                Job * job = &w.jobs[w.nextJob++ & (MAX_JOBS_PER_WORKER - 1)];
+                if (job->unfinished.load(std::memory_order_acquire) == Job::RECYCLABLE) return job;
+            }
+            return nullptr;
+        }
+
+        template<typename F>
+        static void invoke_functor(Job * job)
+        {
+            F * f = job->get_functor<F>();
+            (*f)();
+            f->~F();
+        }
+
+        Job * steal_job(Worker & self, int selfIndex)
+        {
+            const size_t count = workers.size();
+            if (count < 2) return nullptr;
+
+            // xorshift to pick a random starting victim
+            self.rng ^= self.rng << 13; self.rng ^= self.rng >> 17; self.rng ^= self.rng << 5;
+            const size_t start = self.rng % count;
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                const size_t victim = (start + i) % count;
+                if (static_cast<int>(victim) == selfIndex) continue;
+                if (workers[victim]->deque.empty()) continue;
+
+                self.stealAttempts.fetch_add(1, std::memory_order_relaxed);
+                Job * job = nullptr;
+                if (workers[victim]->deque.steal(job))
+                {
+                    self.steals.fetch_add(1, std::memory_order_relaxed);
+                    return job;
+                }
+            }
+            return nullptr;
+        }
+
+        Job * take_injected()
+        {
+            if (injectedCount.load(std::memory_order_acquire) == 0) return nullptr;
+            std::lock_guard<std::mutex> guard(injectedMutex);
+            if (injected.empty()) return nullptr;
+            Job * job = injected.front();
+            injected.pop_front();
+            injectedCount.fetch_sub(1, std::memory_order_release);
+            return job;
+        }
+
+        Job * find_job(int index)
+        {
+            Job * job = nullptr;
+            if (index >= 0)
+            {
+                Worker & self = *workers[index];
+                if (self.deque.pop(job)) return job;
+                if ((job = take_injected())) return job;
+                return steal_job(self, index);
+            }
+
+            // Foreign threads can still help while waiting by draining injected work
+            return take_injected();
+        }
+
+        void finish(Job * job)
+        {
+            const int32_t remaining = job->unfinished.fetch_sub(1, std::memory_order_acq_rel) - 1;
+            if (remaining != 0) return;
+
+            // Closing the list makes later add_continuation() calls submit directly. A slot that has been reserved
+            // but not yet written belongs to an adder a few instructions away from publishing it.
+            Job * parent = job->parent;
+            Job * continuations[Job::MAX_CONTINUATIONS];
+            const int32_t numContinuations = job->continuationCount.exchange(Job::CONTINUATIONS_CLOSED, std::memory_order_acq_rel);
+            for (int32_t i = 0; i < numContinuations; ++i)
+            {
+                while (!(continuations[i] = job->continuations[i].load(std::memory_order_acquire))) std::this_thread::yield();
+            }
+
+            // Nothing below reads the job, so allocate_from() may hand the slot out again from here on
+            job->unfinished.store(Job::RECYCLABLE, std::memory_order_release);
+
+            for (int32_t i = 0; i < numContinuations; ++i) submit(continuations[i]);
+            if (parent) finish(parent);
+        }
+
+        void execute(Job * job, int index)
+        {
+            job->function(job);
+            finish(job);
+            if (index >= 0) workers[index]->jobsExecuted.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void wake_one()
+        {
+            if (sleepingWorkers.load(std::memory_order_acquire) > 0)
+            {
+                std::lock_guard<std::mutex> guard(sleepMutex);
+                sleepCondition.notify_one();
+            }
+        }
+
+        void worker_main(size_t index)
+        {
+            get_thread_contexts().push_back({ this, index });
+
+            Worker & self = *workers[index];
+            int idleSpins = 0;
+
+            while (running.load(std::memory_order_acquire))
+            {
+                if (Job * job = find_job(static_cast<int>(index)))
+                {
+                    execute(job, static_cast<int>(index));
+                    idleSpins = 0;
+                    continue;
+                }
+
+                const auto t0 = std::chrono::high_resolution_clock::now();
+                if (++idleSpins < SPIN_ITERATIONS)
+                {
+                    std::this_thread::yield();
+                }
+                else
+                {
+                    // Sleep until new work is submitted. The timeout covers the (benign) race between
+                    // checking for work and registering as a sleeper.
+                    std::unique_lock<std::mutex> lock(sleepMutex);
+                    sleepingWorkers.fetch_add(1, std::memory_order_acq_rel);
+                    sleepCondition.wait_for(lock, std::chrono::milliseconds(2));
+                    sleepingWorkers.fetch_sub(1, std::memory_order_acq_rel);
+                    idleSpins = 0;
+                }
+                const auto idle = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - t0).count();
+                self.idleNanoseconds.fetch_add(static_cast<uint64_t>(idle), std::memory_order_relaxed);
+            }
+        }
+
+    public:
+
+        // The constructing thread becomes worker 0 and participates in work while it waits on jobs.
+        // numThreads counts that thread, so JobSystem(1) runs everything inline from wait(). The system must be
+        // destroyed on the thread that constructed it.
+        JobSystem(size_t numThreads = std::max<size_t>(1, std::thread::hardware_concurrency())) : foreign(make_aligned_unique<Worker>()), owner(std::this_thread::get_id())
+        {
+            numThreads = std::max<size_t>(1, numThreads);
+            for (size_t i = 0; i < numThreads; ++i)
+            {
+                workers.push_back(make_aligned_unique<Worker>());
+                workers.back()->rng = static_cast<uint32_t>(2654435761u * (i + 1));
+            }
+
+            get_thread_contexts().push_back({ this, 0 });
+
+            for (size_t i = 1; i < numThreads; ++i) threads.emplace_back(&JobSystem::worker_main, this, i);
+        }
+
+        ~JobSystem()
+        {
+            running.store(false, std::memory_order_release);
+            {
+                std::lock_guard<std::mutex> guard(sleepMutex);
+                sleepCondition.notify_all();
+            }
+            for (auto & t : threads) t.join();
+
+            assert(std::this_thread::get_id() == owner);
+            auto & contexts = get_thread_contexts();
+            contexts.erase(std::remove_if(contexts.begin(), contexts.end(), [this](const ThreadContext & c) { return c.system == this; }), contexts.end());
+        }
+
+        size_t get_worker_count() const { return workers.size(); }
+
+        // Creates (but does not submit) a job that runs f(). If parent is non-null, the parent will not
+        // finish until this job has. The functor must fit in Job::PAYLOAD_SIZE bytes; capture by reference
+        // or pointer when that is not the case.
+        template<typename F>
+        Job * create_job(F && f, Job * parent = nullptr)
+        {
+            typedef typename std::decay<F>::type Functor;
+            static_assert(sizeof(Functor) <= Job::PAYLOAD_SIZE, "job functor too large; capture by reference");
+            static_assert(alignof(Functor) <= alignof(void *), "job functor over-aligned");
+
+            Job * job = allocate_job();
+            if (parent) parent->unfinished.fetch_add(1, std::memory_order_acq_rel);
+
+            job->function = &invoke_functor<Functor>;
+            job->parent = parent;
+            job->continuationCount.store(0, std::memory_order_relaxed);
+            for (auto & c : job->continuations) c.store(nullptr, std::memory_order_relaxed);
+            job->unfinished.store(1, std::memory_order_release);
+            new (&job->payload) Functor(std::forward<F>(f));
+            return job;
+        }
+
+        // Runs the unsubmitted `continuation` once `job` (and all of its children) have finished. `job` may be
+        // unsubmitted, running or already finished (but not yet recycled); in the last case the continuation is
+        // submitted right away and false is returned. At most Job::MAX_CONTINUATIONS per job.
+        bool add_continuation(Job * job, Job * continuation)
+        {
+            int32_t slot = job->continuationCount.load(std::memory_order_acquire);
+            do
+            {
+                if (slot == Job::CONTINUATIONS_CLOSED)
+                {
+                    submit(continuation);
+                    return false;
+                }
+                assert(slot < Job::MAX_CONTINUATIONS);
+            } while (!job->continuationCount.compare_exchange_weak(slot, slot + 1, std::memory_order_acq_rel));
+            job->continuations[slot].store(continuation, std::memory_order_release);
+            return true;
+        }
+
+        void submit(Job * job)
+        {
+            const int index = get_worker_index();
+            if (index >= 0)
+            {
+                workers[index]->deque.produce(job);
+            }
+            else
+            {
+                std::lock_guard<std::mutex> guard(injectedMutex);
+                injected.push_back(job);
+                injectedCount.fetch_add(1, std::memory_order_release);
+            }
+            wake_one();
+        }
+
+        template<typename F>
+        Job * run(F && f, Job * parent = nullptr)
+        {
+            Job * job = create_job(std::forward<F>(f), parent);
+            submit(job);
+            return job;
+        }
+
+        // Zero while finish() is still submitting continuations, RECYCLABLE after
+        bool is_finished(const Job * job) const { return job->unfinished.load(std::memory_order_acquire) <= 0; }
+
+        // Executes other jobs on the calling thread until `job` has finished
+        void wait(const Job * job)
+        {
+            const int index = get_worker_index();
+            while (!is_finished(job))
+            {
+                if (Job * next = find_job(index)) execute(next, index);
+                else std::this_thread::yield();
+            }
+        }
+
+        /*
+         * Calls fn(begin, end) over [0, count) in ranges of at most `grain` elements and returns when all have run.
+         * Ranges are produced by recursive halving: each job pushes its upper half and keeps the lower half, so
+         * thieves take the largest remaining blocks first.
+         */
+        template<typename F>
+        void parallel_for(size_t count, size_t grain, const F & fn)
+        {
+            if (count == 0) return;
+            grain = std::max<size_t>(1, grain);
+
+            if (count <= grain || workers.size() == 1)
+            {
+                for (size_t begin = 0; begin < count; begin += grain) fn(begin, std::min(count, begin + grain));
+                return;
+            }
+
+            struct Splitter
+            {
+                JobSystem * system;
+                const F * fn;
+                Job * root;
+                size_t begin, end, grain;
+
+                void operator()() const
+                {
+                    size_t e = end;
+                    while (e - begin > grain)
+                    {
+                        const size_t mid = begin + (e - begin) / 2;
+                        system->run(Splitter{ system, fn, root, mid, e, grain }, root);
+                        e = mid;
+                    }
+                    (*fn)(begin, e);
+                }
+            };
+
+            Job * root = create_job([]() {});
+            Job * top = create_job(Splitter{ this, &fn, root, 0, count, grain }, root);
+            submit(top);
+            submit(root);
+            wait(root);
+        }
+
+        std::vector<JobWorkerStats> get_stats() const
+        {
+            std::vector<JobWorkerStats> stats(workers.size());
+            for (size_t i = 0; i < workers.size(); ++i)
+            {
+                stats[i].jobsExecuted = workers[i]->jobsExecuted.load(std::memory_order_relaxed);
+                stats[i].steals = workers[i]->steals.load(std::memory_order_relaxed);
+                stats[i].stealAttempts = workers[i]->stealAttempts.load(std::memory_order_relaxed);
+                stats[i].idleMs = workers[i]->idleNanoseconds.load(std::memory_order_relaxed) / 1e6;
+            }
+            return stats;
+        }
+
+        void reset_stats()
+        {
+            for (auto & w : workers)
+            {
+                w->jobsExecuted.store(0); w->steals.store(0); w->stealAttempts.store(0); w->idleNanoseconds.store(0);
+            }
+        }
+    };
+
+    // Process-wide pool for recurring per-frame work (culling, light binning, vertex generation), so frames never
+    // spawn threads. Created on first use, and the calling thread becomes worker 0: call it first from the render thread.
+    inline JobSystem & get_shared_job_system()
+    {
+        static JobSystem system;
+        return system;
+    }
+
+} // end namespace avl
+
+namespace job_system_tests
+{
+    using namespace avl;
+
+    inline void execute(const size_t numThreads = std::max<size_t>(1, std::thread::hardware_concurrency()))
+    {
+        avl::JobSystem jobs(numThreads);
+
+        // parent/child counting: the parent finishes only after every child
+        std::atomic<int> counter{ 0 };
+        avl::Job * parent = jobs.create_job([]() {});
+        for (int i = 0; i < 100; ++i) jobs.run([&counter]() { counter.fetch_add(1); }, parent);
+        jobs.submit(parent);
+        jobs.wait(parent);
+        assert(counter.load() == 100);
+
+        // continuations run after their antecedent
+        std::atomic<int> order{ 0 };
+        int first = -1, second = -1;
+        avl::Job * a = jobs.create_job([&]() { first = order.fetch_add(1); });
+        avl::Job * done = jobs.create_job([]() {});
+        avl::Job * b = jobs.create_job([&]() { second = order.fetch_add(1); }, done);
+        jobs.add_continuation(a, b);
+        jobs.submit(a);
+        jobs.submit(done);
+        jobs.wait(done);
+        assert(first == 0 && second == 1);
+
+        // a continuation added after the antecedent finished is submitted immediately
+        std::atomic<int> late{ 0 };
+        avl::Job * finished = jobs.run([]() {});
+        jobs.wait(finished);
+        avl::Job * lateDone = jobs.create_job([]() {});
+        const bool queued = jobs.add_continuation(finished, jobs.create_job([&late]() { late = 1; }, lateDone));
+        jobs.submit(lateDone);
+        jobs.wait(lateDone);
+        assert(!queued && late.load() == 1);
+
+        // continuations added while the antecedent runs are never lost
+        for (int round = 0; round < 200; ++round)
+        {
+            std::atomic<int> ran{ 0 };
+            avl::Job * group = jobs.create_job([]() {});
+            avl::Job * running = jobs.run([]() {});
+            for (int i = 0; i < Job::MAX_CONTINUATIONS; ++i) jobs.add_continuation(running, jobs.create_job([&ran]() { ran.fetch_add(1); }, group));
+            jobs.submit(group);
+            jobs.wait(group);
+            assert(ran.load() == Job::MAX_CONTINUATIONS);
+        }
+
+        // more live jobs than the ring holds: allocation helps drain the queue instead of failing
+        std::atomic<int> flood{ 0 };
+        avl::Job * floodParent = jobs.create_job([]() {});
+        for (int i = 0; i < 3 * 4096; ++i) jobs.run([&flood]() { flood.fetch_add(1); }, floodParent);
+        jobs.submit(floodParent);
+        jobs.wait(floodParent);
+        assert(flood.load() == 3 * 4096);
+
+        // systems sharing a constructing thread each keep that thread as their own worker 0
+        {
+            avl::JobSystem single(1);
+            {
+                avl::JobSystem other(1);
+                other.wait(other.run([]() {}));
+            }
+            single.reset_stats();
+            single.wait(single.run([]() {}));
+            assert(single.get_stats()[0].jobsExecuted == 1);
+        }
+
+        // parallel_for covers every index exactly once
+        std::vector<int> hits(100003, 0);
+        jobs.parallel_for(hits.size(), 1000, [&hits](size_t begin, size_t end) { for (size_t i = begin; i < end; ++i) hits[i]++; });
+        for (auto h : hits) assert(h == 1);
+    }
+
+    // Runs the same parallel_for workload with 1..hardware_concurrency threads and prints time and per-worker stats
+    inline void benchmark(const size_t count = 1 << 24, const size_t grain = 4096)
+    {
+        std::vector<float> data(count);
+        const size_t maxThreads = std::max<size_t>(1, std::thread::hardware_concurrency());
+
+        for (size_t numThreads = 1; numThreads <= maxThreads; numThreads = (numThreads < maxThreads && numThreads * 2 > maxThreads) ? maxThreads : numThreads * 2)
+        {
+            avl::JobSystem jobs(numThreads);
+            {
+                AVL_SCOPED_TIMER("parallel_for with " + std::to_string(numThreads) + " threads");
+                jobs.parallel_for(count, grain, [&data](size_t begin, size_t end)
+                {
+                    for (size_t i = begin; i < end; ++i) data[i] = std::sqrt(std::sin(float(i)) * std::sin(float(i)) + 1.0f);
+                });
+            }
+
+            const auto stats = jobs.get_stats();
+            for (size_t w = 0; w < stats.size(); ++w)
+            {
+                std::cout << "    worker " << w << ": jobs " << stats[w].jobsExecuted << ", steals " << stats[w].steals << "/" << stats[w].stealAttempts << ", idle " << stats[w].idleMs << " ms" << std::endl;
+            }
+        }
+    }
+}
+
+#endif // end job_system_hpp
@@ -114,6 +114,13 @@ public:
         return false;
     }
 
+    // Looks `name` up in the asset table without creating an entry for it (unlike get() and assigned())
+    static bool contains(const std::string & name)
+    {
+        const auto it = table.find(name);
+        return it != table.end() && it->second && it->second->assigned;
+    }
+
     static std::vector<AssetHandle> list()
     {
         std::vector<AssetHandle> results;
@@ -36,7 +36,7 @@ struct BloomPass
     GlTexture2D brightTex, blurPasses[2], outputTex; 
     GlTexture2D luminanceTex[5];
 
-    GlMesh fsQuad;
+    std::shared_ptr<GlMesh> fsQuad;
 
     float2 perEyeSize;
 
@@ -53,7 +53,7 @@ struct BloomPass
 
     BloomPass(float2 size) : perEyeSize(size)
     {
-        fsQuad = make_fullscreen_quad();
+        fsQuad = shared_fullscreen_quad();
 
         luminanceTex[0].setup(128, 128, GL_RGBA, GL_RGBA, GL_FLOAT, nullptr);
         luminanceTex[1].setup(64, 64, GL_RGBA, GL_RGBA, GL_FLOAT, nullptr);
@@ -107,7 +107,7 @@ struct BloomPass
         hdr_lumShader.bind();
         hdr_lumShader.texture("s_texColor", 0, sceneColorTex, GL_TEXTURE_2D);
         hdr_lumShader.uniform("u_modelViewProj", Identity4x4);
-        fsQuad.draw_elements();
+        fsQuad->draw_elements();
 
         {
             glBindProgramPipeline(downsample_pipeline);
@@ -119,7 +119,7 @@ struct BloomPass
                 glBindFramebuffer(GL_FRAMEBUFFER, luminance[idx + 1]);
                 glViewport(0, 0, targetSize.x, targetSize.y);
                 hdr_avgLumShader.texture("s_texColor", 0, luminance[idx], GL_TEXTURE_2D); // not bound?
-                fsQuad.draw_elements();
+                fsQuad->draw_elements();
             };
 
             for (auto target : downsampleTargets) downsample(target.x, float2(target.y, target.z));
@@ -156,7 +156,7 @@ struct BloomPass
         hdr_brightShader.uniform("u_exposure", exposure);
         hdr_brightShader.uniform("u_tonemap", tonemap);
         hdr_brightShader.uniform("u_modelViewProj", Identity4x4);
-        fsQuad.draw_elements();
+        fsQuad->draw_elements();
         hdr_brightShader.unbind();
 
         static int dx = 0;
@@ -187,13 +187,13 @@ struct BloomPass
             hdr_blurShader.uniform("blurSize", 1.f / (perEyeSize.x / blurDownsampleFactor));
             hdr_blurShader.uniform("blurMultiplyVec", float2(1.0f, 0.0f));
             hdr_blurShader.texture("s_blurTexure", 0, brightTex, GL_TEXTURE_2D);
-            fsQuad.draw_elements();
+            fsQuad->draw_elements();
 
             // Vertical pass
             hdr_blurShader.uniform("blurSize", 1.f / (perEyeSize.y / blurDownsampleFactor));
             hdr_blurShader.uniform("blurMultiplyVec", float2(0.0f, 1.0f));
             hdr_blurShader.texture("s_blurTexure", 0, blurPasses[1 - dx], GL_TEXTURE_2D);
-            fsQuad.draw_elements();
+            fsQuad->draw_elements();
 
             dx = 1 - dx; // swap
 
@@ -206,7 +206,7 @@ struct BloomPass
         tonemapProgram.bind();
         tonemapProgram.texture("s_texColor", 0, sceneColorTex, GL_TEXTURE_2D);
         tonemapProgram.texture("s_bloom", 1, blurPasses[dx], GL_TEXTURE_2D);
-        fsQuad.draw_elements();
+        fsQuad->draw_elements();
         tonemapProgram.unbind();
     }
 
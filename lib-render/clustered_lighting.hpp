@@ -0,0 +1,394 @@
+#pragma once
+
+#ifndef vr_clustered_lighting_hpp
+#define vr_clustered_lighting_hpp
+
+#include "math-core.hpp"
+#include "util.hpp"
+#include "job_system.hpp"
+#include "uniforms.hpp"
+#include "gl-api.hpp"
+
+#include <random>
+
+using namespace avl;
+
+/*
+ * Clustered light assignment after "Practical Clustered Shading" (Persson, 2012). The culling view is divided into
+ * a froxel grid (screen tiles x exponential depth slices); every light's influence sphere is tested against the cells
+ * it can touch and the result is packed into three storage buffers: the lights, a (offset, count) record per cell,
+ * and the tightly packed light indices. Fragments locate their cell from the world position and loop only over that
+ * list. Assignment runs on the CPU (no depth prepass or compute shader required) and parallelizes over lights.
+ */
+
+// Must match the constants in forward_lighting_frag.glsl: point lights use intensity / (d / r + 1)^2, windowed
+// to zero at `cutoff`, which reaches zero at r * sqrt(intensity / cutoff).
+static const float POINT_LIGHT_INTENSITY = 2.0f;
+static const float POINT_LIGHT_CUTOFF = 0.1f;
+static const float SPOT_LIGHT_CUTOFF = 0.01f; // spot lights use 1 / (c + l*d + q*d^2), windowed at this value
+
+inline float point_light_range(const uniforms::point_light & l)
+{
+    return l.radius * std::sqrt(POINT_LIGHT_INTENSITY / POINT_LIGHT_CUTOFF);
+}
+
+// Smallest distance where 1 / (c + l*d + q*d^2) drops below the cutoff; `fallback` when it never does
+inline float spot_light_range(const uniforms::spot_light & s, const float fallback)
+{
+    const float c = s.attenuation.x - 1.f / SPOT_LIGHT_CUTOFF, l = s.attenuation.y, q = s.attenuation.z;
+    if (c >= 0.f) return 0.f; // never brighter than the cutoff
+    if (q > 0.f) return (-l + std::sqrt(l * l - 4.f * q * c)) / (2.f * q);
+    if (l > 0.f) return -c / l;
+    return fallback;
+}
+
+inline uniforms::clustered_light make_clustered_light(const uniforms::point_light & l)
+{
+    uniforms::clustered_light g = {};
+    g.positionRange = float4(l.position, point_light_range(l));
+    g.colorType = float4(l.color, 0.f);
+    g.attenuation = float4(l.radius, 0, 0, 0);
+    return g;
+}
+
+inline uniforms::clustered_light make_clustered_light(const uniforms::spot_light & s, const float fallbackRange)
+{
+    uniforms::clustered_light g = {};
+    g.positionRange = float4(s.position, spot_light_range(s, fallbackRange));
+    g.colorType = float4(s.color, 1.f);
+    g.attenuation = float4(s.attenuation, 0.f);
+    g.spotDirectionCutoff = float4(safe_normalize(s.direction), s.cutoff);
+    return g;
+}
+
+class clustered_lighting
+{
+public:
+
+    constexpr static const int NUM_CLUSTERS_X = 16;
+    constexpr static const int NUM_CLUSTERS_Y = 9;
+    constexpr static const int NUM_CLUSTERS_Z = 24;
+    constexpr static const int NUM_CLUSTERS = NUM_CLUSTERS_X * NUM_CLUSTERS_Y * NUM_CLUSTERS_Z;
+
+private:
+
+    constexpr static const size_t LIGHTS_PER_TASK = 256;
+
+    struct cell_range { int x0, x1, y0, y1, z0, z1; };
+
+    // View-space AABBs of every cell, rebuilt only when the projection or depth range changes
+    std::vector<Bounds3D> cellBounds;
+    float4x4 cachedProjection = Zero4x4;
+    float cachedNear{ 0.f }, cachedFar{ 0.f };
+
+    std::vector<uniforms::clustered_light> lights;
+    std::vector<std::vector<uint32_t>> taskPairs;   // (cell, light) pairs, flattened, one list per task
+    std::vector<uint32_t> cellCounts;
+    std::vector<uint2> cells;                       // (offset, count) into `indices`
+    std::vector<uint32_t> indices;
+    uint32_t visibleLights{ 0 };
+
+    uniforms::clustered_lighting params = {};
+
+    float slice_depth(const int z) const
+    {
+        return cachedNear * std::pow(cachedFar / cachedNear, float(z) / float(NUM_CLUSTERS_Z));
+    }
+
+    void build_cell_bounds(const float4x4 & projection, const float nearClip, const float farClip)
+    {
+        cachedProjection = projection;
+        cachedNear = nearClip;
+        cachedFar = farClip;
+        cellBounds.resize(NUM_CLUSTERS);
+
+        // View-space ray through every tile corner, scaled to unit depth
+        const float4x4 invProjection = inverse(projection);
+        std::vector<float3> rays((NUM_CLUSTERS_X + 1) * (NUM_CLUSTERS_Y + 1));
+        for (int y = 0; y <= NUM_CLUSTERS_Y; ++y)
+        {
+            for (int x = 0; x <= NUM_CLUSTERS_X; ++x)
+            {
+                const float2 ndc = float2(float(x) / NUM_CLUSTERS_X, float(y) / NUM_CLUSTERS_Y) * 2.f - 1.f;
+                const float3 p = transform_coord(invProjection, float3(ndc, -1.f));
+                rays[y * (NUM_CLUSTERS_X + 1) + x] = p / -p.z;
+            }
+        }
+
+        for (int z = 0; z < NUM_CLUSTERS_Z; ++z)
+        {
+            const float d0 = slice_depth(z), d1 = slice_depth(z + 1);
+            for (int y = 0; y < NUM_CLUSTERS_Y; ++y)
+            {
+                for (int x = 0; x < NUM_CLUSTERS_X; ++x)
+                {
+                    Bounds3D b(float3(std::numeric_limits<float>::max()), float3(std::numeric_limits<float>::lowest()));
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        const float3 & r = rays[(y + (c >> 1)) * (NUM_CLUSTERS_X + 1) + x + (c & 1)];
+                        b._min = min(b._min, min(r * d0, r * d1));
+                        b._max = max(b._max, max(r * d0, r * d1));
+                    }
+                    cellBounds[(z * NUM_CLUSTERS_Y + y) * NUM_CLUSTERS_X + x] = b;
+                }
+            }
+        }
+    }
+
+    int slice_for_depth(const float depth) const
+    {
+        const int z = (int) std::floor(std::log(depth) * params.depthParams.z + params.depthParams.w);
+        return clamp(z, 0, NUM_CLUSTERS_Z - 1);
+    }
+
+    // Conservative cell range of a view-space sphere; false if it misses the view entirely
+    bool compute_cell_range(const float3 & c, const float r, const float4x4 & projection, cell_range & out) const
+    {
+        const float dMin = std::max(-c.z - r, cachedNear), dMax = std::min(-c.z + r, cachedFar);
+        if (dMin > dMax) return false;
+
+        // ndc = f(x / depth) is monotonic in both terms, so the box corners bound the projected sphere
+        float2 lo(std::numeric_limits<float>::max()), hi(std::numeric_limits<float>::lowest());
+        for (int i = 0; i < 8; ++i)
+        {
+            const float3 corner((i & 1) ? c.x + r : c.x - r, (i & 2) ? c.y + r : c.y - r, (i & 4) ? -dMax : -dMin);
+            const float3 ndc = transform_coord(projection, corner);
+            lo = min(lo, ndc.xy());
+            hi = max(hi, ndc.xy());
+        }
+        if (lo.x > 1.f || lo.y > 1.f || hi.x < -1.f || hi.y < -1.f) return false;
+
+        out.x0 = clamp((int) std::floor((lo.x * 0.5f + 0.5f) * NUM_CLUSTERS_X), 0, NUM_CLUSTERS_X - 1);
+        out.x1 = clamp((int) std::floor((hi.x * 0.5f + 0.5f) * NUM_CLUSTERS_X), 0, NUM_CLUSTERS_X - 1);
+        out.y0 = clamp((int) std::floor((lo.y * 0.5f + 0.5f) * NUM_CLUSTERS_Y), 0, NUM_CLUSTERS_Y - 1);
+        out.y1 = clamp((int) std::floor((hi.y * 0.5f + 0.5f) * NUM_CLUSTERS_Y), 0, NUM_CLUSTERS_Y - 1);
+        out.z0 = slice_for_depth(dMin);
+        out.z1 = slice_for_depth(dMax);
+        return true;
+    }
+
+    static bool sphere_intersects_box(const float3 & c, const float r, const Bounds3D & b)
+    {
+        const float3 d = max(max(b._min - c, c - b._max), float3(0.f));
+        return dot(d, d) <= r * r;
+    }
+
+    void assign_range(const float4x4 & view, const float4x4 & projection, size_t begin, size_t end, std::vector<uint32_t> & out) const
+    {
+        out.clear();
+        for (size_t i = begin; i < end; ++i)
+        {
+            const float3 c = transform_coord(view, lights[i].positionRange.xyz());
+            const float r = lights[i].positionRange.w;
+
+            cell_range range;
+            if (r <= 0.f || !compute_cell_range(c, r, projection, range)) continue;
+
+            for (int z = range.z0; z <= range.z1; ++z)
+            {
+                for (int y = range.y0; y <= range.y1; ++y)
+                {
+                    for (int x = range.x0; x <= range.x1; ++x)
+                    {
+                        const uint32_t cell = (z * NUM_CLUSTERS_Y + y) * NUM_CLUSTERS_X + x;
+                        if (!sphere_intersects_box(c, r, cellBounds[cell])) continue;
+                        out.push_back(cell);
+                        out.push_back(static_cast<uint32_t>(i));
+                    }
+                }
+            }
+        }
+    }
+
+public:
+
+    // Number of lights accepted by the last call to `set_lights` and how many of them touched at least one cell
+    size_t get_light_count() const { return lights.size(); }
+    uint32_t get_visible_light_count() const { return visibleLights; }
+    size_t get_index_count() const { return indices.size(); }
+
+    const std::vector<uint2> & get_cells() const { return cells; }
+    const std::vector<uint32_t> & get_indices() const { return indices; }
+
+    // Gathers point and spot lights (point lights first) into the light buffer, keeping at most `maxLights`
+    void set_lights(const std::vector<uniforms::point_light> & pointLights, const std::vector<uniforms::spot_light> & spotLights, const size_t maxLights, const float fallbackRange)
+    {
+        lights.clear();
+        for (auto & l : pointLights) { if (lights.size() == maxLights) break; lights.push_back(make_clustered_light(l)); }
+        for (auto & s : spotLights) { if (lights.size() == maxLights) break; lights.push_back(make_clustered_light(s, fallbackRange)); }
+    }
+
+    // Builds the froxel grid for `view`/`projection` and assigns the current lights to it. CPU only.
+    void assign(const float4x4 & view, const float4x4 & projection, const float nearClip, const float farClip)
+    {
+        if (projection != cachedProjection || nearClip != cachedNear || farClip != cachedFar) build_cell_bounds(projection, nearClip, farClip);
+
+        const float depthScale = float(NUM_CLUSTERS_Z) / std::log(farClip / nearClip);
+        params.view = view;
+        params.viewProj = mul(projection, view);
+        params.depthParams = float4(nearClip, farClip, depthScale, -std::log(nearClip) * depthScale);
+        params.dims = int4(NUM_CLUSTERS_X, NUM_CLUSTERS_Y, NUM_CLUSTERS_Z, (int) lights.size());
+
+        const size_t numTasks = (lights.size() + LIGHTS_PER_TASK - 1) / LIGHTS_PER_TASK;
+        taskPairs.resize(numTasks);
+        get_shared_job_system().parallel_for(numTasks, 1, [&](size_t taskBegin, size_t taskEnd)
+        {
+            for (size_t t = taskBegin; t < taskEnd; ++t)
+            {
+                assign_range(view, projection, t * LIGHTS_PER_TASK, std::min(lights.size(), (t + 1) * LIGHTS_PER_TASK), taskPairs[t]);
+            }
+        });
+
+        // Counting sort on cell id. Tasks are visited in order, so each cell lists its lights in ascending order.
+        cellCounts.assign(NUM_CLUSTERS, 0);
+        size_t total = 0;
+        uint32_t lastLight = std::numeric_limits<uint32_t>::max();
+        visibleLights = 0;
+        for (auto & pairs : taskPairs)
+        {
+            for (size_t p = 0; p < pairs.size(); p += 2)
+            {
+                cellCounts[pairs[p]]++;
+                if (pairs[p + 1] != lastLight) { lastLight = pairs[p + 1]; visibleLights++; }
+            }
+            total += pairs.size() / 2;
+        }
+
+        cells.resize(NUM_CLUSTERS);
+        uint32_t offset = 0;
+        for (int c = 0; c < NUM_CLUSTERS; ++c)
+        {
+            cells[c] = uint2(offset, 0);
+            offset += cellCounts[c];
+        }
+
+        indices.resize(total);
+        for (auto & pairs : taskPairs)
+        {
+            for (size_t p = 0; p < pairs.size(); p += 2)
+            {
+                uint2 & cell = cells[pairs[p]];
+                indices[cell.x + cell.y++] = pairs[p + 1];
+            }
+        }
+    }
+
+    // Writes the lights, cell table and index list into this frame's region of `stream` and binds them for the forward pass
+    void upload(GlStreamingBuffer & stream)
+    {
+        // Storage ranges are never left empty so the bindings stay valid with zero lights
+        static const uniforms::clustered_light emptyLight = {};
+        static const uint32_t emptyIndex = 0;
+
+        stream.bind_storage(uniforms::clustered_lighting::lightBinding, lights.empty() ? &emptyLight : lights.data(), std::max<size_t>(1, lights.size()));
+        stream.bind_storage(uniforms::clustered_lighting::cellBinding, cells.data(), cells.size());
+        stream.bind_storage(uniforms::clustered_lighting::indexBinding, indices.empty() ? &emptyIndex : indices.data(), std::max<size_t>(1, indices.size()));
+        stream.bind_uniform(uniforms::clustered_lighting::binding, params);
+    }
+};
+
+// Deterministic field of point and spot lights scattered through `volume`, used by the stress scene and benchmark
+inline void make_light_stress_scene(const size_t numPointLights, const size_t numSpotLights, const Bounds3D & volume, const uint32_t seed,
+    std::vector<uniforms::point_light> & outPoint, std::vector<uniforms::spot_light> & outSpot)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    auto random_in_volume = [&]() { return volume.min() + volume.size() * float3(unit(gen), unit(gen), unit(gen)); };
+    auto random_color = [&]() { return normalize(float3(unit(gen), unit(gen), unit(gen)) + float3(0.1f)); };
+
+    outPoint.resize(numPointLights);
+    for (auto & l : outPoint)
+    {
+        l.position = random_in_volume();
+        l.color = random_color();
+        l.radius = 0.05f + 0.2f * unit(gen);
+    }
+
+    outSpot.resize(numSpotLights);
+    for (auto & s : outSpot)
+    {
+        s.position = random_in_volume();
+        s.color = random_color();
+        s.direction = normalize(float3(unit(gen) - 0.5f, -1.f, unit(gen) - 0.5f));
+        s.attenuation = float3(1.f, 0.5f + unit(gen), 2.f + 4.f * unit(gen));
+        s.cutoff = std::cos(to_radians(15.f + 30.f * unit(gen)));
+    }
+}
+
+namespace clustered_lighting_tests
+{
+    using namespace avl;
+
+    // Every light whose sphere reaches a cell (by brute force) must appear in that cell's list
+    inline bool execute(const size_t numLights = 2048)
+    {
+        std::vector<uniforms::point_light> points;
+        std::vector<uniforms::spot_light> spots;
+        make_light_stress_scene(numLights / 2, numLights / 2, Bounds3D(float3(-20, -2, -40), float3(20, 6, 2)), 7, points, spots);
+
+        const float nearClip = 0.1f, farClip = 64.f;
+        const float4x4 projection = make_projection_matrix(to_radians(90.f), 16.f / 9.f, nearClip, farClip);
+        const float4x4 view = Pose(float4(0, 0, 0, 1), float3(0, 1, 0)).view_matrix();
+
+        clustered_lighting clusters;
+        clusters.set_lights(points, spots, numLights, farClip);
+        clusters.assign(view, projection, nearClip, farClip);
+
+        std::vector<uniforms::clustered_light> all;
+        for (auto & l : points) all.push_back(make_clustered_light(l));
+        for (auto & s : spots) all.push_back(make_clustered_light(s, farClip));
+
+        // Sample every cell at its centre and just inside its faces, edges and corners (where a too-tight cell range
+        // drops lights first) and make sure each light touching a sample is listed
+        const float4x4 invProjection = inverse(projection), invView = inverse(view);
+        const float depthScale = float(clustered_lighting::NUM_CLUSTERS_Z) / std::log(farClip / nearClip);
+        const float offsets[3] = { 0.01f, 0.5f, 0.99f };
+        size_t missing = 0;
+        for (int z = 0; z < clustered_lighting::NUM_CLUSTERS_Z; ++z)
+        {
+            for (int y = 0; y < clustered_lighting::NUM_CLUSTERS_Y; ++y)
+            {
+                for (int x = 0; x < clustered_lighting::NUM_CLUSTERS_X; ++x)
+                {
+                    const uint2 cell = clusters.get_cells()[(z * clustered_lighting::NUM_CLUSTERS_Y + y) * clustered_lighting::NUM_CLUSTERS_X + x];
+                    for (int s = 0; s < 27; ++s)
+                    {
+                        const float depth = nearClip * std::exp((z + offsets[s / 9]) / depthScale);
+                        const float2 ndc = float2((x + offsets[s % 3]) / clustered_lighting::NUM_CLUSTERS_X, (y + offsets[(s / 3) % 3]) / clustered_lighting::NUM_CLUSTERS_Y) * 2.f - 1.f;
+                        const float3 ray = transform_coord(invProjection, float3(ndc, -1.f));
+                        const float3 sample = transform_coord(invView, ray * (depth / -ray.z));
+
+                        for (uint32_t i = 0; i < all.size(); ++i)
+                        {
+                            if (length(sample - all[i].positionRange.xyz()) > all[i].positionRange.w) continue;
+                            bool found = false;
+                            for (uint32_t k = 0; k < cell.y && !found; ++k) found = clusters.get_indices()[cell.x + k] == i;
+                            if (!found) missing++;
+                        }
+                    }
+                }
+            }
+        }
+
+        std::cout << "clustered lighting: " << clusters.get_visible_light_count() << " visible lights, " << clusters.get_index_count() << " indices, " << missing << " missing" << std::endl;
+        return missing == 0;
+    }
+
+    inline void benchmark(const size_t numLights = 8192, const int iterations = 100)
+    {
+        std::vector<uniforms::point_light> points;
+        std::vector<uniforms::spot_light> spots;
+        make_light_stress_scene(numLights * 3 / 4, numLights / 4, Bounds3D(float3(-40, -2, -80), float3(40, 8, 2)), 1, points, spots);
+
+        const float4x4 projection = make_projection_matrix(to_radians(90.f), 16.f / 9.f, 0.1f, 64.f);
+        const float4x4 view = Pose(float4(0, 0, 0, 1), float3(0, 1, 0)).view_matrix();
+
+        clustered_lighting clusters;
+        clusters.set_lights(points, spots, numLights, 64.f);
+
+        scoped_timer t("clustered light assignment x " + std::to_string(iterations));
+        for (int i = 0; i < iterations; ++i) clusters.assign(view, projection, 0.1f, 64.f);
+    }
+}
+
+#endif // end vr_clustered_lighting_hpp
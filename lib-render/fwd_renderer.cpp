@@ -11,7 +11,7 @@ void forward_renderer::update_per_object_uniform_buffer(Renderable * r, const vi
     object.modelMatrixIT = inverse(transpose(object.modelMatrix));
     object.modelViewMatrix = mul(d.viewMatrix, object.modelMatrix);
     object.receiveShadow = (float)r->get_receive_shadow();
-    perObject.set_buffer_data(sizeof(object), &object, GL_STREAM_DRAW);
+    frameData.bind_uniform(uniforms::per_object::binding, object);
 }
 
 uint32_t forward_renderer::get_color_texture(const uint32_t idx) const
@@ -36,7 +36,52 @@ BloomPass & forward_renderer::get_bloom_pass() const
     return *bloom;
 }
 
-void forward_renderer::run_depth_prepass(const view_data & view, const scene_data & scene)
+void forward_renderer::upload_per_view(const view_data & view)
+{
+    uniforms::per_view v = {};
+    v.view = view.viewMatrix;
+    v.viewProj = view.viewProjMatrix;
+    v.eyePos = float4(view.pose.position, 1);
+    frameData.bind_uniform(uniforms::per_view::binding, v);
+}
+
+void forward_renderer::upload_per_view_stereo(const view_data & left, const view_data & right)
+{
+    uniforms::per_view v = {};
+    v.view = left.viewMatrix; // shaders unaware of stereo see the left eye
+    v.viewProj = left.viewProjMatrix;
+    v.eyePos = float4(left.pose.position, 1);
+    v.stereoView[0] = left.viewMatrix;
+    v.stereoView[1] = right.viewMatrix;
+    v.stereoViewProj[0] = left.viewProjMatrix;
+    v.stereoViewProj[1] = right.viewProjMatrix;
+    v.stereoEyePos[0] = float4(left.pose.position, 1);
+    v.stereoEyePos[1] = float4(right.pose.position, 1);
+    v.stereoParams = float4(1, 0, 0, 0);
+    frameData.bind_uniform(uniforms::per_view::binding, v);
+}
+
+void forward_renderer::create_stereo_targets()
+{
+    const int width = settings.renderSize.x * 2, height = settings.renderSize.y;
+
+    glNamedRenderbufferStorageMultisampleEXT(stereoMultisampleRenderbuffers[0], settings.msaaSamples, GL_RGBA8, width, height);
+    glNamedFramebufferRenderbufferEXT(stereoMultisampleFramebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, stereoMultisampleRenderbuffers[0]);
+    glNamedRenderbufferStorageMultisampleEXT(stereoMultisampleRenderbuffers[1], settings.msaaSamples, GL_DEPTH_COMPONENT, width, height);
+    glNamedFramebufferRenderbufferEXT(stereoMultisampleFramebuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, stereoMultisampleRenderbuffers[1]);
+    stereoMultisampleFramebuffer.check_complete();
+
+    // A multisample resolve can't move pixels, so both eyes resolve in place and are then copied out per eye
+    stereoResolveTexture.setup(width, height, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, nullptr, false);
+    stereoResolveDepthTexture.setup(width, height, GL_DEPTH_COMPONENT32, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glNamedFramebufferTexture2DEXT(stereoResolveFramebuffer, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, stereoResolveTexture, 0);
+    glNamedFramebufferTexture2DEXT(stereoResolveFramebuffer, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, stereoResolveDepthTexture, 0);
+    stereoResolveFramebuffer.check_complete();
+
+    stereoTargetsReady = true;
+}
+
+void forward_renderer::run_depth_prepass(const std::vector<visible_renderable> & renderQueueMaterial, const std::vector<visible_renderable> & renderQueueDefault, const view_data & view, const int instances)
 {
     GLboolean colorMask[4];
     glGetBooleanv(GL_COLOR_WRITEMASK, &colorMask[0]);
@@ -48,10 +93,13 @@ void forward_renderer::run_depth_prepass(const view_data & view, const scene_dat
 
     auto & shader = earlyZPass.get();
     shader.bind();
-    for (auto obj : scene.renderSet)
+    for (auto * list : { &renderQueueMaterial, &renderQueueDefault })
     {
-        update_per_object_uniform_buffer(obj, view);
-        obj->draw();
+        for (auto & v : *list)
+        {
+            update_per_object_uniform_buffer(v.object, view);
+            v.object->draw_depth(instances);
+        }
     }
     shader.unbind();
 
@@ -103,7 +151,7 @@ void forward_renderer::run_shadow_pass(const view_data & view, const scene_data
         {
             float4x4 modelMatrix = mul(obj->get_pose().matrix(), make_scaling_matrix(obj->get_scale()));
             shadow->program.get().uniform("u_modelShadowMatrix", modelMatrix);
-            obj->draw();
+            obj->draw_depth(0);
         }
     }
 
@@ -112,7 +160,7 @@ void forward_renderer::run_shadow_pass(const view_data & view, const scene_data
     gl_check_error(__FILE__, __LINE__);
 }
 
-void forward_renderer::run_forward_pass(std::vector<Renderable *> & renderQueueMaterial, std::vector<Renderable *> & renderQueueDefault, const view_data & view, const scene_data & scene)
+void forward_renderer::run_forward_pass(const std::vector<visible_renderable> & renderQueueMaterial, const std::vector<visible_renderable> & renderQueueDefault, const view_data & view, const scene_data & scene, const int instances)
 {
     if (settings.useDepthPrepass)
     {
@@ -121,23 +169,24 @@ void forward_renderer::run_forward_pass(std::vector<Renderable *> & renderQueueM
         glDepthMask(GL_FALSE); // depth already comes from the prepass
     }
 
-    for (auto r : renderQueueMaterial)
+    for (auto & v : renderQueueMaterial)
     {
-        update_per_object_uniform_buffer(r, view);
+        update_per_object_uniform_buffer(v.object, view);
 
-        Material * mat = r->get_material();
+        Material * mat = v.material;
         mat->update_uniforms();
         if (auto * mr = dynamic_cast<MetallicRoughnessMaterial*>(mat)) mr->update_cascaded_shadow_array_handle(shadow->get_output_texture());
         mat->use();
 
-        r->draw();
+        if (instances) v.object->draw_instanced(instances);
+        else v.object->draw();
     }
 
     // We assume that objects without a valid material take care of their own shading in the `draw()` function. 
-    for (auto r : renderQueueDefault)
+    for (auto & v : renderQueueDefault)
     {
-        update_per_object_uniform_buffer(r, view);
-        r->draw();
+        update_per_object_uniform_buffer(v.object, view);
+        v.object->draw();
     }
 
     if (settings.useDepthPrepass)
@@ -211,41 +260,161 @@ forward_renderer::~forward_renderer()
     timer.stop();
 }
 
+void forward_renderer::render_views_multipass(const scene_data & scene)
+{
+    GLfloat defaultColor[] = { 1.0f, 0.0f, 0.f, 1.0f };
+    GLfloat defaultDepth = 1.f;
+
+    for (int camIdx = 0; camIdx < settings.cameraCount; ++camIdx)
+    {
+        upload_per_view(scene.views[camIdx]);
+
+        // Render into multisampled fbo
+        glEnable(GL_MULTISAMPLE);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, multisampleFramebuffer);
+        glViewport(0, 0, settings.renderSize.x, settings.renderSize.y);
+        glClearNamedFramebufferfv(multisampleFramebuffer, GL_COLOR, 0, &defaultColor[0]);
+        glClearNamedFramebufferfv(multisampleFramebuffer, GL_DEPTH, 0, &defaultDepth);
+
+        // Execute the forward passes
+        if (settings.useDepthPrepass)
+        {
+            gpuProfiler.begin(AVL_PROFILE_TAG("depth-prepass"));
+            run_depth_prepass(materialRenderList, defaultRenderList, scene.views[camIdx]);
+            gpuProfiler.end();
+        }
+
+        gpuProfiler.begin(AVL_PROFILE_TAG("forward pass"));
+        run_skybox_pass(scene.views[camIdx], scene);
+        run_forward_pass(materialRenderList, defaultRenderList, scene.views[camIdx], scene);
+        gpuProfiler.end();
+
+        glDisable(GL_MULTISAMPLE);
+
+        // Resolve multisample into per-view framebuffer
+        {
+            gpuProfiler.begin(AVL_PROFILE_TAG("blit"));
+
+            // blit color 
+            glBlitNamedFramebuffer(multisampleFramebuffer, eyeFramebuffers[camIdx],
+                0, 0, settings.renderSize.x, settings.renderSize.y, 0, 0,
+                settings.renderSize.x, settings.renderSize.y, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+            // blit depth
+            glBlitNamedFramebuffer(multisampleFramebuffer, eyeFramebuffers[camIdx],
+                0, 0, settings.renderSize.x, settings.renderSize.y, 0, 0,
+                settings.renderSize.x, settings.renderSize.y, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+            gpuProfiler.end();
+        }
+
+        gl_check_error(__FILE__, __LINE__);
+    }
+}
+
+void forward_renderer::render_views_single_pass_stereo(const scene_data & scene)
+{
+    const view_data & left = scene.views[0];
+    const view_data & right = scene.views[1];
+    const int width = settings.renderSize.x, height = settings.renderSize.y;
+
+    if (!stereoTargetsReady) create_stereo_targets();
+
+    // Anything that can't issue an instanced draw (or shades itself) falls back to one draw per eye
+    stereoInstancedList.clear();
+    stereoPerEyeList.clear();
+    for (auto & v : materialRenderList) (v.object->supports_instanced_draw() ? stereoInstancedList : stereoPerEyeList).push_back(v);
+
+    GLfloat defaultColor[] = { 1.0f, 0.0f, 0.f, 1.0f };
+    GLfloat defaultDepth = 1.f;
+
+    glEnable(GL_MULTISAMPLE);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, stereoMultisampleFramebuffer);
+    glClearNamedFramebufferfv(stereoMultisampleFramebuffer, GL_COLOR, 0, &defaultColor[0]);
+    glClearNamedFramebufferfv(stereoMultisampleFramebuffer, GL_DEPTH, 0, &defaultDepth);
+
+    // Both eyes are drawn side-by-side: odd instances land in the right half and are clipped at the seam
+    if (settings.useDepthPrepass)
+    {
+        gpuProfiler.begin(AVL_PROFILE_TAG("depth-prepass"));
+        upload_per_view_stereo(left, right);
+        glViewport(0, 0, width * 2, height);
+        glEnable(GL_CLIP_DISTANCE0);
+        run_depth_prepass(stereoInstancedList, {}, left, 2);
+        glDisable(GL_CLIP_DISTANCE0);
+        gpuProfiler.end();
+    }
+
+    gpuProfiler.begin(AVL_PROFILE_TAG("forward pass"));
+
+    for (int camIdx = 0; camIdx < 2; ++camIdx)
+    {
+        upload_per_view(scene.views[camIdx]);
+        glViewport(camIdx * width, 0, width, height);
+        if (settings.useDepthPrepass) run_depth_prepass(stereoPerEyeList, defaultRenderList, scene.views[camIdx]);
+        run_skybox_pass(scene.views[camIdx], scene);
+        run_forward_pass(stereoPerEyeList, defaultRenderList, scene.views[camIdx], scene);
+    }
+
+    upload_per_view_stereo(left, right);
+    glViewport(0, 0, width * 2, height);
+    glEnable(GL_CLIP_DISTANCE0);
+    run_forward_pass(stereoInstancedList, {}, left, scene, 2);
+    glDisable(GL_CLIP_DISTANCE0);
+
+    gpuProfiler.end();
+
+    glDisable(GL_MULTISAMPLE);
+
+    // Resolve both eyes at once, then copy each half into its per-view framebuffer
+    {
+        gpuProfiler.begin(AVL_PROFILE_TAG("blit"));
+
+        glBlitNamedFramebuffer(stereoMultisampleFramebuffer, stereoResolveFramebuffer,
+            0, 0, width * 2, height, 0, 0, width * 2, height, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+        for (int camIdx = 0; camIdx < 2; ++camIdx)
+        {
+            glBlitNamedFramebuffer(stereoResolveFramebuffer, eyeFramebuffers[camIdx],
+                camIdx * width, 0, (camIdx + 1) * width, height, 0, 0, width, height,
+                GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        }
+
+        gpuProfiler.end();
+    }
+
+    glViewport(0, 0, width, height);
+
+    gl_check_error(__FILE__, __LINE__);
+}
+
 void forward_renderer::render_frame(const scene_data & scene)
 {
     assert(settings.cameraCount == scene.views.size());
 
-    cpuProfiler.begin("renderloop");
+    AVL_PROFILE_SCOPE("renderloop");
+    gpuProfiler.begin(AVL_PROFILE_TAG("renderloop"));
 
     // Renderer default state
     glEnable(GL_CULL_FACE);
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_FRAMEBUFFER_SRGB);
 
-    glBindBufferBase(GL_UNIFORM_BUFFER, uniforms::per_scene::binding, perScene);
-    glBindBufferBase(GL_UNIFORM_BUFFER, uniforms::per_view::binding, perView);
-    glBindBufferBase(GL_UNIFORM_BUFFER, uniforms::per_object::binding, perObject);
-
     // Update per-scene uniform buffer
     uniforms::per_scene b = {};
     b.time = timer.milliseconds().count() / 1000.f; // millisecond resolution expressed as seconds
     b.resolution = settings.renderSize;
     b.invResolution = 1.f / b.resolution;
-    b.activePointLights = scene.pointLights.size();
 
     b.directional_light.color = scene.sunlight.color;
     b.directional_light.direction = scene.sunlight.direction;
     b.directional_light.amount = scene.sunlight.amount;
-    for (int i = 0; i < (int) std::min(scene.pointLights.size(), size_t(uniforms::MAX_POINT_LIGHTS)); ++i) b.point_lights[i] = scene.pointLights[i];
-
-    GLfloat defaultColor[] = { 1.0f, 0.0f, 0.f, 1.0f };
-    GLfloat defaultDepth = 1.f;
 
     view_data shadowAndCullingView = scene.views[0];
 
     if (settings.cameraCount == 2)
     {
-        cpuProfiler.begin("center-view");
+        AVL_PROFILE_SCOPE("center-view");
 
         // Take the mid-point between the eyes
         shadowAndCullingView.pose = Pose(scene.views[0].pose.orientation, (scene.views[0].pose.position + scene.views[1].pose.position) * 0.5f);
@@ -259,15 +428,15 @@ void forward_renderer::render_frame(const scene_data & scene)
 
         // Regenerate the view matrix and near/far clip planes
         shadowAndCullingView.viewMatrix = inverse(mul(shadowAndCullingView.pose.matrix(), make_translation_matrix(centerOffsetZ)));
+        shadowAndCullingView.viewProjMatrix = mul(shadowAndCullingView.projectionMatrix, shadowAndCullingView.viewMatrix);
         near_far_clip_from_projection(shadowAndCullingView.projectionMatrix, shadowAndCullingView.nearClip, shadowAndCullingView.farClip);
-        cpuProfiler.end("center-view");
     }
 
     if (settings.shadowsEnabled)
     {
-        gpuProfiler.begin("shadowpass");
+        gpuProfiler.begin(AVL_PROFILE_TAG("shadowpass"));
         run_shadow_pass(shadowAndCullingView, scene);
-        gpuProfiler.end("shadowpass");
+        gpuProfiler.end();
 
         for (int c = 0; c < uniforms::NUM_CASCADES; c++)
         {
@@ -278,123 +447,43 @@ void forward_renderer::render_frame(const scene_data & scene)
         }
     }
 
-    // Per-scene can be uploaded now that the shadow pass has completed
-    perScene.set_buffer_data(sizeof(b), &b, GL_STREAM_DRAW);
-
-    // We follow the sorting strategy outlined here: http://realtimecollisiondetection.net/blog/?p=86
-    auto materialSortFunc = [shadowAndCullingView](Renderable * lhs, Renderable * rhs)
+    // Assign point and spot lights to the froxel grid of the culling view
     {
-        const float lDist = distance(shadowAndCullingView.pose.position, lhs->get_pose().position);
-        const float rDist = distance(shadowAndCullingView.pose.position, rhs->get_pose().position);
-
-        // Sort by material (expensive shader state change)
-        auto lid = lhs->get_material()->id();
-        auto rid = rhs->get_material()->id();
-        if (lid != rid) return lid > rid;
-
-        // Otherwise sort by distance
-        return lDist < rDist;
-    };
-
-    auto distanceSortFunc = [shadowAndCullingView](Renderable * lhs, Renderable * rhs)
-    {
-        const float lDist = distance(shadowAndCullingView.pose.position, lhs->get_pose().position);
-        const float rDist = distance(shadowAndCullingView.pose.position, rhs->get_pose().position);
-        return lDist < rDist;
-    };
-
-    std::priority_queue<Renderable *, std::vector<Renderable*>, decltype(materialSortFunc)> renderQueueMaterial(materialSortFunc);
-    std::priority_queue<Renderable *, std::vector<Renderable*>, decltype(distanceSortFunc)> renderQueueDefault(distanceSortFunc);
-
-    for (auto obj : scene.renderSet)
-    {
-        // Can't sort by material if the renderable doesn't *have* a material; bucket all other objects 
-        if (obj->get_material() != nullptr) renderQueueMaterial.push(obj);
-        else renderQueueDefault.push(obj);
+        AVL_PROFILE_SCOPE("light-assignment");
+        lightClusters.set_lights(scene.pointLights, scene.spotLights, std::max(0, settings.maxLights), shadowAndCullingView.farClip);
+        lightClusters.assign(shadowAndCullingView.viewMatrix, shadowAndCullingView.projectionMatrix, shadowAndCullingView.nearClip, shadowAndCullingView.farClip);
     }
+    lightClusters.upload(frameData);
+    b.activeLights = (int) lightClusters.get_light_count();
 
-    // Resolve render queues into flat lists
-    std::vector<Renderable *> materialRenderList;
-    while (!renderQueueMaterial.empty())
-    {
-        Renderable * top = renderQueueMaterial.top();
-        renderQueueMaterial.pop();
-        materialRenderList.push_back(top);
-    }
+    // Per-scene can be uploaded now that the shadow pass has completed
+    frameData.bind_uniform(uniforms::per_scene::binding, b);
 
-    std::vector<Renderable *> defaultRenderList;
-    while (!renderQueueDefault.empty())
+    // Cull once against the superfrustum, producing sorted per-material and default lists shared by both eyes
     {
-        Renderable * top = renderQueueDefault.top();
-        renderQueueDefault.pop();
-        defaultRenderList.push_back(top);
+        AVL_PROFILE_SCOPE("visibility");
+        visibility.execute(scene.renderSet, shadowAndCullingView.viewProjMatrix, shadowAndCullingView.pose, materialRenderList, defaultRenderList);
     }
 
-    for (int camIdx = 0; camIdx < settings.cameraCount; ++camIdx)
-    {
-        // Update per-view uniform buffer
-        uniforms::per_view v = {};
-        v.view = scene.views[camIdx].viewMatrix;
-        v.viewProj = scene.views[camIdx].viewProjMatrix;
-        v.eyePos = float4(scene.views[camIdx].pose.position, 1);
-        perView.set_buffer_data(sizeof(v), &v, GL_STREAM_DRAW);
-
-
-        // Render into multisampled fbo
-        glEnable(GL_MULTISAMPLE);
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, multisampleFramebuffer);
-        glViewport(0, 0, settings.renderSize.x, settings.renderSize.y);
-        glClearNamedFramebufferfv(multisampleFramebuffer, GL_COLOR, 0, &defaultColor[0]);
-        glClearNamedFramebufferfv(multisampleFramebuffer, GL_DEPTH, 0, &defaultDepth);
-
-        // Execute the forward passes
-        if (settings.useDepthPrepass)
-        {
-            gpuProfiler.begin("depth-prepass");
-            run_depth_prepass(scene.views[camIdx], scene);
-            gpuProfiler.end("depth-prepass");
-        }
-
-        gpuProfiler.begin("forward pass");
-        run_skybox_pass(scene.views[camIdx], scene);
-        run_forward_pass(materialRenderList, defaultRenderList, scene.views[camIdx], scene);
-        gpuProfiler.end("forward pass");
-
-        glDisable(GL_MULTISAMPLE);
-
-        // Resolve multisample into per-view framebuffer
-        {
-            gpuProfiler.begin("blit");
-
-            // blit color 
-            glBlitNamedFramebuffer(multisampleFramebuffer, eyeFramebuffers[camIdx],
-                0, 0, settings.renderSize.x, settings.renderSize.y, 0, 0,
-                settings.renderSize.x, settings.renderSize.y, GL_COLOR_BUFFER_BIT, GL_LINEAR);
-
-            // blit depth
-            glBlitNamedFramebuffer(multisampleFramebuffer, eyeFramebuffers[camIdx],
-                0, 0, settings.renderSize.x, settings.renderSize.y, 0, 0,
-                settings.renderSize.x, settings.renderSize.y, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
-
-            gpuProfiler.end("blit");
-        }
-
-        gl_check_error(__FILE__, __LINE__);
-    }
+    if (settings.cameraCount == 2 && settings.singlePassStereo) render_views_single_pass_stereo(scene);
+    else render_views_multipass(scene);
 
     // Execute the post passes after having resolved the multisample framebuffers
     {
-        gpuProfiler.begin("postprocess");
+        gpuProfiler.begin(AVL_PROFILE_TAG("postprocess"));
         for (int camIdx = 0; camIdx < settings.cameraCount; ++camIdx)
         {
             run_post_pass(scene.views[camIdx], scene);
         }
-        gpuProfiler.end("postprocess");
+        gpuProfiler.end();
     }
 
     glDisable(GL_FRAMEBUFFER_SRGB);
 
-    cpuProfiler.end("renderloop");
+    gpuProfiler.end();
+    gpuProfiler.end_frame();
+
+    frameData.end_frame();
 
     gl_check_error(__FILE__, __LINE__);
 }
\ No newline at end of file
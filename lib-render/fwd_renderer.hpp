@@ -6,16 +6,18 @@
 #include "math-core.hpp"
 #include "simple_timer.hpp"
 #include "uniforms.hpp"
-#include "circular_buffer.hpp"
+#include "profiler.hpp"
 #include "human_time.hpp"
 
 #include "gl-camera.hpp"
-#include "gl-async-gpu-timer.hpp"
+#include "gl-gpu-profiler.hpp"
 #include "gl-procedural-sky.hpp"
 
 #include "scene.hpp"
 #include "bloom_pass.hpp"
 #include "shadow_pass.hpp"
+#include "visibility.hpp"
+#include "clustered_lighting.hpp"
 
 using namespace avl;
 
@@ -28,6 +30,8 @@ struct renderer_settings
     bool useDepthPrepass = false;
     bool bloomEnabled = true;
     bool shadowsEnabled = true;
+    bool singlePassStereo = true;  // with two cameras, draw both eyes with one instanced call per object
+    int maxLights = 4096;          // point + spot lights considered by clustered shading per frame
 };
 
 struct view_data
@@ -56,58 +60,30 @@ struct scene_data
     ProceduralSky * skybox{ nullptr };
     std::vector<Renderable *> renderSet;
     std::vector<uniforms::point_light> pointLights;
+    std::vector<uniforms::spot_light> spotLights;
     uniforms::directional_light sunlight;
     std::vector<view_data> views;
 };
 
-template<typename T>
-struct profiler
-{
-    struct data_point
-    {
-        CircularBuffer<double> average{ 30 };
-        T timer;
-    };
-
-    std::unordered_map<std::string, data_point> dataPoints;
-
-    bool enabled{ true };
-
-    profiler() { }
-
-    void set_enabled(bool newState) 
-    { 
-        enabled = newState;
-        dataPoints.clear();
-    }
-
-    void begin(const std::string & id)
-    { 
-        if (!enabled) return;
-        dataPoints[id].timer.start();
-    }
-
-    void end(const std::string & id) 
-    { 
-        if (!enabled) return;
-        dataPoints[id].timer.stop();
-        const double t = dataPoints[id].timer.elapsed_ms();
-        if (t > 0.0) dataPoints[id].average.put(t);
-    }
-};
-
 class forward_renderer
 {
     SimpleTimer timer;
 
-    GlBuffer perScene;
-    GlBuffer perView;
-    GlBuffer perObject;
+    // Per-scene, per-view and per-object blocks plus the light clusters, rewritten every frame
+    GlStreamingBuffer frameData;
 
     // MSAA 
     GlRenderbuffer multisampleRenderbuffers[2];
     GlFramebuffer multisampleFramebuffer;
 
+    // Side-by-side targets for single-pass stereo (2 * renderSize.x wide): MSAA, then resolved before the per-eye copy
+    GlRenderbuffer stereoMultisampleRenderbuffers[2];
+    GlFramebuffer stereoMultisampleFramebuffer;
+    GlTexture2D stereoResolveTexture;
+    GlTexture2D stereoResolveDepthTexture;
+    GlFramebuffer stereoResolveFramebuffer;
+    bool stereoTargetsReady{ false };
+
     // Non-MSAA Targets
     std::vector<GlFramebuffer> eyeFramebuffers;
     std::vector<GlTexture2D> eyeTextures;
@@ -118,29 +94,52 @@ class forward_renderer
 
     GlShaderHandle earlyZPass = { "depth-prepass" };
 
+    // Culled against the (stereo super-) frustum once per frame and shared by every eye
+    visibility_stage visibility;
+    std::vector<visible_renderable> materialRenderList;
+    std::vector<visible_renderable> defaultRenderList;
+
+    // Single-pass stereo split of materialRenderList: instanced draws, and objects that must be drawn per eye
+    std::vector<visible_renderable> stereoInstancedList;
+    std::vector<visible_renderable> stereoPerEyeList;
+
+    // Froxel light lists fitted to the culling view, shared by every eye
+    clustered_lighting lightClusters;
+
     // Update per-object uniform buffer
     void update_per_object_uniform_buffer(Renderable * top, const view_data & d);
 
-    void run_depth_prepass(const view_data & view, const scene_data & scene);
+    void upload_per_view(const view_data & view);
+    void upload_per_view_stereo(const view_data & left, const view_data & right);
+    void create_stereo_targets();
+
+    void run_depth_prepass(const std::vector<visible_renderable> & renderQueueMaterial, const std::vector<visible_renderable> & renderQueueDefault, const view_data & view, const int instances = 0);
     void run_skybox_pass(const view_data & view, const scene_data & scene);
     void run_shadow_pass(const view_data & view, const scene_data & scene);
-    void run_forward_pass(std::vector<Renderable *> & renderQueueMaterial, std::vector<Renderable *> & renderQueueDefault, const view_data & view, const scene_data & scene);
+    void run_forward_pass(const std::vector<visible_renderable> & renderQueueMaterial, const std::vector<visible_renderable> & renderQueueDefault, const view_data & view, const scene_data & scene, const int instances = 0);
     void run_post_pass(const view_data & view, const scene_data & scene);
 
+    void render_views_multipass(const scene_data & scene);
+    void render_views_single_pass_stereo(const scene_data & scene);
+
 public:
 
     renderer_settings settings;
-    profiler<SimpleTimer> cpuProfiler;
-    profiler<GlGpuTimer> gpuProfiler;
+    GlGpuProfiler gpuProfiler; // CPU scopes record into Profiler::get()
 
     forward_renderer(const renderer_settings & settings);
     ~forward_renderer();
 
     void render_frame(const scene_data & scene);
 
+    // Number of renderables that passed culling in the last frame
+    size_t get_visible_count() const { return materialRenderList.size() + defaultRenderList.size(); }
+
     uint32_t get_color_texture(const uint32_t idx) const;
     uint32_t get_depth_texture(const uint32_t idx) const;
 
+    const clustered_lighting & get_light_clusters() const { return lightClusters; }
+
     StableCascadedShadowPass & get_shadow_pass() const;
     BloomPass & get_bloom_pass() const;
 };
@@ -154,6 +153,8 @@ template<class F> void visit_fields(forward_renderer & o, F f)
     f("depth_prepass", o.settings.useDepthPrepass);
     f("bloom_pass", o.settings.bloomEnabled);
     f("shadow_pass", o.settings.shadowsEnabled);
+    f("single_pass_stereo", o.settings.singlePassStereo);
+    f("max_lights", o.settings.maxLights, range_metadata<int>{ 0, 65536 });
 };
 
 #endif // end vr_renderer_hpp
@@ -16,12 +16,17 @@ namespace avl
         virtual void update_uniforms() {}
         virtual void use() {}
         uint32_t id() const { return program.get().handle(); }
+
+        // True when the program picks the eye from gl_InstanceID (see renderer_common.glsl), so single-pass stereo
+        // can draw both eyes with one instanced call
+        virtual bool supports_instanced_stereo() const { return false; }
     };
 
     struct DefaultMaterial final : public Material
     {
         DefaultMaterial() { program = { "default-shader" }; }
         void use() override { program.get().bind(); }
+        bool supports_instanced_stereo() const override { return true; } // forward_lighting_vert.glsl
     };
 
     class MetallicRoughnessMaterial final : public Material
@@ -34,6 +39,7 @@ namespace avl
         void update_cascaded_shadow_array_handle(GLuint handle);
         void update_uniforms() override;
         void use() override;
+        bool supports_instanced_stereo() const override { return true; } // forward_lighting_vert.glsl
 
         float3 baseAlbedo{ float3(1, 1, 1) };
         float opacity{ 1.f };
@@ -7,6 +7,8 @@
 #include "gl-mesh.hpp"
 #include "gl-camera.hpp"
 
+#include <atomic>
+
 #include "uniforms.hpp"
 #include "assets.hpp"
 #include "material.hpp"
@@ -64,6 +66,7 @@ struct Renderable : public GameObject
 
         else return nullptr; 
     }
+    const Material * get_material() const { return mat.assigned() ? mat.get().get() : nullptr; }
     void set_material(AssetHandle<std::shared_ptr<Material>> handle) { mat = handle; }
 
     void set_receive_shadow(const bool value) { receive_shadow = value; }
@@ -72,7 +75,25 @@ struct Renderable : public GameObject
     void set_cast_shadow(const bool value) { cast_shadow = value; }
     bool get_cast_shadow() const { return cast_shadow; }
 
+    // Changes whenever the world bounds may have (pose, scale or local bounds), so culling can cache them. Versions
+    // come from one global counter, so a recycled address never matches a stale cache entry. Code that writes those
+    // fields directly instead of through the setters (e.g. the inspector) must call invalidate_bounds().
+    uint32_t get_bounds_version() const { return boundsVersion; }
+    void invalidate_bounds() { boundsVersion = next_bounds_version(); }
+
     virtual void draw() const {};
+
+    // Single-pass stereo issues one draw with `instances` copies; renderables that can't are drawn once per eye instead
+    virtual bool supports_instanced_draw() const { return false; }
+    virtual void draw_instanced(const int instances) const {};
+
+    // Depth prepass and shadow maps only need positions; meshes with a position stream fetch nothing else
+    virtual void draw_depth(const int instances) const { if (instances) draw_instanced(instances); else draw(); }
+
+private:
+
+    static uint32_t next_bounds_version() { static std::atomic<uint32_t> counter{ 0 }; return ++counter; }
+    uint32_t boundsVersion{ next_bounds_version() };
 };
 
 struct PointLight final : public Renderable
@@ -87,7 +108,7 @@ struct PointLight final : public Renderable
     }
 
     Pose get_pose() const override { return Pose(float4(0, 0, 0, 1), data.position); }
-    void set_pose(const Pose & p) override { data.position = p.position; }
+    void set_pose(const Pose & p) override { data.position = p.position; invalidate_bounds(); }
     Bounds3D get_bounds() const override { return Bounds3D(float3(-0.5f), float3(0.5f)); }
     float3 get_scale() const override { return float3(1, 1, 1); }
     void set_scale(const float3 & s) override { /* no-op */ }
@@ -133,6 +154,7 @@ struct DirectionalLight final : public Renderable
     void set_pose(const Pose & p) override
     {
         data.direction = qydir(p.orientation);
+        invalidate_bounds();
     }
 
     Bounds3D get_bounds() const override { return Bounds3D(float3(-0.5f), float3(0.5f)); }
@@ -168,16 +190,38 @@ struct StaticMesh final : public Renderable
     StaticMesh() { }
 
     Pose get_pose() const override { return pose; }
-    void set_pose(const Pose & p) override { pose = p; }
+    void set_pose(const Pose & p) override { pose = p; invalidate_bounds(); }
     Bounds3D get_bounds() const override { return bounds; }
+    void set_bounds(const Bounds3D & b) { bounds = b; invalidate_bounds(); }
     float3 get_scale() const override { return scale; }
-    void set_scale(const float3 & s) override { scale = s; }
+
+    // Local bounds are derived from the geometry asset. Call after assigning `geom` or (re)loading its asset; until
+    // the asset exists the bounds stay empty and the mesh is never culled.
+    void update_bounds() { set_bounds(GeometryHandle::contains(geom.name) ? compute_bounds(geom.get()) : Bounds3D()); }
+    void set_scale(const float3 & s) override { scale = s; invalidate_bounds(); }
 
     void draw() const override
     {
         mesh.get().draw_elements();
     }
 
+    // The mesh can always be instanced, but only a stereo-aware program places the copies in each eye
+    bool supports_instanced_draw() const override
+    {
+        const Material * m = get_material();
+        return m && m->supports_instanced_stereo();
+    }
+
+    void draw_instanced(const int instances) const override
+    {
+        mesh.get().draw_elements(instances);
+    }
+
+    void draw_depth(const int instances) const override
+    {
+        mesh.get().draw_positions(instances);
+    }
+
     void update(const float & dt) override { }
 
     Bounds3D get_world_bounds() const override
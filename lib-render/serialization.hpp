@@ -230,6 +230,9 @@ namespace cereal
         archive(cereal::make_nvp("renderable", cereal::base_class<Renderable>(&m)));
         archive(cereal::make_nvp("game_object", cereal::base_class<GameObject>(&m)));
         visit_fields(m, [&archive](const char * name, auto & field, auto... metadata) { archive(cereal::make_nvp(name, field)); });
+
+        // Bounds are not stored but derived from the geometry, if it has already been loaded
+        if (std::is_base_of<cereal::detail::InputArchiveBase, Archive>::value) m.update_bounds();
     };
 
     template<class Archive> void serialize(Archive & archive, PointLight & m)
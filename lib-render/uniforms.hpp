@@ -12,7 +12,6 @@ using namespace avl;
 
 namespace uniforms
 {
-    static const int MAX_POINT_LIGHTS = 4;
     static const int NUM_CASCADES = 2;
 
     struct point_light
@@ -42,9 +41,8 @@ namespace uniforms
     {
         static const int      binding = 0;
         directional_light     directional_light;
-        point_light           point_lights[MAX_POINT_LIGHTS];
         float                 time;
-        int                   activePointLights;
+        int                   activeLights;
         ALIGNED(8)  float2    resolution;
         ALIGNED(8)  float2    invResolution;
         ALIGNED(16) float4    cascadesPlane[NUM_CASCADES];
@@ -59,6 +57,32 @@ namespace uniforms
         ALIGNED(16) float4x4  view;
         ALIGNED(16) float4x4  viewProj;
         ALIGNED(16) float4    eyePos;
+        ALIGNED(16) float4x4  stereoView[2];        // single-pass stereo: selected by gl_InstanceID & 1
+        ALIGNED(16) float4x4  stereoViewProj[2];
+        ALIGNED(16) float4    stereoEyePos[2];
+        ALIGNED(16) float4    stereoParams;         // x = 1 while instanced stereo draws are active
+    };
+
+    // Element of the clustered light buffer (std430)
+    struct clustered_light
+    {
+        float4                positionRange;        // w: distance at which the light's contribution reaches zero
+        float4                colorType;            // w: 0 = point, 1 = spot
+        float4                attenuation;          // point: x = source radius; spot: constant, linear, quadratic
+        float4                spotDirectionCutoff;  // w: cosine of the cone angle
+    };
+
+    // Froxel grid parameters; the lights, per-cell (offset, count) records and indices live in storage buffers
+    struct clustered_lighting
+    {
+        static const int      binding = 3;
+        static const int      lightBinding = 0;
+        static const int      cellBinding = 1;
+        static const int      indexBinding = 2;
+        ALIGNED(16) float4x4  view;                 // the culling view the grid was fitted to
+        ALIGNED(16) float4x4  viewProj;
+        ALIGNED(16) float4    depthParams;          // near, far, slice scale, slice bias (slice = log(depth) * z + w)
+        ALIGNED(16) int4      dims;                 // xyz: grid size, w: light count
     };
 
     struct per_object
@@ -0,0 +1,172 @@
+#pragma once
+
+#ifndef vr_visibility_hpp
+#define vr_visibility_hpp
+
+#include "math-core.hpp"
+#include "bounding_volume_kernels.hpp"
+#include "util.hpp"
+#include "job_system.hpp"
+#include "scene.hpp"
+
+using namespace avl;
+
+// A renderable that survived culling, with everything the sort and draw loops need precomputed
+struct visible_renderable
+{
+    Renderable * object;
+    Material * material;   // nullptr for objects that shade themselves in draw()
+    uint32_t materialId;
+    float viewDepth;       // distance along the culling view's forward axis
+};
+
+/*
+ * Caches world-space bounds for the render set in a BoxStream, tests them against a frustum with the batch
+ * kernels in bounding_volume_kernels.hpp, and emits a compact visible list. A slot's AABB is only recomputed when the
+ * renderable in it or that renderable's bounds version changes, so static objects cost one compare per frame. Both
+ * the refresh and the test run in chunks on the shared job system; chunk outputs are concatenated in order so results
+ * are deterministic.
+ */
+class visibility_stage
+{
+    constexpr static const size_t CHUNK_SIZE = 1024;
+    constexpr static const float UNBOUNDED_EXTENT = 1e30f;    // finite so that |n| * e never produces 0 * inf
+
+    BoxStream bounds; // world AABBs
+    std::vector<const Renderable *> cachedObjects;  // which renderable each slot of `bounds` was computed for
+    std::vector<uint32_t> cachedVersions;           // and at which bounds version
+    std::vector<std::vector<uint32_t>> chunkVisible;
+    std::vector<uint32_t> visibleIndices;
+
+    // Objects without meaningful bounds (controllers, meshes whose geometry has not loaded yet) are never culled
+    static bool has_bounds(const Bounds3D & b)
+    {
+        const float3 s = b.size();
+        return s.x > 0.f || s.y > 0.f || s.z > 0.f;
+    }
+
+    void refresh_bounds(const std::vector<Renderable *> & renderSet, size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const Renderable * r = renderSet[i];
+            const uint32_t version = r->get_bounds_version();
+            if (cachedObjects[i] == r && cachedVersions[i] == version) continue;
+            cachedObjects[i] = r;
+            cachedVersions[i] = version;
+
+            const Bounds3D local = r->get_bounds();
+
+            const Pose pose = r->get_pose();
+            if (!has_bounds(local))
+            {
+                bounds.set(i, pose.position, float3(UNBOUNDED_EXTENT));
+                continue;
+            }
+
+            // Conservative AABB of the scaled, rotated local box: |R| * halfExtents
+            const float3 scale = r->get_scale();
+            const float3 c = pose.transform_coord(local.center() * scale);
+            const float3 h = abs(local.size() * scale) * 0.5f;
+            const float3 ax = abs(pose.xdir()), ay = abs(pose.ydir()), az = abs(pose.zdir());
+            const float3 e = ax * h.x + ay * h.y + az * h.z;
+            bounds.set(i, c, e);
+        }
+    }
+
+public:
+
+    /*
+     * Culls `renderSet` against `viewProj` and fills `outMaterial` (sorted by material, then front to back) and
+     * `outDefault` (objects without a material, back to front as before).
+     */
+    void execute(const std::vector<Renderable *> & renderSet, const float4x4 & viewProj, const Pose & viewPose,
+        std::vector<visible_renderable> & outMaterial, std::vector<visible_renderable> & outDefault)
+    {
+        outMaterial.clear();
+        outDefault.clear();
+
+        const size_t count = renderSet.size();
+        bounds.resize(count);
+        cachedObjects.resize(count, nullptr);
+        cachedVersions.resize(count, 0);
+
+        const size_t numChunks = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        chunkVisible.resize(numChunks);
+
+        const TransposedFrustum frustum((Frustum(viewProj)));
+
+        get_shared_job_system().parallel_for(numChunks, 1, [&](size_t chunkBegin, size_t chunkEnd)
+        {
+            for (size_t c = chunkBegin; c < chunkEnd; ++c)
+            {
+                const size_t begin = c * CHUNK_SIZE, end = std::min(count, begin + CHUNK_SIZE);
+                refresh_bounds(renderSet, begin, end);
+                chunkVisible[c].clear();
+                frustum_cull_boxes(frustum, bounds, chunkVisible[c], begin, end);
+            }
+        });
+
+        visibleIndices.clear();
+        for (auto & v : chunkVisible) visibleIndices.insert(visibleIndices.end(), v.begin(), v.end());
+
+        // Material lookups go through the asset tables, so they stay on this thread and only touch visible objects
+        const float3 eye = viewPose.position;
+        const float3 forward = -viewPose.zdir();
+        for (const uint32_t i : visibleIndices)
+        {
+            Renderable * r = renderSet[i];
+            const float depth = dot(bounds.center(i) - eye, forward);
+            Material * mat = r->get_material();
+            if (mat) outMaterial.push_back({ r, mat, mat->id(), depth });
+            else outDefault.push_back({ r, nullptr, 0, depth });
+        }
+
+        // We follow the sorting strategy outlined here: http://realtimecollisiondetection.net/blog/?p=86
+        std::sort(outMaterial.begin(), outMaterial.end(), [](const visible_renderable & a, const visible_renderable & b)
+        {
+            if (a.materialId != b.materialId) return a.materialId < b.materialId; // expensive shader state change
+            return a.viewDepth < b.viewDepth;
+        });
+
+        std::sort(outDefault.begin(), outDefault.end(), [](const visible_renderable & a, const visible_renderable & b)
+        {
+            return a.viewDepth > b.viewDepth;
+        });
+    }
+
+    size_t get_tested_count() const { return bounds.size(); }
+};
+
+namespace visibility_tests
+{
+    using namespace avl;
+
+    // A mesh is culled by the bounds of its geometry: the box ahead of the view survives, the one behind it does not
+    inline bool execute()
+    {
+        Geometry box;
+        for (int i = 0; i < 8; ++i) box.vertices.push_back(float3(i & 1 ? 0.5f : -0.5f, i & 2 ? 0.5f : -0.5f, i & 4 ? 0.5f : -0.5f));
+        create_handle_for_asset("visibility-test-box", std::move(box));
+
+        StaticMesh ahead, behind;
+        for (StaticMesh * m : { &ahead, &behind })
+        {
+            m->geom = "visibility-test-box";
+            m->update_bounds();
+        }
+        ahead.set_pose(Pose(float4(0, 0, 0, 1), float3(0, 0, -5)));
+        behind.set_pose(Pose(float4(0, 0, 0, 1), float3(0, 0, 5)));
+
+        const Pose viewPose;
+        const float4x4 viewProj = mul(make_projection_matrix(to_radians(90.f), 1.f, 0.1f, 64.f), viewPose.view_matrix());
+        const std::vector<Renderable *> renderSet = { &ahead, &behind };
+
+        visibility_stage visibility;
+        std::vector<visible_renderable> withMaterial, withoutMaterial;
+        visibility.execute(renderSet, viewProj, viewPose, withMaterial, withoutMaterial);
+        return withMaterial.empty() && withoutMaterial.size() == 1 && withoutMaterial[0].object == &ahead;
+    }
+}
+
+#endif // end vr_visibility_hpp
@@ -11,13 +11,17 @@
 #define lru_cache_hpp
 
 #include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <functional>
 #include <list>
 #include <mutex>
+#include <shared_mutex>
 #include <stdexcept>
 #include <thread>
 #include <unordered_map>
-#include "util.hpp" // for avl:: Noncopyable
+#include <assert.h>
+#include "util.hpp" // for avl:: Noncopyable, make_aligned_unique
 
 // A no-op lockable concept that can be used in place of std::mutex
 struct null_lock_t 
@@ -170,4 +174,568 @@ public:
     
 };
 
+////////////////////////////////
+//   Sharded, budgeted cache   //
+////////////////////////////////
+
+enum class CacheEviction
+{
+    lru,    // every hit moves the entry to the front; hits take the shard's exclusive lock
+    clock   // hits only set a reference bit under a shared lock; eviction gives referenced entries a second chance
+};
+
+struct CacheStats
+{
+    uint64_t hits{ 0 }, misses{ 0 }, inserts{ 0 }, evictions{ 0 }, rejections{ 0 };
+    size_t entries{ 0 }, bytes{ 0 };
+    double hit_rate() const { return hits + misses ? double(hits) / double(hits + misses) : 0.0; }
+};
+
+/*
+ * A thread-safe cache for resources shared across loader threads (decoded textures, mesh LODs, terrain tiles), bounded
+ * by a byte budget rather than an entry count. Keys are spread over independently locked shards, each with its own
+ * budget (capacity / shard count). Nodes are intrusive (hash chain and recency ring live in the node) and come from a
+ * per-shard pool of fixed-size chunks, so a warmed-up cache inserts and evicts without touching the heap. Key and
+ * Value must be default constructible; a freed node is reset to Value() so that handles release promptly.
+ *
+ * The eviction callback receives entries pushed out by the budget (not explicit removals or replacements) and runs
+ * after the shard lock is released, so it may call back into the cache.
+ */
+template<class Key, class Value, class Hash = std::hash<Key>>
+class ShardedCache : public avl::Noncopyable
+{
+public:
+
+    typedef std::function<void(const Key & key, Value & value, size_t bytes)> eviction_callback;
+
+private:
+
+    enum : uint32_t { NONE = 0xffffffff, CHUNK_BITS = 8, CHUNK_SIZE = 1 << CHUNK_BITS };
+
+    struct Node
+    {
+        Key key;
+        Value value;
+        size_t bytes{ 0 };
+        size_t hash{ 0 };
+        uint32_t prev{ NONE }, next{ NONE };    // recency ring
+        uint32_t chain{ NONE };                 // hash bucket chain, or the free list
+        uint32_t self{ NONE };                  // this node's index, so pending nodes can be released directly
+        Node * pending{ nullptr };              // evicted nodes awaiting their callback
+        std::atomic<uint8_t> referenced{ 0 };
+    };
+
+    struct alignas(64) Shard
+    {
+        mutable std::mutex mutex;                       // lru: every access reorders the ring
+        mutable std::shared_timed_mutex sharedMutex;    // clock: hits only read the ring
+        std::vector<std::unique_ptr<Node[]>> chunks;
+        std::vector<uint32_t> buckets;
+        uint32_t freeList{ NONE };
+        uint32_t nodeCount{ 0 };
+        uint32_t head{ NONE };                  // most recent entry (lru), or the clock hand
+        size_t entries{ 0 }, bytes{ 0 }, budget{ 0 };
+        std::atomic<uint64_t> hits{ 0 }, misses{ 0 }, inserts{ 0 }, evictions{ 0 }, rejections{ 0 };
+
+        Node & node(const uint32_t i) { return chunks[i >> CHUNK_BITS][i & (CHUNK_SIZE - 1)]; }
+        const Node & node(const uint32_t i) const { return chunks[i >> CHUNK_BITS][i & (CHUNK_SIZE - 1)]; }
+        uint32_t & bucket(const size_t hash) { return buckets[hash & (buckets.size() - 1)]; }
+
+        uint32_t find(const Key & key, const size_t hash) const
+        {
+            if (buckets.empty()) return NONE;
+            for (uint32_t i = buckets[hash & (buckets.size() - 1)]; i != NONE; i = node(i).chain)
+            {
+                const Node & n = node(i);
+                if (n.hash == hash && n.key == key) return i;
+            }
+            return NONE;
+        }
+
+        uint32_t allocate()
+        {
+            if (freeList == NONE)
+            {
+                chunks.emplace_back(new Node[CHUNK_SIZE]);
+                for (uint32_t k = CHUNK_SIZE; k-- > 0;)
+                {
+                    node(nodeCount + k).self = nodeCount + k;
+                    node(nodeCount + k).chain = freeList;
+                    freeList = nodeCount + k;
+                }
+                nodeCount += CHUNK_SIZE;
+            }
+            const uint32_t i = freeList;
+            freeList = node(i).chain;
+            return i;
+        }
+
+        void release(const uint32_t i)
+        {
+            Node & n = node(i);
+            n.key = Key();
+            n.value = Value();
+            n.pending = nullptr;
+            n.chain = freeList;
+            freeList = i;
+        }
+
+        // Inserted just ahead of `head`: the front for lru, the last entry the clock hand reaches
+        void link(const uint32_t i, const CacheEviction policy)
+        {
+            // Rehash first: it walks the ring, which must not contain `i` yet
+            if (entries + 1 > buckets.size()) rehash(std::max<size_t>(16, buckets.size() * 2));
+
+            Node & n = node(i);
+            if (head == NONE) { n.prev = n.next = i; head = i; }
+            else
+            {
+                Node & h = node(head);
+                n.next = head;
+                n.prev = h.prev;
+                node(h.prev).next = i;
+                h.prev = i;
+                if (policy == CacheEviction::lru) head = i;
+            }
+
+            n.chain = bucket(n.hash);
+            bucket(n.hash) = i;
+            entries++;
+            bytes += n.bytes;
+        }
+
+        void unlink(const uint32_t i)
+        {
+            Node & n = node(i);
+            if (n.next == i) head = NONE;
+            else
+            {
+                node(n.prev).next = n.next;
+                node(n.next).prev = n.prev;
+                if (head == i) head = n.next;
+            }
+
+            uint32_t * link = &bucket(n.hash);
+            while (*link != i) link = &node(*link).chain;
+            *link = n.chain;
+            entries--;
+            bytes -= n.bytes;
+        }
+
+        // Moves a linked entry to the front of the ring without touching its hash chain
+        void touch(const uint32_t i)
+        {
+            if (head == i) return;
+            Node & n = node(i);
+            node(n.prev).next = n.next;
+            node(n.next).prev = n.prev;
+            Node & h = node(head);
+            n.next = head;
+            n.prev = h.prev;
+            node(h.prev).next = i;
+            h.prev = i;
+            head = i;
+        }
+
+        void rehash(const size_t count)
+        {
+            buckets.assign(count, NONE);
+            if (head == NONE) return;
+            uint32_t i = head;
+            do
+            {
+                Node & n = node(i);
+                n.chain = bucket(n.hash);
+                bucket(n.hash) = i;
+                i = n.next;
+            } while (i != head);
+        }
+
+        // The entry to give up next, never `keep`; NONE when nothing else is left
+        uint32_t victim(const CacheEviction policy, const uint32_t keep)
+        {
+            if (head == NONE) return NONE;
+            if (policy == CacheEviction::lru)
+            {
+                const uint32_t tail = node(head).prev;
+                return tail == keep ? (tail == head ? NONE : node(tail).prev) : tail;
+            }
+
+            // Two sweeps at most: the first clears every reference bit it passes
+            for (size_t step = 0; step < 2 * entries + 1; ++step)
+            {
+                Node & n = node(head);
+                const uint32_t candidate = head;
+                head = n.next;
+                if (candidate == keep) continue;
+                // Readers may set the bit concurrently; losing that race only costs the entry its second chance
+                if (!n.referenced.load(std::memory_order_relaxed)) return candidate;
+                n.referenced.store(0, std::memory_order_relaxed);
+            }
+            return NONE;
+        }
+    };
+
+    std::vector<avl::aligned_unique_ptr<Shard>> shards;
+    size_t shardMask;
+    size_t capacity;
+    CacheEviction policy;
+    eviction_callback onEviction;
+    Hash hasher;
+
+    size_t hash_of(const Key & key) const
+    {
+        // Spread weak hashes (std::hash<int> is the identity) before taking shard and bucket bits from both ends
+        uint64_t h = static_cast<uint64_t>(hasher(key)) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+
+    // Counters written under an exclusive lock need no read-modify-write
+    static void bump(std::atomic<uint64_t> & counter) { counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+
+    // Locks whichever mutex the policy uses; shared access is only ever shared under the clock policy
+    class shard_guard
+    {
+        const Shard & s;
+        const bool clock, shared;
+    public:
+        shard_guard(const Shard & s, const CacheEviction policy, const bool shared = false) : s(s), clock(policy == CacheEviction::clock), shared(shared && clock)
+        {
+            if (!clock) s.mutex.lock();
+            else if (shared) s.sharedMutex.lock_shared();
+            else s.sharedMutex.lock();
+        }
+        ~shard_guard()
+        {
+            if (!clock) s.mutex.unlock();
+            else if (shared) s.sharedMutex.unlock_shared();
+            else s.sharedMutex.unlock();
+        }
+    };
+
+    Shard & shard_of(const size_t hash) const { return *shards[(hash >> 24) & shardMask]; }
+
+    // Evicts until `incoming` more bytes fit; the evicted nodes are chained for finish_evictions()
+    Node * make_room(Shard & s, const size_t incoming, const uint32_t keep)
+    {
+        Node * pending = nullptr, ** tail = &pending;
+        while (s.bytes + incoming > s.budget)
+        {
+            const uint32_t i = s.victim(policy, keep);
+            if (i == NONE) break;
+            s.unlink(i);
+            bump(s.evictions);
+            if (!onEviction) { s.release(i); continue; }
+            *tail = &s.node(i);
+            tail = &s.node(i).pending;
+        }
+        return pending;
+    }
+
+    void finish_evictions(Shard & s, Node * pending)
+    {
+        if (!pending) return;
+        for (Node * n = pending; n; n = n->pending) onEviction(n->key, n->value, n->bytes);
+
+        shard_guard g(s, policy);
+        for (Node * n = pending; n;)
+        {
+            Node * following = n->pending;
+            s.release(n->self);
+            n = following;
+        }
+    }
+
+public:
+
+    // The shard count is rounded up to a power of two; every shard gets an equal slice of capacityBytes
+    explicit ShardedCache(const size_t capacityBytes, const size_t shardCount = 16, const CacheEviction policy = CacheEviction::lru)
+        : capacity(capacityBytes), policy(policy)
+    {
+        size_t count = 1;
+        while (count < shardCount) count *= 2;
+        shardMask = count - 1;
+        for (size_t i = 0; i < count; ++i)
+        {
+            shards.push_back(avl::make_aligned_unique<Shard>());
+            shards[i]->budget = capacityBytes / count;
+        }
+    }
+
+    // Set before the cache is shared between threads
+    void set_eviction_callback(eviction_callback callback) { onEviction = std::move(callback); }
+
+    // Inserts or replaces. Returns false (and caches nothing) when the entry alone exceeds a shard's budget.
+    bool insert(const Key & key, Value value, const size_t bytes = 1)
+    {
+        const size_t hash = hash_of(key);
+        Shard & s = shard_of(hash);
+        Node * pending = nullptr;
+        {
+            shard_guard g(s, policy);
+            if (bytes > s.budget)
+            {
+                bump(s.rejections);
+                return false;
+            }
+
+            uint32_t i = s.find(key, hash);
+            if (i != NONE)
+            {
+                // Replace in place, then move to the front as if it were a hit
+                Node & n = s.node(i);
+                n.value = std::move(value);
+                s.bytes = s.bytes - n.bytes + bytes;
+                n.bytes = bytes;
+                n.referenced.store(1, std::memory_order_relaxed);
+                if (policy == CacheEviction::lru) s.touch(i);
+                pending = make_room(s, 0, i);
+            }
+            else
+            {
+                pending = make_room(s, bytes, NONE);
+                i = s.allocate();
+                Node & n = s.node(i);
+                n.key = key;
+                n.value = std::move(value);
+                n.bytes = bytes;
+                n.hash = hash;
+                n.referenced.store(1, std::memory_order_relaxed);
+                s.link(i, policy);
+            }
+            bump(s.inserts);
+        }
+        finish_evictions(s, pending);
+        return true;
+    }
+
+    bool try_get(const Key & key, Value & value)
+    {
+        const size_t hash = hash_of(key);
+        Shard & s = shard_of(hash);
+
+        if (policy == CacheEviction::clock)
+        {
+            shard_guard g(s, policy, true);
+            const uint32_t i = s.find(key, hash);
+            if (i == NONE) { s.misses.fetch_add(1, std::memory_order_relaxed); return false; }
+            Node & n = s.node(i);
+            if (!n.referenced.load(std::memory_order_relaxed)) n.referenced.store(1, std::memory_order_relaxed);
+            value = n.value;
+            s.hits.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        shard_guard g(s, policy);
+        const uint32_t i = s.find(key, hash);
+        if (i == NONE) { bump(s.misses); return false; }
+        s.touch(i);
+        value = s.node(i).value;
+        bump(s.hits);
+        return true;
+    }
+
+    // Does not count as a use
+    bool contains(const Key & key) const
+    {
+        const size_t hash = hash_of(key);
+        Shard & s = shard_of(hash);
+        shard_guard g(s, policy, true);
+        return s.find(key, hash) != NONE;
+    }
+
+    bool remove(const Key & key)
+    {
+        const size_t hash = hash_of(key);
+        Shard & s = shard_of(hash);
+        shard_guard g(s, policy);
+        const uint32_t i = s.find(key, hash);
+        if (i == NONE) return false;
+        s.unlink(i);
+        s.release(i);
+        return true;
+    }
+
+    // Drops every entry without invoking the eviction callback; pooled nodes are kept for reuse
+    void clear()
+    {
+        for (size_t k = 0; k <= shardMask; ++k)
+        {
+            Shard & s = *shards[k];
+            shard_guard g(s, policy);
+            while (s.head != NONE)
+            {
+                const uint32_t i = s.head;
+                s.unlink(i);
+                s.release(i);
+            }
+        }
+    }
+
+    CacheStats stats() const
+    {
+        CacheStats r;
+        for (size_t k = 0; k <= shardMask; ++k)
+        {
+            const Shard & s = *shards[k];
+            r.hits += s.hits.load(std::memory_order_relaxed);
+            r.misses += s.misses.load(std::memory_order_relaxed);
+            r.inserts += s.inserts.load(std::memory_order_relaxed);
+            r.evictions += s.evictions.load(std::memory_order_relaxed);
+            r.rejections += s.rejections.load(std::memory_order_relaxed);
+            shard_guard g(s, policy, true);
+            r.entries += s.entries;
+            r.bytes += s.bytes;
+        }
+        return r;
+    }
+
+    void reset_stats()
+    {
+        for (size_t k = 0; k <= shardMask; ++k)
+        {
+            Shard & s = *shards[k];
+            for (auto * counter : { &s.hits, &s.misses, &s.inserts, &s.evictions, &s.rejections }) counter->store(0);
+        }
+    }
+
+    size_t size() const { return stats().entries; }
+    size_t size_bytes() const { return stats().bytes; }
+    size_t get_capacity() const { return capacity; }
+    size_t get_shard_count() const { return shardMask + 1; }
+    CacheEviction get_policy() const { return policy; }
+};
+
+namespace lru_cache_tests
+{
+    inline void execute()
+    {
+        // Least recently used goes first, by bytes
+        {
+            ShardedCache<int, int> cache(100, 1);
+            std::vector<int> evicted;
+            cache.set_eviction_callback([&](const int & k, int & v, size_t) { assert(v == k * 10); evicted.push_back(k); });
+            for (int k = 0; k < 4; ++k) assert(cache.insert(k, k * 10, 25));
+            int v;
+            assert(cache.try_get(0, v) && v == 0);
+            assert(cache.insert(4, 40, 30));                // evicts 1 and 2 (the oldest), not 0
+            assert(evicted.size() == 2 && evicted[0] == 1 && evicted[1] == 2);
+            assert(cache.contains(0) && cache.contains(3) && cache.contains(4) && !cache.contains(1));
+            assert(cache.size_bytes() == 80 && cache.size() == 3);
+
+            assert(!cache.insert(5, 50, 101));              // larger than the budget
+            assert(cache.insert(3, 33, 60));                // replacing grows 3 to 115 bytes in total and evicts 0
+            assert(cache.try_get(3, v) && v == 33 && !cache.contains(0) && cache.size() == 2 && cache.size_bytes() == 90);
+            assert(cache.insert(3, 34, 100));               // only 4 is left to evict, never 3 itself
+            assert(cache.size() == 1 && cache.size_bytes() == 100);
+            assert(cache.remove(3) && !cache.remove(3) && cache.size() == 0);
+
+            const CacheStats s = cache.stats();
+            assert(s.rejections == 1 && s.evictions == 4 && s.hits == 2 && s.misses == 0 && s.inserts == 7);
+        }
+
+        // Clock gives referenced entries a second chance
+        {
+            ShardedCache<int, int> cache(3, 1, CacheEviction::clock);
+            for (int k = 0; k < 3; ++k) cache.insert(k, k);
+            cache.insert(3, 3);                             // every bit set: one full sweep, then the hand takes 0
+            int v;
+            assert(!cache.contains(0));
+            assert(cache.try_get(1, v));
+            cache.insert(4, 4);                             // 1 was referenced again, so 2 goes
+            assert(cache.contains(1) && !cache.contains(2) && cache.contains(3) && cache.contains(4));
+        }
+
+        // Callbacks may re-enter the cache, and nodes are recycled
+        {
+            ShardedCache<int, std::shared_ptr<int>> cache(8, 1);
+            std::shared_ptr<int> handle = std::make_shared<int>(7);
+            cache.set_eviction_callback([&](const int & k, std::shared_ptr<int> &, size_t) { assert(!cache.contains(k)); });
+            for (int k = 0; k < 1000; ++k) cache.insert(k, handle);
+            assert(handle.use_count() == 9);                // freed nodes drop their handle
+            cache.clear();
+            assert(handle.use_count() == 1 && cache.size() == 0);
+        }
+
+        // Concurrent readers and writers keep values paired with keys and stay within budget
+        for (CacheEviction policy : { CacheEviction::lru, CacheEviction::clock })
+        {
+            ShardedCache<uint32_t, uint64_t> cache(4096, 8, policy);
+            std::vector<std::thread> threads;
+            for (uint32_t t = 0; t < 4; ++t)
+            {
+                threads.emplace_back([&cache, t]()
+                {
+                    std::mt19937 gen(t);
+                    for (int i = 0; i < 100000; ++i)
+                    {
+                        const uint32_t key = gen() % 8192;
+                        uint64_t value;
+                        if (cache.try_get(key, value)) assert(value == uint64_t(key) * 3);
+                        else cache.insert(key, uint64_t(key) * 3, 1 + key % 7);
+                        if (i % 997 == 0) cache.remove(key);
+                    }
+                });
+            }
+            for (auto & t : threads) t.join();
+            assert(cache.size_bytes() <= 4096);
+        }
+    }
+
+    // Multithreaded lookups with a skewed key distribution: on a miss the "loader" inserts the value it would have built
+    template<class Cache, class Lookup, class Insert>
+    inline void run_benchmark(const std::string & name, Cache & cache, Lookup lookup, Insert insert, const int threadCount, const int operations)
+    {
+        std::vector<std::thread> threads;
+        std::atomic<uint64_t> hits{ 0 };
+        const auto t0 = std::chrono::high_resolution_clock::now();
+        for (int t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back([&, t]()
+            {
+                std::mt19937 gen(t + 1);
+                std::uniform_real_distribution<float> unit(0.f, 1.f);
+                uint64_t localHits = 0;
+                for (int i = 0; i < operations; ++i)
+                {
+                    const float u = unit(gen);
+                    const uint32_t key = static_cast<uint32_t>(u * u * u * 16384.f);
+                    if (lookup(cache, key)) localHits++;
+                    else insert(cache, key);
+                }
+                hits += localHits;
+            });
+        }
+        for (auto & t : threads) t.join();
+        const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t0).count();
+        const double total = double(threadCount) * operations;
+        std::cout << name << " x" << threadCount << ": " << total / seconds / 1e6 << " Mops/s, hit rate " << double(hits) / total << std::endl;
+    }
+
+    inline void benchmark(const int operations = 1 << 20)
+    {
+        const size_t capacity = 8192;
+        typedef std::shared_ptr<const std::vector<uint8_t>> Resource;
+        std::vector<Resource> resources(65536);
+        for (auto & r : resources) r = std::make_shared<const std::vector<uint8_t>>(64);
+
+        for (int threadCount : { 1, 2, 4, 8 })
+        {
+            {
+                LeastRecentlyUsedCache<uint32_t, Resource, std::mutex> cache(capacity, 0);
+                run_benchmark("LeastRecentlyUsedCache<std::mutex>", cache,
+                    [](decltype(cache) & c, uint32_t k) { Resource r; return c.try_get(k, r); },
+                    [&](decltype(cache) & c, uint32_t k) { c.insert(k, resources[k]); }, threadCount, operations);
+            }
+            for (CacheEviction policy : { CacheEviction::lru, CacheEviction::clock })
+            {
+                ShardedCache<uint32_t, Resource> cache(capacity, 16, policy);
+                run_benchmark(policy == CacheEviction::lru ? "ShardedCache<lru>" : "ShardedCache<clock>", cache,
+                    [](decltype(cache) & c, uint32_t k) { Resource r; return c.try_get(k, r); },
+                    [&](decltype(cache) & c, uint32_t k) { c.insert(k, resources[k]); }, threadCount, operations);
+            }
+        }
+    }
+}
+
 #endif // end lru_cache_hpp
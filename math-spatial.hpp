@@ -378,6 +378,12 @@ namespace avl
         return ret;
     }
 
+    // Blends position linearly and orientation along the shorter arc; t = 0 gives a, t = 1 gives b
+    inline Pose interpolate(const Pose & a, const Pose & b, const float t)
+    {
+        return Pose(qnlerp(a.orientation, b.orientation, t), lerp(a.position, b.position, t));
+    }
+
     inline Pose look_at_pose_rh(float3 eyePoint, float3 target, float3 worldUp = { 0,1,0 })
     {
         Pose p;
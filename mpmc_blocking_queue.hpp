@@ -7,12 +7,15 @@
 #include <mutex>
 #include <queue>
 #include <condition_variable>
+#include <thread>
+#include "mpmc_bounded_queue.hpp"
+#include "futex.hpp"
 
 template<typename T>
 class MPMCBlockingQueue
 {
     std::queue<T> queue;
-    std::mutex mutex;
+    mutable std::mutex mutex;
     std::condition_variable condition;
 
     MPMCBlockingQueue(const MPMCBlockingQueue &) = delete;
@@ -20,6 +23,8 @@ class MPMCBlockingQueue
 
 public:
 
+    MPMCBlockingQueue() = default;
+
     // Produce a new value and possibily notify one of the threads calling `wait_and_consume`
     void produce(T const & value)
     {
@@ -47,14 +52,161 @@ public:
         return true;
     }
 
+    // Pushes the batch under a single lock acquisition
+    void produce_bulk(const T * values, std::size_t count)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (std::size_t i = 0; i < count; ++i) queue.push(values[i]);
+        }
+        if (count == 1) condition.notify_one();
+        else if (count > 1) condition.notify_all();
+    }
+
+    // Non-blocking; returns the number of values popped
+    std::size_t try_consume_bulk(T * values, std::size_t maxCount)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::size_t count = 0;
+        while (count < maxCount && !queue.empty())
+        {
+            values[count++] = queue.front();
+            queue.pop();
+        }
+        return count;
+    }
+
     bool empty() const
     {
         std::unique_lock<std::mutex> lock(mutex);
         return queue.empty();
     }
         
-    std::size_t size() const { return queue.size(); }
+    std::size_t size() const
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        return queue.size();
+    }
     
 };
 
+// Same interface as MPMCBlockingQueue, but bounded and lock-free on the fast path: items live in an MPMCBoundedQueue
+// and threads only park (on a futex word) after a short spin finds the queue empty/full. Producers block when full.
+template<typename T>
+class MPMCFutexQueue
+{
+    static const int SPIN_COUNT = 128;
+    typedef char cache_line_pad_t[64];
+
+    MPMCBoundedQueue<T> queue;
+
+    // Wait words are bumped on every state change that a sleeper might be waiting for
+    cache_line_pad_t pad0;
+    std::atomic<uint32_t> itemsEpoch{ 0 };
+    std::atomic<uint32_t> sleepingConsumers{ 0 };
+    cache_line_pad_t pad1;
+    std::atomic<uint32_t> spaceEpoch{ 0 };
+    std::atomic<uint32_t> sleepingProducers{ 0 };
+    cache_line_pad_t pad2;
+    std::atomic<intptr_t> count{ 0 }; // may dip below zero briefly when a consumer beats the producer's increment
+
+    MPMCFutexQueue(const MPMCFutexQueue &) = delete;
+    MPMCFutexQueue & operator= (const MPMCFutexQueue &) = delete;
+
+    void notify(std::atomic<uint32_t> & epoch, std::atomic<uint32_t> & sleepers, bool all)
+    {
+        // Pairs with the increment of `sleepers` before a waiter re-checks the queue (Dekker-style handshake)
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) == 0) return;
+        epoch.fetch_add(1, std::memory_order_release);
+        if (all) avl::futex_wake_all(epoch);
+        else avl::futex_wake_one(epoch);
+    }
+
+    template<typename F>
+    void wait_until(F && attempt, std::atomic<uint32_t> & epoch, std::atomic<uint32_t> & sleepers)
+    {
+        for (int i = 0; i < SPIN_COUNT; ++i)
+        {
+            if (attempt()) return;
+            if (i > SPIN_COUNT / 2) std::this_thread::yield();
+        }
+
+        while (true)
+        {
+            const uint32_t observed = epoch.load(std::memory_order_acquire);
+            sleepers.fetch_add(1, std::memory_order_seq_cst);
+            if (attempt())
+            {
+                sleepers.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+            avl::futex_wait(epoch, observed);
+            sleepers.fetch_sub(1, std::memory_order_relaxed);
+            if (attempt()) return;
+        }
+    }
+
+public:
+
+    MPMCFutexQueue(size_t capacity = 1024) : queue(capacity) {}
+
+    // Blocks while the queue is full
+    void produce(T const & value)
+    {
+        wait_until([&]() { return try_produce(value); }, spaceEpoch, sleepingProducers);
+    }
+
+    bool try_produce(T const & value)
+    {
+        if (!queue.mp_produce(value)) return false;
+        count.fetch_add(1, std::memory_order_relaxed);
+        notify(itemsEpoch, sleepingConsumers, false);
+        return true;
+    }
+
+    // Blocks while the queue is empty
+    void wait_and_consume(T & popped_value)
+    {
+        wait_until([&]() { return try_consume(popped_value); }, itemsEpoch, sleepingConsumers);
+    }
+
+    bool try_consume(T & popped_value)
+    {
+        if (!queue.consume(popped_value)) return false;
+        count.fetch_sub(1, std::memory_order_relaxed);
+        notify(spaceEpoch, sleepingProducers, false);
+        return true;
+    }
+
+    // Blocks until every value has been enqueued; wakes all sleeping consumers at most once per chunk
+    void produce_bulk(const T * values, std::size_t total)
+    {
+        std::size_t written = 0;
+        while (written < total)
+        {
+            std::size_t n = 0;
+            wait_until([&]() { return (n = queue.mp_produce_bulk(values + written, total - written)) != 0; }, spaceEpoch, sleepingProducers);
+            written += n;
+            count.fetch_add((intptr_t) n, std::memory_order_relaxed);
+            notify(itemsEpoch, sleepingConsumers, n > 1);
+        }
+    }
+
+    std::size_t try_consume_bulk(T * values, std::size_t maxCount)
+    {
+        const std::size_t n = queue.consume_bulk(values, maxCount);
+        if (n)
+        {
+            count.fetch_sub((intptr_t) n, std::memory_order_relaxed);
+            notify(spaceEpoch, sleepingProducers, n > 1);
+        }
+        return n;
+    }
+
+    // Approximate under concurrent modification
+    bool empty() const { return count.load(std::memory_order_relaxed) <= 0; }
+    std::size_t size() const { const intptr_t c = count.load(std::memory_order_relaxed); return c > 0 ? (std::size_t) c : 0; }
+};
+
 #endif // end mpmc_blocking_queue_hpp
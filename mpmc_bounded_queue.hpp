@@ -8,6 +8,7 @@
 #include <assert.h>
 #include <atomic>
 #include <stdint.h>
+#include <stddef.h>
 #include <vector>
 
 template<typename T>
@@ -41,20 +42,22 @@ public:
 
     ~MPMCBoundedQueue()
     {
-        delete[] buffer;
+        delete[] reinterpret_cast<aligned_node_t*>(buffer);
     }
     
+    // Only valid when a single thread ever produces; skips the CAS on head
     bool sp_produce(T const & input)
     {
+        const size_t headSequence = head.load(std::memory_order_relaxed);
         node_t * node = &buffer[headSequence & mask];
-        size_t nodeSequence = node->node.load(std::memory_order_acquire);
-        intptr_t diff = (intptr_t)nodeSequence - (intptr_t)headSequence;
+        size_t nodeSequence = node->next.load(std::memory_order_acquire);
+        intptr_t dif = (intptr_t)nodeSequence - (intptr_t)headSequence;
 
-        if (dif == 0) 
+        if (dif == 0)
         {
-            ++head;
+            head.store(headSequence + 1, std::memory_order_relaxed);
             node->data = input;
-            node->next.store(headSequence, std::memory_order_release);
+            node->next.store(headSequence + 1, std::memory_order_release);
             return true;
         }
 
@@ -124,6 +127,68 @@ public:
         return false;
     }
 
+    // Claims a run of free slots with a single CAS on head. Returns the number of items written (0 if full).
+    size_t mp_produce_bulk(const T * input, size_t count)
+    {
+        size_t headSequence = head.load(std::memory_order_relaxed);
+
+        while (count)
+        {
+            size_t n = 0;
+            while (n < count && n <= mask && buffer[(headSequence + n) & mask].next.load(std::memory_order_acquire) == headSequence + n) ++n;
+            if (n == 0)
+            {
+                const size_t current = head.load(std::memory_order_relaxed);
+                if (current == headSequence) return 0;
+                headSequence = current;
+                continue;
+            }
+
+            if (head.compare_exchange_weak(headSequence, headSequence + n, std::memory_order_relaxed))
+            {
+                for (size_t i = 0; i < n; ++i)
+                {
+                    node_t * node = &buffer[(headSequence + i) & mask];
+                    node->data = input[i];
+                    node->next.store(headSequence + i + 1, std::memory_order_release);
+                }
+                return n;
+            }
+        }
+        return 0;
+    }
+
+    // Claims a run of filled slots with a single CAS on tail. Returns the number of items read (0 if empty).
+    size_t consume_bulk(T * output, size_t maxCount)
+    {
+        size_t tailSequence = tail.load(std::memory_order_relaxed);
+
+        while (maxCount)
+        {
+            size_t n = 0;
+            while (n < maxCount && n <= mask && buffer[(tailSequence + n) & mask].next.load(std::memory_order_acquire) == tailSequence + n + 1) ++n;
+            if (n == 0)
+            {
+                const size_t current = tail.load(std::memory_order_relaxed);
+                if (current == tailSequence) return 0;
+                tailSequence = current;
+                continue;
+            }
+
+            if (tail.compare_exchange_weak(tailSequence, tailSequence + n, std::memory_order_relaxed))
+            {
+                for (size_t i = 0; i < n; ++i)
+                {
+                    node_t * node = &buffer[(tailSequence + i) & mask];
+                    output[i] = node->data;
+                    node->next.store(tailSequence + i + mask + 1, std::memory_order_release);
+                }
+                return n;
+            }
+        }
+        return 0;
+    }
+
 };
 
 #endif // end mpmc_bounded_queue_hpp
@@ -1,4 +1,6 @@
 // This is free and unencumbered software released into the public domain.
+// Based on http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+// Specialized for a single consumer: the consumer owns tail outright and never needs a CAS.
 
 #ifndef mpsc_bounded_queue_hpp
 #define mpsc_bounded_queue_hpp
@@ -6,61 +8,124 @@
 #include <assert.h>
 #include <atomic>
 #include <stdint.h>
+#include <stddef.h>
+#include <type_traits>
 
 template<typename T>
-class MPSCQueue
+class MPSCBoundedQueue
 {
 
-    struct buffer_node_t { T data; std::atomic<buffer_node_t*> next; };
-    typedef typename std::aligned_storage<sizeof(buffer_node_t), std::alignment_of<buffer_node_t>::value>::type buffer_node_aligned_t;
-    std::atomic<buffer_node_t*> head;
-    std::atomic<buffer_node_t*> tail;
-    MPSCQueue(const MPSCQueue &) {}
-    void operator= (const MPSCQueue &) {}
-    
+    struct node_t { T data; std::atomic<size_t> next; };
+    typedef typename std::aligned_storage<sizeof(node_t), std::alignment_of<node_t>::value>::type aligned_node_t;
+    typedef char cache_line_pad_t[64];
+
+    cache_line_pad_t pad0;
+    const size_t size;
+    const size_t mask;
+    node_t * const buffer;
+    cache_line_pad_t pad1;
+    std::atomic<size_t> head{ 0 };
+    cache_line_pad_t pad2;
+    size_t tail{ 0 };
+    cache_line_pad_t pad3;
+
+    MPSCBoundedQueue(const MPSCBoundedQueue &) {}
+    void operator= (const MPSCBoundedQueue &) {}
+
 public:
 
-    MPSCQueue() : head(reinterpret_cast<buffer_node_t*>(new buffer_node_aligned_t)), tail(head.load(std::memory_order_relaxed))
+    MPSCBoundedQueue(size_t size = 1024) : size(size), mask(size - 1), buffer(reinterpret_cast<node_t*>(new aligned_node_t[size]))
     {
-        buffer_node_t * front = head.load(std::memory_order_relaxed);
-        front->next.store(nullptr, std::memory_order_relaxed);
+        assert((size != 0) && ((size & (~size + 1)) == size)); // enforce power of 2
+        for (size_t i = 0; i < size; ++i) buffer[i].next.store(i, std::memory_order_relaxed);
     }
 
-    ~MPSCQueue()
+    ~MPSCBoundedQueue()
     {
-        T output;
-        while (this->consume(output)) {}
-        buffer_node_t* front = head.load(std::memory_order_relaxed);
-        delete front;
+        delete[] reinterpret_cast<aligned_node_t*>(buffer);
     }
 
     bool produce(const T & input)
     {
-        buffer_node_t* node = reinterpret_cast<buffer_node_t*>(new buffer_node_aligned_t);
-        node->data = input;
-        node->next.store(nullptr, std::memory_order_relaxed);
+        size_t headSequence = head.load(std::memory_order_relaxed);
 
-        buffer_node_t* prevhead = head.exchange(node, std::memory_order_acq_rel);
-        prevhead->next.store(node, std::memory_order_release);
-        return true;
+        while (true)
+        {
+            node_t * node = &buffer[headSequence & mask];
+            size_t nodeSequence = node->next.load(std::memory_order_acquire);
+            intptr_t dif = (intptr_t)nodeSequence - (intptr_t)headSequence;
+
+            if (dif == 0)
+            {
+                if (head.compare_exchange_weak(headSequence, headSequence + 1, std::memory_order_relaxed))
+                {
+                    node->data = input;
+                    node->next.store(headSequence + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (dif < 0)
+            {
+                return false; // full
+            }
+            else
+            {
+                headSequence = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Claims a run of free slots with one CAS. Returns the number of items written (0 if full).
+    size_t produce_bulk(const T * input, size_t count)
+    {
+        size_t headSequence = head.load(std::memory_order_relaxed);
+
+        while (count)
+        {
+            size_t n = 0;
+            while (n < count && n <= mask && buffer[(headSequence + n) & mask].next.load(std::memory_order_acquire) == headSequence + n) ++n;
+            if (n == 0)
+            {
+                const size_t current = head.load(std::memory_order_relaxed);
+                if (current == headSequence) return 0; // full
+                headSequence = current;
+                continue;
+            }
+
+            if (head.compare_exchange_weak(headSequence, headSequence + n, std::memory_order_relaxed))
+            {
+                for (size_t i = 0; i < n; ++i)
+                {
+                    node_t * node = &buffer[(headSequence + i) & mask];
+                    node->data = input[i];
+                    node->next.store(headSequence + i + 1, std::memory_order_release);
+                }
+                return n;
+            }
+        }
+        return 0;
     }
 
     bool consume(T & output)
     {
-        buffer_node_t * tail = tail.load(std::memory_order_relaxed);
-        buffer_node_t * next = tail->next.load(std::memory_order_acquire);
-        if (next == nullptr) return false;
-        output = next->data;
-        tail.store(next, std::memory_order_release);
-        delete tail;
+        node_t * node = &buffer[tail & mask];
+        if (node->next.load(std::memory_order_acquire) != tail + 1) return false;
+        output = node->data;
+        node->next.store(tail + mask + 1, std::memory_order_release);
+        ++tail;
         return true;
     }
 
-    bool available()
+    size_t consume_bulk(T * output, size_t maxCount)
+    {
+        size_t count = 0;
+        while (count < maxCount && consume(output[count])) ++count;
+        return count;
+    }
+
+    bool available() const
     {
-        buffer_node_t * tail = tail.load(std::memory_order_relaxed);
-        buffer_node_t * next = tail->next.load(std::memory_order_acquire);
-        return next != nullptr;
+        return buffer[tail & mask].next.load(std::memory_order_acquire) == tail + 1;
     }
 
 };
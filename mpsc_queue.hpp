@@ -6,15 +6,20 @@
 #include <assert.h>
 #include <atomic>
 #include <stdint.h>
+#include <stddef.h>
 
 template<typename T>
 class MPSCQueue
 {
     struct buffer_node_t { T data; std::atomic<buffer_node_t*> next; };
     typedef typename std::aligned_storage<sizeof(buffer_node_t), std::alignment_of<buffer_node_t>::value>::type buffer_node_aligned_t;
+    typedef char cache_line_pad_t[64];
 
+    // Producers hammer head while the consumer owns tail; keep them on separate lines
     std::atomic<buffer_node_t*> head;
+    cache_line_pad_t pad0;
     std::atomic<buffer_node_t*> tail;
+    cache_line_pad_t pad1;
 
     MPSCQueue(const MPSCQueue &) { }
     void operator= (const MPSCQueue &) { }
@@ -45,6 +50,28 @@ public:
         return true;
     }
 
+    // Links the batch privately, then splices it in with a single exchange on head
+    size_t produce_bulk(const T * input, size_t count)
+    {
+        if (count == 0) return 0;
+
+        buffer_node_t * first = reinterpret_cast<buffer_node_t*>(new buffer_node_aligned_t);
+        buffer_node_t * last = first;
+        first->data = input[0];
+        for (size_t i = 1; i < count; ++i)
+        {
+            buffer_node_t * node = reinterpret_cast<buffer_node_t*>(new buffer_node_aligned_t);
+            node->data = input[i];
+            last->next.store(node, std::memory_order_relaxed);
+            last = node;
+        }
+        last->next.store(nullptr, std::memory_order_relaxed);
+
+        buffer_node_t* prevhead = head.exchange(last, std::memory_order_acq_rel);
+        prevhead->next.store(first, std::memory_order_release);
+        return count;
+    }
+
     bool consume(T & output)
     {
         buffer_node_t * t = tail.load(std::memory_order_relaxed);
@@ -56,11 +83,18 @@ public:
         return true;
     }
 
+    size_t consume_bulk(T * output, size_t maxCount)
+    {
+        size_t count = 0;
+        while (count < maxCount && consume(output[count])) ++count;
+        return count;
+    }
+
     bool available()
     {
-        buffer_node_t * tail = tail.load(std::memory_order_relaxed);
-        buffer_node_t * next = tail->next.load(std::memory_order_acquire);
-        return next != nullptr;
+        buffer_node_t * t = tail.load(std::memory_order_relaxed);
+        buffer_node_t * n = t->next.load(std::memory_order_acquire);
+        return n != nullptr;
     }
 };
 
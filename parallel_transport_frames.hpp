@@ -7,90 +7,298 @@
 
 // good ref: http://sunandblackcat.com/tipFullView.php?l=eng&topicid=4
 
-// Compute a set of reference frames defined by their transformation matrix along a 
-// curve. It is designed so that the array of points and the array of matrices used 
-// to fetch these routines don't need to be ordered as the curve. e.g.
-//
-//     m[0] = first_frame(p[0], p[1], p[2]);
-//     for(int i = 1; i < n - 1; i++)
-//     {
-//         m[i] = next_frame(m[i-1], p[i-1], p[i], t[i-1], t[i]);
-//     }
-//     m[n-1] = last_frame(m[n-2], p[n-2], p[n-1]);
-//
-//   See Game Programming Gems 2, Section 2.5
+// Parallel transport keeps each frame's normal from twisting around the tangent between samples. The frames come from
+// Spline::sample_frames, which transports the normal with the double reflection method rather than by composing one
+// axis-angle rotation per sample (Game Programming Gems 2, Section 2.5), so error does not accumulate along the curve.
 
+// Frames at `segments` points spaced evenly by arc length along the Bezier through the four control positions,
+// both ends included. See Spline::sample_frames for the frame convention.
 inline std::vector<float4x4> make_parallel_transport_frame_bezier(const std::array<Pose, 4> controlPoints, const int segments)
 {
-    BezierCurve curve(controlPoints[0].position, controlPoints[1].position, controlPoints[2].position, controlPoints[3].position);
+    const Spline curve(SplineBasis::bezier, { controlPoints[0].position, controlPoints[1].position, controlPoints[2].position, controlPoints[3].position });
+    return curve.sample_frames(static_cast<size_t>(std::max(segments, 0)));
+}
 
-    std::vector<float3> points;         // Points in spline
-    std::vector<float3> tangents;       // Tangents in spline (fwd dir)
+// Carries `normal` from a sample at (p0, t0) to one at (p1, t1) by reflecting through the chord and then through the
+// bisector of the reflected and new tangents (Wang et al., "Computation of Rotation Minimizing Frames", 2008)
+inline float3 transport_normal(const float3 & normal, const float3 & p0, const float3 & t0, const float3 & p1, const float3 & t1)
+{
+    const float3 v1 = p1 - p0;
+    const float c1 = dot(v1, v1);
+    if (c1 <= 0.f) return normal;
+    const float3 rL = normal - (2.f / c1) * dot(v1, normal) * v1;
+    const float3 tL = t0 - (2.f / c1) * dot(v1, t0) * v1;
+    const float3 v2 = t1 - tL;
+    const float c2 = dot(v2, v2);
+    return (c2 > 0.f) ? rL - (2.f / c2) * dot(v2, rL) * v2 : rL;
+}
+
+// Rotation-minimizing frames over a path that grows at the back and retires at the front, such as a trail or an
+// animated cable. Samples live in a fixed-capacity ring, so steady-state updates never allocate. Appending a point
+// re-frames only the previous end sample (whose tangent changes from one-sided to central) and frames the new one;
+// retiring leaves the remaining frames untouched, so neither end ever recomputes the whole path.
+class TransportFrameStream
+{
+public:
 
-    // Build the spline.
-    float dt = 1.0f / float(segments);
-    for (int i = 0; i < segments; ++i) 
+    struct Sample
     {
-        float t = float(i) * dt;
-        float3 P = curve.point(t);
-        points.push_back(P);
+        float3 position, tangent, normal;
+        float distance;     // arc length from the first point ever appended; stable as the front retires
+    };
+
+private:
+
+    std::vector<Sample> ring;
+    size_t head{ 0 }, count{ 0 };
+    float3 up;
+
+    Sample & at(const size_t i) { return ring[(head + i) % ring.size()]; }
+
+public:
+
+    // `up` seeds the first normal; when the path starts along it, the x axis is used instead
+    explicit TransportFrameStream(const size_t capacity = 256, const float3 & up = { 0, 1, 0 }) : ring(std::max<size_t>(capacity, 2)), up(up) {}
 
-        float3 T = normalize(curve.derivative(t));
-        tangents.push_back(T);
+    size_t size() const { return count; }
+    size_t capacity() const { return ring.size(); }
+    bool empty() const { return count == 0; }
+    const Sample & operator[](const size_t i) const { return ring[(head + i) % ring.size()]; }
+    const Sample & front() const { return (*this)[0]; }
+    const Sample & back() const { return (*this)[count - 1]; }
+    float length() const { return count ? back().distance - front().distance : 0.f; }
+
+    void clear() { head = 0; count = 0; }
+
+    void pop_front(const size_t n = 1)
+    {
+        const size_t k = std::min(n, count);
+        head = (head + k) % ring.size();
+        count -= k;
     }
 
-    auto n = points.size();
-    std::vector<float4x4> frames(n); // Coordinate frame at each spline sample
+    // Appends a point, retiring the oldest sample first when the ring is full. Repeated points are ignored.
+    void push_back(const float3 & p)
+    {
+        if (count && length2(p - back().position) < 1e-12f) return;
+        if (count == ring.size()) pop_front();
+
+        Sample & s = at(count);
+        s.position = p;
+        count++;
+        if (count == 1)
+        {
+            s.distance = 0.f;
+            s.tangent = float3(0, 0, 0);
+            s.normal = up;
+            return;
+        }
+
+        Sample & prev = at(count - 2);
+        const float3 chord = p - prev.position;
+        s.distance = prev.distance + linalg::length(chord);
+        s.tangent = normalize(chord);
 
-    // Require at least 3 points to start
-    if (n >= 3) 
+        if (count == 2)
+        {
+            prev.tangent = s.tangent;
+            float3 side = cross(up, prev.tangent);
+            if (length2(side) < 1e-12f) side = cross(float3(1, 0, 0), prev.tangent);
+            prev.normal = normalize(cross(prev.tangent, side));
+        }
+        else
+        {
+            const Sample & before = at(count - 3);
+            prev.tangent = safe_normalize(p - before.position);
+            prev.normal = transport_normal(before.normal, before.position, before.tangent, prev.position, prev.tangent);
+        }
+        s.normal = transport_normal(prev.normal, prev.position, prev.tangent, s.position, s.tangent);
+    }
+
+    // Appends `count` points spaced evenly by arc length along `spline`
+    void append(const Spline & spline, const size_t count)
     {
-        // First frame, expressed in a Y-up, right-handed coordinate system
-        const float3 B = normalize(points[1] - points[0]);      // bitangent
-        const float3 T = normalize(cross({ 0, 1, 0 }, B));      // tangent
-        const float3 N = cross(B, N);                           // normal
-        frames[0] = { float4(-T, 0), float4(N, 0), float4(B, 0), float4(points[0], 1) };
-
-        // This sets the transformation matrix to the last reference frame defined by the previously computed 
-        // transformation matrix and the last point along the curve.
-        for (int i = 1; i < n - 1; ++i) 
+        float u[256];
+        for (size_t first = 0; first < count; first += 256)
         {
-            float3 axis;
-            float r = 0.f;
+            const size_t n = std::min<size_t>(256, count - first);
+            for (size_t i = 0; i < n; ++i) u[i] = spline.parameter_at_distance(spline.length() * float(first + i) / float(std::max<size_t>(count - 1, 1)));
+            float3 p[256];
+            spline.evaluate(u, n, p);
+            for (size_t i = 0; i < n; ++i) push_back(p[i]);
+        }
+    }
+};
 
-            if ((length2(tangents[i - 1]) != 0.0f) && (length2(tangents[i]) != 0.0f))
-            {
-                const float3 prevTangent = normalize(tangents[i - 1]);
-                const float3 curTangent = normalize(tangents[i]);
+// Interleaved vertex for generated tubes and ribbons; 32 bytes, with the mesh attribute locations of make_mesh_from_geometry
+// (position 0, normal 1, texcoord 3). texcoord.x runs around the tube or across the ribbon, texcoord.y is arc length.
+struct TubeVertex
+{
+    float3 position;
+    float3 normal;
+    float2 texcoord;
+};
 
-                float dp = dot(prevTangent, curTangent);
+// A tube ring repeats its first vertex so the texture wraps without a seam
+inline size_t tube_ring_size(const uint32_t sides) { return sides + 1; }
+inline size_t tube_vertex_count(const TransportFrameStream & s, const uint32_t sides) { return s.size() < 2 ? 0 : s.size() * tube_ring_size(sides); }
+inline size_t ribbon_vertex_count(const TransportFrameStream & s) { return s.size() < 2 ? 0 : s.size() * 2; }
 
-                if (dp > 1) dp = 1;
-                else if (dp < -1) dp = -1;
+constexpr static const uint32_t MAX_TUBE_SIDES = 64;
 
-                r = std::acos(dp);
-                axis = cross(prevTangent, curTangent);
-            }
+inline void write_tube_vertices(const TransportFrameStream & s, const float radius, const uint32_t sides, TubeVertex * out)
+{
+    assert(sides >= 3 && sides <= MAX_TUBE_SIDES);
+    if (s.size() < 2) return;
+
+    float2 ring[MAX_TUBE_SIDES + 1];
+    for (uint32_t j = 0; j <= sides; ++j)
+    {
+        const float angle = float(ANVIL_TAU) * float(j) / float(sides);
+        ring[j] = { std::cos(angle), std::sin(angle) };
+    }
+
+    for (size_t i = 0; i < s.size(); ++i)
+    {
+        const TransportFrameStream::Sample & f = s[i];
+        const float3 binormal = cross(f.tangent, f.normal);
+        for (uint32_t j = 0; j <= sides; ++j)
+        {
+            const float3 n = ring[j].x * f.normal + ring[j].y * binormal;
+            *out++ = { f.position + radius * n, n, { float(j) / float(sides), f.distance } };
+        }
+    }
+}
 
-            if ((length(axis) != 0.0f) && (r != 0.0f))
+// A ribbon lies in the plane of each sample's binormal, or faces `eye` when one is given (billboarded trails)
+inline void write_ribbon_vertices(const TransportFrameStream & s, const float halfWidth, TubeVertex * out, const float3 * eye = nullptr)
+{
+    if (s.size() < 2) return;
+    for (size_t i = 0; i < s.size(); ++i)
+    {
+        const TransportFrameStream::Sample & f = s[i];
+        float3 side = cross(f.tangent, f.normal), normal = f.normal;
+        if (eye)
+        {
+            const float3 facing = cross(f.tangent, *eye - f.position);
+            if (length2(facing) > 1e-12f)
             {
-                float4x4 R = make_rotation_matrix(normalize(axis), r);      // note the normalized axis
-                float4x4 Tj = make_translation_matrix(points[i]);           // current point
-                float4x4 Ti = make_translation_matrix(-points[i - 1]);      // previous point
-                frames[i] = mul(Tj, mul(R, mul(Ti, frames[i - 1])));
+                side = normalize(facing);
+                normal = cross(side, f.tangent);
             }
-            else
+        }
+        *out++ = { f.position - halfWidth * side, normal, { 0.f, f.distance } };
+        *out++ = { f.position + halfWidth * side, normal, { 1.f, f.distance } };
+    }
+}
+
+// Triangle indices joining `rows` consecutive rings of `ringSize` vertices. They depend only on the sizes, so one
+// index buffer built for the longest path serves every shorter path as a prefix of (rows - 1) * (ringSize - 1) * 6.
+inline void write_strip_indices(const size_t rows, const uint32_t ringSize, uint32_t * out)
+{
+    for (uint32_t r = 0; r + 1 < rows; ++r)
+    {
+        for (uint32_t j = 0; j + 1 < ringSize; ++j)
+        {
+            const uint32_t a = r * ringSize + j, b = a + 1, c = a + ringSize + 1, d = a + ringSize;
+            *out++ = a; *out++ = b; *out++ = c;
+            *out++ = a; *out++ = c; *out++ = d;
+        }
+    }
+}
+
+inline size_t strip_index_count(const size_t rows, const uint32_t ringSize) { return rows < 2 ? 0 : (rows - 1) * (ringSize - 1) * 6; }
+
+namespace transport_frame_tests
+{
+    inline void execute()
+    {
+        // A streamed helix matches frames computed in one pass, and stays orthonormal while it retires
+        TransportFrameStream stream(64);
+        std::vector<float3> path;
+        for (int i = 0; i < 200; ++i) path.push_back({ std::cos(i * 0.2f), i * 0.05f, std::sin(i * 0.2f) });
+        for (const float3 & p : path) stream.push_back(p);
+        assert(stream.size() == 64);
+        assert(distance(stream.back().position, path.back()) == 0.f);
+
+        for (size_t i = 0; i < stream.size(); ++i)
+        {
+            const auto & f = stream[i];
+            assert(std::abs(length(f.tangent) - 1.f) < 1e-4f && std::abs(length(f.normal) - 1.f) < 1e-3f && std::abs(dot(f.tangent, f.normal)) < 1e-3f);
+            if (i + 1 < stream.size()) assert(f.distance < stream[i + 1].distance);
+        }
+
+        // Appending one point changes only the last two frames
+        const TransportFrameStream::Sample before = stream[stream.size() - 3];
+        stream.push_back({ std::cos(40.f), 10.f, std::sin(40.f) });
+        assert(distance(stream[stream.size() - 4].normal, before.normal) < 1e-6f);
+
+        // Tube winding faces outward, and indices stay inside the written vertices
+        const uint32_t sides = 6;
+        std::vector<TubeVertex> vertices(tube_vertex_count(stream, sides));
+        write_tube_vertices(stream, 0.1f, sides, vertices.data());
+        std::vector<uint32_t> indices(strip_index_count(stream.size(), uint32_t(tube_ring_size(sides))));
+        write_strip_indices(stream.size(), uint32_t(tube_ring_size(sides)), indices.data());
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            const TubeVertex & a = vertices[indices[i]], & b = vertices[indices[i + 1]], & c = vertices[indices[i + 2]];
+            assert(dot(cross(b.position - a.position, c.position - a.position), a.normal + b.normal + c.normal) > 0.f);
+        }
+
+        std::vector<TubeVertex> ribbon(ribbon_vertex_count(stream));
+        const float3 eye(0, 5, 10);
+        write_ribbon_vertices(stream, 0.05f, ribbon.data(), &eye);
+        for (const TubeVertex & v : ribbon) assert(std::abs(length(v.normal) - 1.f) < 1e-3f);
+
+        // Paths of different lengths packed back to back, as GlTubeBatch draws them: a prefix of one index buffer built
+        // for the longest path, offset by each path's base vertex, stays inside that path and reaches all its vertices
+        std::vector<TransportFrameStream> paths;
+        for (size_t n : { 2, 17, 5, 64, 3 })
+        {
+            paths.emplace_back(n);
+            for (size_t i = 0; i < n; ++i) paths.back().push_back({ float(i), std::sin(i * 0.3f), float(n) });
+        }
+        for (const uint32_t ringSize : { uint32_t(tube_ring_size(sides)), 2u })
+        {
+            std::vector<uint32_t> shared(strip_index_count(64, ringSize));
+            write_strip_indices(64, ringSize, shared.data());
+
+            size_t first = 0;
+            for (const TransportFrameStream & p : paths)
             {
-                float4x4 t = make_translation_matrix(points[i] - points[i - 1]);
-                frames[i] = mul(t, frames[i - 1]);
+                const size_t count = p.size() * ringSize;
+                std::vector<bool> reached(count, false);
+                for (size_t i = 0; i < strip_index_count(p.size(), ringSize); ++i)
+                {
+                    const size_t v = first + shared[i];
+                    assert(v >= first && v < first + count);
+                    reached[v - first] = true;
+                }
+                for (bool r : reached) assert(r);
+                first += count;
             }
         }
-
-        // Last frame
-        frames[n - 1] = mul(make_translation_matrix(points[n - 1] - points[n - 2]), frames[n - 2]);
     }
 
-    return frames;
+    inline void benchmark(const size_t numCables = 20000, const size_t samplesPerCable = 64, const uint32_t sides = 6)
+    {
+        std::vector<TransportFrameStream> cables(numCables, TransportFrameStream(samplesPerCable));
+        for (size_t c = 0; c < numCables; ++c) for (size_t i = 0; i < samplesPerCable; ++i) cables[c].push_back({ float(c), std::sin(i * 0.1f + c), i * 0.1f });
+
+        std::vector<TubeVertex> vertices(numCables * samplesPerCable * tube_ring_size(sides));
+        {
+            AVL_SCOPED_TIMER("TransportFrameStream::push_back (one point per cable)");
+            for (size_t c = 0; c < numCables; ++c) cables[c].push_back({ float(c), std::cos(float(c)), samplesPerCable * 0.1f + cables[c].back().position.z });
+        }
+        {
+            AVL_SCOPED_TIMER("write_tube_vertices (all cables)");
+            parallel_ranges(numCables, 256, [&](size_t begin, size_t end)
+            {
+                for (size_t c = begin; c < end; ++c) write_tube_vertices(cables[c], 0.05f, sides, &vertices[c * samplesPerCable * tube_ring_size(sides)]);
+            });
+        }
+        std::cout << "vertices: " << vertices.size() << std::endl;
+    }
 }
 
 #endif // end parallel_transport_frames_hpp
\ No newline at end of file
@@ -85,7 +85,6 @@ void particle_system::update(float dt, const float3 & gravityVec)
             sz *= 0.9f;
         }
     }
-    glNamedBufferDataEXT(instanceBuffer, instances.size() * sizeof(float4), instances.data(), GL_DYNAMIC_DRAW);
 }
 
 void particle_system::draw(const float4x4 & viewMat, const float4x4 & projMat, GlShader & shader, GlTexture2D & outerTex, GlTexture2D & innerTex, float time)
@@ -106,10 +105,11 @@ void particle_system::draw(const float4x4 & viewMat, const float4x4 & projMat, G
         shader.texture("s_outerTex", 0, outerTex, GL_TEXTURE_2D);
         shader.texture("s_innerTex", 1, innerTex, GL_TEXTURE_2D);
 
-        // Instance buffer contains position and size
-        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        // Instance data contains position and size
+        const GlStreamingRange instanceRange = instanceStream.upload_vertices(instances);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceRange.buffer);
         glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(float4), nullptr);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(float4), (const GLvoid *) instanceRange.offset);
         glVertexAttribDivisor(0, 1);
 
         // Quad
@@ -128,6 +128,7 @@ void particle_system::draw(const float4x4 & viewMat, const float4x4 & projMat, G
     }
 
     shader.unbind();
+    instanceStream.end_frame();
 }
 
 shader_workbench::shader_workbench() : GLFWApp(1200, 800, "Particle System Example")
@@ -128,7 +128,8 @@ class particle_system
 {
     std::vector<particle> particles;
     std::vector<float4> instances;
-    GlBuffer vertexBuffer, instanceBuffer;
+    GlBuffer vertexBuffer;
+    GlStreamingBuffer instanceStream;
     std::vector<std::unique_ptr<particle_modifier>> particleModifiers;
     size_t trailCount = 0;
 public:
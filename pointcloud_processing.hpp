@@ -1,9 +1,19 @@
 #ifndef pointcloud_processing_hpp
 #define pointcloud_processing_hpp
 
+#include "util.hpp"
 #include "math-core.hpp"
+#include "radix_sort.hpp"
 #include <random>
 #include <utility>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <map>
+#include <tuple>
+#include <stdexcept>
+#include <cstdio>
+#include <cassert>
 
 using namespace avl;
 
@@ -132,6 +142,13 @@ namespace pca_impl
     }
 }
 
+// Returns principal axes of a covariance matrix as a pose (centered on the mean) and the variance along pose's local x,y,z
+inline std::pair<Pose, float3> make_principal_axes(const float3x3 & covarianceMatrix, const float3 & centerOfMass)
+{
+    float4 q = pca_impl::Diagonalizer(covarianceMatrix);
+    return std::make_pair<Pose, float3>({ q, centerOfMass }, pca_impl::Diagonal(mul(transpose(qmat(q)), covarianceMatrix, qmat(q))));
+}
+
 // Returns principal axes as a pose and population's variance along pose's local x,y,z
 inline std::pair<Pose, float3> make_principal_axes(const std::vector<float3> & points)
 {
@@ -146,9 +163,313 @@ inline std::pair<Pose, float3> make_principal_axes(const std::vector<float3> & p
     for (const float3 p : points) covarianceMatrix += outerprod(p - centerOfMass, p - centerOfMass);
     covarianceMatrix /= static_cast<float>(points.size());
 
-    float4 q = pca_impl::Diagonalizer(covarianceMatrix);
+    return make_principal_axes(covarianceMatrix, centerOfMass);
+}
 
-    return std::make_pair<Pose, float3>({ q, centerOfMass }, pca_impl::Diagonal(mul(transpose(qmat(q)), covarianceMatrix, qmat(q))));
+/*
+ * Exact voxel-grid downsampling. Unlike make_subsampled_pointcloud, every occupied voxel
+ * produces exactly one output point. Points are binned by a 63-bit morton key (21 bits per axis,
+ * so voxel coordinates must lie within +/- 2^20 of the origin), radix sorted, and each run of
+ * equal keys is reduced into a centroid and (optionally) a covariance used to estimate a normal.
+ * Key generation and the segmented reduce are split across hardware threads.
+ */
+
+namespace voxel_impl
+{
+    constexpr static const int64_t MORTON_BIAS = (1 << 20);
+
+    // Spread the low 21 bits of v so that there are two zero bits between each
+    inline uint64_t morton_split_3d(uint64_t v)
+    {
+        v &= 0x1fffff;
+        v = (v | v << 32) & 0x1f00000000ffff;
+        v = (v | v << 16) & 0x1f0000ff0000ff;
+        v = (v | v << 8)  & 0x100f00f00f00f00f;
+        v = (v | v << 4)  & 0x10c30c30c30c30c3;
+        v = (v | v << 2)  & 0x1249249249249249;
+        return v;
+    }
+
+    inline uint64_t morton_compact_3d(uint64_t v)
+    {
+        v &= 0x1249249249249249;
+        v = (v ^ (v >> 2))  & 0x10c30c30c30c30c3;
+        v = (v ^ (v >> 4))  & 0x100f00f00f00f00f;
+        v = (v ^ (v >> 8))  & 0x1f0000ff0000ff;
+        v = (v ^ (v >> 16)) & 0x1f00000000ffff;
+        v = (v ^ (v >> 32)) & 0x1fffff;
+        return v;
+    }
+
+    inline uint64_t morton_encode(const int3 & c)
+    {
+        return morton_split_3d(uint64_t(c.x + MORTON_BIAS)) | (morton_split_3d(uint64_t(c.y + MORTON_BIAS)) << 1) | (morton_split_3d(uint64_t(c.z + MORTON_BIAS)) << 2);
+    }
+
+    inline int3 morton_decode(uint64_t key)
+    {
+        return int3(int(int64_t(morton_compact_3d(key)) - MORTON_BIAS), int(int64_t(morton_compact_3d(key >> 1)) - MORTON_BIAS), int(int64_t(morton_compact_3d(key >> 2)) - MORTON_BIAS));
+    }
+
+    inline int3 voxel_coord(const float3 & pt, float inverseVoxelSize)
+    {
+        const float3 fcoord = floor(pt * inverseVoxelSize);
+        return int3(static_cast<int>(fcoord.x), static_cast<int>(fcoord.y), static_cast<int>(fcoord.z));
+    }
+}
+
+// Accumulated contents of a single voxel. Positions are stored relative to the voxel's
+// minimum corner to keep the second moments well-conditioned in single precision.
+struct VoxelStatistics
+{
+    uint64_t key{ 0 };
+    float3 sum{ 0, 0, 0 };
+    float3x3 sumOuter;
+    uint32_t count{ 0 };
+
+    VoxelStatistics & operator += (const VoxelStatistics & other)
+    {
+        sum += other.sum;
+        sumOuter += other.sumOuter;
+        count += other.count;
+        return *this;
+    }
+
+    float3 get_centroid(float voxelSize) const
+    {
+        return (float3(voxel_impl::morton_decode(key)) + sum / static_cast<float>(count)) * voxelSize;
+    }
+
+    float3x3 get_covariance(float voxelSize) const
+    {
+        const float3 mean = sum / static_cast<float>(count);
+        return (sumOuter / static_cast<float>(count) - outerprod(mean, mean)) * (voxelSize * voxelSize);
+    }
+
+    // The axis of least variance. Returns zero for voxels with too few points to define a plane.
+    float3 get_normal(float voxelSize) const
+    {
+        if (count < 3) return float3(0, 0, 0);
+        const auto axes = make_principal_axes(get_covariance(voxelSize), get_centroid(voxelSize));
+        return qzdir(axes.first.orientation);
+    }
+};
+
+// Sorts the chunk by voxel key and reduces each run of equal keys into a VoxelStatistics
+inline std::vector<VoxelStatistics> make_voxel_statistics(const float3 * points, size_t count, float voxelSize, bool computeCovariance)
+{
+    std::vector<VoxelStatistics> voxels;
+    if (count == 0) return voxels;
+
+    const float inverseVoxelSize = 1.0f / voxelSize;
+    constexpr static const size_t GRAIN = 16384;
+
+    std::vector<uint64_t> keys(count);
+    std::vector<uint32_t> indices(count);
+
+    parallel_ranges(count, GRAIN, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            keys[i] = voxel_impl::morton_encode(voxel_impl::voxel_coord(points[i], inverseVoxelSize));
+            indices[i] = static_cast<uint32_t>(i);
+        }
+    });
+
+    RadixSort().sort(keys.data(), indices.data(), count);
+
+    std::vector<size_t> segmentStarts;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (i == 0 || keys[i] != keys[i - 1]) segmentStarts.push_back(i);
+    }
+    segmentStarts.push_back(count);
+
+    voxels.resize(segmentStarts.size() - 1);
+
+    // Segmented reduce; each segment is owned by exactly one thread so no synchronization is required
+    parallel_ranges(voxels.size(), GRAIN / 8, [&](size_t begin, size_t end)
+    {
+        for (size_t s = begin; s < end; ++s)
+        {
+            VoxelStatistics & voxel = voxels[s];
+            voxel.key = keys[segmentStarts[s]];
+            const float3 corner = float3(voxel_impl::morton_decode(voxel.key));
+
+            for (size_t i = segmentStarts[s]; i < segmentStarts[s + 1]; ++i)
+            {
+                const float3 local = points[indices[i]] * inverseVoxelSize - corner;
+                voxel.sum += local;
+                if (computeCovariance) voxel.sumOuter += outerprod(local, local);
+            }
+
+            voxel.count = static_cast<uint32_t>(segmentStarts[s + 1] - segmentStarts[s]);
+        }
+    });
+
+    return voxels;
+}
+
+// Converts reduced voxels into output points (and normals, if outNormals is non-null). Matches the
+// make_subsampled_pointcloud convention of keeping voxels with strictly more than minOccupants points.
+inline std::vector<float3> make_voxel_grid_points(const std::vector<VoxelStatistics> & voxels, float voxelSize, int minOccupants, std::vector<float3> * outNormals = nullptr)
+{
+    std::vector<float3> kept;
+    std::vector<const VoxelStatistics *> survivors;
+    survivors.reserve(voxels.size());
+    for (const auto & v : voxels) if (static_cast<int>(v.count) > minOccupants) survivors.push_back(&v);
+
+    kept.resize(survivors.size());
+    if (outNormals) outNormals->resize(survivors.size());
+
+    parallel_ranges(survivors.size(), 4096, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            kept[i] = survivors[i]->get_centroid(voxelSize);
+            if (outNormals) (*outNormals)[i] = survivors[i]->get_normal(voxelSize);
+        }
+    });
+
+    return kept;
+}
+
+inline std::vector<float3> make_voxel_grid_pointcloud(const std::vector<float3> & points, float voxelSize, int minOccupants)
+{
+    return make_voxel_grid_points(make_voxel_statistics(points.data(), points.size(), voxelSize, false), voxelSize, minOccupants);
+}
+
+// Same as above, but also estimates a per-voxel normal from the covariance of the voxel's points
+inline std::vector<float3> make_voxel_grid_pointcloud(const std::vector<float3> & points, float voxelSize, int minOccupants, std::vector<float3> & outNormals)
+{
+    return make_voxel_grid_points(make_voxel_statistics(points.data(), points.size(), voxelSize, true), voxelSize, minOccupants, &outNormals);
+}
+
+/*
+ * Streaming variant of the voxel-grid filter for captures that don't fit in memory. Each chunk
+ * passed to add_points is reduced independently and merged into a table of occupied voxels, so
+ * memory is bounded by the number of occupied voxels rather than the number of input points.
+ */
+class VoxelGridAccumulator
+{
+    float voxelSize;
+    bool computeCovariance;
+    std::unordered_map<uint64_t, VoxelStatistics> voxels;
+
+public:
+
+    VoxelGridAccumulator(float voxelSize, bool computeCovariance = false) : voxelSize(voxelSize), computeCovariance(computeCovariance) {}
+
+    void add_points(const float3 * points, size_t count)
+    {
+        for (const auto & v : make_voxel_statistics(points, count, voxelSize, computeCovariance))
+        {
+            auto it = voxels.find(v.key);
+            if (it == voxels.end()) voxels.emplace(v.key, v);
+            else it->second += v;
+        }
+    }
+
+    void add_points(const std::vector<float3> & points) { add_points(points.data(), points.size()); }
+
+    size_t get_voxel_count() const { return voxels.size(); }
+
+    // Output is ordered by morton key, matching make_voxel_grid_pointcloud
+    std::vector<float3> get_points(int minOccupants, std::vector<float3> * outNormals = nullptr) const
+    {
+        std::vector<VoxelStatistics> sorted;
+        sorted.reserve(voxels.size());
+        for (const auto & v : voxels) sorted.push_back(v.second);
+        std::sort(sorted.begin(), sorted.end(), [](const VoxelStatistics & a, const VoxelStatistics & b) { return a.key < b.key; });
+        return make_voxel_grid_points(sorted, voxelSize, minOccupants, computeCovariance ? outNormals : nullptr);
+    }
+
+    void clear() { voxels.clear(); }
+};
+
+// Streams a file of tightly packed float3 positions through a VoxelGridAccumulator, chunkSize points at a time
+inline std::vector<float3> make_voxel_grid_pointcloud_from_file(const std::string & pathToFile, float voxelSize, int minOccupants, std::vector<float3> * outNormals = nullptr, size_t chunkSize = (1 << 20))
+{
+    FILE * f = fopen(pathToFile.c_str(), "rb");
+    if (!f) throw std::runtime_error("file not found");
+
+    VoxelGridAccumulator accumulator(voxelSize, outNormals != nullptr);
+    std::vector<float3> chunk(chunkSize);
+
+    size_t pointsRead = 0;
+    while ((pointsRead = fread(chunk.data(), sizeof(float3), chunkSize, f)) > 0)
+    {
+        accumulator.add_points(chunk.data(), pointsRead);
+    }
+
+    fclose(f);
+    return accumulator.get_points(minOccupants, outNormals);
+}
+
+namespace pointcloud_processing_tests
+{
+    inline void execute()
+    {
+        std::mt19937 gen(7);
+
+        // Key/value radix sort is stable, so it matches std::stable_sort on (key, original index) exactly. Small keys
+        // leave the high passes trivial (skipped), large ones exercise every pass.
+        for (const uint64_t keyRange : { uint64_t(1) << 18, ~uint64_t(0) })
+        {
+            std::uniform_int_distribution<uint64_t> keyDist(0, keyRange);
+            std::vector<uint64_t> keys(50000);
+            for (auto & k : keys) k = keyDist(gen) & ~uint64_t(3); // repeats, to test stability
+            std::vector<uint32_t> values(keys.size());
+            for (uint32_t i = 0; i < values.size(); ++i) values[i] = i;
+
+            std::vector<std::pair<uint64_t, uint32_t>> reference(keys.size());
+            for (size_t i = 0; i < keys.size(); ++i) reference[i] = { keys[i], values[i] };
+            std::stable_sort(reference.begin(), reference.end(), [](const std::pair<uint64_t, uint32_t> & a, const std::pair<uint64_t, uint32_t> & b) { return a.first < b.first; });
+
+            RadixSort().sort(keys.data(), values.data(), keys.size());
+            for (size_t i = 0; i < keys.size(); ++i) assert(keys[i] == reference[i].first && values[i] == reference[i].second);
+        }
+
+        // Voxel filter against a map keyed by voxel coordinate; points straddle zero so negative coordinates are covered
+        const float voxelSize = 0.1f;
+        const int minOccupants = 2;
+        std::uniform_real_distribution<float> coord(-0.75f, 0.75f);
+        std::vector<float3> points(40000);
+        for (auto & p : points) p = { coord(gen), coord(gen), coord(gen) * 0.2f };
+
+        std::map<std::tuple<int, int, int>, std::pair<double3, int>> naive;
+        for (const auto & p : points)
+        {
+            auto & cell = naive[std::make_tuple(int(std::floor(p.x / voxelSize)), int(std::floor(p.y / voxelSize)), int(std::floor(p.z / voxelSize)))];
+            cell.first += double3(p);
+            cell.second++;
+        }
+        std::vector<std::pair<uint64_t, float3>> expected;
+        for (const auto & cell : naive)
+        {
+            if (cell.second.second <= minOccupants) continue;
+            const int3 c(std::get<0>(cell.first), std::get<1>(cell.first), std::get<2>(cell.first));
+            expected.push_back({ voxel_impl::morton_encode(c), float3(cell.second.first / double(cell.second.second)) });
+        }
+        std::sort(expected.begin(), expected.end(), [](const std::pair<uint64_t, float3> & a, const std::pair<uint64_t, float3> & b) { return a.first < b.first; });
+
+        const std::vector<float3> filtered = make_voxel_grid_pointcloud(points, voxelSize, minOccupants);
+        assert(filtered.size() == expected.size());
+        for (size_t i = 0; i < filtered.size(); ++i) assert(distance(filtered[i], expected[i].second) < 1e-5f);
+
+        // Streaming in uneven chunks reduces to the same points
+        VoxelGridAccumulator accumulator(voxelSize);
+        for (size_t begin = 0; begin < points.size(); begin += 7777) accumulator.add_points(points.data() + begin, std::min<size_t>(7777, points.size() - begin));
+        const std::vector<float3> streamed = accumulator.get_points(minOccupants);
+        assert(streamed.size() == filtered.size());
+        for (size_t i = 0; i < streamed.size(); ++i) assert(distance(streamed[i], filtered[i]) < 1e-5f);
+
+        // Points on a plane give normals along the plane's axis
+        std::vector<float3> plane(20000), normals;
+        for (auto & p : plane) p = { coord(gen), coord(gen), 0.37f };
+        make_voxel_grid_pointcloud(plane, voxelSize, minOccupants, normals);
+        for (const auto & n : normals) assert(std::abs(std::abs(n.z) - 1.f) < 1e-3f);
+    }
 }
 
 #endif // end pointcloud_processing_hpp
@@ -6,6 +6,10 @@
 #include "geometry.hpp"
 #include "algo_misc.hpp"
 #include <assert.h>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
 
 #if defined(ANVIL_PLATFORM_WINDOWS)
 #pragma warning(push)
@@ -791,44 +795,44 @@ namespace avl
     inline Geometry make_icosasphere(uint32_t subdivisions = 1)
     {
         Geometry ico = make_icosahedron();
+        for (auto & v : ico.vertices) v = normalize(v);
+
+        // Each edge is split once and its midpoint shared by both neighbouring triangles, so the sphere is closed and
+        // the sphere has 10 * 4^n + 2 vertices (before the UV seam is split) rather than three new ones per triangle
+        std::unordered_map<uint64_t, uint32_t> midpoints;
+        auto midpoint = [&](const uint32_t a, const uint32_t b)
+        {
+            const uint64_t key = (uint64_t(std::min(a, b)) << 32) | std::max(a, b);
+            const auto it = midpoints.find(key);
+            if (it != midpoints.end()) return it->second;
+            const uint32_t index = (uint32_t) ico.vertices.size();
+            ico.vertices.push_back(normalize(ico.vertices[a] + ico.vertices[b]));
+            midpoints.emplace(key, index);
+            return index;
+        };
 
-        for (int j = 0; j < subdivisions; ++j)
+        for (uint32_t j = 0; j < subdivisions; ++j)
         {
-            ico.vertices.reserve(ico.vertices.size() + ico.faces.size());
-            ico.normals.reserve(ico.normals.size() + ico.faces.size());
-            ico.faces.reserve(ico.faces.size() * 3);
+            midpoints.clear();
+            midpoints.reserve(ico.faces.size() * 3 / 2);
+            ico.vertices.reserve(ico.vertices.size() + ico.faces.size() * 3 / 2);
 
-            // For each triangle
-            const size_t numTriangles = ico.faces.size();
-            for (uint32_t i = 0; i < numTriangles; ++i)
+            std::vector<uint3> faces;
+            faces.reserve(ico.faces.size() * 4);
+            for (const uint3 & f : ico.faces)
             {
-                uint32_t index0 = ico.faces[i].x;
-                uint32_t index1 = ico.faces[i].y;
-                uint32_t index2 = ico.faces[i].z;
-
-                uint32_t index3 = (uint32_t) ico.vertices.size();
-                uint32_t index4 = index3 + 1;
-                uint32_t index5 = index4 + 1;
-
-                ico.faces[i].y = index3;
-                ico.faces[i].z = index5;
-
-                ico.faces.push_back({ index3, index1, index4 });
-                ico.faces.push_back({ index5, index3, index4 });
-                ico.faces.push_back({ index5, index4, index2 });
-
-                ico.vertices.push_back(0.5f * (ico.vertices[index0] + ico.vertices[index1]));
-                ico.vertices.push_back(0.5f * (ico.vertices[index1] + ico.vertices[index2]));
-                ico.vertices.push_back(0.5f * (ico.vertices[index2] + ico.vertices[index0]));
-
-                ico.normals.push_back(0.5f * (ico.normals[index0] + ico.normals[index1]));
-                ico.normals.push_back(0.5f * (ico.normals[index1] + ico.normals[index2]));
-                ico.normals.push_back(0.5f * (ico.normals[index2] + ico.normals[index0]));
+                const uint32_t a = midpoint(f.x, f.y);
+                const uint32_t b = midpoint(f.y, f.z);
+                const uint32_t c = midpoint(f.z, f.x);
+                faces.push_back({ f.x, a, c });
+                faces.push_back({ a, f.y, b });
+                faces.push_back({ c, b, f.z });
+                faces.push_back({ a, b, c });
             }
+            ico.faces = std::move(faces);
         }
 
-        for (auto & v : ico.vertices) v = normalize(v);
-        for (auto & n : ico.normals) n = normalize(n);
+        ico.normals = ico.vertices;
 
         ico.texcoord0.resize(ico.normals.size(), float2());
         for (size_t i = 0; i < ico.normals.size(); ++i)
@@ -865,10 +869,85 @@ namespace avl
             else if (std::abs(d2) > 0.5f) add_unique_vertex(i, 2, uv2 + float2((d2 < 0.0f) ? 1.0f : -1.0f, 0.0f));
         }
 
-        compute_tangents(ico);
+        // Tangents follow +u and bitangents +v of the longitude/latitude mapping above, so they are exact per vertex
+        // (and identical on both sides of the UV seam). At the poles, where u is undefined, any tangent will do.
+        ico.tangents.resize(ico.vertices.size());
+        ico.bitangents.resize(ico.vertices.size());
+        for (size_t i = 0; i < ico.vertices.size(); ++i)
+        {
+            const float3 & n = ico.normals[i];
+            const float3 t = float3(n.z, 0, -n.x);
+            ico.tangents[i] = length2(t) > 1e-12f ? normalize(t) : float3(1, 0, 0);
+            ico.bitangents[i] = cross(n, ico.tangents[i]);
+        }
 
         return ico;
     }
+
+    // Memoizes generated resources by key. Only weak references are kept, so an entry lives exactly as long as some
+    // caller holds it: identical requests share one instance, and nothing (e.g. a GPU buffer) outlives its users.
+    template<typename T>
+    class MemoizedResources
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string, std::weak_ptr<T>> entries;
+
+    public:
+
+        // `generate` runs under the lock, so two threads asking for the same key never both build it
+        template<typename Generator>
+        std::shared_ptr<T> get(const std::string & key, Generator && generate)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::weak_ptr<T> & entry = entries[key];
+            if (std::shared_ptr<T> existing = entry.lock()) return existing;
+            std::shared_ptr<T> created = std::make_shared<T>(generate());
+            entry = created;
+            return created;
+        }
+
+        // Drops keys whose resources have all been released
+        void prune()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto it = entries.begin(); it != entries.end();) it = it->second.expired() ? entries.erase(it) : std::next(it);
+        }
+
+        size_t size()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            size_t live = 0;
+            for (const auto & e : entries) if (!e.second.expired()) live++;
+            return live;
+        }
+    };
+
+    // Builds a cache key from a generator name and its parameters, e.g. procedural_key("icosasphere", 5)
+    inline void append_procedural_key(std::ostringstream &) {}
+    template<typename A, typename ... Rest> void append_procedural_key(std::ostringstream & s, const A & arg, const Rest & ... rest) { s << ':' << arg; append_procedural_key(s, rest...); }
+
+    template<typename ... Args>
+    inline std::string procedural_key(const std::string & name, const Args & ... args)
+    {
+        std::ostringstream s;
+        s.precision(9);
+        s << name;
+        append_procedural_key(s, args...);
+        return s.str();
+    }
+
+    inline MemoizedResources<Geometry> & procedural_geometry_cache()
+    {
+        static MemoizedResources<Geometry> cache;
+        return cache;
+    }
+
+    // e.g. shared_geometry(procedural_key("icosasphere", 5), [] { return make_icosasphere(5); })
+    template<typename Generator>
+    inline std::shared_ptr<Geometry> shared_geometry(const std::string & key, Generator && generate)
+    {
+        return procedural_geometry_cache().get(key, std::forward<Generator>(generate));
+    }
     
 }
 
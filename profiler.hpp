@@ -0,0 +1,453 @@
+// This is free and unencumbered software released into the public domain.
+
+#pragma once
+
+#ifndef profiler_hpp
+#define profiler_hpp
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include <assert.h>
+#include <stdint.h>
+
+namespace avl
+{
+
+    // 64-bit FNV-1a. Used through AVL_PROFILE_TAG, where it is forced to compile time.
+    constexpr uint64_t profile_hash(const char * s, const uint64_t h = 14695981039346656037ull)
+    {
+        return *s ? profile_hash(s + 1, (h ^ uint64_t(uint8_t(*s))) * 1099511628211ull) : h;
+    }
+
+    // A profiled region: its hashed id and a name with static storage duration (a string literal)
+    struct ProfileTag
+    {
+        uint64_t id;
+        const char * name;
+    };
+
+    #define AVL_PROFILE_TAG(NAME) avl::ProfileTag{ std::integral_constant<uint64_t, avl::profile_hash(NAME)>::value, NAME }
+
+    struct ProfileEvent
+    {
+        const char * name;
+        uint64_t id;
+        int64_t beginNs, endNs;     // on the profiler clock (nanoseconds since the profiler was created)
+        uint32_t track;             // one track per thread, plus any registered by GPU profilers
+        uint32_t depth;
+    };
+
+    struct ProfileStats
+    {
+        const char * name;
+        uint32_t track;
+        uint32_t calls;             // in the most recent frame
+        double lastMs, minMs, avgMs, maxMs, p99Ms;
+    };
+
+    /*
+     * Scoped, hierarchical profiler. Every thread records completed regions into its own single-producer ring, so
+     * recording is two clock reads and a store with no locks or hashing; names are interned at compile time by
+     * AVL_PROFILE_TAG. Once per frame, end_frame() drains every ring on the calling thread, keeps the last
+     * `historyFrames` frames of raw events (for the flame graph and Chrome trace export), and folds per-frame totals
+     * for each region into a sliding window for min/avg/max/p99.
+     */
+    class Profiler
+    {
+    public:
+
+        constexpr static const size_t RING_CAPACITY = 1 << 14;      // events per thread between two end_frame() calls
+        constexpr static const size_t STATS_WINDOW = 240;           // frames of history behind each statistic
+
+        struct Track
+        {
+            std::string name;
+            uint32_t index{ 0 };
+            std::vector<ProfileEvent> ring;
+            std::atomic<uint64_t> head{ 0 }, tail{ 0 };
+            std::atomic<uint64_t> dropped{ 0 };
+            uint32_t depth{ 0 };    // owning thread only
+
+            // Owning thread only. Drops the event rather than block when the collector is behind.
+            void push(const ProfileEvent & e)
+            {
+                const uint64_t h = head.load(std::memory_order_relaxed);
+                if (h - tail.load(std::memory_order_acquire) >= ring.size()) { dropped.fetch_add(1, std::memory_order_relaxed); return; }
+                ring[h & (ring.size() - 1)] = e;
+                head.store(h + 1, std::memory_order_release);
+            }
+        };
+
+        struct Frame
+        {
+            int64_t beginNs{ 0 }, endNs{ 0 };
+            std::vector<ProfileEvent> events;   // sorted by track, then begin time
+        };
+
+    private:
+
+        struct Window
+        {
+            const char * name{ nullptr };
+            uint32_t track{ 0 };
+            uint32_t calls{ 0 };
+            double frameMs{ 0.0 };              // accumulated during the current frame
+            std::vector<float> samples;
+            size_t next{ 0 };
+            bool touched{ false };
+        };
+
+        typedef std::chrono::steady_clock clock;
+        const clock::time_point epoch{ clock::now() };
+
+        std::atomic<bool> enabled{ true };
+
+        mutable std::mutex tracksMutex;
+        std::vector<std::unique_ptr<Track>> tracks;
+
+        size_t historyFrames;
+        std::vector<Frame> history;             // ring of completed frames
+        size_t historyNext{ 0 }, historyCount{ 0 };
+        int64_t frameBeginNs{ 0 };
+
+        std::unordered_map<uint64_t, Window> windows;
+
+        static uint64_t window_key(const uint64_t id, const uint32_t track) { return id + track * 0x9E3779B97F4A7C15ull; }
+
+        static Track *& thread_track()
+        {
+            static thread_local Track * track = nullptr;
+            return track;
+        }
+
+    public:
+
+        Profiler(const size_t historyFrames = 120) : historyFrames(std::max<size_t>(1, historyFrames)), history(std::max<size_t>(1, historyFrames)) {}
+
+        // The process-wide instance that AVL_PROFILE_SCOPE records into
+        static Profiler & get()
+        {
+            static Profiler instance;
+            return instance;
+        }
+
+        int64_t now_ns() const { return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - epoch).count(); }
+
+        void set_enabled(const bool state) { enabled.store(state, std::memory_order_relaxed); }
+        bool is_enabled() const { return enabled.load(std::memory_order_relaxed); }
+
+        // Creates a track that is fed explicitly with submit(), e.g. by a GPU timer
+        Track * create_track(const std::string & name)
+        {
+            std::lock_guard<std::mutex> lock(tracksMutex);
+            tracks.emplace_back(new Track());
+            Track * t = tracks.back().get();
+            t->name = name;
+            t->index = static_cast<uint32_t>(tracks.size() - 1);
+            t->ring.resize(RING_CAPACITY);
+            return t;
+        }
+
+        // The calling thread's track, created on first use
+        Track * get_thread_track()
+        {
+            Track *& t = thread_track();
+            if (!t)
+            {
+                const size_t count = [this]() { std::lock_guard<std::mutex> lock(tracksMutex); return tracks.size(); }();
+                t = create_track("thread " + std::to_string(count));
+            }
+            return t;
+        }
+
+        void set_thread_name(const std::string & name)
+        {
+            Track * t = get_thread_track();
+            std::lock_guard<std::mutex> lock(tracksMutex);
+            t->name = name;
+        }
+
+        // Single producer per track: only the thread that owns `track` may submit to it
+        void submit(Track * track, const ProfileTag & tag, const int64_t beginNs, const int64_t endNs, const uint32_t depth)
+        {
+            track->push({ tag.name, tag.id, beginNs, endNs, track->index, depth });
+        }
+
+        // Drains every track into the frame history and updates statistics. Call once per frame from one thread.
+        void end_frame()
+        {
+            const int64_t frameEndNs = now_ns();
+            Frame & frame = history[historyNext];
+            frame.events.clear();
+            frame.beginNs = frameBeginNs;
+            frame.endNs = frameEndNs;
+
+            {
+                std::lock_guard<std::mutex> lock(tracksMutex);
+                for (auto & t : tracks)
+                {
+                    const uint64_t tail = t->tail.load(std::memory_order_relaxed);
+                    const uint64_t head = t->head.load(std::memory_order_acquire);
+                    for (uint64_t i = tail; i < head; ++i) frame.events.push_back(t->ring[i & (t->ring.size() - 1)]);
+                    t->tail.store(head, std::memory_order_release);
+                }
+            }
+
+            std::sort(frame.events.begin(), frame.events.end(), [](const ProfileEvent & a, const ProfileEvent & b)
+            {
+                if (a.track != b.track) return a.track < b.track;
+                if (a.beginNs != b.beginNs) return a.beginNs < b.beginNs;
+                return a.depth < b.depth;
+            });
+
+            Window * last = nullptr;
+            uint64_t lastKey = 0;
+            for (const ProfileEvent & e : frame.events)
+            {
+                // Loops emit runs of the same region, so most events skip the map lookup
+                const uint64_t key = window_key(e.id, e.track);
+                if (!last || key != lastKey) { last = &windows[key]; lastKey = key; }
+                Window & w = *last;
+                if (!w.name) { w.name = e.name; w.track = e.track; w.samples.reserve(STATS_WINDOW); }
+                if (!w.touched) { w.frameMs = 0.0; w.calls = 0; w.touched = true; }
+                w.frameMs += (e.endNs - e.beginNs) * 1e-6;
+                w.calls++;
+            }
+
+            for (auto & entry : windows)
+            {
+                Window & w = entry.second;
+                if (!w.touched) continue;
+                if (w.samples.size() < STATS_WINDOW) w.samples.push_back(static_cast<float>(w.frameMs));
+                else w.samples[w.next] = static_cast<float>(w.frameMs);
+                w.next = (w.next + 1) % STATS_WINDOW;
+                w.touched = false;
+            }
+
+            historyNext = (historyNext + 1) % historyFrames;
+            historyCount = std::min(historyCount + 1, historyFrames);
+            frameBeginNs = frameEndNs;
+        }
+
+        // The most recent completed frame, or nullptr before the first end_frame()
+        const Frame * get_last_frame() const
+        {
+            if (!historyCount) return nullptr;
+            return &history[(historyNext + historyFrames - 1) % historyFrames];
+        }
+
+        // Frames of retained history, oldest first
+        std::vector<const Frame *> get_history() const
+        {
+            std::vector<const Frame *> frames;
+            for (size_t i = 0; i < historyCount; ++i) frames.push_back(&history[(historyNext + historyFrames - historyCount + i) % historyFrames]);
+            return frames;
+        }
+
+        // Statistics of per-frame totals, ordered by track then name
+        std::vector<ProfileStats> get_stats() const
+        {
+            std::vector<ProfileStats> result;
+            std::vector<float> sorted;
+            for (auto & entry : windows)
+            {
+                const Window & w = entry.second;
+                if (w.samples.empty()) continue;
+
+                sorted = w.samples;
+                const size_t p99 = std::min(sorted.size() - 1, (sorted.size() * 99) / 100);
+                std::nth_element(sorted.begin(), sorted.begin() + p99, sorted.end());
+
+                ProfileStats s;
+                s.name = w.name;
+                s.track = w.track;
+                s.calls = w.calls;
+                s.lastMs = w.samples[(w.next + w.samples.size() - 1) % w.samples.size()];
+                s.minMs = *std::min_element(w.samples.begin(), w.samples.end());
+                s.maxMs = *std::max_element(w.samples.begin(), w.samples.end());
+                double sum = 0.0;
+                for (auto v : w.samples) sum += v;
+                s.avgMs = sum / w.samples.size();
+                s.p99Ms = sorted[p99];
+                result.push_back(s);
+            }
+            std::sort(result.begin(), result.end(), [](const ProfileStats & a, const ProfileStats & b)
+            {
+                if (a.track != b.track) return a.track < b.track;
+                return std::string(a.name) < std::string(b.name);
+            });
+            return result;
+        }
+
+        std::vector<std::string> get_track_names() const
+        {
+            std::lock_guard<std::mutex> lock(tracksMutex);
+            std::vector<std::string> names;
+            for (auto & t : tracks) names.push_back(t->name);
+            return names;
+        }
+
+        uint64_t get_dropped_events() const
+        {
+            std::lock_guard<std::mutex> lock(tracksMutex);
+            uint64_t dropped = 0;
+            for (auto & t : tracks) dropped += t->dropped.load(std::memory_order_relaxed);
+            return dropped;
+        }
+
+        // Writes the retained history in the Chrome trace event format (chrome://tracing, Perfetto, Speedscope)
+        bool write_chrome_trace(const std::string & path) const
+        {
+            std::ofstream out(path);
+            if (!out) return false;
+
+            auto escape = [](const std::string & s)
+            {
+                std::string r;
+                for (char c : s) { if (c == '"' || c == '\\') r += '\\'; r += c; }
+                return r;
+            };
+
+            out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+            const auto names = get_track_names();
+            bool first = true;
+            for (size_t t = 0; t < names.size(); ++t)
+            {
+                out << (first ? "" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":" << t << ",\"args\":{\"name\":\"" << escape(names[t]) << "\"}}";
+                first = false;
+            }
+
+            char buffer[64];
+            for (const Frame * f : get_history())
+            {
+                for (const ProfileEvent & e : f->events)
+                {
+                    out << (first ? "" : ",\n") << "{\"ph\":\"X\",\"pid\":0,\"tid\":" << e.track << ",\"name\":\"" << escape(e.name) << "\"";
+                    snprintf(buffer, sizeof(buffer), ",\"ts\":%.3f,\"dur\":%.3f}", e.beginNs * 1e-3, (e.endNs - e.beginNs) * 1e-3);
+                    out << buffer;
+                    first = false;
+                }
+            }
+            out << "\n]}\n";
+            return bool(out);
+        }
+    };
+
+    // Records the enclosing scope on the calling thread's track. end() closes it early, for regions that don't match a block.
+    class ProfileScope
+    {
+        Profiler * profiler;
+        Profiler::Track * track{ nullptr };
+        ProfileTag tag;
+        int64_t beginNs{ 0 };
+    public:
+        ProfileScope(const ProfileTag & tag, Profiler & profiler = Profiler::get()) : profiler(&profiler), tag(tag)
+        {
+            if (!profiler.is_enabled()) return;
+            track = profiler.get_thread_track();
+            track->depth++;
+            beginNs = profiler.now_ns();
+        }
+
+        ~ProfileScope() { end(); }
+
+        void end()
+        {
+            if (!track) return;
+            track->depth--;
+            profiler->submit(track, tag, beginNs, profiler->now_ns(), track->depth);
+            track = nullptr;
+        }
+    };
+
+    #define AVL_PROFILE_CONCAT_INNER(A, B) A ## B
+    #define AVL_PROFILE_CONCAT(A, B) AVL_PROFILE_CONCAT_INNER(A, B)
+    #define AVL_PROFILE_SCOPE(NAME) avl::ProfileScope AVL_PROFILE_CONCAT(profileScope, __LINE__)(AVL_PROFILE_TAG(NAME))
+
+} // end namespace avl
+
+namespace profiler_tests
+{
+    using namespace avl;
+
+    inline void execute()
+    {
+        static_assert(std::integral_constant<uint64_t, profile_hash("renderloop")>::value != profile_hash("visibility"), "hash collision");
+
+        Profiler & p = Profiler::get();
+        p.set_thread_name("main");
+        p.end_frame(); // discard anything recorded before the test
+
+        for (int frame = 0; frame < 10; ++frame)
+        {
+            AVL_PROFILE_SCOPE("outer");
+            for (int i = 0; i < 3; ++i)
+            {
+                AVL_PROFILE_SCOPE("inner");
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+
+            std::thread worker([]()
+            {
+                Profiler::get().set_thread_name("worker");
+                AVL_PROFILE_SCOPE("worker-task");
+            });
+            worker.join();
+        }
+        p.end_frame();
+
+        const Profiler::Frame * f = p.get_last_frame();
+        assert(f && f->events.size() == 50);
+
+        size_t outer = 0, inner = 0;
+        for (auto & e : f->events)
+        {
+            if (e.id == profile_hash("outer")) { outer++; assert(e.depth == 0); }
+            if (e.id == profile_hash("inner")) { inner++; assert(e.depth == 1); }
+        }
+        assert(outer == 10 && inner == 30);
+
+        for (auto & s : p.get_stats())
+        {
+            if (std::string(s.name) == "inner") assert(s.calls == 30 && s.lastMs >= 3.0 && s.minMs <= s.avgMs && s.avgMs <= s.maxMs && s.p99Ms <= s.maxMs);
+        }
+    }
+
+    // Cost of recording one scope (enabled and disabled), and of collecting it in end_frame()
+    inline void benchmark(const int frames = 64)
+    {
+        Profiler & p = Profiler::get();
+        const int scopesPerFrame = static_cast<int>(Profiler::RING_CAPACITY / 2);
+        for (const bool state : { true, false })
+        {
+            p.set_enabled(state);
+            double recordNs = 0.0, collectNs = 0.0;
+            for (int f = 0; f < frames; ++f)
+            {
+                const auto t0 = std::chrono::steady_clock::now();
+                for (int i = 0; i < scopesPerFrame; ++i) { AVL_PROFILE_SCOPE("benchmark"); }
+                const auto t1 = std::chrono::steady_clock::now();
+                p.end_frame();
+                const auto t2 = std::chrono::steady_clock::now();
+                recordNs += std::chrono::duration<double, std::nano>(t1 - t0).count();
+                collectNs += std::chrono::duration<double, std::nano>(t2 - t1).count();
+            }
+            const double scopes = double(frames) * scopesPerFrame;
+            std::cout << "profile scope (" << (state ? "enabled" : "disabled") << "): record " << recordNs / scopes << " ns, collect " << collectNs / scopes << " ns" << std::endl;
+        }
+        p.set_enabled(true);
+    }
+}
+
+#endif // end profiler_hpp
@@ -0,0 +1,404 @@
+// This is free and unencumbered software released into the public domain.
+// Throughput and latency harness for the top-level queues. Every configuration also doubles as a
+// contention test: the consumed item count and sequence checksum must match what was produced.
+
+#ifndef queue_benchmark_hpp
+#define queue_benchmark_hpp
+
+#include "spsc_queue.hpp"
+#include "spsc_bounded_queue.hpp"
+#include "mpsc_queue.hpp"
+#include "mpsc_bounded_queue.hpp"
+#include "mpmc_bounded_queue.hpp"
+#include "mpmc_blocking_queue.hpp"
+#include "spmc_stealing_queue.hpp"
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <stdint.h>
+#include <assert.h>
+
+namespace queue_benchmark
+{
+    // Items carry their producer, a sequence number and the time they were enqueued; the rest is ballast
+    template<size_t N>
+    struct Payload
+    {
+        static_assert(N >= 16, "payload must hold a header");
+        uint64_t timestamp;
+        uint32_t producer;
+        uint32_t sequence;
+        uint8_t ballast[N - 16];
+    };
+
+    template<>
+    struct Payload<16>
+    {
+        uint64_t timestamp;
+        uint32_t producer;
+        uint32_t sequence;
+    };
+
+    const uint32_t SENTINEL = 0xffffffff;
+
+    inline uint64_t now_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    struct Result
+    {
+        std::string queue;
+        int producers{ 0 };
+        int consumers{ 0 };
+        size_t payloadBytes{ 0 };
+        double itemsPerSecond{ 0 };
+        double p50LatencyNs{ 0 };
+        double p99LatencyNs{ 0 };
+        bool valid{ false };
+    };
+
+    struct Config
+    {
+        size_t itemsPerProducer{ 1 << 18 };
+        size_t capacity{ 4096 };      // bounded queues only
+        size_t batch{ 1 };            // > 1 uses the bulk APIs on the producer side
+        uint32_t latencySampleRate{ 16 };
+    };
+
+    // Adapters give every queue the same non-blocking try_produce / try_consume surface. Blocking queues also get
+    // a blocking consume so that the harness measures their parking path rather than a spin on try_consume.
+
+    template<typename T> struct SPSCAdapter
+    {
+        static const char * name() { return "SPSCQueue"; }
+        static bool supports(int p, int c) { return p == 1 && c == 1; }
+        SPSCQueue<T> q;
+        SPSCAdapter(const Config &) {}
+        bool try_produce(const T & v, int) { return q.produce(v); }
+        size_t try_produce_bulk(const T * v, size_t n, int) { return q.produce_bulk(v, n); }
+        bool try_consume(T & v) { return q.consume(v); }
+        size_t try_consume_bulk(T * v, size_t n) { return q.consume_bulk(v, n); }
+    };
+
+    template<typename T> struct SPSCBoundedAdapter
+    {
+        static const char * name() { return "SPSCBoundedQueue"; }
+        static bool supports(int p, int c) { return p == 1 && c == 1; }
+        SPSCBoundedQueue<T> q;
+        SPSCBoundedAdapter(const Config & c) : q(c.capacity) {}
+        bool try_produce(const T & v, int) { return q.produce(v); }
+        size_t try_produce_bulk(const T * v, size_t n, int) { return q.produce_bulk(v, n); }
+        bool try_consume(T & v) { return q.consume(v); }
+        size_t try_consume_bulk(T * v, size_t n) { return q.consume_bulk(v, n); }
+    };
+
+    template<typename T> struct MPSCAdapter
+    {
+        static const char * name() { return "MPSCQueue"; }
+        static bool supports(int, int c) { return c == 1; }
+        MPSCQueue<T> q;
+        MPSCAdapter(const Config &) {}
+        bool try_produce(const T & v, int) { return q.produce(v); }
+        size_t try_produce_bulk(const T * v, size_t n, int) { return q.produce_bulk(v, n); }
+        bool try_consume(T & v) { return q.consume(v); }
+        size_t try_consume_bulk(T * v, size_t n) { return q.consume_bulk(v, n); }
+    };
+
+    template<typename T> struct MPSCBoundedAdapter
+    {
+        static const char * name() { return "MPSCBoundedQueue"; }
+        static bool supports(int, int c) { return c == 1; }
+        MPSCBoundedQueue<T> q;
+        MPSCBoundedAdapter(const Config & c) : q(c.capacity) {}
+        bool try_produce(const T & v, int) { return q.produce(v); }
+        size_t try_produce_bulk(const T * v, size_t n, int) { return q.produce_bulk(v, n); }
+        bool try_consume(T & v) { return q.consume(v); }
+        size_t try_consume_bulk(T * v, size_t n) { return q.consume_bulk(v, n); }
+    };
+
+    template<typename T> struct MPMCBoundedAdapter
+    {
+        static const char * name() { return "MPMCBoundedQueue"; }
+        static bool supports(int, int) { return true; }
+        MPMCBoundedQueue<T> q;
+        int producers{ 0 };
+        MPMCBoundedAdapter(const Config & c) : q(c.capacity) {}
+        bool try_produce(const T & v, int) { return producers == 1 ? q.sp_produce(v) : q.mp_produce(v); }
+        size_t try_produce_bulk(const T * v, size_t n, int) { return q.mp_produce_bulk(v, n); }
+        bool try_consume(T & v) { return q.consume(v); }
+        size_t try_consume_bulk(T * v, size_t n) { return q.consume_bulk(v, n); }
+    };
+
+    template<typename T> struct MPMCBlockingAdapter
+    {
+        static const char * name() { return "MPMCBlockingQueue"; }
+        static bool supports(int, int) { return true; }
+        MPMCBlockingQueue<T> q;
+        MPMCBlockingAdapter(const Config &) {}
+        bool try_produce(const T & v, int) { q.produce(v); return true; }
+        size_t try_produce_bulk(const T * v, size_t n, int) { q.produce_bulk(v, n); return n; }
+        bool try_consume(T & v) { return q.try_consume(v); }
+        size_t try_consume_bulk(T * v, size_t n) { return q.try_consume_bulk(v, n); }
+        void wait_and_consume(T & v) { q.wait_and_consume(v); }
+    };
+
+    template<typename T> struct MPMCFutexAdapter
+    {
+        static const char * name() { return "MPMCFutexQueue"; }
+        static bool supports(int, int) { return true; }
+        MPMCFutexQueue<T> q;
+        MPMCFutexAdapter(const Config & c) : q(c.capacity) {}
+        bool try_produce(const T & v, int) { q.produce(v); return true; }
+        size_t try_produce_bulk(const T * v, size_t n, int) { q.produce_bulk(v, n); return n; }
+        bool try_consume(T & v) { return q.try_consume(v); }
+        size_t try_consume_bulk(T * v, size_t n) { return q.try_consume_bulk(v, n); }
+        void wait_and_consume(T & v) { q.wait_and_consume(v); }
+    };
+
+    // The owning thread produces, every consumer is a thief. Deque slots are std::atomic<T>, so like the job system
+    // it carries pointers; payloads live in a producer-owned array sized for the whole run.
+    template<typename T> struct SPMCStealingAdapter
+    {
+        static const char * name() { return "SPMCStealingQueue"; }
+        static bool supports(int p, int) { return p == 1; }
+        SPMCStealingQueue<T *> q;
+        std::vector<T> storage;
+        size_t next{ 0 };
+        SPMCStealingAdapter(const Config & c) : storage(c.itemsPerProducer + 64) {}
+        bool try_produce(const T & v, int) { storage[next] = v; q.produce(&storage[next++]); return true; }
+        size_t try_produce_bulk(const T * v, size_t n, int)
+        {
+            T * items[64];
+            n = std::min<size_t>(n, 64);
+            for (size_t i = 0; i < n; ++i) { storage[next] = v[i]; items[i] = &storage[next++]; }
+            q.produce_bulk(items, n);
+            return n;
+        }
+        bool try_consume(T & v) { T * p; if (!q.steal(p)) return false; v = *p; return true; }
+        size_t try_consume_bulk(T * v, size_t n) { return (n && try_consume(v[0])) ? 1 : 0; }
+    };
+
+    template<typename A, typename T, typename = void> struct has_blocking_consume : std::false_type {};
+    template<typename A, typename T> struct has_blocking_consume<A, T, decltype(std::declval<A&>().wait_and_consume(std::declval<T&>()))> : std::true_type {};
+
+    template<typename A, typename T>
+    typename std::enable_if<has_blocking_consume<A, T>::value>::type consume_one(A & a, T & v) { a.wait_and_consume(v); }
+
+    template<typename A, typename T>
+    typename std::enable_if<!has_blocking_consume<A, T>::value>::type consume_one(A & a, T & v)
+    {
+        int spins = 0;
+        while (!a.try_consume(v)) if (++spins > 64) std::this_thread::yield();
+    }
+
+    template<typename A, typename T>
+    void produce_one(A & a, const T & v, int producer)
+    {
+        int spins = 0;
+        while (!a.try_produce(v, producer)) if (++spins > 64) std::this_thread::yield();
+    }
+
+    template<typename A> void set_producer_count(A &, int) {}
+    template<typename T> void set_producer_count(MPMCBoundedAdapter<T> & a, int producers) { a.producers = producers; }
+
+    // Runs one configuration; returns valid == false if the queue does not support the producer/consumer shape
+    template<template<typename> class Adapter, size_t PayloadBytes>
+    Result run(int numProducers, int numConsumers, const Config & config = {})
+    {
+        typedef Payload<PayloadBytes> T;
+        typedef Adapter<T> A;
+
+        Result result;
+        result.queue = A::name();
+        result.producers = numProducers;
+        result.consumers = numConsumers;
+        result.payloadBytes = sizeof(T);
+        if (!A::supports(numProducers, numConsumers)) return result;
+
+        std::unique_ptr<A> adapter(new A(config));
+        set_producer_count(*adapter, numProducers);
+
+        std::atomic<int> ready{ 0 };
+        std::atomic<bool> go{ false };
+        std::atomic<int> producersRemaining{ numProducers };
+        std::vector<uint64_t> consumed(numConsumers, 0), checksum(numConsumers, 0);
+        std::vector<std::vector<uint32_t>> latencies(numConsumers);
+
+        std::vector<std::thread> threads;
+        for (int p = 0; p < numProducers; ++p)
+        {
+            threads.emplace_back([&, p]()
+            {
+                std::vector<T> batch(config.batch);
+                ready.fetch_add(1);
+                while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+
+                for (size_t i = 0; i < config.itemsPerProducer; )
+                {
+                    const size_t n = std::min(config.batch, config.itemsPerProducer - i);
+                    const uint64_t t = now_ns();
+                    for (size_t k = 0; k < n; ++k)
+                    {
+                        batch[k].timestamp = t;
+                        batch[k].producer = (uint32_t) p;
+                        batch[k].sequence = (uint32_t) (i + k);
+                    }
+
+                    if (n == 1) produce_one(*adapter, batch[0], p);
+                    else
+                    {
+                        size_t written = 0;
+                        while (written < n)
+                        {
+                            const size_t w = adapter->try_produce_bulk(batch.data() + written, n - written, p);
+                            if (!w) std::this_thread::yield();
+                            written += w;
+                        }
+                    }
+                    i += n;
+                }
+
+                // The last producer to finish tells every consumer to stop
+                if (producersRemaining.fetch_sub(1) == 1)
+                {
+                    T sentinel = {};
+                    sentinel.sequence = SENTINEL;
+                    for (int c = 0; c < numConsumers; ++c) produce_one(*adapter, sentinel, p);
+                }
+            });
+        }
+
+        for (int c = 0; c < numConsumers; ++c)
+        {
+            latencies[c].reserve(numProducers * config.itemsPerProducer / config.latencySampleRate / numConsumers + 1024);
+            threads.emplace_back([&, c]()
+            {
+                ready.fetch_add(1);
+                while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+
+                T item;
+                uint64_t count = 0, sum = 0;
+                while (true)
+                {
+                    consume_one(*adapter, item);
+                    if (item.sequence == SENTINEL) break;
+                    if ((count++ % config.latencySampleRate) == 0) latencies[c].push_back((uint32_t) std::min<uint64_t>(now_ns() - item.timestamp, 0xffffffff));
+                    sum += item.sequence + (uint64_t(item.producer) << 32);
+                }
+                consumed[c] = count;
+                checksum[c] = sum;
+            });
+        }
+
+        while (ready.load() != numProducers + numConsumers) std::this_thread::yield();
+        const uint64_t t0 = now_ns();
+        go.store(true, std::memory_order_release);
+        for (auto & t : threads) t.join();
+        const double seconds = (now_ns() - t0) * 1e-9;
+
+        uint64_t totalConsumed = 0, totalChecksum = 0, expectedChecksum = 0;
+        for (int c = 0; c < numConsumers; ++c) { totalConsumed += consumed[c]; totalChecksum += checksum[c]; }
+        for (int p = 0; p < numProducers; ++p)
+        {
+            const uint64_t n = config.itemsPerProducer;
+            expectedChecksum += n * (n - 1) / 2 + n * (uint64_t(p) << 32);
+        }
+
+        std::vector<uint32_t> samples;
+        for (auto & l : latencies) samples.insert(samples.end(), l.begin(), l.end());
+        auto percentile = [&](double q) -> double
+        {
+            if (samples.empty()) return 0;
+            const size_t k = std::min(samples.size() - 1, (size_t) (q * samples.size()));
+            std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+            return samples[k];
+        };
+
+        result.itemsPerSecond = totalConsumed / seconds;
+        result.p50LatencyNs = percentile(0.50);
+        result.p99LatencyNs = percentile(0.99);
+        result.valid = (totalConsumed == numProducers * config.itemsPerProducer) && (totalChecksum == expectedChecksum);
+        assert(result.valid && "queue lost, duplicated or corrupted items");
+        return result;
+    }
+
+    inline void print(const Result & r)
+    {
+        if (r.producers == 0 || (!r.valid && r.itemsPerSecond == 0)) return;
+        std::cout << std::left << std::setw(20) << r.queue
+                  << std::right << std::setw(3) << r.producers << "p" << std::setw(3) << r.consumers << "c"
+                  << std::setw(6) << r.payloadBytes << "B"
+                  << std::setw(12) << std::fixed << std::setprecision(2) << r.itemsPerSecond * 1e-6 << " Mitems/s"
+                  << "  p50 " << std::setw(9) << std::setprecision(0) << r.p50LatencyNs << " ns"
+                  << "  p99 " << std::setw(9) << r.p99LatencyNs << " ns"
+                  << (r.valid ? "" : "  INVALID") << std::endl;
+    }
+
+    template<template<typename> class Adapter, size_t PayloadBytes>
+    void run_shapes(std::vector<Result> & results, const std::vector<std::pair<int, int>> & shapes, const Config & config)
+    {
+        for (auto & s : shapes)
+        {
+            Result r = run<Adapter, PayloadBytes>(s.first, s.second, config);
+            if (r.itemsPerSecond > 0) { print(r); results.push_back(r); }
+        }
+    }
+
+    template<size_t PayloadBytes>
+    void run_all_queues(std::vector<Result> & results, const std::vector<std::pair<int, int>> & shapes, const Config & config)
+    {
+        run_shapes<SPSCAdapter, PayloadBytes>(results, shapes, config);
+        run_shapes<SPSCBoundedAdapter, PayloadBytes>(results, shapes, config);
+        run_shapes<MPSCAdapter, PayloadBytes>(results, shapes, config);
+        run_shapes<MPSCBoundedAdapter, PayloadBytes>(results, shapes, config);
+        run_shapes<MPMCBoundedAdapter, PayloadBytes>(results, shapes, config);
+        run_shapes<MPMCBlockingAdapter, PayloadBytes>(results, shapes, config);
+        run_shapes<MPMCFutexAdapter, PayloadBytes>(results, shapes, config);
+        run_shapes<SPMCStealingAdapter, PayloadBytes>(results, shapes, config);
+    }
+
+    // Full matrix: every queue x producer/consumer shape x payload size, single-item and bulk producers
+    inline std::vector<Result> benchmark(const Config & config = {})
+    {
+        const std::vector<std::pair<int, int>> shapes = { { 1, 1 }, { 2, 1 }, { 4, 1 }, { 1, 2 }, { 1, 4 }, { 2, 2 }, { 4, 4 } };
+        std::vector<Result> results;
+
+        Config bulk = config;
+        bulk.batch = 32;
+
+        std::cout << "--- single-item ---" << std::endl;
+        run_all_queues<16>(results, shapes, config);
+        run_all_queues<64>(results, shapes, config);
+        run_all_queues<256>(results, shapes, config);
+
+        std::cout << "--- bulk (32) ---" << std::endl;
+        run_all_queues<16>(results, shapes, bulk);
+        run_all_queues<64>(results, shapes, bulk);
+
+        return results;
+    }
+
+    // Short contention pass over every queue and shape; asserts on lost or duplicated items
+    inline void execute()
+    {
+        Config config;
+        config.itemsPerProducer = 1 << 14;
+        config.capacity = 64; // small rings so producers regularly hit the full path
+        const std::vector<std::pair<int, int>> shapes = { { 1, 1 }, { 3, 1 }, { 1, 3 }, { 3, 3 } };
+        std::vector<Result> results;
+        run_all_queues<16>(results, shapes, config);
+        config.batch = 7;
+        run_all_queues<16>(results, shapes, config);
+    }
+
+} // end namespace queue_benchmark
+
+#endif // end queue_benchmark_hpp
@@ -15,11 +15,15 @@
 
 #include "util.hpp"
 #include "math-core.hpp"
+#include "simd_lanes.hpp"
 #include <memory>
 #include <unordered_map>
 #include <array>
 #include <assert.h>
 #include <deque>
+#include <mutex>
+#include <random>
+#include <tuple>
 
 using namespace avl;
 
@@ -155,8 +159,16 @@ namespace quickhull
         MeshBuilder() = default;
         
         // Create a mesh with initial tetrahedron ABCD. Dot product of AB with the normal of triangle ABC should be negative.
-        MeshBuilder(size_t a, size_t b, size_t c, size_t d) 
+        MeshBuilder(size_t a, size_t b, size_t c, size_t d) { setup(a, b, c, d); }
+
+        // Same as the constructor, but reuses the capacity of an existing mesh. Faces must not own point vectors.
+        void setup(size_t a, size_t b, size_t c, size_t d)
         {
+            m_faces.clear();
+            m_halfEdges.clear();
+            m_disabledFaces.clear();
+            m_disabledHalfEdges.clear();
+
             // Create halfedges
             m_halfEdges.emplace_back(b, 6, 0, 1);     // ab
             m_halfEdges.emplace_back(c, 9, 0, 2);     // bc
@@ -172,15 +184,11 @@ namespace quickhull
             m_halfEdges.emplace_back(c, 4, 3, 9);     // dc
 
             // Create faces
-            Face ABC, ACD, BAD, CBD;
-            ABC.m_he = 0;
-            m_faces.push_back(std::move(ABC));
-            ACD.m_he = 3;
-            m_faces.push_back(std::move(ACD));
-            BAD.m_he = 6;
-            m_faces.push_back(std::move(BAD));
-            CBD.m_he = 9;
-            m_faces.push_back(std::move(CBD));
+            m_faces.resize(4);
+            m_faces[0].m_he = 0; // ABC
+            m_faces[1].m_he = 3; // ACD
+            m_faces[2].m_he = 6; // BAD
+            m_faces[3].m_he = 9; // CBD
         }
 
         std::array<size_t, 3> getVertexIndicesOfFace(const Face & f) const 
@@ -403,13 +411,26 @@ namespace quickhull
 
         size_t m_failedHorizonEdges{ 0 };
 
-        // Temporary variables used during iteration process
+        struct FaceData
+        {
+            size_t m_faceIndex;
+            size_t m_enteredFromHalfEdge; // If the face turns out not to be visible, this half edge will be marked as horizon edge
+            FaceData(size_t fi, size_t he) : m_faceIndex(fi), m_enteredFromHalfEdge(he) {}
+        };
+
+        // Temporary variables used during iteration process. These are members (rather than locals) so that
+        // a QuickHull object used for many hulls keeps their capacity between calls.
         std::vector<size_t> m_newFaceIndices;
         std::vector<size_t> m_newHalfEdgeIndices;
         std::vector< std::unique_ptr<std::vector<size_t>> > m_disabledFacePointVectors;
-
-        // Create a half edge mesh representing the base tetrahedron from which the QuickHull iteration proceeds. m_extremeValues must be properly set up when this is called.
-        MeshBuilder getInitialTetrahedron()
+        std::vector<size_t> m_visibleFaces;
+        std::vector<size_t> m_horizonEdges;
+        std::vector<FaceData> m_possiblyVisibleFaces;
+        std::deque<size_t> m_faceList;
+        std::vector<size_t> m_vertexRemap;
+
+        // Set up m_mesh as the base tetrahedron from which the QuickHull iteration proceeds. m_extremeValues must be properly set up when this is called.
+        void setupInitialTetrahedron()
         {
             const size_t vertexCount = m_vertexData.size();
             
@@ -426,7 +447,8 @@ namespace quickhull
                 {
                     std::swap(v[0],v[1]);
                 }
-                return MeshBuilder(v[0],v[1],v[2],v[3]);
+                m_mesh.setup(v[0],v[1],v[2],v[3]);
+                return;
             }
             
             // Find two most distant extreme points.
@@ -448,7 +470,8 @@ namespace quickhull
             // A degenerate case: the point cloud seems to consists of a single point
             if (maxD == m_epsilonSquared) 
             {
-                return MeshBuilder(0,std::min((size_t)1,vertexCount-1), std::min((size_t)2,vertexCount-1),std::min((size_t)3,vertexCount-1));
+                m_mesh.setup(0,std::min((size_t)1,vertexCount-1), std::min((size_t)2,vertexCount-1),std::min((size_t)3,vertexCount-1));
+                return;
             }
 
             assert(selectedPoints.first != selectedPoints.second);
@@ -487,7 +510,8 @@ namespace quickhull
 
                 const size_t fourthPoint = (it == m_vertexData.end()) ? selectedPoints.first : std::distance(m_vertexData.begin(),it);
 
-                return MeshBuilder(selectedPoints.first,selectedPoints.second,thirdPoint,fourthPoint);
+                m_mesh.setup(selectedPoints.first,selectedPoints.second,thirdPoint,fourthPoint);
+                return;
             }
 
             // These three points form the base triangle for our tetrahedron.
@@ -537,10 +561,10 @@ namespace quickhull
             }
 
             // Create a tetrahedron half edge mesh and compute planes defined by each triangle
-            MeshBuilder mesh(baseTriangle[0],baseTriangle[1],baseTriangle[2],maxI);
-            for (auto & f : mesh.m_faces) 
+            m_mesh.setup(baseTriangle[0],baseTriangle[1],baseTriangle[2],maxI);
+            for (auto & f : m_mesh.m_faces) 
             {
-                auto v = mesh.getVertexIndicesOfFace(f);
+                auto v = m_mesh.getVertexIndicesOfFace(f);
                 const float3 & va = m_vertexData[v[0]];
                 const float3 & vb = m_vertexData[v[1]];
                 const float3 & vc = m_vertexData[v[2]];
@@ -552,7 +576,7 @@ namespace quickhull
             // Finally we assign a face for each vertex outside the tetrahedron (vertices inside the tetrahedron have no role anymore)
             for (size_t i=0;i<vCount;i++) 
             {
-                for (auto & face : mesh.m_faces) 
+                for (auto & face : m_mesh.m_faces) 
                 {
                     if (addPointToFace(face, i)) 
                     {
@@ -560,8 +584,6 @@ namespace quickhull
                     }
                 }
             }
-
-            return mesh;
         }
 
         // Given a list of half edges, try to rearrange them so that they form a loop. Return true on success.
@@ -684,23 +706,22 @@ namespace quickhull
         // This will update m_mesh from which we create the ConvexHull object that getConvexHull function returns
         void createConvexHalfEdgeMesh()
         {
-            // Temporary variables used during iteration
-            std::vector<size_t> visibleFaces;
-            std::vector<size_t> horizonEdges;
-
-            struct FaceData 
+            auto & visibleFaces = m_visibleFaces;
+            auto & horizonEdges = m_horizonEdges;
+            auto & possiblyVisibleFaces = m_possiblyVisibleFaces;
+            auto & faceList = m_faceList;
+            faceList.clear();
+
+            // Faces left over from a previous hull (i.e. after failed horizon edges) may still own point vectors
+            for (auto & f : m_mesh.m_faces)
             {
-                size_t m_faceIndex;
-                size_t m_enteredFromHalfEdge; // If the face turns out not to be visible, this half edge will be marked as horizon edge
-                FaceData(size_t fi, size_t he) : m_faceIndex(fi), m_enteredFromHalfEdge(he) {}
-            };
-            std::vector<FaceData> possiblyVisibleFaces;
+                if (f.m_pointsOnPositiveSide) reclaimToIndexVectorPool(f.m_pointsOnPositiveSide);
+            }
 
-            m_mesh = getInitialTetrahedron(); // Compute base tetrahedron
+            setupInitialTetrahedron(); // Compute base tetrahedron
             assert(m_mesh.m_faces.size() == 4);
 
             // Init face stack with those faces that have points assigned to them
-            std::deque<size_t> faceList;
             for (size_t i=0;i < 4;i++) 
             {
                 auto & f = m_mesh.m_faces[i];
@@ -939,9 +960,8 @@ namespace quickhull
                     }
                 }
             }
-            
-            // Cleanup
-            m_indexVectorPool.clear();
+
+            // The index vector pool is kept for the next hull; reclaimToIndexVectorPool already bounds its memory
         }
         
         // Constructs the convex hull into a MeshBuilder object which can be converted to a ConvexHull or Mesh object
@@ -974,6 +994,35 @@ namespace quickhull
             return ConvexHull(m_mesh, m_vertexData, CCW, useOriginalIndices);
         }
 
+        // Writes the vertices referenced by the hull and a triangle list into outVertices/outIndices
+        void extractConvexHull(bool CCW, std::vector<float3> & outVertices, std::vector<size_t> & outIndices)
+        {
+            const size_t invalid = std::numeric_limits<size_t>::max();
+            m_vertexRemap.assign(m_vertexData.size(), invalid);
+            outVertices.clear();
+            outIndices.clear();
+
+            for (const auto & face : m_mesh.m_faces)
+            {
+                if (face.isDisabled()) continue;
+
+                auto vertices = m_mesh.getVertexIndicesOfFace(face);
+                for (auto & v : vertices)
+                {
+                    if (m_vertexRemap[v] == invalid)
+                    {
+                        m_vertexRemap[v] = outVertices.size();
+                        outVertices.push_back(m_vertexData[v]);
+                    }
+                    v = m_vertexRemap[v];
+                }
+
+                outIndices.push_back(vertices[0]);
+                outIndices.push_back(CCW ? vertices[2] : vertices[1]);
+                outIndices.push_back(CCW ? vertices[1] : vertices[2]);
+            }
+        }
+
     public:
         
         // Fair warning: QuickHull has the capacity to mutate the output of pointCloud.
@@ -990,9 +1039,372 @@ namespace quickhull
             return getConvexHull(formatOutputCCW, useOriginalIndices, eps);
         }
         
+        /*
+         * Same as above with UseOriginalIndices = false, but the hull is written into caller-owned buffers. Repeated calls
+         * on the same QuickHull object (after refilling the bound point cloud) reuse all internal storage and the capacity
+         * of the output buffers, so steady-state use does not allocate.
+         */
+        void computeConvexHull(bool formatOutputCCW, std::vector<float3> & outVertices, std::vector<size_t> & outIndices, float eps = 0.00001)
+        {
+            assert(m_vertexData.size() >= 3);
+            buildMesh(formatOutputCCW, false, eps);
+            extractConvexHull(formatOutputCCW, outVertices, outIndices);
+        }
+
         const size_t & getFailedHorizonEdges() { return m_failedHorizonEdges; }
     };
 
+    /////////////////////////////
+    //   Workspace & Batching   //
+    /////////////////////////////
+
+    // A triangle mesh of a convex hull: only the points on the hull, with indices into them
+    struct HullMesh
+    {
+        std::vector<float3> vertices;
+        std::vector<size_t> indices;
+    };
+
+    /*
+     * Owns everything needed to build hulls repeatedly without allocating once warmed up (a QuickHull bound to an
+     * internal point buffer plus its scratch storage). Before building, points that are strictly inside the convex
+     * hull of the 26 extreme points along the 13 k-DOP directions (axes, face and body diagonals) are discarded in
+     * parallel. Those points can never be hull vertices. How much this removes depends on how well the k-DOP fits the
+     * cloud: most of a uniformly filled ball, far less of elongated or off-centre shapes, so measure on your own data
+     * before counting on it. One workspace per thread.
+     */
+    class QuickHullWorkspace
+    {
+        std::vector<float3> m_points;
+        QuickHull m_hull{ m_points };
+
+        std::vector<float3> m_dopPoints;
+        QuickHull m_dopHull{ m_dopPoints };
+        std::vector<float3> m_dopVertices;
+        std::vector<size_t> m_dopIndices;
+        std::vector<float> m_dopPlanes[4]; // SoA nx, ny, nz, d; padded to the lane width with planes nothing is outside of
+
+        float3 m_dopCenter;
+        float m_dopInnerRadius2{ 0 }; // squared radius of a sphere around m_dopCenter that lies inside every culling plane
+        std::vector<uint8_t> m_keep;
+        std::mutex m_mutex;
+
+        constexpr static const size_t NUM_DOP_DIRECTIONS = 13;
+        constexpr static const size_t MIN_FILTER_POINTS = 4096; // below this, building the k-DOP costs more than it saves
+        constexpr static const size_t PARALLEL_GRAIN = 65536;
+
+        static const std::array<float3, NUM_DOP_DIRECTIONS> & get_dop_directions()
+        {
+            static const std::array<float3, NUM_DOP_DIRECTIONS> directions = {{
+                { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 },
+                { 1, 1, 0 }, { 1, -1, 0 }, { 1, 0, 1 }, { 1, 0, -1 }, { 0, 1, 1 }, { 0, 1, -1 },
+                { 1, 1, 1 }, { 1, 1, -1 }, { 1, -1, 1 }, { -1, 1, 1 }
+            }};
+            return directions;
+        }
+
+        // Builds the inward-facing culling planes (xyz = outward normal, w = distance) from the hull of the k-DOP extreme points.
+        // Returns false if the extremes are degenerate (i.e. planar input), in which case no filtering is possible.
+        bool build_dop_planes(const float3 * points, size_t count, bool parallel)
+        {
+            const auto & directions = get_dop_directions();
+
+            typedef simd::float_xN lane;
+            const size_t W = simd::lane_traits<lane>::width;
+            const size_t numRegisters = (NUM_DOP_DIRECTIONS + W - 1) / W;
+
+            // Directions are evaluated W at a time; padded lanes use the zero direction and are ignored
+            float dx[16] = {}, dy[16] = {}, dz[16] = {};
+            for (size_t d = 0; d < NUM_DOP_DIRECTIONS; ++d) { dx[d] = directions[d].x; dy[d] = directions[d].y; dz[d] = directions[d].z; }
+
+            std::array<float, NUM_DOP_DIRECTIONS * 2> best;
+            std::array<size_t, NUM_DOP_DIRECTIONS * 2> bestIndex;
+            for (size_t d = 0; d < NUM_DOP_DIRECTIONS; ++d)
+            {
+                best[d * 2 + 0] = best[d * 2 + 1] = dot(points[0], directions[d]);
+                bestIndex[d * 2 + 0] = bestIndex[d * 2 + 1] = 0;
+            }
+
+            auto find_extremes = [&](size_t begin, size_t end)
+            {
+                // Indices are tracked in float lanes relative to a block base, which is exact below 2^24
+                const size_t BLOCK = size_t(1) << 24;
+                for (size_t blockBase = begin; blockBase < end; blockBase += BLOCK)
+                {
+                    const size_t blockEnd = std::min(end, blockBase + BLOCK);
+                    lane maxV[16], minV[16], maxI[16], minI[16];
+                    for (size_t r = 0; r < numRegisters; ++r)
+                    {
+                        const float3 & p = points[blockBase];
+                        maxV[r] = minV[r] = simd::load<lane>(&dx[r * W]) * lane(p.x) + simd::load<lane>(&dy[r * W]) * lane(p.y) + simd::load<lane>(&dz[r * W]) * lane(p.z);
+                        maxI[r] = minI[r] = lane(0.0f);
+                    }
+
+                    for (size_t i = blockBase; i < blockEnd; ++i)
+                    {
+                        const lane px(points[i].x), py(points[i].y), pz(points[i].z), index(static_cast<float>(i - blockBase));
+                        for (size_t r = 0; r < numRegisters; ++r)
+                        {
+                            const lane t = simd::load<lane>(&dx[r * W]) * px + simd::load<lane>(&dy[r * W]) * py + simd::load<lane>(&dz[r * W]) * pz;
+                            const auto gt = simd::greater(t, maxV[r]);
+                            const auto lt = simd::less(t, minV[r]);
+                            maxV[r] = simd::select(gt, t, maxV[r]);
+                            maxI[r] = simd::select(gt, index, maxI[r]);
+                            minV[r] = simd::select(lt, t, minV[r]);
+                            minI[r] = simd::select(lt, index, minI[r]);
+                        }
+                    }
+
+                    float localMax[16], localMin[16], localMaxI[16], localMinI[16];
+                    for (size_t r = 0; r < numRegisters; ++r)
+                    {
+                        simd::store(&localMax[r * W], maxV[r]); simd::store(&localMin[r * W], minV[r]);
+                        simd::store(&localMaxI[r * W], maxI[r]); simd::store(&localMinI[r * W], minI[r]);
+                    }
+
+                    std::lock_guard<std::mutex> guard(m_mutex);
+                    for (size_t d = 0; d < NUM_DOP_DIRECTIONS; ++d)
+                    {
+                        if (localMax[d] > best[d * 2 + 0]) { best[d * 2 + 0] = localMax[d]; bestIndex[d * 2 + 0] = blockBase + static_cast<size_t>(localMaxI[d]); }
+                        if (localMin[d] < best[d * 2 + 1]) { best[d * 2 + 1] = localMin[d]; bestIndex[d * 2 + 1] = blockBase + static_cast<size_t>(localMinI[d]); }
+                    }
+                }
+            };
+
+            if (parallel) parallel_ranges(count, PARALLEL_GRAIN, find_extremes);
+            else find_extremes(0, count);
+
+            m_dopPoints.clear();
+            float3 centroid(0, 0, 0);
+            for (auto index : bestIndex)
+            {
+                if (std::find(m_dopPoints.begin(), m_dopPoints.end(), points[index]) == m_dopPoints.end()) m_dopPoints.push_back(points[index]);
+            }
+            if (m_dopPoints.size() < 4) return false;
+            for (const auto & p : m_dopPoints) centroid += p;
+            centroid /= static_cast<float>(m_dopPoints.size());
+
+            m_dopHull.computeConvexHull(true, m_dopVertices, m_dopIndices);
+
+            float scale = 0;
+            for (const auto & p : m_dopVertices) scale = std::max(scale, length(p - centroid));
+            const float epsilon = 0.0001f * std::max(scale, 1.0f);
+
+            for (auto & c : m_dopPlanes) c.clear();
+            float innerRadius = std::numeric_limits<float>::max();
+            for (size_t t = 0; t + 2 < m_dopIndices.size(); t += 3)
+            {
+                const float3 & a = m_dopVertices[m_dopIndices[t + 0]];
+                const float3 & b = m_dopVertices[m_dopIndices[t + 1]];
+                const float3 & c = m_dopVertices[m_dopIndices[t + 2]];
+                float3 n = cross(b - a, c - a);
+                const float len = length(n);
+                if (len <= std::numeric_limits<float>::epsilon()) continue;
+                n /= len;
+                float dist = -dot(n, a);
+                if (dot(n, centroid) + dist > 0) { n = -n; dist = -dist; } // orient outward
+                if (dot(n, centroid) + dist > -epsilon) return false;      // flat k-DOP, nothing is strictly inside
+                innerRadius = std::min(innerRadius, -(dot(n, centroid) + dist + epsilon));
+                m_dopPlanes[0].push_back(n.x);                             // pull the planes in so only clearly interior points are culled
+                m_dopPlanes[1].push_back(n.y);
+                m_dopPlanes[2].push_back(n.z);
+                m_dopPlanes[3].push_back(dist + epsilon);
+            }
+
+            if (m_dopPlanes[0].size() < 4) return false;
+
+            m_dopCenter = centroid;
+            m_dopInnerRadius2 = std::max(innerRadius, 0.0f) * std::max(innerRadius, 0.0f);
+
+            while (m_dopPlanes[0].size() % simd::lane_traits<simd::float_xN>::width)
+            {
+                m_dopPlanes[0].push_back(0); m_dopPlanes[1].push_back(0); m_dopPlanes[2].push_back(0); m_dopPlanes[3].push_back(-1);
+            }
+            return true;
+        }
+
+        void filter_points(const float3 * points, size_t count, bool parallel)
+        {
+            m_points.clear();
+
+            if (count < MIN_FILTER_POINTS || !build_dop_planes(points, count, parallel))
+            {
+                m_points.assign(points, points + count);
+                return;
+            }
+
+            m_keep.resize(count);
+            auto classify = [&](size_t begin, size_t end)
+            {
+                typedef simd::float_xN lane;
+                const size_t W = simd::lane_traits<lane>::width;
+                const size_t numPlanes = m_dopPlanes[0].size();
+                const float * nx = m_dopPlanes[0].data(), * ny = m_dopPlanes[1].data(), * nz = m_dopPlanes[2].data(), * nd = m_dopPlanes[3].data();
+                for (size_t i = begin; i < end; ++i)
+                {
+                    if (distance2(points[i], m_dopCenter) < m_dopInnerRadius2) { m_keep[i] = 0; continue; }
+
+                    const lane px(points[i].x), py(points[i].y), pz(points[i].z);
+                    uint8_t outside = 0;
+                    for (size_t k = 0; k < numPlanes; k += W)
+                    {
+                        const lane d = simd::load<lane>(nx + k) * px + simd::load<lane>(ny + k) * py + simd::load<lane>(nz + k) * pz + simd::load<lane>(nd + k);
+                        if (simd::any(simd::greater_equal(d, lane(0.0f)))) { outside = 1; break; }
+                    }
+                    m_keep[i] = outside;
+                }
+            };
+
+            if (parallel) parallel_ranges(count, PARALLEL_GRAIN, classify);
+            else classify(0, count);
+
+            // The extreme points themselves always survive, so the hull can never be emptied
+            for (size_t i = 0; i < count; ++i) if (m_keep[i]) m_points.push_back(points[i]);
+            for (const auto & p : m_dopPoints) m_points.push_back(p);
+        }
+
+    public:
+
+        QuickHullWorkspace() = default;
+        QuickHullWorkspace(const QuickHullWorkspace &) = delete;
+        QuickHullWorkspace & operator = (const QuickHullWorkspace &) = delete;
+
+        // Computes the hull of points[0..count) into out, reusing the capacity of out. Set parallel to false when the
+        // workspace is already being driven from a worker thread (i.e. compute_convex_hulls).
+        void compute(const float3 * points, size_t count, HullMesh & out, bool formatOutputCCW = true, bool parallel = true)
+        {
+            assert(count >= 3);
+            filter_points(points, count, parallel);
+            m_hull.computeConvexHull(formatOutputCCW, out.vertices, out.indices);
+        }
+
+        void compute(const std::vector<float3> & points, HullMesh & out, bool formatOutputCCW = true, bool parallel = true)
+        {
+            compute(points.data(), points.size(), out, formatOutputCCW, parallel);
+        }
+
+        // Number of points that survived the k-DOP cull on the last call
+        size_t get_filtered_point_count() const { return m_points.size(); }
+    };
+
+    // Builds many hulls at once. Each hardware thread owns one workspace and takes a contiguous range of the input sets.
+    inline std::vector<HullMesh> compute_convex_hulls(const std::vector<std::vector<float3>> & pointSets, bool formatOutputCCW = true)
+    {
+        std::vector<HullMesh> hulls(pointSets.size());
+        parallel_ranges(pointSets.size(), 1, [&](size_t begin, size_t end)
+        {
+            QuickHullWorkspace workspace;
+            for (size_t i = begin; i < end; ++i)
+            {
+                if (pointSets[i].size() >= 3) workspace.compute(pointSets[i], hulls[i], formatOutputCCW, false);
+            }
+        });
+        return hulls;
+    }
+
 } // namespace quickhull
 
+namespace quickhull_tests
+{
+    // Checks the filtered workspace on a ball, a flat ellipsoid and a rotated, offset ellipsoid (where the k-DOP cull
+    // removes little): the hull is closed and convex with consistently wound faces, contains every input point, and has the same
+    // vertices as the parallel path, the serial path and a plain QuickHull over the unfiltered input.
+    inline void execute()
+    {
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<float> dist(-1.f, 1.f);
+        const float4 rotation = make_rotation_quat_axis_angle(normalize(float3(1, 2, 3)), 0.7f);
+
+        for (int shape = 0; shape < 3; ++shape)
+        {
+            std::vector<float3> points;
+            while (points.size() < 20000)
+            {
+                const float3 p(dist(gen), dist(gen), dist(gen));
+                if (length2(p) > 1.0f) continue;
+                if (shape == 0) points.push_back(p);
+                else if (shape == 1) points.push_back(p * float3(3.0f, 1.0f, 0.3f));
+                else points.push_back(qrot(rotation, p * float3(3.0f, 1.0f, 0.3f)) + float3(5, -2, 7));
+            }
+
+            quickhull::QuickHullWorkspace workspace;
+            quickhull::HullMesh parallelMesh, serialMesh;
+            workspace.compute(points, parallelMesh);
+            assert(workspace.get_filtered_point_count() < points.size());
+            workspace.compute(points, serialMesh, true, false);
+            assert(parallelMesh.vertices == serialMesh.vertices && parallelMesh.indices == serialMesh.indices);
+
+            std::vector<float3> copy = points;
+            quickhull::QuickHull reference(copy);
+            std::vector<float3> referenceVertices = reference.computeConvexHull(true, false).getVertexBuffer();
+
+            const quickhull::HullMesh & mesh = parallelMesh;
+            assert(mesh.indices.size() >= 12 && mesh.indices.size() % 3 == 0);
+            assert(mesh.indices.size() / 3 == 2 * mesh.vertices.size() - 4); // closed triangulated sphere (Euler)
+
+            float3 centroid(0, 0, 0);
+            for (const auto & v : mesh.vertices) centroid += v;
+            centroid /= static_cast<float>(mesh.vertices.size());
+
+            const float tolerance = 1e-3f; // the shapes span a few units
+            for (size_t t = 0; t < mesh.indices.size(); t += 3)
+            {
+                const float3 & a = mesh.vertices[mesh.indices[t]], & b = mesh.vertices[mesh.indices[t + 1]], & c = mesh.vertices[mesh.indices[t + 2]];
+                const float3 n = normalize(cross(c - a, b - a)); // formatOutputCCW winds cross(b - a, c - a) inward
+                assert(dot(n, centroid - a) < 0.f);
+                for (const auto & v : mesh.vertices) assert(dot(n, v - a) <= tolerance);
+                for (const auto & p : points) assert(dot(n, p - a) <= tolerance);
+            }
+
+            auto less = [](const float3 & a, const float3 & b) { return std::make_tuple(a.x, a.y, a.z) < std::make_tuple(b.x, b.y, b.z); };
+            std::vector<float3> sortedVertices = mesh.vertices;
+            std::sort(sortedVertices.begin(), sortedVertices.end(), less);
+            std::sort(referenceVertices.begin(), referenceVertices.end(), less);
+            assert(sortedVertices == referenceVertices);
+        }
+    }
+
+    // Times the plain QuickHull against the filtered workspace on uniformly filled spheres and noisy spherical shells
+    // (a stand-in for scanned data, where most points lie near the surface) from 100k to 10M points.
+    inline void benchmark()
+    {
+        std::mt19937 gen(1337);
+        std::uniform_real_distribution<float> dist(-1.f, 1.f);
+        std::normal_distribution<float> noise(0.f, 0.01f);
+
+        for (size_t count : { size_t(100000), size_t(1000000), size_t(10000000) })
+        {
+            for (int shell = 0; shell < 2; ++shell)
+            {
+                std::vector<float3> points;
+                points.reserve(count);
+                while (points.size() < count)
+                {
+                    const float3 p(dist(gen), dist(gen), dist(gen));
+                    if (length2(p) > 1.0f || length2(p) < 1e-6f) continue;
+                    points.push_back(shell ? normalize(p) * (1.0f + noise(gen)) : p);
+                }
+
+                const std::string label = std::to_string(count) + (shell ? " shell" : " solid");
+                size_t referenceFaces = 0;
+                {
+                    std::vector<float3> copy = points;
+                    AVL_SCOPED_TIMER("QuickHull " + label);
+                    quickhull::QuickHull hull(copy);
+                    referenceFaces = hull.computeConvexHull(true, false).getIndexBuffer().size() / 3;
+                }
+
+                quickhull::QuickHullWorkspace workspace;
+                quickhull::HullMesh mesh;
+                workspace.compute(points, mesh); // warm up
+                {
+                    AVL_SCOPED_TIMER("QuickHullWorkspace " + label);
+                    workspace.compute(points, mesh);
+                }
+                std::cout << "    faces: " << referenceFaces << " / " << mesh.indices.size() / 3 << ", points after k-DOP cull: " << workspace.get_filtered_point_count() << std::endl;
+            }
+        }
+    }
+}
+
 #endif // quick_hull_hpp
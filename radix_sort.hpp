@@ -11,6 +11,7 @@
 #include <algorithm>
 #include <utility>
 #include <vector>
+#include <type_traits>
 
 class RadixSort
 {
@@ -73,14 +74,88 @@ class RadixSort
         }
     }
 
+    // Sorts keys and carries a parallel payload array along with them (i.e. a permutation of indices)
+    template<typename K, typename V>
+    void radix_pairs_impl(K * keys, V * values, size_t size)
+    {
+        const uint32_t PASSES = (sizeof(K) * 8) % RADIX_LENGTH_BITS == 0 ? (sizeof(K) * 8) / RADIX_LENGTH_BITS : (sizeof(K) * 8) / RADIX_LENGTH_BITS + 1;
+
+        std::vector<size_t> histograms(PASSES * HISTOGRAM_BUCKETS);
+        std::vector<K> resultKeys(size);
+        std::vector<V> resultValues(size);
+
+        for (size_t i = 0; i < size; i++)
+        {
+            K element = keys[i];
+
+            for (uint32_t r = 0; r < PASSES; r++)
+            {
+                K pos = (element >> (r * RADIX_LENGTH_BITS)) & BIT_MASK;
+                histograms[r * HISTOGRAM_BUCKETS + pos] += 1;
+            }
+        }
+
+        // Passes where every key lands in the same bucket are skipped (common for the high bits of morton codes)
+        std::vector<bool> trivialPass(PASSES);
+        for (uint32_t r = 0; r < PASSES; r++)
+        {
+            const K firstPos = (keys[0] >> (r * RADIX_LENGTH_BITS)) & BIT_MASK;
+            trivialPass[r] = (histograms[r * HISTOGRAM_BUCKETS + firstPos] == size);
+
+            size_t sum = 0;
+            for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+            {
+                size_t val = histograms[r * HISTOGRAM_BUCKETS + i];
+                histograms[r * HISTOGRAM_BUCKETS + i] = sum;
+                sum += val;
+            }
+        }
+
+        K * srcKeys = keys;
+        K * dstKeys = resultKeys.data();
+        V * srcValues = values;
+        V * dstValues = resultValues.data();
+        for (uint32_t r = 0; r < PASSES; r++)
+        {
+            if (trivialPass[r]) continue;
+
+            for (size_t i = 0; i < size; i++)
+            {
+                K element = srcKeys[i];
+                K pos = ((element >> (r * RADIX_LENGTH_BITS)) & BIT_MASK);
+
+                size_t & index = histograms[r * HISTOGRAM_BUCKETS + pos];
+                dstKeys[index] = element;
+                dstValues[index] = srcValues[i];
+                index++;
+            }
+
+            std::swap(srcKeys, dstKeys);
+            std::swap(srcValues, dstValues);
+        }
+
+        if (srcKeys != keys)
+        {
+            std::copy(srcKeys, srcKeys + size, keys);
+            std::copy(srcValues, srcValues + size, values);
+        }
+    }
+
 public:
 
-    template<typename T = typename std::enable_if<std::is_integral<T>::value, T>::type>
-    void sort(T * data, size_t size)
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value>::type sort(T * data, size_t size)
     {
         radix_impl<T>(data, size);
     }
 
+    template<typename K, typename V>
+    typename std::enable_if<std::is_integral<K>::value>::type sort(K * keys, V * values, size_t size)
+    {
+        if (size == 0) return;
+        radix_pairs_impl<K, V>(keys, values, size);
+    }
+
     void sort(float * data, size_t size)
     {
         for (size_t i = 0; i < size; i++) float_flip((uint32_t &)data[i]);
@@ -4,6 +4,20 @@
 #define running_stats_h
 
 #include <stdint.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <assert.h>
+#include "simd_lanes.hpp"
+#include "util.hpp"
 
 namespace avl
 {
@@ -13,6 +27,63 @@ namespace avl
     {
         uint64_t n;
         T M1, M2, M3, M4;
+        // Moments about `shift` (a first estimate of the mean): sums of d, d^2, d^3 and d^4 for d = x - shift
+        template<typename U = T>
+        static typename std::enable_if<!std::is_same<U, float>::value>::type shifted_sums(const U * x, const size_t count, const U shift, U (&sums)[4])
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                const U d = x[i] - shift, d2 = d * d;
+                sums[0] += d; sums[1] += d2; sums[2] += d2 * d; sums[3] += d2 * d2;
+            }
+        }
+
+        template<typename U = T>
+        static typename std::enable_if<std::is_same<U, float>::value>::type shifted_sums(const float * x, const size_t count, const float shift, float (&sums)[4])
+        {
+            typedef simd::float_xN lanes;
+            const size_t W = simd::lane_traits<lanes>::width;
+            lanes s1(0.f), s2(0.f), s3(0.f), s4(0.f);
+            const lanes m(shift);
+            size_t i = 0;
+            for (; i + W <= count; i += W)
+            {
+                const lanes d = simd::load<lanes>(x + i) - m, d2 = d * d;
+                s1 = s1 + d; s2 = s2 + d2; s3 = s3 + d2 * d; s4 = s4 + d2 * d2;
+            }
+
+            float lane[4][W];
+            simd::store(lane[0], s1); simd::store(lane[1], s2); simd::store(lane[2], s3); simd::store(lane[3], s4);
+            for (size_t k = 0; k < 4; ++k) for (size_t j = 0; j < W; ++j) sums[k] += lane[k][j];
+            for (; i < count; ++i)
+            {
+                const float d = x[i] - shift, d2 = d * d;
+                sums[0] += d; sums[1] += d2; sums[2] += d2 * d; sums[3] += d2 * d2;
+            }
+        }
+
+        static RunningStats from_block(const T * x, const size_t count)
+        {
+            RunningStats r;
+            if (count == 0) return r;
+
+            // A rough mean first keeps the power sums small; the residual shift e is then removed exactly
+            T zero[4] = { 0, 0, 0, 0 };
+            shifted_sums<T>(x, count, T(0), zero);
+            const T shift = zero[0] / T(count);
+
+            T sums[4] = { 0, 0, 0, 0 };
+            shifted_sums<T>(x, count, shift, sums);
+            const T c = T(count), e = sums[0] / c, e2 = e * e;
+
+            r.n = count;
+            r.M1 = shift + e;
+            r.M2 = sums[1] - c * e2;
+            r.M3 = sums[2] - T(3) * e * sums[1] + T(2) * c * e2 * e;
+            r.M4 = sums[3] - T(4) * e * sums[2] + T(6) * e2 * sums[1] - T(3) * c * e2 * e2;
+            return r;
+        }
+
     public:
 
         RunningStats()
@@ -22,21 +93,27 @@ namespace avl
 
         friend RunningStats operator + (const RunningStats a, const RunningStats b)
         {
+            if (a.n == 0) return b;
+            if (b.n == 0) return a;
+
             RunningStats combined;
 
             combined.n += a.n + b.n;
 
+            // Counts as T: (na - nb) must not wrap around in unsigned arithmetic
+            const T na = T(a.n), nb = T(b.n), n = T(combined.n);
+
             T delta = b.M1 - a.M1;
             T delta2 = delta*delta;
             T delta3 = delta*delta2;
             T delta4 = delta2*delta2;
 
-            combined.M1 = (a.n*a.M1 + b.n*b.M1) / combined.n;
-            combined.M2 = a.M2 + b.M2 + delta2 * a.n * b.n / combined.n;
-            combined.M3 = a.M3 + b.M3 +  delta3 * a.n * b.n * (a.n - b.n)/(combined.n*combined.n);
-            combined.M3 += 3.0 * delta * (a.n*b.M2 - b.n*a.M2) / combined.n;
-            combined.M4 = a.M4 + b.M4 + delta4*a.n*b.n * (a.n*a.n - a.n*b.n + b.n*b.n) / (combined.n*combined.n*combined.n);
-            combined.M4 += 6.0 * delta2 * (a.n*a.n*b.M2 + b.n*b.n*a.M2)/(combined.n*combined.n) + 4.0 * delta*(a.n*b.M3 - b.n*a.M3) / combined.n;
+            combined.M1 = (na*a.M1 + nb*b.M1) / n;
+            combined.M2 = a.M2 + b.M2 + delta2 * na * nb / n;
+            combined.M3 = a.M3 + b.M3 +  delta3 * na * nb * (na - nb)/(n*n);
+            combined.M3 += T(3.0) * delta * (na*b.M2 - nb*a.M2) / n;
+            combined.M4 = a.M4 + b.M4 + delta4*na*nb * (na*na - na*nb + nb*nb) / (n*n*n);
+            combined.M4 += T(6.0) * delta2 * (na*na*b.M2 + nb*nb*a.M2)/(n*n) + T(4.0) * delta*(na*b.M3 - nb*a.M3) / n;
 
             return combined;
         }
@@ -70,6 +147,16 @@ namespace avl
             M2 += term1;
         }
 
+        // Adds a batch: the central moments of each block are summed in two passes (SIMD lanes for float) and the
+        // block is merged with operator +, which costs far less per value than put(x) and is more accurate
+        void put(const T * values, const size_t count)
+        {
+            const size_t BLOCK = 1024;
+            for (size_t begin = 0; begin < count; begin += BLOCK) *this += from_block(values + begin, std::min(BLOCK, count - begin));
+        }
+
+        void put(const std::vector<T> & values) { put(values.data(), values.size()); }
+
         uint64_t num_values() const
         {
             return n;
@@ -102,6 +189,294 @@ namespace avl
 
     };
 
+    /*
+     * DDSketch (Masson, Rim and Lee, VLDB 2019): a mergeable quantile sketch with relative-error guarantees. Positive
+     * values fall into logarithmic bins of ratio gamma = (1 + a) / (1 - a), so any quantile is reported within a
+     * relative error `a` of a value in the sketch's rank neighbourhood. Sketches with the same accuracy merge exactly
+     * with operator +. When more than maxBins bins are in use the lowest ones are collapsed, which only degrades the
+     * lowest quantiles. Values at or below zero are counted together in a zero bin (durations and latencies).
+     */
+    class QuantileSketch
+    {
+        double accuracy, gamma, inverseLogGamma;
+        size_t maxBins;
+        std::vector<uint64_t> bins;
+        int32_t offset{ 0 };                 // key of bins[0]
+        uint64_t zeroCount{ 0 }, count{ 0 };
+        double minValue{ std::numeric_limits<double>::infinity() }, maxValue{ -std::numeric_limits<double>::infinity() }, sum{ 0.0 };
+
+        constexpr static const double MIN_POSITIVE = 1e-12;
+
+        int32_t key(const double x) const { return static_cast<int32_t>(std::ceil(std::log(x) * inverseLogGamma)); }
+
+        // Makes room for `k`, growing either end and collapsing the lowest bins past maxBins; returns its bin
+        uint64_t & bin(int32_t k)
+        {
+            if (bins.empty())
+            {
+                offset = k;
+                bins.assign(1, 0);
+            }
+            else if (k < offset)
+            {
+                const int32_t highest = offset + int32_t(bins.size()) - 1;
+                if (size_t(highest - k + 1) > maxBins) k = std::min(offset, highest - int32_t(maxBins) + 1);
+                bins.insert(bins.begin(), size_t(offset - k), 0);
+                offset = k;
+            }
+            else if (k >= offset + int32_t(bins.size()))
+            {
+                bins.resize(size_t(k - offset + 1), 0);
+                if (bins.size() > maxBins)
+                {
+                    const size_t excess = bins.size() - maxBins;
+                    uint64_t folded = 0;
+                    for (size_t i = 0; i < excess; ++i) folded += bins[i];
+                    bins.erase(bins.begin(), bins.begin() + excess);
+                    bins[0] += folded;
+                    offset += int32_t(excess);
+                }
+            }
+            return bins[size_t(std::max(k, offset) - offset)];
+        }
+
+        void add(const double x, const uint64_t weight)
+        {
+            if (x > MIN_POSITIVE) bin(key(x)) += weight;
+            else zeroCount += weight;
+        }
+
+    public:
+
+        explicit QuantileSketch(const double relativeAccuracy = 0.01, const size_t maxBins = 2048)
+            : accuracy(relativeAccuracy), gamma((1.0 + relativeAccuracy) / (1.0 - relativeAccuracy)), inverseLogGamma(1.0 / std::log(gamma)), maxBins(std::max<size_t>(maxBins, 16))
+        {
+            assert(relativeAccuracy > 0.0 && relativeAccuracy < 1.0);
+        }
+
+        void put(const double x)
+        {
+            add(x, 1);
+            count++;
+            sum += x;
+            minValue = std::min(minValue, x);
+            maxValue = std::max(maxValue, x);
+        }
+
+        template<typename T> void put(const T * values, const size_t n) { for (size_t i = 0; i < n; ++i) put(double(values[i])); }
+
+        // q in [0, 1]; q = 0 and q = 1 are the exact minimum and maximum. NaN when empty.
+        double quantile(const double q) const
+        {
+            if (count == 0) return std::numeric_limits<double>::quiet_NaN();
+            if (q <= 0.0) return minValue;
+            if (q >= 1.0) return maxValue;
+
+            const double rank = q * double(count - 1);
+            double seen = double(zeroCount);
+            if (rank < seen) return std::max(minValue, std::min(0.0, maxValue));
+            for (size_t i = 0; i < bins.size(); ++i)
+            {
+                seen += double(bins[i]);
+                if (rank < seen)
+                {
+                    const double estimate = 2.0 * std::pow(gamma, double(offset + int32_t(i))) / (gamma + 1.0);
+                    return std::max(minValue, std::min(maxValue, estimate));
+                }
+            }
+            return maxValue;
+        }
+
+        friend QuantileSketch operator + (QuantileSketch a, const QuantileSketch & b)
+        {
+            a += b;
+            return a;
+        }
+
+        QuantileSketch & operator += (const QuantileSketch & rhs)
+        {
+            assert(rhs.accuracy == accuracy);
+            if (rhs.count == 0) return *this;
+            // Widen toward the higher end first so the lowest-bin collapse sees the final range only once
+            if (!rhs.bins.empty()) bin(rhs.offset + int32_t(rhs.bins.size()) - 1);
+            for (size_t i = 0; i < rhs.bins.size(); ++i) if (rhs.bins[i]) bin(rhs.offset + int32_t(i)) += rhs.bins[i];
+            zeroCount += rhs.zeroCount;
+            count += rhs.count;
+            sum += rhs.sum;
+            minValue = std::min(minValue, rhs.minValue);
+            maxValue = std::max(maxValue, rhs.maxValue);
+            return *this;
+        }
+
+        void clear()
+        {
+            bins.clear();
+            offset = 0;
+            zeroCount = count = 0;
+            sum = 0.0;
+            minValue = std::numeric_limits<double>::infinity();
+            maxValue = -std::numeric_limits<double>::infinity();
+        }
+
+        uint64_t num_values() const { return count; }
+        double compute_mean() const { return count ? sum / double(count) : 0.0; }
+        double get_min() const { return minValue; }
+        double get_max() const { return maxValue; }
+        double get_relative_accuracy() const { return accuracy; }
+        size_t get_bin_count() const { return bins.size(); }
+    };
+
+    /*
+     * Per-thread accumulation for any mergeable statistic (RunningStats, QuantileSketch): each thread updates one of
+     * a fixed set of stripes, chosen once per thread from its id, under that stripe's own lock, which is uncontended
+     * unless two threads share a stripe or a merge is in progress. merged() folds the stripes together with +=.
+     */
+    template<class Accumulator, size_t STRIPES = 16>
+    class StripedAccumulator
+    {
+        struct alignas(64) Stripe
+        {
+            mutable std::mutex mutex;
+            Accumulator value;
+        };
+
+        Accumulator prototype;
+        std::array<Stripe, STRIPES> stripes;
+
+        Stripe & local()
+        {
+            static thread_local const size_t index = std::hash<std::thread::id>()(std::this_thread::get_id());
+            return stripes[index % STRIPES];
+        }
+
+    public:
+
+        // Every stripe starts as a copy of `prototype` (e.g. a QuantileSketch with the wanted accuracy)
+        explicit StripedAccumulator(const Accumulator & prototype = Accumulator()) : prototype(prototype)
+        {
+            for (auto & s : stripes) s.value = prototype;
+        }
+
+        template<class Fn> void update(Fn && fn)
+        {
+            Stripe & s = local();
+            std::lock_guard<std::mutex> g(s.mutex);
+            fn(s.value);
+        }
+
+        template<class T> void put(const T & x) { update([&](Accumulator & a) { a.put(x); }); }
+        template<class T> void put(const T * values, const size_t n) { update([&](Accumulator & a) { a.put(values, n); }); }
+
+        Accumulator merged() const
+        {
+            Accumulator result = prototype;
+            for (auto & s : stripes)
+            {
+                std::lock_guard<std::mutex> g(s.mutex);
+                result += s.value;
+            }
+            return result;
+        }
+
+        // Merges and resets in one pass, e.g. once per telemetry interval
+        Accumulator drain()
+        {
+            Accumulator result = prototype;
+            for (auto & s : stripes)
+            {
+                std::lock_guard<std::mutex> g(s.mutex);
+                result += s.value;
+                s.value = prototype;
+            }
+            return result;
+        }
+    };
+
+    namespace running_statistics_tests
+    {
+        inline bool close(const double a, const double b, const double tolerance) { return std::abs(a - b) <= tolerance * std::max(1.0, std::abs(b)); }
+
+        inline void execute()
+        {
+            std::mt19937 gen(5);
+            std::gamma_distribution<float> frameTimes(9.f, 2.f);    // skewed, like frame times in ms
+            std::vector<float> values(100003);
+            for (auto & v : values) v = frameTimes(gen);
+
+            // Double-precision reference
+            RunningStats<double> reference;
+            for (auto v : values) reference.put(double(v));
+
+            // Batched float, and merged halves (including empty and uneven sides)
+            RunningStats<float> batched, left, right;
+            const RunningStats<float> empty;
+            batched.put(values);
+            left.put(values.data(), 7);
+            right.put(values.data() + 7, values.size() - 7);
+            const RunningStats<float> merged = empty + left + right + empty;
+            for (const RunningStats<float> * r : { static_cast<const RunningStats<float> *>(&batched), &merged })
+            {
+                assert(r->num_values() == values.size());
+                assert(close(r->compute_mean(), reference.compute_mean(), 1e-5));
+                assert(close(r->compute_variance(), reference.compute_variance(), 1e-4));
+                assert(close(r->compute_skewness(), reference.compute_skewness(), 1e-3));
+                assert(close(r->compute_kurtosis(), reference.compute_kurtosis(), 1e-3));
+            }
+
+            // Sketch quantiles within the relative accuracy of the exact order statistics
+            std::vector<float> sorted = values;
+            std::sort(sorted.begin(), sorted.end());
+            QuantileSketch sketch(0.01), a(0.01), b(0.01);
+            sketch.put(values.data(), values.size());
+            a.put(values.data(), values.size() / 3);
+            b.put(values.data() + values.size() / 3, values.size() - values.size() / 3);
+            const QuantileSketch combined = a + b;
+            for (double q : { 0.0, 0.01, 0.5, 0.95, 0.99, 0.999, 1.0 })
+            {
+                const double exact = sorted[size_t(q * (sorted.size() - 1))];
+                assert(close(sketch.quantile(q), exact, 0.0101));
+                assert(combined.quantile(q) == sketch.quantile(q));
+            }
+
+            // Bounded bins: collapsing the low end keeps the upper quantiles intact
+            QuantileSketch narrow(0.01, 64);
+            for (int i = -20; i <= 20; ++i) narrow.put(std::pow(10.0, i * 0.25));
+            assert(narrow.get_bin_count() <= 64 && close(narrow.quantile(0.99), std::pow(10.0, 4.75), 0.011) && narrow.quantile(0.0) == std::pow(10.0, -5.0));
+
+            // Concurrent producers
+            StripedAccumulator<QuantileSketch> concurrentSketch(QuantileSketch(0.01));
+            StripedAccumulator<RunningStats<double>> concurrentStats;
+            std::vector<std::thread> threads;
+            for (size_t t = 0; t < 4; ++t)
+            {
+                threads.emplace_back([&, t]()
+                {
+                    for (size_t i = t; i < values.size(); i += 4) { concurrentSketch.put(double(values[i])); concurrentStats.put(double(values[i])); }
+                });
+            }
+            for (auto & t : threads) t.join();
+            const RunningStats<double> total = concurrentStats.drain();
+            assert(total.num_values() == values.size() && close(total.compute_mean(), reference.compute_mean(), 1e-9));
+            assert(concurrentSketch.merged().quantile(0.5) == sketch.quantile(0.5));
+            assert(concurrentStats.merged().num_values() == 0);
+        }
+
+        inline void benchmark(const size_t count = 1 << 22)
+        {
+            std::mt19937 gen(11);
+            std::uniform_real_distribution<float> dist(1.f, 40.f);
+            std::vector<float> values(count);
+            for (auto & v : values) v = dist(gen);
+
+            RunningStats<float> scalar, batched;
+            QuantileSketch sketch;
+            { AVL_SCOPED_TIMER("RunningStats::put(x)"); for (auto v : values) scalar.put(v); }
+            { AVL_SCOPED_TIMER("RunningStats::put(values, count)"); batched.put(values); }
+            { AVL_SCOPED_TIMER("QuantileSketch::put(values, count)"); sketch.put(values.data(), values.size()); }
+            std::cout << scalar.compute_mean() << " " << batched.compute_mean() << " p99 " << sketch.quantile(0.99) << std::endl;
+        }
+    }
+
 }
  
 #endif // end running_stats_h
\ No newline at end of file
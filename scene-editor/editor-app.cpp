@@ -54,18 +54,21 @@ scene_editor_app::scene_editor_app() : GLFWApp(1920, 1080, "Scene Editor")
     shaderMonitor.watch(
         "../assets/shaders/renderer/forward_lighting_vert.glsl",
         "../assets/shaders/renderer/default_material_frag.glsl",
-        "../assets/shaders/renderer", {}, [](GlShader shader)
+        "../assets/shaders/renderer", meshFormat.shader_defines(), [](GlShader shader)
     {
         create_handle_for_asset("default-shader", std::move(shader));
     });
 
+    std::vector<std::string> pbrDefines = { "TWO_CASCADES", "USE_PCF_3X3", "ENABLE_SHADOWS",
+        "USE_IMAGE_BASED_LIGHTING",
+        "HAS_ROUGHNESS_MAP", "HAS_METALNESS_MAP", "HAS_ALBEDO_MAP", "HAS_NORMAL_MAP", "HAS_OCCLUSION_MAP" };
+    for (const auto & define : meshFormat.shader_defines()) pbrDefines.push_back(define);
+
     pbrProgramAsset = shaderMonitor.watch(
         "../assets/shaders/renderer/forward_lighting_vert.glsl",
         "../assets/shaders/renderer/forward_lighting_frag.glsl",
         "../assets/shaders/renderer",
-        { "TWO_CASCADES", "USE_PCF_3X3", "ENABLE_SHADOWS",
-         "USE_IMAGE_BASED_LIGHTING",
-         "HAS_ROUGHNESS_MAP", "HAS_METALNESS_MAP", "HAS_ALBEDO_MAP", "HAS_NORMAL_MAP", "HAS_OCCLUSION_MAP" }, [](GlShader shader)
+        pbrDefines, [](GlShader shader)
     {
         create_handle_for_asset("pbr-forward-lighting", std::move(shader));
     });
@@ -113,17 +116,23 @@ scene_editor_app::scene_editor_app() : GLFWApp(1920, 1080, "Scene Editor")
     create_handle_for_asset("wells-radiance-cubemap", load_cubemap(radianceHandle));
     create_handle_for_asset("wells-irradiance-cubemap", load_cubemap(irradianceHandle));
 
-    create_handle_for_asset("rusted-iron-albedo", load_image("../assets/nonfree/Metal_ModernMetalIsoDiamondTile_2k_basecolor.tga", false));
-    create_handle_for_asset("rusted-iron-normal", load_image("../assets/nonfree/Metal_ModernMetalIsoDiamondTile_2k_n.tga", false));
-    create_handle_for_asset("rusted-iron-metallic", load_image("../assets/nonfree/Metal_ModernMetalIsoDiamondTile_2k_metallic.tga", false));
-    create_handle_for_asset("rusted-iron-roughness", load_image("../assets/nonfree/Metal_ModernMetalIsoDiamondTile_2k_roughness.tga", false));
-    create_handle_for_asset("rusted-iron-occlusion", load_image("../assets/nonfree/Metal_ModernMetalIsoDiamondTile_2k_ao.tga", false));
+    // Material textures stream in over the first frames instead of blocking startup
+    textureStreamer.reset(new TextureStreamer([](const std::string & name, GlTexture2D && texture)
+    {
+        create_handle_for_asset(name.c_str(), std::move(texture));
+    }));
+
+    textureStreamer->request("rusted-iron-albedo", "../assets/nonfree/Metal_ModernMetalIsoDiamondTile_2k_basecolor.tga");
+    textureStreamer->request("rusted-iron-normal", "../assets/nonfree/Metal_ModernMetalIsoDiamondTile_2k_n.tga");
+    textureStreamer->request("rusted-iron-metallic", "../assets/nonfree/Metal_ModernMetalIsoDiamondTile_2k_metallic.tga");
+    textureStreamer->request("rusted-iron-roughness", "../assets/nonfree/Metal_ModernMetalIsoDiamondTile_2k_roughness.tga");
+    textureStreamer->request("rusted-iron-occlusion", "../assets/nonfree/Metal_ModernMetalIsoDiamondTile_2k_ao.tga");
 
-    create_handle_for_asset("scifi-floor-albedo", load_image("../assets/nonfree/Metal_ScifiHangarFloor_2k_basecolor.tga", false));
-    create_handle_for_asset("scifi-floor-normal", load_image("../assets/nonfree/Metal_ScifiHangarFloor_2k_n.tga", false));
-    create_handle_for_asset("scifi-floor-metallic", load_image("../assets/nonfree/Metal_ScifiHangarFloor_2k_metallic.tga", false));
-    create_handle_for_asset("scifi-floor-roughness", load_image("../assets/nonfree/Metal_ScifiHangarFloor_2k_roughness.tga", false));
-    create_handle_for_asset("scifi-floor-occlusion", load_image("../assets/nonfree/Metal_ScifiHangarFloor_2k_ao.tga", false));
+    textureStreamer->request("scifi-floor-albedo", "../assets/nonfree/Metal_ScifiHangarFloor_2k_basecolor.tga");
+    textureStreamer->request("scifi-floor-normal", "../assets/nonfree/Metal_ScifiHangarFloor_2k_n.tga");
+    textureStreamer->request("scifi-floor-metallic", "../assets/nonfree/Metal_ScifiHangarFloor_2k_metallic.tga");
+    textureStreamer->request("scifi-floor-roughness", "../assets/nonfree/Metal_ScifiHangarFloor_2k_roughness.tga");
+    textureStreamer->request("scifi-floor-occlusion", "../assets/nonfree/Metal_ScifiHangarFloor_2k_ao.tga");
 
     std::shared_ptr<DefaultMaterial> default = std::make_shared<DefaultMaterial>();
     create_handle_for_asset("default-material", static_cast<std::shared_ptr<Material>>(default));
@@ -146,43 +155,43 @@ scene_editor_app::scene_editor_app() : GLFWApp(1920, 1080, "Scene Editor")
     */
 
     auto cap = make_icosasphere(3);
-    create_handle_for_asset("shaderball", make_mesh_from_geometry(cap));
+    create_handle_for_asset("shaderball", make_mesh_from_geometry(cap, meshFormat));
     create_handle_for_asset("shaderball", std::move(cap));
 
     auto ico = make_icosasphere(5);
-    create_handle_for_asset("icosphere", make_mesh_from_geometry(ico));
+    create_handle_for_asset("icosphere", make_mesh_from_geometry(ico, meshFormat));
     create_handle_for_asset("icosphere", std::move(ico));
 
     auto cube = make_cube();
-    create_handle_for_asset("cube", make_mesh_from_geometry(cube));
+    create_handle_for_asset("cube", make_mesh_from_geometry(cube, meshFormat));
     create_handle_for_asset("cube", std::move(cube));
 
+    // Imported models are cooked once into the runtime folder and reloaded from there on later drops and sessions
+    modelCache.reset(new DerivedDataCache("../assets/models/runtime/", [this](const std::string & name, Geometry && geometry)
+    {
+        create_handle_for_asset(name.c_str(), make_mesh_from_geometry(geometry, meshFormat));
+        create_handle_for_asset(name.c_str(), std::move(geometry));
+
+        // Meshes deserialized before their geometry streamed in have empty bounds until now
+        for (auto & obj : scene.objects)
+        {
+            if (auto * mesh = dynamic_cast<StaticMesh*>(obj.get())) if (mesh->geom.name == name) mesh->update_bounds();
+        }
+    }));
+
     scene.objects.clear();
     cereal::deserialize_from_json("../assets/scene.json", scene.objects);
 
     std::unordered_map<std::string, uint32_t> missingGeometryAssets;
     std::unordered_map<std::string, uint32_t> missingMeshAssets;
 
+    // Meshes imported in earlier sessions stream back in from the cache; anything else is reported
     for (auto & obj : scene.objects)
     {
         if (auto * mesh = dynamic_cast<StaticMesh*>(obj.get()))
         {
-            bool foundGeom = false;
-            bool foundMesh = false;
-
-            for (auto & h : AssetHandle<Geometry>::list())
-            {
-                if (h.name == mesh->geom.name) foundGeom = true;
-            }
-
-            for (auto & h : AssetHandle<GlMesh>::list())
-            {
-                if (h.name == mesh->mesh.name) foundMesh = true;
-            }
-
-            if (!foundGeom) missingGeometryAssets[mesh->geom.name] += 1;
-            if (!foundMesh) missingMeshAssets[mesh->mesh.name] += 1;
-
+            if (!GeometryHandle::contains(mesh->geom.name) && !modelCache->request_cooked(mesh->geom.name)) missingGeometryAssets[mesh->geom.name] += 1;
+            if (!GlMeshHandle::contains(mesh->mesh.name) && !modelCache->request_cooked(mesh->mesh.name)) missingMeshAssets[mesh->mesh.name] += 1;
         }
     }
 
@@ -222,27 +231,7 @@ void scene_editor_app::on_drop(std::vector<std::string> filepaths)
             return;
         }
 
-        auto importedModel = import_model(path);
-
-        for (auto & m : importedModel)
-        {
-            auto & mesh = m.second;
-            rescale_geometry(mesh, 1.f);
-
-            if (mesh.normals.size() == 0) compute_normals(mesh);
-            if (mesh.tangents.size() == 0) compute_tangents(mesh);
-                
-            const std::string filename = get_filename_without_extension(path);
-            const std::string outputBasePath = "../assets/models/runtime/";
-            const std::string outputFile = outputBasePath + filename + "-" + m.first + "-" + ".mesh";
-
-            export_mesh_binary(outputFile, mesh, false);
-
-            auto importedMesh = import_mesh_binary(outputFile);
-
-            create_handle_for_asset(std::string(get_filename_without_extension(path) + "-" + m.first).c_str(), make_mesh_from_geometry(importedMesh));
-            create_handle_for_asset(std::string(get_filename_without_extension(path) + "-" + m.first).c_str(), std::move(importedMesh));
-        }
+        modelCache->request_model(path);
 
         /*
         if (fileExtension == "ply")
@@ -383,11 +372,10 @@ void scene_editor_app::on_update(const UpdateEvent & e)
     int width, height;
     glfwGetWindowSize(window, &width, &height);
 
-    editorProfiler.begin("on_update");
+    AVL_PROFILE_SCOPE("editor-update");
     flycam.update(e.timestep_ms);
     shaderMonitor.handle_recompile();
     editor->on_update(cam, float2(width, height));
-    editorProfiler.end("on_update");
 }
 
 void scene_editor_app::on_draw()
@@ -396,6 +384,16 @@ void scene_editor_app::on_draw()
 
     glfwMakeContextCurrent(window);
 
+    {
+        AVL_PROFILE_SCOPE("texture-streaming");
+        textureStreamer->update();
+    }
+
+    {
+        AVL_PROFILE_SCOPE("model-cache");
+        modelCache->update();
+    }
+
     glEnable(GL_CULL_FACE);
     glEnable(GL_DEPTH_TEST);
 
@@ -415,7 +413,8 @@ void scene_editor_app::on_draw()
     const float4x4 viewProjectionMatrix = mul(projectionMatrix, viewMatrix);
 
     {
-        editorProfiler.begin("gather-scene");
+        ProfileScope gatherScope(AVL_PROFILE_TAG("gather-scene"));
+
         // Single-viewport camera
         sceneData.views.push_back(view_data(0, cameraPose, projectionMatrix));
 
@@ -427,6 +426,8 @@ void scene_editor_app::on_draw()
                 sceneData.pointLights.push_back(r->data);
             }
         }
+        sceneData.pointLights.insert(sceneData.pointLights.end(), stressPointLights.begin(), stressPointLights.end());
+        sceneData.spotLights.insert(sceneData.spotLights.end(), stressSpotLights.begin(), stressSpotLights.end());
 
         // Gather Objects
         std::vector<Renderable *> sceneObjects;
@@ -437,15 +438,29 @@ void scene_editor_app::on_draw()
                 sceneData.renderSet.push_back(r);
             }
         }
-        editorProfiler.end("gather-scene");
 
-        editorProfiler.begin("submit-scene");
+        // Streamed textures used by this frame's materials are the last the residency budget evicts
+        for (Renderable * r : sceneData.renderSet)
+        {
+            if (auto * m = dynamic_cast<MetallicRoughnessMaterial*>(r->get_material()))
+            {
+                for (const GlTextureHandle * t : { &m->albedo, &m->normal, &m->metallic, &m->roughness, &m->emissive, &m->height, &m->occlusion })
+                {
+                    textureStreamer->touch(t->name);
+                }
+            }
+        }
+        gatherScope.end();
+
         // Submit scene to the renderer
-        renderer->render_frame(sceneData);
-        editorProfiler.end("submit-scene");
+        {
+            AVL_PROFILE_SCOPE("submit-scene");
+            renderer->render_frame(sceneData);
+        }
     
         // Remember to clear any transient per-frame data
         sceneData.pointLights.clear();
+        sceneData.spotLights.clear();
         sceneData.renderSet.clear();
         sceneData.views.clear();
 
@@ -467,9 +482,9 @@ void scene_editor_app::on_draw()
         gl_check_error(__FILE__, __LINE__);
     }
 
-    editorProfiler.begin("wireframe-rendering");
     // Selected objects as wireframe
     {
+        AVL_PROFILE_SCOPE("wireframe-rendering");
         glDisable(GL_DEPTH_TEST);
 
         auto & program = wireframeHandle.get();
@@ -493,9 +508,8 @@ void scene_editor_app::on_draw()
 
         glEnable(GL_DEPTH_TEST);
     }
-    editorProfiler.end("wireframe-rendering");
 
-    editorProfiler.begin("imgui-menu");
+    ProfileScope menuScope(AVL_PROFILE_TAG("imgui-menu"));
     igm->begin_frame();
 
     gui::imgui_menu_stack menu(*this, ImGui::GetIO().KeysDown);
@@ -532,6 +546,11 @@ void scene_editor_app::on_draw()
 
             take_screenshot("scene-editor");
         }
+        if (menu.item(is_recording() ? "Stop Recording" : "Record Frames", GLFW_MOD_CONTROL, GLFW_KEY_R, mod_enabled))
+        {
+            if (is_recording()) stop_recording();
+            else start_recording(std::make_shared<PngSink>("scene-editor-frame-"));
+        }
         if (menu.item("Exit", GLFW_MOD_ALT, GLFW_KEY_F4)) exit();
         menu.end();
 
@@ -577,9 +596,9 @@ void scene_editor_app::on_draw()
 
     }
     menu.app_menu_end();
-    editorProfiler.end("imgui-menu");
+    menuScope.end();
 
-    editorProfiler.begin("imgui-editor");
+    ProfileScope editorScope(AVL_PROFILE_TAG("imgui-editor"));
     if (showUI)
     {
         static int horizSplit = 380;
@@ -602,18 +621,25 @@ void scene_editor_app::on_draw()
         gui::imgui_fixed_window_begin("Inspector", topRightPane);
         if (editor->get_selection().size() >= 1)
         {
-            InspectGameObjectPolymorphic(nullptr, editor->get_selection()[0]);
+            GameObject * inspected = editor->get_selection()[0];
+            if (InspectGameObjectPolymorphic(nullptr, inspected))
+            {
+                // Fields are edited in place, bypassing the setters (including a possibly reassigned geometry handle)
+                if (auto * mesh = dynamic_cast<StaticMesh *>(inspected)) mesh->update_bounds();
+                else if (auto * r = dynamic_cast<Renderable *>(inspected)) r->invalidate_bounds();
+            }
         }
         gui::imgui_fixed_window_end();
 
         gui::imgui_fixed_window_begin("Materials", middleRightPane);
+        const auto materialHandles = AssetHandle<std::shared_ptr<Material>>::list();
         std::vector<std::string> mats;
-        for (auto & m : AssetHandle<std::shared_ptr<Material>>::list()) mats.push_back(m.name);
+        for (auto & m : materialHandles) mats.push_back(m.name);
         static int selectedMaterial = 1;
         ImGui::ListBox("Material", &selectedMaterial, mats);
-        if (mats.size() >= 1)
+        if (selectedMaterial >= 0 && selectedMaterial < (int) materialHandles.size())
         {
-            auto w = AssetHandle<std::shared_ptr<Material>>::list()[selectedMaterial].get();
+            auto w = materialHandles[selectedMaterial].get();
             InspectGameObjectPolymorphic(nullptr, w.get());
         }
         gui::imgui_fixed_window_end();
@@ -682,8 +708,7 @@ void scene_editor_app::on_draw()
 
                 if (Edit("renderer", *renderer))
                 {
-                    renderer->gpuProfiler.set_enabled(renderer->settings.performanceProfiling);
-                    renderer->cpuProfiler.set_enabled(renderer->settings.performanceProfiling);
+                    Profiler::get().set_enabled(renderer->settings.performanceProfiling);
 
                     if (renderer->settings.shadowsEnabled != lastSettings.shadowsEnabled)
                     {
@@ -735,15 +760,52 @@ void scene_editor_app::on_draw()
 
             ImGui::Dummy({ 0, 10 });
 
-            if (renderer->settings.performanceProfiling)
+            if (ImGui::TreeNode("Texture Streaming"))
+            {
+                const TextureStreamer::Stats stats = textureStreamer->get_stats();
+                ImGui::Text("Resident %.1f / %.1f MB", stats.residentBytes / (1024.0 * 1024.0), stats.budgetBytes / (1024.0 * 1024.0));
+                ImGui::Text("Decoding %i, uploading %i", (int) stats.pendingDecodes, (int) stats.streamingTextures);
+                ImGui::Text("Uploaded %.1f KB last frame, %i stalled frames", stats.uploadedBytesLastFrame / 1024.0, (int) stats.stalledFrames);
+                ImGui::Text("Evicted levels %i", (int) stats.evictedLevels);
+                ImGui::TreePop();
+            }
+
+            ImGui::Dummy({ 0, 10 });
+
+            if (ImGui::TreeNode("Model Cache"))
+            {
+                const DerivedDataCache::Stats stats = modelCache->get_stats();
+                ImGui::Text("Cooked %i, cache hits %i", (int) stats.cooked, (int) stats.cacheHits);
+                ImGui::Text("Pending %i, failed %i", (int) stats.pending, (int) stats.failed);
+                ImGui::TreePop();
+            }
+
+            ImGui::Dummy({ 0, 10 });
+
+            if (ImGui::TreeNode("Clustered Lighting"))
             {
-                for (auto & t : renderer->gpuProfiler.dataPoints) ImGui::Text("[Renderer GPU] %s %f ms", t.first.c_str(), (float)compute_mean(t.second.average));
-                for (auto & t : renderer->cpuProfiler.dataPoints) ImGui::Text("[Renderer CPU] %s %f ms", t.first.c_str(), (float)compute_mean(t.second.average));
+                const clustered_lighting & clusters = renderer->get_light_clusters();
+                ImGui::Text("Lights %i (%i visible)", (int) clusters.get_light_count(), (int) clusters.get_visible_light_count());
+                ImGui::Text("Light indices %i", (int) clusters.get_index_count());
+
+                // Three quarters point lights, one quarter spot lights, scattered over the floor area
+                if (ImGui::SliderInt("Stress Lights", &stressLightCount, 0, 8192))
+                {
+                    make_light_stress_scene(stressLightCount * 3 / 4, stressLightCount - stressLightCount * 3 / 4,
+                        Bounds3D(float3(-24, 0.1f, -24), float3(24, 4, 24)), 0, stressPointLights, stressSpotLights);
+                }
+                ImGui::TreePop();
             }
 
             ImGui::Dummy({ 0, 10 });
 
-            for (auto & t : editorProfiler.dataPoints) ImGui::Text("[Editor] %s %f ms", t.first.c_str(), (float)compute_mean(t.second.average));
+            if (renderer->settings.performanceProfiling && ImGui::TreeNodeEx("Profiler", ImGuiTreeNodeFlags_DefaultOpen))
+            {
+                gui::profiler_flame_graph(Profiler::get());
+                gui::profiler_statistics(Profiler::get());
+                if (ImGui::Button("Export Chrome Trace")) Profiler::get().write_chrome_trace("scene-editor-trace.json");
+                ImGui::TreePop();
+            }
         }
         gui::imgui_fixed_window_end();
 
@@ -756,7 +818,7 @@ void scene_editor_app::on_draw()
     }
 
     igm->end_frame();
-    editorProfiler.end("imgui-editor");
+    editorScope.end();
 
     // Debug Views
     /*
@@ -770,10 +832,9 @@ void scene_editor_app::on_draw()
     */
 
     {
-        editorProfiler.begin("gizmo_on_draw");
+        AVL_PROFILE_SCOPE("gizmo-on-draw");
         glClear(GL_DEPTH_BUFFER_BIT);
         editor->on_draw();
-        editorProfiler.end("gizmo_on_draw");
     }
 
     gl_check_error(__FILE__, __LINE__);
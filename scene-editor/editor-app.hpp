@@ -8,6 +8,8 @@
 #include "assets.hpp"
 #include "scene.hpp"
 #include "gui.hpp"
+#include "texture_streaming.hpp"
+#include "derived_data_cache.hpp"
 
 static inline Pose to_linalg(tinygizmo::rigid_transform & t)
 {
@@ -160,21 +162,30 @@ struct scene_editor_app final : public GLFWApp
 
     uint32_t pbrProgramAsset = -1;
 
+    // Every mesh the editor builds uses this layout; the forward lighting shaders are compiled to match
+    const VertexFormat meshFormat = VertexFormat::compact();
+
     Scene scene;
 
     GlShaderHandle wireframeHandle{ "wireframe" };
     GlShaderHandle iblHandle{ "ibl" };
     GlMeshHandle cubeHandle{ "cube" };
 
-    profiler<SimpleTimer> editorProfiler;
 
     std::unique_ptr<gui::imgui_wrapper> igm;
 
     std::unique_ptr<editor_controller<GameObject>> editor;
 
     std::unique_ptr<forward_renderer> renderer;
+    std::unique_ptr<TextureStreamer> textureStreamer;
+    std::unique_ptr<DerivedDataCache> modelCache;
     scene_data sceneData;
 
+    // Transient lights for the clustered shading stress test; never serialized with the scene
+    int stressLightCount = 0;
+    std::vector<uniforms::point_light> stressPointLights;
+    std::vector<uniforms::spot_light> stressSpotLights;
+
     ImGui::ImGuiAppLog log;
     auto_layout uiSurface;
     std::vector<std::shared_ptr<GLTextureView>> debugViews;
@@ -1,46 +1,419 @@
 #ifndef signal_h
 #define signal_h
 
-#include <functional>
-#include <list>
+#include <assert.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 #include <utility>
+#include <vector>
+#include "mpsc_bounded_queue.hpp"
 
-// Usage: 
-// nodeSignals.add([someObject](Node const & myNode) { someObject.doSomething(myNode); return true; });
+// Usage:
+// auto c = nodeSignals.add([someObject](Node const & myNode) { someObject.doSomething(myNode); return true; });
 // nodeSignals.broadcast(someNode);
+// nodeSignals.remove(c);
+//
+// Subscribers returning false (or added with add_once) are removed after the call. Broadcasts from another thread
+// can be deferred through an EventQueue, which the owning thread drains in batches with dispatch().
 
 namespace avl
 {
 
+    // A std::function without the heap: the callable is stored inline and must fit in Capacity bytes (checked at
+    // compile time), so construction, copies and calls never allocate
+    template <typename Signature, size_t Capacity = 32>
+    class Delegate;
+
+    template <typename R, typename... Args, size_t Capacity>
+    class Delegate<R(Args...), Capacity>
+    {
+        enum Operation { COPY, MOVE, DESTROY };
+
+        typename std::aligned_storage<Capacity, alignof(std::max_align_t)>::type storage;
+        R (*invoker)(void *, Args...) = nullptr;
+        void (*manager)(Operation, void *, void *) = nullptr;
+
+        template <typename F> static R invoke(void * f, Args... args) { return (*static_cast<F *>(f))(std::forward<Args>(args)...); }
+
+        template <typename F> static void manage(Operation op, void * dst, void * src)
+        {
+            switch (op)
+            {
+            case COPY: new (dst) F(*static_cast<const F *>(src)); break;
+            case MOVE: new (dst) F(std::move(*static_cast<F *>(src))); break;
+            case DESTROY: static_cast<F *>(dst)->~F(); break;
+            }
+        }
+
+        void take(const Delegate & rhs, const Operation op)
+        {
+            if (!rhs.invoker) return;
+            rhs.manager(op, &storage, const_cast<void *>(static_cast<const void *>(&rhs.storage)));
+            invoker = rhs.invoker;
+            manager = rhs.manager;
+        }
+
+    public:
+
+        Delegate() = default;
+
+        template <typename F, typename Fn = typename std::decay<F>::type, typename = typename std::enable_if<!std::is_same<Fn, Delegate>::value>::type>
+        Delegate(F && f)
+        {
+            static_assert(sizeof(Fn) <= Capacity, "callable does not fit the delegate's inline storage; capture less or raise Capacity");
+            static_assert(alignof(Fn) <= alignof(std::max_align_t), "over-aligned callable");
+            new (&storage) Fn(std::forward<F>(f));
+            invoker = &invoke<Fn>;
+            manager = &manage<Fn>;
+        }
+
+        Delegate(const Delegate & rhs) { take(rhs, COPY); }
+        Delegate(Delegate && rhs) { take(rhs, MOVE); }
+
+        Delegate & operator = (const Delegate & rhs) { if (this != &rhs) { reset(); take(rhs, COPY); } return *this; }
+        Delegate & operator = (Delegate && rhs) { if (this != &rhs) { reset(); take(rhs, MOVE); } return *this; }
+
+        ~Delegate() { reset(); }
+
+        void reset()
+        {
+            if (manager) manager(DESTROY, &storage, nullptr);
+            invoker = nullptr;
+            manager = nullptr;
+        }
+
+        R operator() (Args... args) const { assert(invoker); return invoker(const_cast<void *>(static_cast<const void *>(&storage)), std::forward<Args>(args)...); }
+
+        explicit operator bool() const { return invoker != nullptr; }
+    };
+
+    typedef uint32_t SignalConnection;  // 0 is never handed out
+
+    // Subscribers live in one contiguous array and receive events by const reference. A recursive lock makes add,
+    // remove and broadcast safe from any thread and lets subscribers add or remove (themselves included) while being
+    // called: removals are tombstoned and additions parked until the outermost broadcast returns. After reserve() or
+    // warm-up, none of this allocates. Subscribers run with the lock held, so they must not block on other threads
+    // that use the same signal.
     template <typename T>
     class Signal
     {
-        std::list<std::function<bool(T)>> subscribers;
     public:
+
+        typedef Delegate<bool(const T &)> Subscriber;
+
+    private:
+
+        struct Slot
+        {
+            Subscriber fn;
+            SignalConnection id;
+        };
+
+        template <typename F> struct KeepSubscribed
+        {
+            F f;
+            bool operator() (const T & v) { f(v); return true; }
+        };
+
+        template <typename F> struct CallOnce
+        {
+            F f;
+            bool operator() (const T & v) { f(v); return false; }
+        };
+
+        std::vector<Slot> slots;
+        std::vector<Slot> added;            // subscribed during a broadcast
+        mutable std::recursive_mutex mutex;
+        SignalConnection nextId{ 1 };
+        uint32_t depth{ 0 };                // broadcasts in flight on the locking thread
+        size_t deferredReserve{ 0 };        // reserve() requested during a broadcast, applied by settle()
+        bool tombstones{ false };
+
+        template <typename F> static Subscriber wrap(F && f, std::true_type) { return KeepSubscribed<typename std::decay<F>::type>{ std::forward<F>(f) }; }
+        template <typename F> static Subscriber wrap(F && f, std::false_type) { return Subscriber(std::forward<F>(f)); }
+
+        SignalConnection insert(Subscriber && fn)
+        {
+            std::lock_guard<std::recursive_mutex> guard(mutex);
+            const SignalConnection id = nextId++;
+            if (nextId == 0) nextId = 1;
+            (depth ? added : slots).push_back({ std::move(fn), id });
+            return id;
+        }
+
+        void settle()
+        {
+            if (tombstones)
+            {
+                slots.erase(std::remove_if(slots.begin(), slots.end(), [](const Slot & s) { return s.id == 0; }), slots.end());
+                tombstones = false;
+            }
+            if (deferredReserve)
+            {
+                slots.reserve(deferredReserve);
+                deferredReserve = 0;
+            }
+            for (auto & s : added) if (s.id) slots.push_back(std::move(s));
+            added.clear();
+        }
+
+    public:
+
+        Signal() = default;
+        Signal(const Signal &) = delete;
+        Signal & operator = (const Signal &) = delete;
+
+        // Callables taking `const T &` and returning bool (false unsubscribes) or void (stays subscribed)
         template <typename F>
-        void add(F && f)
+        SignalConnection add(F && f)
         {
-            subscribers.push_back(std::forward<F>(f));
+            typedef decltype(std::declval<typename std::decay<F>::type &>()(std::declval<const T &>())) Result;
+            return insert(wrap(std::forward<F>(f), std::is_void<Result>()));
         }
 
         template <typename F>
-        void add_once(F const &f)
+        SignalConnection add_once(F && f)
         {
-            subscribers.push_back([f](T const & v) -> bool { f(v); return false; });
+            return insert(Subscriber(CallOnce<typename std::decay<F>::type>{ std::forward<F>(f) }));
         }
 
-        void broadcast(T const &v)
+        // Returns false if the connection was already gone
+        bool remove(const SignalConnection id)
         {
-            for (typename std::list<std::function<bool(T)>>::iterator it = subscribers.begin(); it != subscribers.end();)
+            if (id == 0) return false;
+            std::lock_guard<std::recursive_mutex> guard(mutex);
+            for (auto * list : { &slots, &added })
             {
-                if ((*it)(v))
-                    ++it;
-                else
-                    it = subscribers.erase(it);
+                for (size_t i = 0; i < list->size(); ++i)
+                {
+                    Slot & s = (*list)[i];
+                    if (s.id != id) continue;
+                    if (depth) { s.id = 0; tombstones = true; }    // it may be the subscriber currently running
+                    else list->erase(list->begin() + i);
+                    return true;
+                }
             }
+            return false;
+        }
+
+        void broadcast(const T & v) { broadcast(&v, 1); }
+
+        // Delivers each event to every subscriber in turn under a single lock acquisition. Subscribers added during
+        // the call first hear from the next broadcast.
+        void broadcast(const T * events, const size_t count)
+        {
+            std::lock_guard<std::recursive_mutex> guard(mutex);
+            ++depth;
+            const size_t n = slots.size();
+            for (size_t e = 0; e < count; ++e)
+            {
+                for (size_t i = 0; i < n; ++i)
+                {
+                    if (slots[i].id && !slots[i].fn(events[e]))
+                    {
+                        slots[i].id = 0;
+                        tombstones = true;
+                    }
+                }
+            }
+            if (--depth == 0) settle();
+        }
+
+        void clear()
+        {
+            std::lock_guard<std::recursive_mutex> guard(mutex);
+            if (depth)
+            {
+                for (auto & s : slots) s.id = 0;
+                for (auto & s : added) s.id = 0;
+                tombstones = true;
+            }
+            else
+            {
+                slots.clear();
+                added.clear();
+            }
+        }
+
+        // Called from a subscriber, this only grows the list of parked additions: `slots` holds the running delegate,
+        // so it is reallocated once the outermost broadcast returns
+        void reserve(const size_t subscribers)
+        {
+            std::lock_guard<std::recursive_mutex> guard(mutex);
+            if (depth) deferredReserve = std::max(deferredReserve, subscribers);
+            else slots.reserve(subscribers);
+            added.reserve(subscribers);
+        }
+
+        size_t size() const
+        {
+            std::lock_guard<std::recursive_mutex> guard(mutex);
+            size_t live = 0;
+            for (auto & s : slots) live += s.id != 0;
+            for (auto & s : added) live += s.id != 0;
+            return live;
         }
     };
 
+    // Deferred dispatch: any thread may post() into a preallocated MPSCBoundedQueue, and the thread that owns the
+    // subscribers drains it with dispatch() (e.g. once per frame), broadcasting events in batches of BATCH. post()
+    // never allocates or blocks; it fails and counts a drop when the ring is full. Events are copied into raw ring
+    // storage, so they must be trivially copyable (carry ids or handles rather than strings).
+    template <typename T, size_t BATCH = 64>
+    class EventQueue
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "queued events must be trivially copyable");
+
+        MPSCBoundedQueue<T> queue;
+        Signal<T> signal;
+        std::atomic<uint64_t> dropped{ 0 };
+
+    public:
+
+        // `capacity` must be a power of two
+        explicit EventQueue(const size_t capacity = 1024) : queue(capacity) { }
+
+        template <typename F> SignalConnection subscribe(F && f) { return signal.add(std::forward<F>(f)); }
+        bool unsubscribe(const SignalConnection c) { return signal.remove(c); }
+        Signal<T> & get_signal() { return signal; }
+
+        bool post(const T & event)
+        {
+            if (queue.produce(event)) return true;
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        // Returns how many of the events were queued; the remainder are counted as dropped
+        size_t post(const T * events, const size_t count)
+        {
+            size_t queued = 0;
+            while (queued < count)
+            {
+                const size_t n = queue.produce_bulk(events + queued, count - queued);
+                if (n == 0) break;
+                queued += n;
+            }
+            if (queued < count) dropped.fetch_add(count - queued, std::memory_order_relaxed);
+            return queued;
+        }
+
+        // Single consumer: call from one thread at a time. Events posted while dispatching may be delivered in the
+        // same call; `maxEvents` bounds the work per call. Returns the number of events delivered.
+        size_t dispatch(const size_t maxEvents = std::numeric_limits<size_t>::max())
+        {
+            T batch[BATCH];
+            size_t delivered = 0;
+            while (delivered < maxEvents)
+            {
+                const size_t n = queue.consume_bulk(batch, std::min(BATCH, maxEvents - delivered));
+                if (n == 0) break;
+                signal.broadcast(batch, n);
+                delivered += n;
+            }
+            return delivered;
+        }
+
+        bool pending() const { return queue.available(); }
+        uint64_t get_dropped_count() const { return dropped.load(std::memory_order_relaxed); }
+    };
+
+    // One EventQueue per event type, addressed by type: bus.post(KeyEvent{...}) from any thread, bus.dispatch() on
+    // the owning thread delivers everything queued for every type.
+    template <typename... Events>
+    class EventBus
+    {
+        std::tuple<std::unique_ptr<EventQueue<Events>>...> queues;
+
+        template <typename E> EventQueue<E> & queue_for() { return *std::get<std::unique_ptr<EventQueue<E>>>(queues); }
+
+    public:
+
+        explicit EventBus(const size_t capacityPerType = 1024) : queues(std::unique_ptr<EventQueue<Events>>(new EventQueue<Events>(capacityPerType))...) { }
+
+        template <typename E, typename F> SignalConnection subscribe(F && f) { return queue_for<E>().subscribe(std::forward<F>(f)); }
+        template <typename E> bool unsubscribe(const SignalConnection c) { return queue_for<E>().unsubscribe(c); }
+
+        // Deferred, from any thread
+        template <typename E> bool post(const E & event) { return queue_for<E>().post(event); }
+
+        // Immediate, on the calling thread
+        template <typename E> void broadcast(const E & event) { queue_for<E>().get_signal().broadcast(event); }
+
+        size_t dispatch()
+        {
+            size_t delivered = 0;
+            const int expand[] = { 0, (delivered += queue_for<Events>().dispatch(), 0)... };
+            (void) expand;
+            return delivered;
+        }
+    };
+
+    namespace signal_tests
+    {
+        struct KeyEvent { int key; int action; };
+        struct ReloadEvent { uint32_t assetId; };
+
+        inline void execute()
+        {
+            Signal<int> signal;
+            int sum = 0, onceCalls = 0, lateCalls = 0;
+
+            // Unsubscribe by return value, by add_once and by removing itself mid-broadcast
+            const SignalConnection keep = signal.add([&](const int & v) { sum += v; });
+            signal.add([&](const int & v) { return v < 2; });
+            signal.add_once([&](const int &) { onceCalls++; });
+            SignalConnection self = 0;
+            self = signal.add([&](const int &) { signal.remove(self); signal.add([&](const int &) { lateCalls++; }); });
+            assert(signal.size() == 4);
+
+            signal.broadcast(1);
+            assert(sum == 1 && onceCalls == 1 && lateCalls == 0 && signal.size() == 3);
+            signal.broadcast(2);
+            assert(sum == 3 && onceCalls == 1 && lateCalls == 1 && signal.size() == 2);
+            assert(signal.remove(keep) && !signal.remove(keep) && signal.size() == 1);
+
+            // Growing the signal from inside a subscriber must not move the subscriber that is running
+            Signal<int> growing;
+            int grown = 0;
+            growing.add([&](const int & v) { growing.reserve(1024); grown += v; });
+            growing.broadcast(3);
+            growing.broadcast(4);
+            assert(grown == 7 && growing.size() == 1);
+
+            // Deferred dispatch from several producers
+            EventBus<KeyEvent, ReloadEvent> bus(256);
+            std::atomic<int> keys{ 0 };
+            uint32_t reloaded = 0;
+            bus.subscribe<KeyEvent>([&](const KeyEvent & e) { keys += e.key; });
+            bus.subscribe<ReloadEvent>([&](const ReloadEvent & e) { reloaded += e.assetId; return true; });
+
+            std::vector<std::thread> producers;
+            for (int t = 0; t < 4; ++t) producers.emplace_back([&]() { for (int i = 0; i < 100; ++i) while (!bus.post(KeyEvent{ 1, 0 })) std::this_thread::yield(); });
+            int delivered = 0;
+            while (delivered < 400) delivered += int(bus.dispatch());
+            for (auto & p : producers) p.join();
+            assert(keys == 400 && bus.dispatch() == 0);
+
+            bus.post(ReloadEvent{ 7 });
+            bus.broadcast(ReloadEvent{ 5 });
+            assert(reloaded == 5 && bus.dispatch() == 1 && reloaded == 12);
+
+            EventQueue<int> small(4);
+            const int burst[6] = { 1, 2, 3, 4, 5, 6 };
+            assert(small.post(burst, 6) == 4 && small.get_dropped_count() == 2);
+        }
+    }
+
 }
 
 #endif // end signal_h
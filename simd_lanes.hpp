@@ -0,0 +1,208 @@
+/*
+ * File: simd_lanes.hpp
+ * Thin wrappers over SSE/AVX registers so that batch kernels can be written once as
+ * templates over a lane type and instantiated for `float` (scalar), `float_x4` (SSE)
+ * and `float_x8` (AVX). Comparisons return full-width bit masks in the same type; use
+ * select(mask, a, b) instead of branching. `float_xN` names the widest available type.
+ */
+
+#pragma once
+
+#ifndef simd_lanes_hpp
+#define simd_lanes_hpp
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(__AVX__) || defined(__AVX2__)
+    #define ANVIL_SIMD_AVX 1
+#endif
+
+#if defined(ANVIL_SIMD_AVX) || defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define ANVIL_SIMD_SSE 1
+#endif
+
+#if defined(ANVIL_SIMD_AVX)
+    #include <immintrin.h>
+#elif defined(ANVIL_SIMD_SSE)
+    #include <emmintrin.h>
+#endif
+
+namespace avl
+{
+    namespace simd
+    {
+        ////////////////////////
+        //   Scalar (1-wide)  //
+        ////////////////////////
+
+        // Scalar masks are plain bools, so kernels written against these helpers compile unchanged for float
+        template<typename T> inline T load(const float * p);
+        template<> inline float load<float>(const float * p) { return *p; }
+        inline void store(float * p, float v) { *p = v; }
+        inline float select(bool mask, float a, float b) { return mask ? a : b; }
+        inline bool less(float a, float b) { return a < b; }
+        inline bool less_equal(float a, float b) { return a <= b; }
+        inline bool greater(float a, float b) { return a > b; }
+        inline bool greater_equal(float a, float b) { return a >= b; }
+        inline int movemask(bool mask) { return mask ? 1 : 0; }
+        inline bool any(bool mask) { return mask; }
+        inline bool all(bool mask) { return mask; }
+        inline float abs(float a) { return std::abs(a); }
+        inline float min(float a, float b) { return std::min(a, b); }
+        inline float max(float a, float b) { return std::max(a, b); }
+        inline float sqrt(float a) { return std::sqrt(a); }
+        inline float rsqrt(float a) { return 1.0f / std::sqrt(a); }
+        inline float rcp(float a) { return 1.0f / a; }
+        inline float fmadd(float a, float b, float c) { return a * b + c; }
+
+        template<typename T> struct lane_traits { static const int width = 1; typedef bool mask_type; };
+
+    #if defined(ANVIL_SIMD_SSE)
+
+        ////////////////////////
+        //    SSE (4-wide)    //
+        ////////////////////////
+
+        struct float_x4
+        {
+            __m128 v;
+            float_x4() = default;
+            float_x4(__m128 v) : v(v) {}
+            float_x4(float s) : v(_mm_set1_ps(s)) {}
+            operator __m128 () const { return v; }
+            float_x4 & operator += (const float_x4 & o) { v = _mm_add_ps(v, o.v); return *this; }
+            float_x4 & operator -= (const float_x4 & o) { v = _mm_sub_ps(v, o.v); return *this; }
+            float_x4 & operator *= (const float_x4 & o) { v = _mm_mul_ps(v, o.v); return *this; }
+        };
+
+        inline float_x4 operator + (const float_x4 & a, const float_x4 & b) { return _mm_add_ps(a, b); }
+        inline float_x4 operator - (const float_x4 & a, const float_x4 & b) { return _mm_sub_ps(a, b); }
+        inline float_x4 operator * (const float_x4 & a, const float_x4 & b) { return _mm_mul_ps(a, b); }
+        inline float_x4 operator / (const float_x4 & a, const float_x4 & b) { return _mm_div_ps(a, b); }
+        inline float_x4 operator - (const float_x4 & a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+        inline float_x4 operator & (const float_x4 & a, const float_x4 & b) { return _mm_and_ps(a, b); }
+        inline float_x4 operator | (const float_x4 & a, const float_x4 & b) { return _mm_or_ps(a, b); }
+        inline float_x4 operator ^ (const float_x4 & a, const float_x4 & b) { return _mm_xor_ps(a, b); }
+
+        template<> inline float_x4 load<float_x4>(const float * p) { return _mm_loadu_ps(p); }
+        inline void store(float * p, const float_x4 & v) { _mm_storeu_ps(p, v); }
+        inline float_x4 select(const float_x4 & mask, const float_x4 & a, const float_x4 & b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+        inline float_x4 less(const float_x4 & a, const float_x4 & b) { return _mm_cmplt_ps(a, b); }
+        inline float_x4 less_equal(const float_x4 & a, const float_x4 & b) { return _mm_cmple_ps(a, b); }
+        inline float_x4 greater(const float_x4 & a, const float_x4 & b) { return _mm_cmpgt_ps(a, b); }
+        inline float_x4 greater_equal(const float_x4 & a, const float_x4 & b) { return _mm_cmpge_ps(a, b); }
+        inline int movemask(const float_x4 & mask) { return _mm_movemask_ps(mask); }
+        inline bool any(const float_x4 & mask) { return _mm_movemask_ps(mask) != 0; }
+        inline bool all(const float_x4 & mask) { return _mm_movemask_ps(mask) == 0xf; }
+        inline float_x4 abs(const float_x4 & a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+        inline float_x4 min(const float_x4 & a, const float_x4 & b) { return _mm_min_ps(a, b); }
+        inline float_x4 max(const float_x4 & a, const float_x4 & b) { return _mm_max_ps(a, b); }
+        inline float_x4 sqrt(const float_x4 & a) { return _mm_sqrt_ps(a); }
+        inline float_x4 fmadd(const float_x4 & a, const float_x4 & b, const float_x4 & c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+
+        // Hardware estimate refined by one Newton-Raphson step (~22 bits)
+        inline float_x4 rsqrt(const float_x4 & a)
+        {
+            const __m128 e = _mm_rsqrt_ps(a);
+            return _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), e), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_mul_ps(a, e), e)));
+        }
+
+        inline float_x4 rcp(const float_x4 & a)
+        {
+            const __m128 e = _mm_rcp_ps(a);
+            return _mm_sub_ps(_mm_add_ps(e, e), _mm_mul_ps(_mm_mul_ps(a, e), e));
+        }
+
+        template<> struct lane_traits<float_x4> { static const int width = 4; typedef float_x4 mask_type; };
+
+    #endif // end ANVIL_SIMD_SSE
+
+    #if defined(ANVIL_SIMD_AVX)
+
+        ////////////////////////
+        //    AVX (8-wide)    //
+        ////////////////////////
+
+        struct float_x8
+        {
+            __m256 v;
+            float_x8() = default;
+            float_x8(__m256 v) : v(v) {}
+            float_x8(float s) : v(_mm256_set1_ps(s)) {}
+            operator __m256 () const { return v; }
+            float_x8 & operator += (const float_x8 & o) { v = _mm256_add_ps(v, o.v); return *this; }
+            float_x8 & operator -= (const float_x8 & o) { v = _mm256_sub_ps(v, o.v); return *this; }
+            float_x8 & operator *= (const float_x8 & o) { v = _mm256_mul_ps(v, o.v); return *this; }
+        };
+
+        inline float_x8 operator + (const float_x8 & a, const float_x8 & b) { return _mm256_add_ps(a, b); }
+        inline float_x8 operator - (const float_x8 & a, const float_x8 & b) { return _mm256_sub_ps(a, b); }
+        inline float_x8 operator * (const float_x8 & a, const float_x8 & b) { return _mm256_mul_ps(a, b); }
+        inline float_x8 operator / (const float_x8 & a, const float_x8 & b) { return _mm256_div_ps(a, b); }
+        inline float_x8 operator - (const float_x8 & a) { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+        inline float_x8 operator & (const float_x8 & a, const float_x8 & b) { return _mm256_and_ps(a, b); }
+        inline float_x8 operator | (const float_x8 & a, const float_x8 & b) { return _mm256_or_ps(a, b); }
+        inline float_x8 operator ^ (const float_x8 & a, const float_x8 & b) { return _mm256_xor_ps(a, b); }
+
+        template<> inline float_x8 load<float_x8>(const float * p) { return _mm256_loadu_ps(p); }
+        inline void store(float * p, const float_x8 & v) { _mm256_storeu_ps(p, v); }
+        inline float_x8 select(const float_x8 & mask, const float_x8 & a, const float_x8 & b) { return _mm256_blendv_ps(b, a, mask); }
+        inline float_x8 less(const float_x8 & a, const float_x8 & b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        inline float_x8 less_equal(const float_x8 & a, const float_x8 & b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+        inline float_x8 greater(const float_x8 & a, const float_x8 & b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+        inline float_x8 greater_equal(const float_x8 & a, const float_x8 & b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+        inline int movemask(const float_x8 & mask) { return _mm256_movemask_ps(mask); }
+        inline bool any(const float_x8 & mask) { return _mm256_movemask_ps(mask) != 0; }
+        inline bool all(const float_x8 & mask) { return _mm256_movemask_ps(mask) == 0xff; }
+        inline float_x8 abs(const float_x8 & a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+        inline float_x8 min(const float_x8 & a, const float_x8 & b) { return _mm256_min_ps(a, b); }
+        inline float_x8 max(const float_x8 & a, const float_x8 & b) { return _mm256_max_ps(a, b); }
+        inline float_x8 sqrt(const float_x8 & a) { return _mm256_sqrt_ps(a); }
+
+    #if defined(__FMA__) || defined(__AVX2__)
+        inline float_x8 fmadd(const float_x8 & a, const float_x8 & b, const float_x8 & c) { return _mm256_fmadd_ps(a, b, c); }
+    #else
+        inline float_x8 fmadd(const float_x8 & a, const float_x8 & b, const float_x8 & c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+    #endif
+
+        inline float_x8 rsqrt(const float_x8 & a)
+        {
+            const __m256 e = _mm256_rsqrt_ps(a);
+            return _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), e), _mm256_sub_ps(_mm256_set1_ps(3.0f), _mm256_mul_ps(_mm256_mul_ps(a, e), e)));
+        }
+
+        inline float_x8 rcp(const float_x8 & a)
+        {
+            const __m256 e = _mm256_rcp_ps(a);
+            return _mm256_sub_ps(_mm256_add_ps(e, e), _mm256_mul_ps(_mm256_mul_ps(a, e), e));
+        }
+
+        template<> struct lane_traits<float_x8> { static const int width = 8; typedef float_x8 mask_type; };
+
+    #endif // end ANVIL_SIMD_AVX
+
+        // Iterative kernels (Jacobi sweeps, Newton refinement) drive values toward zero and can spend most of their
+        // time in denormal arithmetic. This enables flush-to-zero and denormals-are-zero for the current scope.
+        class scoped_flush_denormals
+        {
+        #if defined(ANVIL_SIMD_SSE)
+            unsigned int previous;
+        public:
+            scoped_flush_denormals() : previous(_mm_getcsr()) { _mm_setcsr(previous | 0x8040); }
+            ~scoped_flush_denormals() { _mm_setcsr(previous); }
+        #endif
+        };
+
+    #if defined(ANVIL_SIMD_AVX)
+        typedef float_x8 float_xN;
+    #elif defined(ANVIL_SIMD_SSE)
+        typedef float_x4 float_xN;
+    #else
+        typedef float float_xN;
+    #endif
+
+    } // end namespace simd
+} // end namespace avl
+
+#endif // end simd_lanes_hpp
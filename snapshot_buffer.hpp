@@ -0,0 +1,127 @@
+// This is free and unencumbered software released into the public domain.
+
+#pragma once
+
+#ifndef snapshot_buffer_hpp
+#define snapshot_buffer_hpp
+
+#include <mutex>
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#include <assert.h>
+
+namespace avl
+{
+
+    /*
+     * Hands timestamped copies of state from one producer thread (e.g. a fixed-step simulation) to one consumer
+     * (the render loop). The producer fills a private slot and publishes it; the consumer acquires the two most
+     * recently published states so it can interpolate between them. Neither side ever copies under the lock or waits
+     * for the other: the lock only guards slot indices, and there are enough slots (producer 1, published pair 2,
+     * consumer pair 2) that the producer always finds a free one. States skipped by a slow consumer are overwritten.
+     */
+    template<typename T>
+    class SnapshotBuffer
+    {
+        constexpr static const int NUM_SLOTS = 5;
+
+        struct Slot { T state; double time{ 0.0 }; uint64_t sequence{ 0 }; };
+
+        Slot slots[NUM_SLOTS];
+        std::mutex mutex;
+
+        int writing{ 0 };
+        int publishedPrevious{ -1 }, publishedLatest{ -1 };
+        int readPrevious{ -1 }, readLatest{ -1 };
+        uint64_t publishedSequence{ 0 };
+
+        bool in_use(const int i) const
+        {
+            return i == writing || i == publishedPrevious || i == publishedLatest || i == readPrevious || i == readLatest;
+        }
+
+    public:
+
+        // Producer: the slot to fill. It still holds whatever was last written to it, so overwrite every field that matters.
+        T & begin_write() { return slots[writing].state; }
+
+        // Producer: makes the slot from begin_write() visible, stamped with `time` (simulation seconds)
+        void publish(const double time)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slots[writing].time = time;
+            slots[writing].sequence = ++publishedSequence;
+            publishedPrevious = publishedLatest;
+            publishedLatest = writing;
+
+            for (int i = 0; i < NUM_SLOTS; ++i) if (!in_use(i)) { writing = i; return; }
+            assert(false && "snapshot slots exhausted");
+        }
+
+        // Consumer: picks up the newest published pair. False (and the previous pair stays current) when nothing new arrived.
+        bool acquire()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (publishedLatest < 0 || (readLatest >= 0 && slots[readLatest].sequence == slots[publishedLatest].sequence)) return false;
+            readLatest = publishedLatest;
+            readPrevious = publishedPrevious >= 0 ? publishedPrevious : publishedLatest;
+            return true;
+        }
+
+        bool has_state() const { return readLatest >= 0; }
+
+        // Consumer: valid after the first successful acquire() and until the next one
+        const T & previous() const { return slots[readPrevious].state; }
+        const T & latest() const { return slots[readLatest].state; }
+        double previous_time() const { return slots[readPrevious].time; }
+        double latest_time() const { return slots[readLatest].time; }
+
+        // Consumer: blend factor from previous() to latest() for a render at `time`, clamped to [0, 1]
+        float alpha(const double time) const
+        {
+            const double span = latest_time() - previous_time();
+            if (span <= 0.0) return 1.f;
+            return static_cast<float>(std::min(1.0, std::max(0.0, (time - previous_time()) / span)));
+        }
+    };
+
+} // end namespace avl
+
+namespace snapshot_buffer_tests
+{
+    using namespace avl;
+
+    inline void execute()
+    {
+        SnapshotBuffer<int> buffer;
+        assert(!buffer.acquire());
+
+        buffer.begin_write() = 1;
+        buffer.publish(0.1);
+        assert(buffer.acquire());
+        assert(buffer.latest() == 1 && buffer.previous() == 1);
+        assert(!buffer.acquire());
+
+        // A consumer that falls behind sees only the last two states, and keeps them while the producer moves on
+        for (int i = 2; i <= 10; ++i)
+        {
+            buffer.begin_write() = i;
+            buffer.publish(0.1 * i);
+        }
+        assert(buffer.acquire());
+        assert(buffer.previous() == 9 && buffer.latest() == 10);
+        for (int i = 11; i <= 20; ++i)
+        {
+            buffer.begin_write() = i;
+            buffer.publish(0.1 * i);
+            assert(buffer.previous() == 9 && buffer.latest() == 10);
+        }
+
+        assert(buffer.acquire());
+        assert(std::abs(buffer.alpha(1.95) - 0.5f) < 1e-4f);
+        assert(buffer.alpha(0.0) == 0.f && buffer.alpha(5.0) == 1.f);
+    }
+}
+
+#endif // end snapshot_buffer_hpp
@@ -86,7 +86,7 @@ inline int solve_cubic(const double c0, const double c1, const double c2, const
         else  
         {
             // One single and one double solution
-            double u = std::pow(-q, 1.0/3.0);
+            double u = std::cbrt(-q);
             s0 = 2 * u;
             s1 = - u;
             num = 2;
@@ -107,8 +107,8 @@ inline int solve_cubic(const double c0, const double c1, const double c2, const
     {
         // One real solution
         double sqrt_D = std::sqrt(D);
-        double u = std::pow(sqrt_D - q, 1.0/3.0);
-        double v = - std::pow(sqrt_D + q, 1.0/3.0);
+        double u = std::cbrt(sqrt_D - q);
+        double v = - std::cbrt(sqrt_D + q);
 
         s0 = u + v;
         num = 1;
@@ -195,8 +195,8 @@ inline int solve_quartic(double c0, double c1, double c2, double c3, double c4,
         coeffs[0] = 1.0;
 
         if (num == 0) num += solve_quadratic(coeffs[0], coeffs[1], coeffs[2], s0, s1);
-        if (num == 1) num += solve_quadratic(coeffs[0], coeffs[1], coeffs[2], s1, s2);
-        if (num == 2) num += solve_quadratic(coeffs[0], coeffs[1], coeffs[2], s2, s3);
+        else if (num == 1) num += solve_quadratic(coeffs[0], coeffs[1], coeffs[2], s1, s2);
+        else if (num == 2) num += solve_quadratic(coeffs[0], coeffs[1], coeffs[2], s2, s3);
     }
 
     sub = 1.0/4.0 * A;
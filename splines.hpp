@@ -6,10 +6,14 @@
 #define constant_spline_h
 
 #include "math-core.hpp"
+#include "simd_lanes.hpp"
+#include "util.hpp"
+#include <algorithm>
+#include <vector>
 
 namespace avl
 {
-    
+
     struct SplinePoint
     {
         float3 point;
@@ -18,188 +22,380 @@ namespace avl
         SplinePoint(){};
         SplinePoint(float3 p, float d, float ac) : point(p), distance(d), ac(ac) {}
     };
-    
-    // This object creates a B-Spline using 4 points, and a number steps
-    // or a fixed step distance can be specified to create a set of points that cover the curve at constant rate.
-    class ConstantSpline
+
+    enum class SplineBasis
+    {
+        catmull_rom,    // passes through every control point; n points make n - 1 segments (ends are extrapolated)
+        bezier,         // segments share end points; 3n + 1 points make n segments
+        bspline         // uniform cubic B-spline, C2 but approximating; n points make n - 3 segments
+    };
+
+    // Multi-segment cubic curve with an arc-length table. Each segment is kept in power form, c0 + c1 t + c2 t^2 +
+    // c3 t^3, and its length is tabulated at SAMPLES_PER_SEGMENT sub-intervals with Gauss-Legendre quadrature, stored
+    // relative to the segment start. Distance -> parameter is then two binary searches plus one Newton step, and moving
+    // a control point only re-tabulates the (at most four) segments it influences.
+    // Parameters `u` run from 0 to segment_count(): the integer part picks the segment, the fraction is its local t.
+    class Spline
     {
-        std::vector<SplinePoint> points;
-        std::vector<SplinePoint> lPoints;
-        
     public:
-        
-        float3 p0, p1, p2, p3;
-        
-        float d = 0.0f;
-        
-        ConstantSpline() { };
-        
-        void calculate(float increment = 0.01f)
-        {
-            d = 0.0f;
-            points.clear();
-            
-            float3 tmp, result;
-            for (float j = 0; j <= 1.0f; j += increment)
+
+        constexpr static const int SAMPLES_PER_SEGMENT = 16;
+
+        struct Cubic { float3 c0, c1, c2, c3; };
+
+    private:
+
+        SplineBasis basis{ SplineBasis::catmull_rom };
+        std::vector<float3> controlPoints;
+        std::vector<Cubic> segments;
+        std::vector<float> table;           // SAMPLES_PER_SEGMENT + 1 lengths per segment, from the segment start
+        std::vector<float> segmentStart;    // prefix sum of segment lengths, segment_count() + 1 entries
+
+        static float3 eval(const Cubic & c, const float t) { return c.c0 + t * (c.c1 + t * (c.c2 + t * c.c3)); }
+        static float3 eval_derivative(const Cubic & c, const float t) { return c.c1 + t * (2.f * c.c2 + t * 3.f * c.c3); }
+
+        // 5-point Gauss-Legendre estimate of the length of a segment between t0 and t1
+        static float integrate_length(const Cubic & c, const float t0, const float t1)
+        {
+            static const float x[5] = { 0.f, -0.5384693101f, 0.5384693101f, -0.9061798459f, 0.9061798459f };
+            static const float w[5] = { 0.5688888889f, 0.4786286705f, 0.4786286705f, 0.2369268851f, 0.2369268851f };
+            const float half = 0.5f * (t1 - t0), mid = 0.5f * (t1 + t0);
+            float sum = 0.f;
+            for (int i = 0; i < 5; ++i) sum += w[i] * linalg::length(eval_derivative(c, mid + half * x[i]));
+            return sum * half;
+        }
+
+        size_t segments_for(const size_t numPoints) const
+        {
+            switch (basis)
             {
-                float i = (1 - j);
-                float ii = i * i;
-                float iii = ii * i;
-                
-                float jj = j * j;
-                float jjj = jj * j;
-                
-                result = float3(0, 0, 0);
-                
-                tmp = p0;
-                tmp *= iii;
-                result += tmp;
-                
-                tmp = p1;
-                tmp *= 3 * j * ii;
-                result += tmp;
-                
-                tmp = p2;
-                tmp *= 3 * jj * i;
-                result += tmp;
-                
-                tmp = p3;
-                tmp *= jjj;
-                result += tmp;
-                
-                points.emplace_back(result, 0.0f, 0.0f);
+            case SplineBasis::catmull_rom: return numPoints >= 2 ? numPoints - 1 : 0;
+            case SplineBasis::bezier: return numPoints >= 4 ? (numPoints - 1) / 3 : 0;
+            case SplineBasis::bspline: return numPoints >= 4 ? numPoints - 3 : 0;
             }
-            
-            points.emplace_back(p3, 0.0f, 0.0f);
+            return 0;
         }
-        
-        void calculate_distances()
+
+        Cubic make_segment(const size_t s) const
+        {
+            const std::vector<float3> & p = controlPoints;
+            Cubic c;
+            if (basis == SplineBasis::catmull_rom)
+            {
+                const size_t n = p.size();
+                const float3 a = (s == 0) ? 2.f * p[0] - p[1] : p[s - 1];
+                const float3 b = p[s], cc = p[s + 1];
+                const float3 d = (s + 2 >= n) ? 2.f * p[n - 1] - p[n - 2] : p[s + 2];
+                c.c0 = b;
+                c.c1 = 0.5f * (cc - a);
+                c.c2 = 0.5f * (2.f * a - 5.f * b + 4.f * cc - d);
+                c.c3 = 0.5f * (3.f * (b - cc) + d - a);
+            }
+            else if (basis == SplineBasis::bezier)
+            {
+                const float3 & a = p[3 * s], & b = p[3 * s + 1], & cc = p[3 * s + 2], & d = p[3 * s + 3];
+                c.c0 = a;
+                c.c1 = 3.f * (b - a);
+                c.c2 = 3.f * (a - 2.f * b + cc);
+                c.c3 = 3.f * (b - cc) + d - a;
+            }
+            else
+            {
+                const float3 & a = p[s], & b = p[s + 1], & cc = p[s + 2], & d = p[s + 3];
+                c.c0 = (a + 4.f * b + cc) / 6.f;
+                c.c1 = 0.5f * (cc - a);
+                c.c2 = 0.5f * (a - 2.f * b + cc);
+                c.c3 = (3.f * (b - cc) + d - a) / 6.f;
+            }
+            return c;
+        }
+
+        void tabulate(const size_t s)
+        {
+            segments[s] = make_segment(s);
+            float * row = &table[s * (SAMPLES_PER_SEGMENT + 1)];
+            row[0] = 0.f;
+            for (int k = 0; k < SAMPLES_PER_SEGMENT; ++k)
+            {
+                row[k + 1] = row[k] + integrate_length(segments[s], float(k) / SAMPLES_PER_SEGMENT, float(k + 1) / SAMPLES_PER_SEGMENT);
+            }
+        }
+
+        void accumulate()
+        {
+            segmentStart.resize(segments.size() + 1);
+            segmentStart[0] = 0.f;
+            for (size_t s = 0; s < segments.size(); ++s) segmentStart[s + 1] = segmentStart[s] + table[s * (SAMPLES_PER_SEGMENT + 1) + SAMPLES_PER_SEGMENT];
+        }
+
+        void split(const float u, size_t & s, float & t) const
+        {
+            const float clamped = clamp(u, 0.f, float(segments.size()));
+            s = std::min(static_cast<size_t>(clamped), segments.size() - 1);
+            t = clamped - float(s);
+        }
+
+        // Local parameter within segment `s` at `local` distance from its start. `k` is the table interval to start
+        // from; uniform_parameters() walks forward from the previous answer instead of searching.
+        float local_parameter(const size_t s, const float local, size_t k) const
+        {
+            const float * row = &table[s * (SAMPLES_PER_SEGMENT + 1)];
+            while (k + 1 < SAMPLES_PER_SEGMENT && row[k + 1] <= local) ++k;
+
+            const float span = row[k + 1] - row[k];
+            const float t0 = float(k) / SAMPLES_PER_SEGMENT, t1 = float(k + 1) / SAMPLES_PER_SEGMENT;
+            float t = (span > 0.f) ? t0 + (local - row[k]) / span * (t1 - t0) : t0;
+
+            // One Newton step on L(t) - local = 0 removes most of the linear interpolation error
+            const float speed = linalg::length(eval_derivative(segments[s], t));
+            if (speed > 0.f) t = clamp(t - (row[k] + integrate_length(segments[s], t0, t) - local) / speed, t0, t1);
+            return t;
+        }
+
+    public:
+
+        Spline() {}
+        Spline(const SplineBasis basis, const std::vector<float3> & points) { set_control_points(basis, points); }
+
+        void set_control_points(const SplineBasis basis, const std::vector<float3> & points)
+        {
+            this->basis = basis;
+            controlPoints = points;
+            segments.resize(segments_for(points.size()));
+            table.resize(segments.size() * (SAMPLES_PER_SEGMENT + 1));
+            for (size_t s = 0; s < segments.size(); ++s) tabulate(s);
+            accumulate();
+        }
+
+        // Moves one control point, re-tabulating only the segments that depend on it
+        void set_control_point(const size_t index, const float3 & p)
         {
-            d = 0.0f;
-            
-            SplinePoint to;
-            SplinePoint from;
-            float td = 0.0f;
-            
-            for (size_t j = 0; j < points.size() - 1; j++)
+            assert(index < controlPoints.size());
+            controlPoints[index] = p;
+            if (segments.empty()) return;
+
+            size_t first, last;
+            const size_t n = segments.size() - 1;
+            switch (basis)
             {
-                points[j].distance = td;
-                points[j].ac = d;
-                
-                from = points[j];
-                to = points[j + 1];
-                td = distance(to.point, from.point);
-                
-                d += td;
+            case SplineBasis::catmull_rom: first = index >= 2 ? index - 2 : 0; last = index + 1; break;
+            case SplineBasis::bezier: first = index >= 1 ? (index - 1) / 3 : 0; last = index / 3; break;
+            default: first = index >= 3 ? index - 3 : 0; last = index; break;
             }
-            
-            points[points.size() - 1].distance = 0;
-            points[points.size() - 1].ac = d;
-        }
-        
-        float split_segment(const float distancePerStep, SplinePoint & a, const SplinePoint & b, std::vector<SplinePoint> & l)
-        {
-            SplinePoint t = b;
-            float distance = 0.0f;
-            
-            t.point -= a.point;
-            
-            auto rd = length(t.point);
-            t.point = safe_normalize(t.point);
-            t.point *= distancePerStep;
-            
-            auto s = std::floor(rd / distancePerStep);
-            
-            for (size_t i = 0; i < s; ++i)
+            for (size_t s = first; s <= std::min(last, n); ++s) tabulate(s);
+            accumulate();
+        }
+
+        const std::vector<float3> & get_control_points() const { return controlPoints; }
+        SplineBasis get_basis() const { return basis; }
+        size_t segment_count() const { return segments.size(); }
+        const Cubic & segment(const size_t s) const { return segments[s]; }
+        float length() const { return segmentStart.empty() ? 0.f : segmentStart.back(); }
+
+        float3 position(const float u) const { size_t s; float t; split(u, s, t); return eval(segments[s], t); }
+        float3 derivative(const float u) const { size_t s; float t; split(u, s, t); return eval_derivative(segments[s], t); }
+        float3 derivative2(const float u) const { size_t s; float t; split(u, s, t); return 2.f * segments[s].c2 + 6.f * t * segments[s].c3; }
+        float3 tangent(const float u) const { return safe_normalize(derivative(u)); }
+
+        // Arc length from the start of the curve to `u`
+        float distance_at(const float u) const
+        {
+            size_t s; float t; split(u, s, t);
+            const int k = std::min(int(t * SAMPLES_PER_SEGMENT), SAMPLES_PER_SEGMENT - 1);
+            return segmentStart[s] + table[s * (SAMPLES_PER_SEGMENT + 1) + k] + integrate_length(segments[s], float(k) / SAMPLES_PER_SEGMENT, t);
+        }
+
+        // Parameter at arc length `d`, clamped to the curve; O(log segments + log SAMPLES_PER_SEGMENT)
+        float parameter_at_distance(const float d) const
+        {
+            if (segments.empty()) return 0.f;
+            const float target = clamp(d, 0.f, length());
+            const size_t s = std::min(static_cast<size_t>(std::upper_bound(segmentStart.begin(), segmentStart.end(), target) - segmentStart.begin()) - 1, segments.size() - 1);
+            const float local = target - segmentStart[s];
+
+            const float * row = &table[s * (SAMPLES_PER_SEGMENT + 1)];
+            const size_t k = std::min(static_cast<size_t>(std::upper_bound(row, row + SAMPLES_PER_SEGMENT + 1, local) - row), size_t(SAMPLES_PER_SEGMENT)) - 1;
+            return float(s) + local_parameter(s, local, k);
+        }
+
+        // Parameters of `count` samples evenly spaced by arc length, ends included. The distances are sorted, so
+        // this walks the table once instead of searching per sample.
+        void uniform_parameters(const size_t count, float * u) const
+        {
+            if (count == 0) return;
+            if (segments.empty() || count == 1) { std::fill(u, u + count, 0.f); return; }
+
+            const float step = length() / float(count - 1);
+            size_t s = 0, k = 0;
+            for (size_t i = 0; i < count; ++i)
             {
-                a.point += t.point;
-                l.push_back(a);
-                distance += distancePerStep;
+                const float d = std::min(step * float(i), length());
+                while (s + 1 < segments.size() && segmentStart[s + 1] <= d) { ++s; k = 0; }
+                const float local = d - segmentStart[s];
+                const float t = local_parameter(s, local, k);
+                k = std::min(static_cast<size_t>(t * SAMPLES_PER_SEGMENT), size_t(SAMPLES_PER_SEGMENT - 1));
+                u[i] = float(s) + t;
             }
-            return distance;
+            u[count - 1] = float(segments.size());
         }
-        
+
+        // Positions (and optionally first derivatives) at `count` parameters, W lanes at a time. Segment coefficients
+        // are gathered per lane and evaluated with Horner's rule in lane registers.
+        template<typename T = simd::float_xN>
+        void evaluate(const float * u, const size_t count, float3 * positions, float3 * derivatives = nullptr) const
+        {
+            if (segments.empty()) return;
+            const size_t W = simd::lane_traits<T>::width;
+
+            size_t i = 0;
+            for (; i + W <= count; i += W)
+            {
+                float t[simd::lane_traits<T>::width], c[12][simd::lane_traits<T>::width];
+                for (size_t lane = 0; lane < W; ++lane)
+                {
+                    size_t s;
+                    split(u[i + lane], s, t[lane]);
+                    const Cubic & cubic = segments[s];
+                    const float3 * coefficients[4] = { &cubic.c0, &cubic.c1, &cubic.c2, &cubic.c3 };
+                    for (int j = 0; j < 4; ++j) for (int axis = 0; axis < 3; ++axis) c[j * 3 + axis][lane] = (*coefficients[j])[axis];
+                }
+
+                const T tt = simd::load<T>(t);
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    const T c0 = simd::load<T>(c[axis]), c1 = simd::load<T>(c[3 + axis]), c2 = simd::load<T>(c[6 + axis]), c3 = simd::load<T>(c[9 + axis]);
+                    float p[simd::lane_traits<T>::width];
+                    simd::store(p, c0 + tt * (c1 + tt * (c2 + tt * c3)));
+                    for (size_t lane = 0; lane < W; ++lane) positions[i + lane][axis] = p[lane];
+                    if (!derivatives) continue;
+                    simd::store(p, c1 + tt * (T(2.f) * c2 + tt * T(3.f) * c3));
+                    for (size_t lane = 0; lane < W; ++lane) derivatives[i + lane][axis] = p[lane];
+                }
+            }
+            for (; i < count; ++i)
+            {
+                size_t s; float t;
+                split(u[i], s, t);
+                positions[i] = eval(segments[s], t);
+                if (derivatives) derivatives[i] = eval_derivative(segments[s], t);
+            }
+        }
+
+        // `count` points evenly spaced by arc length, ends included, with unit tangents if requested
+        void sample_uniform(const size_t count, std::vector<float3> & positions, std::vector<float3> * tangents = nullptr) const
+        {
+            std::vector<float> u(count);
+            uniform_parameters(count, u.data());
+            positions.resize(count);
+            if (tangents) tangents->resize(count);
+            evaluate(u.data(), count, positions.data(), tangents ? tangents->data() : nullptr);
+            if (tangents) for (auto & t : *tangents) t = safe_normalize(t);
+        }
+
+        // Rotation-minimizing frames at `count` evenly spaced samples, by the double reflection method
+        // (Wang et al., "Computation of Rotation Minimizing Frames", 2008). Columns are (-side, normal, tangent,
+        // position); the first normal is the component of `up` orthogonal to the starting tangent.
+        std::vector<float4x4> sample_frames(const size_t count, const float3 & up = { 0, 1, 0 }) const
+        {
+            std::vector<float3> positions, tangents;
+            sample_uniform(count, positions, &tangents);
+            std::vector<float4x4> frames(count);
+            if (count == 0) return frames;
+
+            float3 side = cross(up, tangents[0]);
+            if (length2(side) < 1e-12f) side = cross(float3(1, 0, 0), tangents[0]);
+            float3 normal = safe_normalize(cross(tangents[0], safe_normalize(side)));
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (i > 0)
+                {
+                    const float3 v1 = positions[i] - positions[i - 1];
+                    const float c1 = dot(v1, v1);
+                    if (c1 > 0.f)
+                    {
+                        const float3 rL = normal - (2.f / c1) * dot(v1, normal) * v1;
+                        const float3 tL = tangents[i - 1] - (2.f / c1) * dot(v1, tangents[i - 1]) * v1;
+                        const float3 v2 = tangents[i] - tL;
+                        const float c2 = dot(v2, v2);
+                        normal = (c2 > 0.f) ? rL - (2.f / c2) * dot(v2, rL) * v2 : rL;
+                    }
+                }
+                side = cross(normal, tangents[i]);
+                frames[i] = { float4(-side, 0), float4(normal, 0), float4(tangents[i], 0), float4(positions[i], 1) };
+            }
+            return frames;
+        }
+    };
+
+    // Samples a single cubic Bezier (p0..p3) at a constant rate along its length
+    class ConstantSpline
+    {
+        Spline spline;
+        std::vector<float3> lPoints;
+
+    public:
+
+        float3 p0, p1, p2, p3;
+
+        float d = 0.0f;
+
+        ConstantSpline() { };
+
+        // The arc-length table replaces the fixed-increment sampling; the increment argument is kept for existing callers
+        void calculate(float /*increment*/ = 0.01f)
+        {
+            spline.set_control_points(SplineBasis::bezier, { p0, p1, p2, p3 });
+            d = spline.length();
+        }
+
+        void calculate_distances()
+        {
+            d = spline.length();
+        }
+
         // In Will Wright's own words:
         //  "Construct network based functions that are defined by divisible intervals
         //   while approximating said network and composing it of pieces of simple functions defined on
         //   subintervals and joined at their endpoints with a suitable degree of smoothness."
         void reticulate(uint32_t steps)
         {
-            float distancePerStep = d / float(steps);
-            
-            lPoints.clear();
-            
-            float localD = 0.f;
-            
-            // First point
-            SplinePoint current = points[0];
-            lPoints.push_back(current);
-            
-            // Reticulate
-            for (size_t i = 0; i < points.size(); ++i)
-            {
-                if (points[i].ac - localD > distancePerStep)
-                {
-                    localD += split_segment(distancePerStep, current, points[i], lPoints);
-                }
-            }
-            
-            // Last point
-            lPoints.push_back(points[points.size() - 1]);
+            spline.sample_uniform(steps + 1, lPoints);
         }
-        
+
         std::vector<float3> get_spline()
         {
-            std::vector<float3> spline;
-            for (auto & p : lPoints) { spline.push_back(p.point); };
-            return spline;
+            return lPoints;
         }
-        
+
     };
-    
-    
+
     class BezierCurve
     {
-        
-        void calculate_length()
-        {
-            arcLengths.resize(num_steps());
-            arcLengths[0] = 0.0f;
-            float3 start = p0;
-            for (int i = 1; i < num_steps(); i++)
-            {
-                float t = float(i) / float(num_steps() - 1);
-                float3 end = point(t);
-                float length = distance(start, end);
-                arcLengths[i] = arcLengths[i - 1] + length;
-                start = end;
-            }
-        }
-        
         float3 p0, p1, p2, p3;
-        std::vector<float> arcLengths;
-        
+        Spline arc;
+
     public:
-        
+
         BezierCurve(float3 p0, float3 p1, float3 p2, float3 p3)
         {
             set_control_points(p0, p1, p2, p3);
         }
-        
+
         void set_control_points(float3 p0, float3 p1, float3 p2, float3 p3)
         {
             this->p0 = p0;
             this->p1 = p1;
             this->p2 = p2;
             this->p3 = p3;
-            calculate_length();
+            arc.set_control_points(SplineBasis::bezier, { p0, p1, p2, p3 });
         }
-        
+
         float num_steps() const
         {
             return 32;
         }
-        
+
         float3 point(const float t) const
         {
             float t2 = t * t;
@@ -209,7 +405,7 @@ namespace avl
             float tt3 = tt2 * tt1;
             return (tt3 * p0) + (3.0f * t * tt2 * p1) + (3.0f * tt1 * t2 * p2) + (t3 * p3);
         }
-        
+
         float3 derivative(const float t) const
         {
             float t2 = t * t;
@@ -217,19 +413,19 @@ namespace avl
             float tt2 = tt1 * tt1;
             return (-3.0f * tt2 * p0) + ((3.0f * tt2 - 6.0f * t * tt1) * p1) + ((6.0f * t * tt1 - 3.0f * t2) * p2) + (3.0f * t2 * p3);
         }
-        
+
         float3 derivative2(const float t) const
         {
             return 6.0f * (1.0f - t) * (p2 - 2.0f * p1 + p0) + 6.0f * t * (p3 - 2.0f * p2 + p1);
         }
-        
+
         float curvature(const float t) const
         {
             float3 deriv = derivative(t);
             float3 deriv2 = derivative2(t);
             return linalg::length(cross(deriv, deriv2)) / powf(linalg::length(deriv), 3.0f);
         }
-        
+
         float max_curvature() const
         {
             float max = std::numeric_limits<float>::min();
@@ -239,43 +435,141 @@ namespace avl
                 float c = curvature(t);
                 if (c > max) max = c;
             }
-            
+
             return max;
         }
-        
+
         float length() const
         {
-            return arcLengths[arcLengths.size() - 1];
+            return arc.length();
         }
-        
-        float get_length_parameter(float t)
+
+        // Curve parameter at fraction `t` of the total length
+        float get_length_parameter(float t) const
         {
-            float targetLength = t * arcLengths[arcLengths.size() - 1];
-            
-            // Find largest arc length that is less than the target length
-            size_t first = 0;
-            size_t last = arcLengths.size() - 1;
-            while (first <= last)
+            return arc.parameter_at_distance(t * arc.length());
+        }
+
+        const Spline & get_spline() const { return arc; }
+
+    };
+
+    namespace spline_tests
+    {
+        inline std::vector<float3> make_helix(const size_t count)
+        {
+            std::vector<float3> points(count);
+            for (size_t i = 0; i < count; ++i) points[i] = { std::cos(i * 0.7f) * 3.f, i * 0.4f, std::sin(i * 0.7f) * 3.f };
+            return points;
+        }
+
+        // Reference length by brute-force chord summation
+        inline float chord_length(const Spline & s, const int steps)
+        {
+            float sum = 0.f;
+            float3 prev = s.position(0.f);
+            for (int i = 1; i <= steps; ++i)
             {
-                auto mid = (first + last) / 2;
-                if (arcLengths[mid] > targetLength) last = mid - 1;
-                else first = mid + 1;
+                const float3 p = s.position(float(s.segment_count()) * i / steps);
+                sum += distance(prev, p);
+                prev = p;
             }
-            
-            size_t index = first - 1;
-            if (arcLengths[index] == targetLength)
-                return index / float(arcLengths.size() - 1); // No need to interpolate
-            
-            // Begin interpolation
-            float start = arcLengths[index];
-            float end = arcLengths[index + 1];
-            float length = end - start;
-            float fraction = (targetLength - start) / length;
-            return (index + fraction) / float(arcLengths.size() - 1);
-        }
-        
-    };
-    
+            return sum;
+        }
+
+        inline void execute()
+        {
+            // Catmull-Rom interpolates its control points; Bezier its segment end points
+            const std::vector<float3> helix = make_helix(12);
+            Spline cr(SplineBasis::catmull_rom, helix);
+            assert(cr.segment_count() == 11);
+            for (size_t i = 0; i < helix.size(); ++i) assert(distance(cr.position(float(i)), helix[i]) < 1e-4f);
+
+            Spline bz(SplineBasis::bezier, make_helix(10));
+            assert(bz.segment_count() == 3);
+            assert(distance(bz.position(1.f), make_helix(10)[3]) < 1e-4f);
+
+            Spline bs(SplineBasis::bspline, helix);
+            assert(bs.segment_count() == 9);
+
+            // A straight uniform B-spline is parameterized linearly, so its length is exact
+            Spline line(SplineBasis::bspline, { { 0, 0, 0 }, { 1, 0, 0 }, { 2, 0, 0 }, { 3, 0, 0 }, { 4, 0, 0 } });
+            assert(std::abs(line.length() - 2.f) < 1e-5f);
+
+            for (const Spline * s : { &cr, &bz, &bs })
+            {
+                assert(std::abs(s->length() - chord_length(*s, 20000)) < 1e-3f * s->length());
+
+                // distance -> parameter -> distance round trips
+                for (int i = 0; i <= 50; ++i)
+                {
+                    const float d = s->length() * i / 50.f;
+                    assert(std::abs(s->distance_at(s->parameter_at_distance(d)) - d) < 1e-3f);
+                }
+
+                // Uniform samples are evenly spaced along the curve, and the batched and scalar evaluators agree
+                std::vector<float3> p, t;
+                s->sample_uniform(257, p, &t);
+                std::vector<float> u(257);
+                s->uniform_parameters(u.size(), u.data());
+                const float step = s->length() / 256.f;
+                for (size_t i = 0; i < u.size(); ++i) assert(std::abs(s->distance_at(u[i]) - step * i) < 1e-3f);
+                std::vector<float3> scalar(u.size());
+                s->evaluate<float>(u.data(), u.size(), scalar.data());
+                for (size_t i = 0; i < u.size(); ++i) assert(distance(scalar[i], p[i]) < 1e-5f && std::abs(length(t[i]) - 1.f) < 1e-4f);
+
+                // Frames stay orthonormal and follow the tangent
+                const std::vector<float4x4> frames = s->sample_frames(64);
+                for (size_t i = 0; i < frames.size(); ++i)
+                {
+                    const float3 x = frames[i][0].xyz(), y = frames[i][1].xyz(), z = frames[i][2].xyz();
+                    assert(std::abs(dot(x, y)) < 1e-3f && std::abs(dot(y, z)) < 1e-3f && std::abs(length(y) - 1.f) < 1e-3f);
+                }
+            }
+
+            // Moving one point matches a full rebuild
+            std::vector<float3> moved = helix;
+            moved[5] += float3(0, 2, 0);
+            Spline incremental = cr;
+            incremental.set_control_point(5, moved[5]);
+            const Spline rebuilt(SplineBasis::catmull_rom, moved);
+            assert(std::abs(incremental.length() - rebuilt.length()) < 1e-4f);
+            for (int i = 0; i <= 110; ++i) assert(distance(incremental.position(i * 0.1f), rebuilt.position(i * 0.1f)) < 1e-5f);
+        }
+
+        inline void benchmark(const size_t numPoints = 1024, const size_t numSamples = 1 << 20)
+        {
+            std::vector<float3> points = make_helix(numPoints);
+            Spline s;
+            {
+                AVL_SCOPED_TIMER("Spline::set_control_points");
+                s.set_control_points(SplineBasis::catmull_rom, points);
+            }
+            {
+                AVL_SCOPED_TIMER("Spline::set_control_point (x1000)");
+                for (int i = 0; i < 1000; ++i) s.set_control_point((i * 7919) % numPoints, points[(i * 104729) % numPoints]);
+            }
+
+            std::vector<float> u(numSamples);
+            float checksum = 0.f;
+            {
+                AVL_SCOPED_TIMER("Spline::parameter_at_distance (random)");
+                for (size_t i = 0; i < numSamples; ++i) checksum += s.parameter_at_distance(s.length() * float((i * 2654435761u) % numSamples) / numSamples);
+            }
+            {
+                AVL_SCOPED_TIMER("Spline::uniform_parameters");
+                s.uniform_parameters(numSamples, u.data());
+            }
+
+            std::vector<float3> p(numSamples), d(numSamples);
+            { AVL_SCOPED_TIMER("Spline::evaluate (scalar)"); s.evaluate<float>(u.data(), numSamples, p.data(), d.data()); checksum += p.back().x; }
+            { AVL_SCOPED_TIMER("Spline::evaluate (" + std::to_string(simd::lane_traits<simd::float_xN>::width) + "-wide)"); s.evaluate(u.data(), numSamples, p.data(), d.data()); checksum += p.back().x; }
+            { AVL_SCOPED_TIMER("Spline::sample_frames"); checksum += s.sample_frames(numSamples / 16).back()[3].x; }
+
+            std::cout << "checksum: " << checksum << std::endl;
+        }
+    }
+
 }
 
 #endif // constant_spline_h
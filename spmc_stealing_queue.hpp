@@ -78,8 +78,9 @@ class SPMCStealingQueue
         }
     };
 
-    alignas(cache_alignment)std::atomic< std::size_t > top_{ 0 };
-    alignas(cache_alignment)std::atomic< std::size_t > bottom_{ 0 };
+    // Indices start at 1 so that pop() on a never-used deque (bottom - 1) cannot wrap around to SIZE_MAX
+    alignas(cache_alignment)std::atomic< std::size_t > top_{ 1 };
+    alignas(cache_alignment)std::atomic< std::size_t > bottom_{ 1 };
     alignas(cache_alignment)std::atomic< array_t * >   backing_array;
     std::vector< array_t * >                           old_array_ts{};
     char                                               padding_[cacheline_length];
@@ -127,6 +128,26 @@ public:
         bottom_.store(bottom + 1, std::memory_order_relaxed);
     }
 
+    // Owner only: appends the batch and publishes it with a single store to bottom
+    void produce_bulk(const T * input, std::size_t count)
+    {
+        std::size_t bottom{ bottom_.load(std::memory_order_relaxed) };
+        std::size_t top{ top_.load(std::memory_order_acquire) };
+        array_t * a{ backing_array.load(std::memory_order_relaxed) };
+
+        while ((a->size() - 1) < (bottom - top + count))
+        {
+            array_t * tmp{ a->resize(bottom, top) };
+            old_array_ts.push_back(a);
+            std::swap(a, tmp);
+            backing_array.store(a, std::memory_order_relaxed);
+        }
+
+        for (std::size_t i = 0; i < count; ++i) a->push(bottom + i, input[i]);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(bottom + count, std::memory_order_relaxed);
+    }
+
     bool pop(T & output)
     {
         std::size_t bottom{ bottom_.load(std::memory_order_acquire) - 1 };
@@ -137,16 +158,14 @@ public:
 
         if (top <= bottom)
         {
-            output = a->pop(top);
+            output = a->pop(bottom);
 
             if (top == bottom)
             {
-                if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
-                {
-                    return false;
-                }
+                // Last element: race against thieves. Either way the deque is now empty, so bottom must be restored.
+                const bool won = top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
                 bottom_.store(bottom + 1, std::memory_order_relaxed);
-                return true;
+                return won;
             }
             return true;
         }
@@ -6,6 +6,7 @@
 #include <assert.h>
 #include <atomic>
 #include <stdint.h>
+#include <stddef.h>
 
 template<typename T>
 class SPSCBoundedQueue
@@ -35,10 +36,10 @@ public:
 
     ~SPSCBoundedQueue()
     {
-        delete[] buffer;
+        delete[] reinterpret_cast<aligned_t*>(buffer);
     }
 
-    bool produce(T & input)
+    bool produce(const T & input)
     {
         const size_t h = head.load(std::memory_order_relaxed);
 
@@ -57,12 +58,34 @@ public:
 
         if (((head.load(std::memory_order_acquire) - t) & mask) >= 1)
         {
-            output = buffer[tail & mask];
+            output = buffer[t & mask];
             tail.store(t + 1, std::memory_order_release);
             return true;
         }
         return false;
     }
+
+    // Writes as many of `count` items as fit and publishes them with one release store. Returns the number written.
+    size_t produce_bulk(const T * input, size_t count)
+    {
+        const size_t h = head.load(std::memory_order_relaxed);
+        const size_t space = (tail.load(std::memory_order_acquire) - (h + 1)) & mask;
+        const size_t n = count < space ? count : space;
+        for (size_t i = 0; i < n; ++i) buffer[(h + i) & mask] = input[i];
+        if (n) head.store(h + n, std::memory_order_release);
+        return n;
+    }
+
+    // Reads up to `maxCount` items and releases their slots with one store. Returns the number read.
+    size_t consume_bulk(T * output, size_t maxCount)
+    {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        const size_t available = (head.load(std::memory_order_acquire) - t) & mask;
+        const size_t n = maxCount < available ? maxCount : available;
+        for (size_t i = 0; i < n; ++i) output[i] = buffer[(t + i) & mask];
+        if (n) tail.store(t + n, std::memory_order_release);
+        return n;
+    }
     
 };
 
@@ -6,6 +6,7 @@
 #include <assert.h>
 #include <atomic>
 #include <stdint.h>
+#include <stddef.h>
 #include <vector>
 
 template<typename T>
@@ -49,6 +50,29 @@ public:
         return true;
     }
 
+    // Links the whole batch privately and publishes it with a single pointer write
+    size_t produce_bulk(const T * input, size_t count)
+    {
+        if (count == 0) return 0;
+
+        node_t * first = reinterpret_cast<node_t*>(new node_aligned_t);
+        node_t * last = first;
+        first->data = input[0];
+        for (size_t i = 1; i < count; ++i)
+        {
+            node_t * node = reinterpret_cast<node_t*>(new node_aligned_t);
+            node->data = input[i];
+            last->next = node;
+            last = node;
+        }
+        last->next = nullptr;
+
+        std::atomic_thread_fence(std::memory_order_acq_rel);
+        head->next = first;
+        head = last;
+        return count;
+    }
+
     bool consume(T & output)
     {
         std::atomic_thread_fence(std::memory_order_consume);
@@ -60,7 +84,14 @@ public:
         delete back;
         return true;
     }
-    
+
+    size_t consume_bulk(T * output, size_t maxCount)
+    {
+        size_t count = 0;
+        while (count < maxCount && consume(output[count])) ++count;
+        return count;
+    }
+
 };
 
 #endif // spsc_queue_hpp
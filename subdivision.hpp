@@ -0,0 +1,381 @@
+#pragma once
+
+#ifndef subdivision_hpp
+#define subdivision_hpp
+
+// Loop and Catmull-Clark subdivision over a compact half-edge mesh. Half-edges are stored face by face, so the edges
+// of face f are the contiguous range [faceOffsets[f], faceOffsets[f + 1]) and `next` is implicit; only `twin` has to
+// be found, once, with a hash of directed edges. Edges with no twin (or a third face on the same edge) are boundaries
+// and use the crease rules, so open meshes keep their outline instead of shrinking away from it.
+// Loop, C. "Smooth Subdivision Surfaces Based on Triangles". MS thesis, University of Utah, 1987.
+// Catmull, E., Clark, J. "Recursively generated B-spline surfaces on arbitrary topological meshes". CAD 10(6), 1978.
+
+#include "math-core.hpp"
+#include "geometry.hpp"
+#include "procedural_mesh.hpp"
+#include <algorithm>
+#include <vector>
+#include <unordered_map>
+
+using namespace avl;
+
+struct HalfEdgeMesh
+{
+    enum : uint32_t { NONE = 0xffffffff }; // no twin (boundary); an enum so it can be passed by reference without a definition
+
+    std::vector<float3> positions;
+    std::vector<uint32_t> faceOffsets{ 0 };   // face f owns half-edges [faceOffsets[f], faceOffsets[f + 1])
+    std::vector<uint32_t> origin;             // per half-edge: the vertex it leaves
+    std::vector<uint32_t> twin;               // per half-edge: the opposite half-edge, or NONE on a boundary
+
+    HalfEdgeMesh() {}
+
+    // Polygons given as a flat index list, `faceSizes[f]` indices per face
+    HalfEdgeMesh(const std::vector<float3> & positions, const std::vector<uint32_t> & faceSizes, const std::vector<uint32_t> & indices) : positions(positions)
+    {
+        faceOffsets.reserve(faceSizes.size() + 1);
+        for (const uint32_t n : faceSizes) faceOffsets.push_back(faceOffsets.back() + n);
+        origin = indices;
+        link_twins();
+    }
+
+    explicit HalfEdgeMesh(const Geometry & g) : positions(g.vertices)
+    {
+        faceOffsets.reserve(g.faces.size() + 1);
+        origin.reserve(g.faces.size() * 3);
+        for (const uint3 & f : g.faces)
+        {
+            origin.push_back(f.x); origin.push_back(f.y); origin.push_back(f.z);
+            faceOffsets.push_back(static_cast<uint32_t>(origin.size()));
+        }
+        link_twins();
+    }
+
+    size_t face_count() const { return faceOffsets.size() - 1; }
+    size_t face_size(size_t f) const { return faceOffsets[f + 1] - faceOffsets[f]; }
+    size_t half_edge_count() const { return origin.size(); }
+
+    uint32_t face_of(uint32_t h) const { return static_cast<uint32_t>(std::upper_bound(faceOffsets.begin(), faceOffsets.end(), h) - faceOffsets.begin() - 1); }
+    uint32_t next_in_face(uint32_t h, uint32_t face) const { return (h + 1 == faceOffsets[face + 1]) ? faceOffsets[face] : h + 1; }
+    uint32_t prev_in_face(uint32_t h, uint32_t face) const { return (h == faceOffsets[face]) ? faceOffsets[face + 1] - 1 : h - 1; }
+
+    // Triangulates each polygon as a fan and computes smooth normals
+    Geometry to_geometry() const
+    {
+        Geometry g;
+        g.vertices = positions;
+        for (size_t f = 0; f < face_count(); ++f)
+        {
+            const uint32_t first = faceOffsets[f];
+            for (uint32_t h = first + 1; h + 1 < faceOffsets[f + 1]; ++h) g.faces.push_back({ origin[first], origin[h], origin[h + 1] });
+        }
+        compute_normals(g);
+        return g;
+    }
+
+private:
+
+    void link_twins()
+    {
+        twin.assign(origin.size(), NONE);
+        std::unordered_map<uint64_t, uint32_t> directed;
+        directed.reserve(origin.size());
+
+        auto key = [](uint32_t a, uint32_t b) { return (uint64_t(a) << 32) | b; };
+
+        for (size_t f = 0; f < face_count(); ++f)
+        {
+            for (uint32_t h = faceOffsets[f]; h < faceOffsets[f + 1]; ++h)
+            {
+                directed.emplace(key(origin[h], origin[next_in_face(h, uint32_t(f))]), h);
+            }
+        }
+
+        for (size_t f = 0; f < face_count(); ++f)
+        {
+            for (uint32_t h = faceOffsets[f]; h < faceOffsets[f + 1]; ++h)
+            {
+                const uint32_t a = origin[h], b = origin[next_in_face(h, uint32_t(f))];
+                const auto it = directed.find(key(b, a));
+                // Only the first half-edge of each direction is paired, so non-manifold fans degrade to boundaries
+                if (it != directed.end() && directed.find(key(a, b))->second == h) twin[h] = it->second;
+            }
+        }
+    }
+};
+
+namespace subdivision_impl
+{
+    // Assigns one new vertex index per undirected edge, shared by both half-edges
+    inline std::vector<uint32_t> number_edges(const HalfEdgeMesh & m, uint32_t firstIndex, uint32_t & count)
+    {
+        std::vector<uint32_t> edgeVertex(m.half_edge_count(), HalfEdgeMesh::NONE);
+        count = 0;
+        for (uint32_t h = 0; h < m.half_edge_count(); ++h)
+        {
+            if (edgeVertex[h] != HalfEdgeMesh::NONE) continue;
+            edgeVertex[h] = firstIndex + count++;
+            if (m.twin[h] != HalfEdgeMesh::NONE) edgeVertex[m.twin[h]] = edgeVertex[h];
+        }
+        return edgeVertex;
+    }
+
+    // Per vertex: sum and count of the neighbours along boundary edges (both directions), used by the crease rules
+    inline void gather_boundary(const HalfEdgeMesh & m, std::vector<float3> & boundarySum, std::vector<uint32_t> & boundaryCount)
+    {
+        boundarySum.assign(m.positions.size(), float3(0, 0, 0));
+        boundaryCount.assign(m.positions.size(), 0);
+        for (size_t f = 0; f < m.face_count(); ++f)
+        {
+            for (uint32_t h = m.faceOffsets[f]; h < m.faceOffsets[f + 1]; ++h)
+            {
+                if (m.twin[h] != HalfEdgeMesh::NONE) continue;
+                const uint32_t a = m.origin[h], b = m.origin[m.next_in_face(h, uint32_t(f))];
+                boundarySum[a] += m.positions[b]; boundaryCount[a]++;
+                boundarySum[b] += m.positions[a]; boundaryCount[b]++;
+            }
+        }
+    }
+}
+
+// One level of Loop subdivision. Every face must be a triangle; each becomes four.
+inline HalfEdgeMesh subdivide_loop(const HalfEdgeMesh & m)
+{
+    using namespace subdivision_impl;
+    const uint32_t numVertices = static_cast<uint32_t>(m.positions.size());
+
+    uint32_t numEdges;
+    const std::vector<uint32_t> edgeVertex = number_edges(m, numVertices, numEdges);
+
+    std::vector<float3> boundarySum;
+    std::vector<uint32_t> boundaryCount;
+    gather_boundary(m, boundarySum, boundaryCount);
+
+    HalfEdgeMesh out;
+    out.positions.resize(numVertices + numEdges);
+
+    // Edge points: 3/8 of each endpoint and 1/8 of each opposite vertex, or the midpoint on a boundary
+    for (size_t f = 0; f < m.face_count(); ++f)
+    {
+        assert(m.face_size(f) == 3 && "loop subdivision needs triangles");
+        for (uint32_t h = m.faceOffsets[f]; h < m.faceOffsets[f + 1]; ++h)
+        {
+            const uint32_t t = m.twin[h];
+            if (t != HalfEdgeMesh::NONE && t < h) continue; // written once per undirected edge
+
+            const uint32_t n = m.next_in_face(h, uint32_t(f));
+            const float3 & a = m.positions[m.origin[h]];
+            const float3 & b = m.positions[m.origin[n]];
+            if (t == HalfEdgeMesh::NONE)
+            {
+                out.positions[edgeVertex[h]] = (a + b) * 0.5f;
+                continue;
+            }
+
+            const float3 & c = m.positions[m.origin[m.next_in_face(n, uint32_t(f))]];
+            const uint32_t tf = m.face_of(t);
+            const float3 & d = m.positions[m.origin[m.prev_in_face(t, tf)]];
+            out.positions[edgeVertex[h]] = (a + b) * (3.f / 8.f) + (c + d) * (1.f / 8.f);
+        }
+    }
+
+    // Vertex points: (1 - n*beta) v + beta * sum(neighbours), with Warren's beta; boundaries use 3/4 v + 1/8 (b0 + b1)
+    std::vector<float3> neighbourSum(numVertices, float3(0, 0, 0));
+    std::vector<uint32_t> valence(numVertices, 0);
+    for (size_t f = 0; f < m.face_count(); ++f)
+    {
+        for (uint32_t h = m.faceOffsets[f]; h < m.faceOffsets[f + 1]; ++h)
+        {
+            neighbourSum[m.origin[h]] += m.positions[m.origin[m.next_in_face(h, uint32_t(f))]];
+            valence[m.origin[h]]++;
+        }
+    }
+
+    for (uint32_t v = 0; v < numVertices; ++v)
+    {
+        const float3 & p = m.positions[v];
+        if (boundaryCount[v] == 2) out.positions[v] = p * 0.75f + boundarySum[v] * 0.125f;
+        else if (boundaryCount[v] > 0 || valence[v] == 0) out.positions[v] = p; // corner or isolated: pinned
+        else
+        {
+            const float n = float(valence[v]);
+            const float beta = (valence[v] == 3) ? 3.f / 16.f : 3.f / (8.f * n);
+            out.positions[v] = p * (1.f - n * beta) + neighbourSum[v] * beta;
+        }
+    }
+
+    // Corner triangles plus the centre one; winding is preserved
+    out.origin.reserve(m.face_count() * 12);
+    auto emit = [&](uint32_t a, uint32_t b, uint32_t c) { out.origin.push_back(a); out.origin.push_back(b); out.origin.push_back(c); };
+    for (size_t f = 0; f < m.face_count(); ++f)
+    {
+        const uint32_t h0 = m.faceOffsets[f], h1 = h0 + 1, h2 = h0 + 2;
+        const uint32_t v0 = m.origin[h0], v1 = m.origin[h1], v2 = m.origin[h2];
+        const uint32_t e01 = edgeVertex[h0], e12 = edgeVertex[h1], e20 = edgeVertex[h2];
+        emit(v0, e01, e20);
+        emit(v1, e12, e01);
+        emit(v2, e20, e12);
+        emit(e01, e12, e20);
+    }
+
+    return HalfEdgeMesh(out.positions, std::vector<uint32_t>(m.face_count() * 4, 3), out.origin);
+}
+
+// One level of Catmull-Clark subdivision. Faces may have any number of sides; each n-gon becomes n quads.
+inline HalfEdgeMesh subdivide_catmull_clark(const HalfEdgeMesh & m)
+{
+    using namespace subdivision_impl;
+    const uint32_t numVertices = static_cast<uint32_t>(m.positions.size());
+    const uint32_t numFaces = static_cast<uint32_t>(m.face_count());
+
+    uint32_t numEdges;
+    const std::vector<uint32_t> edgeVertex = number_edges(m, numVertices + numFaces, numEdges);
+
+    std::vector<float3> boundarySum;
+    std::vector<uint32_t> boundaryCount;
+    gather_boundary(m, boundarySum, boundaryCount);
+
+    HalfEdgeMesh out;
+    out.positions.resize(numVertices + numFaces + numEdges);
+
+    // Face points: centroids
+    for (uint32_t f = 0; f < numFaces; ++f)
+    {
+        float3 sum(0, 0, 0);
+        for (uint32_t h = m.faceOffsets[f]; h < m.faceOffsets[f + 1]; ++h) sum += m.positions[m.origin[h]];
+        out.positions[numVertices + f] = sum / float(m.face_size(f));
+    }
+
+    // Edge points: average of the endpoints and both face points, or the midpoint on a boundary
+    for (uint32_t f = 0; f < numFaces; ++f)
+    {
+        for (uint32_t h = m.faceOffsets[f]; h < m.faceOffsets[f + 1]; ++h)
+        {
+            const uint32_t t = m.twin[h];
+            if (t != HalfEdgeMesh::NONE && t < h) continue;
+            const float3 & a = m.positions[m.origin[h]];
+            const float3 & b = m.positions[m.origin[m.next_in_face(h, f)]];
+            if (t == HalfEdgeMesh::NONE) out.positions[edgeVertex[h]] = (a + b) * 0.5f;
+            else out.positions[edgeVertex[h]] = (a + b + out.positions[numVertices + f] + out.positions[numVertices + m.face_of(t)]) * 0.25f;
+        }
+    }
+
+    // Vertex points: (Q + 2R + (n - 3) S) / n from the adjacent face points Q and edge midpoints R
+    std::vector<float3> faceSum(numVertices, float3(0, 0, 0)), edgeSum(numVertices, float3(0, 0, 0));
+    std::vector<uint32_t> valence(numVertices, 0);
+    for (uint32_t f = 0; f < numFaces; ++f)
+    {
+        for (uint32_t h = m.faceOffsets[f]; h < m.faceOffsets[f + 1]; ++h)
+        {
+            const uint32_t v = m.origin[h];
+            faceSum[v] += out.positions[numVertices + f];
+            edgeSum[v] += (m.positions[v] + m.positions[m.origin[m.next_in_face(h, f)]]) * 0.5f;
+            valence[v]++;
+        }
+    }
+
+    for (uint32_t v = 0; v < numVertices; ++v)
+    {
+        const float3 & p = m.positions[v];
+        if (boundaryCount[v] == 2) out.positions[v] = p * 0.75f + boundarySum[v] * 0.125f;
+        else if (boundaryCount[v] > 0 || valence[v] == 0) out.positions[v] = p;
+        else
+        {
+            const float n = float(valence[v]);
+            out.positions[v] = (faceSum[v] / n + 2.f * edgeSum[v] / n + (n - 3.f) * p) / n;
+        }
+    }
+
+    // Quad per corner: vertex, outgoing edge point, face point, incoming edge point
+    out.origin.reserve(m.half_edge_count() * 4);
+    for (uint32_t f = 0; f < numFaces; ++f)
+    {
+        for (uint32_t h = m.faceOffsets[f]; h < m.faceOffsets[f + 1]; ++h)
+        {
+            out.origin.push_back(m.origin[h]);
+            out.origin.push_back(edgeVertex[h]);
+            out.origin.push_back(numVertices + f);
+            out.origin.push_back(edgeVertex[m.prev_in_face(h, f)]);
+        }
+    }
+
+    return HalfEdgeMesh(out.positions, std::vector<uint32_t>(m.half_edge_count(), 4), out.origin);
+}
+
+inline Geometry subdivide_loop(const Geometry & g, const int levels)
+{
+    HalfEdgeMesh m(g);
+    for (int i = 0; i < levels; ++i) m = subdivide_loop(m);
+    return m.to_geometry();
+}
+
+inline Geometry subdivide_catmull_clark(const Geometry & g, const int levels)
+{
+    HalfEdgeMesh m(g);
+    for (int i = 0; i < levels; ++i) m = subdivide_catmull_clark(m);
+    return m.to_geometry();
+}
+
+namespace subdivision_tests
+{
+    inline HalfEdgeMesh make_quad_cube()
+    {
+        const std::vector<float3> positions = { { -1, -1, -1 }, { 1, -1, -1 }, { 1, 1, -1 }, { -1, 1, -1 }, { -1, -1, 1 }, { 1, -1, 1 }, { 1, 1, 1 }, { -1, 1, 1 } };
+        const std::vector<uint32_t> indices = { 0, 3, 2, 1,  4, 5, 6, 7,  0, 1, 5, 4,  2, 3, 7, 6,  1, 2, 6, 5,  0, 4, 7, 3 };
+        return HalfEdgeMesh(positions, std::vector<uint32_t>(6, 4), indices);
+    }
+
+    inline size_t count_boundary(const HalfEdgeMesh & m)
+    {
+        size_t n = 0;
+        for (const uint32_t t : m.twin) if (t == HalfEdgeMesh::NONE) n++;
+        return n;
+    }
+
+    inline void execute()
+    {
+        // V - E + F stays 2 on closed meshes: Loop adds one vertex per edge, Catmull-Clark one per edge and face
+        {
+            const Geometry ico = make_icosahedron();
+            HalfEdgeMesh m(ico);
+            assert(m.positions.size() == 12 && m.face_count() == 20 && count_boundary(m) == 0);
+
+            m = subdivide_loop(m);
+            assert(m.positions.size() == 12 + 30 && m.face_count() == 80 && count_boundary(m) == 0);
+            m = subdivide_loop(m);
+            assert(m.positions.size() == 42 + 120 && m.face_count() == 320);
+
+            // Symmetric input: every vertex stays equidistant from the center
+            const float r = length(m.positions[0]);
+            for (const float3 & p : m.positions) assert(std::abs(length(p) - r) < 0.05f * r);
+        }
+        {
+            HalfEdgeMesh m = make_quad_cube();
+            assert(count_boundary(m) == 0);
+            m = subdivide_catmull_clark(m);
+            assert(m.positions.size() == 8 + 12 + 6 && m.face_count() == 24 && count_boundary(m) == 0);
+
+            // The limit surface lies inside the control cage; corners move inward along the diagonal
+            const float3 corner = m.positions[6];
+            assert(corner.x < 1.f && std::abs(corner.x - corner.y) < 1e-5f && std::abs(corner.y - corner.z) < 1e-5f);
+        }
+
+        // A flat open grid stays flat, and its outline keeps its extent
+        {
+            const std::vector<float3> positions = { { 0, 0, 0 }, { 1, 0, 0 }, { 2, 0, 0 }, { 0, 1, 0 }, { 1, 1, 0 }, { 2, 1, 0 } };
+            const std::vector<uint32_t> indices = { 0, 1, 4, 3,  1, 2, 5, 4 };
+            HalfEdgeMesh m(positions, { 4, 4 }, indices);
+            assert(count_boundary(m) == 6);
+            m = subdivide_catmull_clark(m);
+            float maxX = 0.f;
+            for (const float3 & p : m.positions) { assert(p.z == 0.f); maxX = std::max(maxX, p.x); }
+            assert(maxX == 2.f);
+
+            Geometry tri = HalfEdgeMesh(positions, { 4, 4 }, indices).to_geometry();
+            HalfEdgeMesh loop = subdivide_loop(HalfEdgeMesh(tri));
+            for (const float3 & p : loop.positions) assert(p.z == 0.f);
+        }
+    }
+}
+
+#endif // end subdivision_hpp
@@ -0,0 +1,500 @@
+#pragma once
+
+#ifndef svd_3x3_hpp
+#define svd_3x3_hpp
+
+// Branch-free 3x3 SVD and polar decomposition, based on:
+// A. McAdams, A. Selle, R. Tamstorf, J. Teran, E. Sifakis, "Computing the Singular Value Decomposition of 3x3 matrices
+// with minimal branching and elementary floating point operations," University of Wisconsin-Madison TR1690, 2011.
+// The symmetric eigenproblem of A^T*A is solved with a fixed number of approximate Jacobi sweeps, accumulating V as a
+// quaternion; A*V is then sorted and QR factored with Givens rotations to produce U and the singular values.
+// Every operation is written against the lane helpers in simd_lanes.hpp, so the same kernel runs on one matrix
+// (float) or on 4/8 matrices at once (SSE/AVX) over structure-of-arrays storage.
+
+#include "math-core.hpp"
+#include "simd_lanes.hpp"
+#include "svd.hpp"
+#include "util.hpp"
+#include <vector>
+#include <random>
+
+using namespace avl;
+
+namespace svd_3x3_impl
+{
+    constexpr static const float GAMMA = 5.828427124f;  // 3 + 2*sqrt(2)
+    constexpr static const float C_STAR = 0.923879532f; // cos(pi/8)
+    constexpr static const float S_STAR = 0.382683432f; // sin(pi/8)
+    constexpr static const float QR_EPSILON = 1e-6f;
+    constexpr static const int JACOBI_SWEEPS = 6; // the paper suggests 4; 6 reaches float precision on poorly separated spectra
+
+    // Row-major element storage so that m[r][c] reads the same as the paper
+    template<typename T> struct mat3 { T m[3][3]; };
+
+    template<typename T>
+    inline void cond_swap(const typename simd::lane_traits<T>::mask_type & c, T & x, T & y)
+    {
+        const T z = x;
+        x = simd::select(c, y, x);
+        y = simd::select(c, z, y);
+    }
+
+    template<typename T>
+    inline void cond_neg_swap(const typename simd::lane_traits<T>::mask_type & c, T & x, T & y)
+    {
+        const T z = -x;
+        x = simd::select(c, y, x);
+        y = simd::select(c, z, y);
+    }
+
+    template<typename T>
+    inline void approximate_givens_quaternion(const T & a11, const T & a12, const T & a22, T & ch, T & sh)
+    {
+        ch = T(2.0f) * (a11 - a22);
+        sh = a12;
+        const auto b = simd::less(T(GAMMA) * sh * sh, ch * ch);
+        const T w = simd::rsqrt(ch * ch + sh * sh);
+        ch = simd::select(b, w * ch, T(C_STAR));
+        sh = simd::select(b, w * sh, T(S_STAR));
+    }
+
+    // One Jacobi conjugation of the symmetric matrix s (lower triangle), zeroing s21. The (x,y,z) permutation picks
+    // which quaternion components the rotation acts on; the matrix is cycled afterwards so the next pair is in place.
+    template<int x, int y, int z, typename T>
+    inline void jacobi_conjugation(T & s11, T & s21, T & s22, T & s31, T & s32, T & s33, T * qV)
+    {
+        T ch, sh;
+        approximate_givens_quaternion(s11, s21, s22, ch, sh);
+
+        // (ch, sh) is already unit length, so the rotation needs no rescale; drift is removed when V is built
+        const T a = ch * ch - sh * sh;
+        const T b = T(2.0f) * sh * ch;
+
+        const T _s11 = s11, _s21 = s21, _s22 = s22, _s31 = s31, _s32 = s32, _s33 = s33;
+
+        const T n11 = a * (a * _s11 + b * _s21) + b * (a * _s21 + b * _s22);
+        const T n21 = a * (-b * _s11 + a * _s21) + b * (-b * _s21 + a * _s22);
+        const T n22 = -b * (-b * _s11 + a * _s21) + a * (-b * _s21 + a * _s22);
+        const T n31 = a * _s31 + b * _s32;
+        const T n32 = -b * _s31 + a * _s32;
+        const T n33 = _s33;
+
+        // Accumulate the rotation into qV (x, y, z, w)
+        const T tmp[3] = { qV[0] * sh, qV[1] * sh, qV[2] * sh };
+        sh = sh * qV[3];
+        qV[0] = qV[0] * ch; qV[1] = qV[1] * ch; qV[2] = qV[2] * ch; qV[3] = qV[3] * ch;
+        qV[z] = qV[z] + sh;
+        qV[3] = qV[3] - tmp[z];
+        qV[x] = qV[x] + tmp[y];
+        qV[y] = qV[y] - tmp[x];
+
+        // Cycle the matrix for the next pair
+        s11 = n22; s21 = n32; s22 = n33; s31 = n21; s32 = n31; s33 = n11;
+    }
+
+    template<typename T>
+    inline void jacobi_eigenanalysis(T s11, T s21, T s22, T s31, T s32, T s33, T * qV)
+    {
+        qV[0] = T(0.0f); qV[1] = T(0.0f); qV[2] = T(0.0f); qV[3] = T(1.0f);
+        for (int i = 0; i < JACOBI_SWEEPS; ++i)
+        {
+            jacobi_conjugation<0, 1, 2>(s11, s21, s22, s31, s32, s33, qV);
+            jacobi_conjugation<1, 2, 0>(s11, s21, s22, s31, s32, s33, qV);
+            jacobi_conjugation<2, 0, 1>(s11, s21, s22, s31, s32, s33, qV);
+        }
+    }
+
+    template<typename T>
+    inline mat3<T> quat_to_mat3(const T * qV)
+    {
+        const T n = simd::rsqrt(qV[0] * qV[0] + qV[1] * qV[1] + qV[2] * qV[2] + qV[3] * qV[3]);
+        const T x = qV[0] * n, y = qV[1] * n, z = qV[2] * n, w = qV[3] * n;
+        const T xx = x * x, yy = y * y, zz = z * z, xy = x * y, xz = x * z, yz = y * z, wx = w * x, wy = w * y, wz = w * z;
+        const T one(1.0f), two(2.0f);
+
+        mat3<T> r;
+        r.m[0][0] = one - two * (yy + zz); r.m[0][1] = two * (xy - wz);       r.m[0][2] = two * (xz + wy);
+        r.m[1][0] = two * (xy + wz);       r.m[1][1] = one - two * (xx + zz); r.m[1][2] = two * (yz - wx);
+        r.m[2][0] = two * (xz - wy);       r.m[2][1] = two * (yz + wx);       r.m[2][2] = one - two * (xx + yy);
+        return r;
+    }
+
+    // Orders the columns of B (and V) by descending norm, negating to keep both proper rotations
+    template<typename T>
+    inline void sort_singular_values(mat3<T> & B, mat3<T> & V)
+    {
+        T rho1 = B.m[0][0] * B.m[0][0] + B.m[1][0] * B.m[1][0] + B.m[2][0] * B.m[2][0];
+        T rho2 = B.m[0][1] * B.m[0][1] + B.m[1][1] * B.m[1][1] + B.m[2][1] * B.m[2][1];
+        T rho3 = B.m[0][2] * B.m[0][2] + B.m[1][2] * B.m[1][2] + B.m[2][2] * B.m[2][2];
+
+        auto c = simd::less(rho1, rho2);
+        for (int r = 0; r < 3; ++r) { cond_neg_swap(c, B.m[r][0], B.m[r][1]); cond_neg_swap(c, V.m[r][0], V.m[r][1]); }
+        cond_swap(c, rho1, rho2);
+
+        c = simd::less(rho1, rho3);
+        for (int r = 0; r < 3; ++r) { cond_neg_swap(c, B.m[r][0], B.m[r][2]); cond_neg_swap(c, V.m[r][0], V.m[r][2]); }
+        cond_swap(c, rho1, rho3);
+
+        c = simd::less(rho2, rho3);
+        for (int r = 0; r < 3; ++r) { cond_neg_swap(c, B.m[r][1], B.m[r][2]); cond_neg_swap(c, V.m[r][1], V.m[r][2]); }
+    }
+
+    template<typename T>
+    inline void qr_givens_quaternion(const T & a1, const T & a2, T & ch, T & sh)
+    {
+        const T eps(QR_EPSILON);
+        const T rho = simd::sqrt(a1 * a1 + a2 * a2);
+        sh = simd::select(simd::greater(rho, eps), a2, T(0.0f));
+        ch = simd::abs(a1) + simd::max(rho, eps);
+        cond_swap(simd::less(a1, T(0.0f)), sh, ch);
+        const T w = simd::rsqrt(ch * ch + sh * sh);
+        ch = ch * w;
+        sh = sh * w;
+    }
+
+    // Factors B = Q*R with three Givens rotations; R's diagonal holds the (signed) singular values
+    template<typename T>
+    inline void qr_decomposition(const mat3<T> & B, mat3<T> & Q, mat3<T> & R)
+    {
+        const T one(1.0f), two(2.0f);
+        T ch1, sh1, ch2, sh2, ch3, sh3;
+        mat3<T> t;
+
+        qr_givens_quaternion(B.m[0][0], B.m[1][0], ch1, sh1);
+        T a = one - two * sh1 * sh1;
+        T b = two * ch1 * sh1;
+        for (int c = 0; c < 3; ++c)
+        {
+            R.m[0][c] = a * B.m[0][c] + b * B.m[1][c];
+            R.m[1][c] = -b * B.m[0][c] + a * B.m[1][c];
+            R.m[2][c] = B.m[2][c];
+        }
+
+        qr_givens_quaternion(R.m[0][0], R.m[2][0], ch2, sh2);
+        a = one - two * sh2 * sh2;
+        b = two * ch2 * sh2;
+        for (int c = 0; c < 3; ++c)
+        {
+            t.m[0][c] = a * R.m[0][c] + b * R.m[2][c];
+            t.m[1][c] = R.m[1][c];
+            t.m[2][c] = -b * R.m[0][c] + a * R.m[2][c];
+        }
+
+        qr_givens_quaternion(t.m[1][1], t.m[2][1], ch3, sh3);
+        a = one - two * sh3 * sh3;
+        b = two * ch3 * sh3;
+        for (int c = 0; c < 3; ++c)
+        {
+            R.m[0][c] = t.m[0][c];
+            R.m[1][c] = a * t.m[1][c] + b * t.m[2][c];
+            R.m[2][c] = -b * t.m[1][c] + a * t.m[2][c];
+        }
+
+        // Q = Q1 * Q2 * Q3
+        const T sh12 = sh1 * sh1, sh22 = sh2 * sh2, sh32 = sh3 * sh3;
+        const T four(4.0f), eight(8.0f);
+        Q.m[0][0] = (-one + two * sh12) * (-one + two * sh22);
+        Q.m[0][1] = four * ch2 * ch3 * (-one + two * sh12) * sh2 * sh3 + two * ch1 * sh1 * (-one + two * sh32);
+        Q.m[0][2] = four * ch1 * ch3 * sh1 * sh3 - two * ch2 * (-one + two * sh12) * sh2 * (-one + two * sh32);
+        Q.m[1][0] = two * ch1 * sh1 * (one - two * sh22);
+        Q.m[1][1] = -eight * ch1 * ch2 * ch3 * sh1 * sh2 * sh3 + (-one + two * sh12) * (-one + two * sh32);
+        Q.m[1][2] = -two * ch3 * sh3 + four * sh1 * (ch3 * sh1 * sh3 + ch1 * ch2 * sh2 * (-one + two * sh32));
+        Q.m[2][0] = two * ch2 * sh2;
+        Q.m[2][1] = two * ch3 * (one - two * sh22) * sh3;
+        Q.m[2][2] = (-one + two * sh22) * (-one + two * sh32);
+    }
+
+    template<typename T>
+    inline mat3<T> mul(const mat3<T> & a, const mat3<T> & b)
+    {
+        mat3<T> r;
+        for (int i = 0; i < 3; ++i) for (int j = 0; j < 3; ++j) r.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j];
+        return r;
+    }
+
+    // A = U * diag(S) * V^T where U and V are proper rotations; S[2] may be negative if det(A) < 0
+    template<typename T>
+    inline void svd(const mat3<T> & A, mat3<T> & U, T * S, mat3<T> & V)
+    {
+        // Lower triangle of A^T * A
+        T ata[3][3];
+        for (int i = 0; i < 3; ++i) for (int j = 0; j <= i; ++j) ata[i][j] = A.m[0][i] * A.m[0][j] + A.m[1][i] * A.m[1][j] + A.m[2][i] * A.m[2][j];
+
+        T qV[4];
+        jacobi_eigenanalysis(ata[0][0], ata[1][0], ata[1][1], ata[2][0], ata[2][1], ata[2][2], qV);
+        V = quat_to_mat3(qV);
+
+        mat3<T> B = mul(A, V);
+        sort_singular_values(B, V);
+
+        mat3<T> R;
+        qr_decomposition(B, U, R);
+        S[0] = R.m[0][0]; S[1] = R.m[1][1]; S[2] = R.m[2][2];
+    }
+
+    // A = R * P with R = U*V^T a rotation and P = V*diag(S)*V^T symmetric
+    template<typename T>
+    inline void polar(const mat3<T> & A, mat3<T> & R, mat3<T> & P)
+    {
+        mat3<T> U, V;
+        T S[3];
+        svd(A, U, S, V);
+        for (int i = 0; i < 3; ++i) for (int j = 0; j < 3; ++j)
+        {
+            R.m[i][j] = U.m[i][0] * V.m[j][0] + U.m[i][1] * V.m[j][1] + U.m[i][2] * V.m[j][2];
+            P.m[i][j] = V.m[i][0] * S[0] * V.m[j][0] + V.m[i][1] * S[1] * V.m[j][1] + V.m[i][2] * S[2] * V.m[j][2];
+        }
+    }
+
+    inline mat3<float> from_float3x3(const float3x3 & a)
+    {
+        mat3<float> r;
+        for (int i = 0; i < 3; ++i) for (int j = 0; j < 3; ++j) r.m[i][j] = a[j][i];
+        return r;
+    }
+
+    inline float3x3 to_float3x3(const mat3<float> & a)
+    {
+        float3x3 r;
+        for (int i = 0; i < 3; ++i) for (int j = 0; j < 3; ++j) r[j][i] = a.m[i][j];
+        return r;
+    }
+}
+
+// Nine parallel arrays, one per matrix element (row-major: e[0] = m00, e[1] = m01, ... e[8] = m22)
+struct Matrix3x3Stream
+{
+    std::vector<float> e[9];
+
+    Matrix3x3Stream(size_t count = 0) { resize(count); }
+    void resize(size_t count) { for (auto & a : e) a.resize(count); }
+    size_t size() const { return e[0].size(); }
+
+    void set(size_t i, const float3x3 & m) { for (int r = 0; r < 3; ++r) for (int c = 0; c < 3; ++c) e[r * 3 + c][i] = m[c][r]; }
+    float3x3 get(size_t i) const { float3x3 m; for (int r = 0; r < 3; ++r) for (int c = 0; c < 3; ++c) m[c][r] = e[r * 3 + c][i]; return m; }
+};
+
+// Three parallel arrays of x, y, z
+struct Vector3Stream
+{
+    std::vector<float> e[3];
+
+    Vector3Stream(size_t count = 0) { resize(count); }
+    void resize(size_t count) { for (auto & a : e) a.resize(count); }
+    size_t size() const { return e[0].size(); }
+
+    void set(size_t i, const float3 & v) { e[0][i] = v.x; e[1][i] = v.y; e[2][i] = v.z; }
+    float3 get(size_t i) const { return { e[0][i], e[1][i], e[2][i] }; }
+};
+
+// Single-matrix entry points. U and V are rotations; S is sorted by descending magnitude and S.z carries the sign of det(A).
+inline void singular_value_decomposition_3x3(const float3x3 & A, float3x3 & U, float3 & S, float3x3 & V)
+{
+    svd_3x3_impl::mat3<float> u, v;
+    float s[3];
+    simd::scoped_flush_denormals ftz;
+    svd_3x3_impl::svd(svd_3x3_impl::from_float3x3(A), u, s, v);
+    U = svd_3x3_impl::to_float3x3(u);
+    V = svd_3x3_impl::to_float3x3(v);
+    S = { s[0], s[1], s[2] };
+}
+
+// A = R * P, where R is the closest rotation to A and P is symmetric
+inline void polar_decomposition_3x3(const float3x3 & A, float3x3 & R, float3x3 & P)
+{
+    svd_3x3_impl::mat3<float> r, p;
+    simd::scoped_flush_denormals ftz;
+    svd_3x3_impl::polar(svd_3x3_impl::from_float3x3(A), r, p);
+    R = svd_3x3_impl::to_float3x3(r);
+    P = svd_3x3_impl::to_float3x3(p);
+}
+
+namespace svd_3x3_impl
+{
+    template<typename T>
+    inline void svd_batch_range(const Matrix3x3Stream & A, Matrix3x3Stream & U, Vector3Stream & S, Matrix3x3Stream & V, size_t begin, size_t end)
+    {
+        const size_t W = simd::lane_traits<T>::width;
+        size_t i = begin;
+        for (; i + W <= end; i += W)
+        {
+            mat3<T> a, u, v;
+            T s[3];
+            for (int k = 0; k < 9; ++k) a.m[k / 3][k % 3] = simd::load<T>(&A.e[k][i]);
+            svd(a, u, s, v);
+            for (int k = 0; k < 9; ++k) { simd::store(&U.e[k][i], u.m[k / 3][k % 3]); simd::store(&V.e[k][i], v.m[k / 3][k % 3]); }
+            for (int k = 0; k < 3; ++k) simd::store(&S.e[k][i], s[k]);
+        }
+        for (; i < end; ++i)
+        {
+            mat3<float> a, u, v;
+            float s[3];
+            for (int k = 0; k < 9; ++k) a.m[k / 3][k % 3] = A.e[k][i];
+            svd(a, u, s, v);
+            for (int k = 0; k < 9; ++k) { U.e[k][i] = u.m[k / 3][k % 3]; V.e[k][i] = v.m[k / 3][k % 3]; }
+            for (int k = 0; k < 3; ++k) S.e[k][i] = s[k];
+        }
+    }
+
+    template<typename T>
+    inline void polar_batch_range(const Matrix3x3Stream & A, Matrix3x3Stream & R, Matrix3x3Stream & P, size_t begin, size_t end)
+    {
+        const size_t W = simd::lane_traits<T>::width;
+        size_t i = begin;
+        for (; i + W <= end; i += W)
+        {
+            mat3<T> a, r, p;
+            for (int k = 0; k < 9; ++k) a.m[k / 3][k % 3] = simd::load<T>(&A.e[k][i]);
+            polar(a, r, p);
+            for (int k = 0; k < 9; ++k) { simd::store(&R.e[k][i], r.m[k / 3][k % 3]); simd::store(&P.e[k][i], p.m[k / 3][k % 3]); }
+        }
+        for (; i < end; ++i)
+        {
+            mat3<float> a, r, p;
+            for (int k = 0; k < 9; ++k) a.m[k / 3][k % 3] = A.e[k][i];
+            polar(a, r, p);
+            for (int k = 0; k < 9; ++k) { R.e[k][i] = r.m[k / 3][k % 3]; P.e[k][i] = p.m[k / 3][k % 3]; }
+        }
+    }
+}
+
+// Batched SVD over SoA storage, processed simd::float_xN lanes at a time (8 with AVX, 4 with SSE). Outputs are resized to match.
+inline void singular_value_decomposition_3x3(const Matrix3x3Stream & A, Matrix3x3Stream & U, Vector3Stream & S, Matrix3x3Stream & V)
+{
+    U.resize(A.size()); S.resize(A.size()); V.resize(A.size());
+    simd::scoped_flush_denormals ftz;
+    svd_3x3_impl::svd_batch_range<simd::float_xN>(A, U, S, V, 0, A.size());
+}
+
+inline void polar_decomposition_3x3(const Matrix3x3Stream & A, Matrix3x3Stream & R, Matrix3x3Stream & P)
+{
+    R.resize(A.size()); P.resize(A.size());
+    simd::scoped_flush_denormals ftz;
+    svd_3x3_impl::polar_batch_range<simd::float_xN>(A, R, P, 0, A.size());
+}
+
+namespace svd_3x3_tests
+{
+    inline float3x3 make_diagonal(const float3 & d) { return { { d.x, 0, 0 }, { 0, d.y, 0 }, { 0, 0, d.z } }; }
+
+    // Checks reconstruction and orthonormality against the general solver in svd.hpp and returns the worst singular value error
+    inline float validate_matrix(const float3x3 & A)
+    {
+        float3x3 U, V;
+        float3 S;
+        singular_value_decomposition_3x3(A, U, S, V);
+
+        float maxEntry = 0;
+        for (int i = 0; i < 3; ++i) for (int j = 0; j < 3; ++j) maxEntry = std::max(maxEntry, std::abs(A[j][i]));
+        const float valueEps = std::max(maxEntry, 1.0f) * 1e-4f;
+
+        const float3x3 P = mul(U, mul(make_diagonal(S), transpose(V)));
+        for (int i = 0; i < 3; ++i) for (int j = 0; j < 3; ++j) assert(std::abs(P[i][j] - A[i][j]) <= valueEps);
+
+        assert(std::abs(determinant(U) - 1.0f) < 1e-3f);
+        assert(std::abs(determinant(V) - 1.0f) < 1e-3f);
+
+        float3x3 ref = A, refV;
+        std::vector<float> refS(3);
+        singular_value_decomposition<float3x3, float>(ref, 3, 3, refS, refV);
+
+        float worst = 0;
+        for (int i = 0; i < 3; ++i) worst = std::max(worst, std::abs(std::abs(S[i]) - refS[i]));
+        assert(worst <= valueEps);
+        return worst;
+    }
+
+    // R must be a rotation (orthonormal, det +1), P symmetric, and R * P must reproduce A. When det(A) < 0, P carries
+    // the reflection, so it is symmetric but not positive definite.
+    inline void validate_polar(const float3x3 & A, const float3x3 & R, const float3x3 & P)
+    {
+        float maxEntry = 0;
+        for (int i = 0; i < 3; ++i) for (int j = 0; j < 3; ++j) maxEntry = std::max(maxEntry, std::abs(A[j][i]));
+        const float valueEps = std::max(maxEntry, 1.0f) * 1e-4f;
+
+        const float3x3 RtR = mul(transpose(R), R), RP = mul(R, P);
+        for (int i = 0; i < 3; ++i) for (int j = 0; j < 3; ++j)
+        {
+            assert(std::abs(RtR[i][j] - (i == j ? 1.0f : 0.0f)) < 1e-4f);
+            assert(std::abs(P[i][j] - P[j][i]) <= valueEps);
+            assert(std::abs(RP[i][j] - A[i][j]) <= valueEps);
+        }
+        assert(std::abs(determinant(R) - 1.0f) < 1e-4f);
+    }
+
+    inline void execute()
+    {
+        validate_matrix(Identity3x3);
+        validate_matrix({ { -0.46673855799602715f, 0.67466260360310948f, 0.97646986796448998f }, { -0.032460753747103721f, 0.046584527749418278f, 0.067431228641151142f }, { -0.088885055229687815f, 0.1280389179308779f, 0.18532617511453064f } });
+        validate_matrix({ { 3.24532f, 9.34234f, -42.0012f }, { 8.69382f, 42.4879f, 0.000001f }, { -12.3872f, -0.5000f, -0.22222f } });
+        validate_matrix({ { 1, 0, 0 }, { 0, -1, 0 }, { 0, 0, 1 } }); // reflection
+
+        std::mt19937 gen(1234);
+        std::uniform_real_distribution<float> dist(-10.f, 10.f);
+        for (int i = 0; i < 1000; ++i) validate_matrix({ { dist(gen), dist(gen), dist(gen) }, { dist(gen), dist(gen), dist(gen) }, { dist(gen), dist(gen), dist(gen) } });
+
+        // The batch path must agree with the single-matrix path lane for lane, including the scalar tail
+        const size_t count = 37;
+        Matrix3x3Stream A(count), U, V;
+        Vector3Stream S;
+        for (size_t i = 0; i < count; ++i) A.set(i, { { dist(gen), dist(gen), dist(gen) }, { dist(gen), dist(gen), dist(gen) }, { dist(gen), dist(gen), dist(gen) } });
+        singular_value_decomposition_3x3(A, U, S, V);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const float3x3 P = mul(U.get(i), mul(make_diagonal(S.get(i)), transpose(V.get(i))));
+            for (int c = 0; c < 3; ++c) for (int r = 0; r < 3; ++r) assert(std::abs(P[c][r] - A.get(i)[c][r]) <= 1e-3f);
+        }
+
+        // Polar decomposition, single matrix and batched (float_xN lanes plus the scalar tail)
+        std::vector<float3x3> polarInputs = { Identity3x3, { { 1, 0, 0 }, { 0, -1, 0 }, { 0, 0, 1 } }, make_diagonal({ 2.f, 1e-6f, 0.5f }) };
+        for (int i = 0; i < 200; ++i) polarInputs.push_back({ { dist(gen), dist(gen), dist(gen) }, { dist(gen), dist(gen), dist(gen) }, { dist(gen), dist(gen), dist(gen) } });
+
+        Matrix3x3Stream polarA(polarInputs.size()), R, P;
+        for (size_t i = 0; i < polarInputs.size(); ++i)
+        {
+            float3x3 r, p;
+            polar_decomposition_3x3(polarInputs[i], r, p);
+            validate_polar(polarInputs[i], r, p);
+            polarA.set(i, polarInputs[i]);
+        }
+        polar_decomposition_3x3(polarA, R, P);
+        for (size_t i = 0; i < polarInputs.size(); ++i) validate_polar(polarInputs[i], R.get(i), P.get(i));
+    }
+
+    // Prints the time taken by the general solver, the scalar 3x3 path and the batched SIMD path over `count` random matrices
+    inline void benchmark(const size_t count = 1000000)
+    {
+        std::mt19937 gen(5678);
+        std::uniform_real_distribution<float> dist(-10.f, 10.f);
+        Matrix3x3Stream A(count), U, V;
+        Vector3Stream S;
+        std::vector<float3x3> matrices(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            matrices[i] = { { dist(gen), dist(gen), dist(gen) }, { dist(gen), dist(gen), dist(gen) }, { dist(gen), dist(gen), dist(gen) } };
+            A.set(i, matrices[i]);
+        }
+
+        float checksum = 0;
+        {
+            AVL_SCOPED_TIMER("singular_value_decomposition (general)");
+            std::vector<float> s(3);
+            float3x3 v;
+            for (auto m : matrices) { singular_value_decomposition<float3x3, float>(m, 3, 3, s, v); checksum += s[0]; }
+        }
+        {
+            AVL_SCOPED_TIMER("singular_value_decomposition_3x3 (scalar)");
+            float3x3 u, v;
+            float3 s;
+            for (const auto & m : matrices) { singular_value_decomposition_3x3(m, u, s, v); checksum += s.x; }
+        }
+        {
+            AVL_SCOPED_TIMER("singular_value_decomposition_3x3 (" + std::to_string(simd::lane_traits<simd::float_xN>::width) + "-wide)");
+            singular_value_decomposition_3x3(A, U, S, V);
+            checksum += S.e[0][0];
+        }
+        std::cout << "checksum: " << checksum << std::endl;
+    }
+}
+
+#endif // end svd_3x3_hpp
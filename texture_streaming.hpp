@@ -0,0 +1,538 @@
+// Asynchronous texture streaming. Worker threads read and decode images (precompressed KTX/DDS through gli, anything
+// else through stb_image with mips built on the worker); the GL thread allocates immutable storage and feeds mip
+// levels coarse-to-fine through a ring of persistently mapped pixel unpack buffers guarded by fences, a bounded
+// number of bytes per frame. The coarsest level is written when a texture is allocated, so it is sampleable at once,
+// and GL_TEXTURE_BASE_LEVEL moves down as finer levels arrive. A residency budget caps the total storage: new textures evict the finest
+// levels of the least recently touched ones, and skip their own finest levels when nothing more can be evicted.
+
+#ifndef texture_streaming_hpp
+#define texture_streaming_hpp
+
+#include "gl-api.hpp"
+#include "asset_io.hpp"
+#include "file_io.hpp"
+#include "util.hpp"
+#include "mpmc_blocking_queue.hpp"
+#include "mpsc_queue.hpp"
+#include "third_party/stb/stb_image.h"
+#include "third_party/gli/gli.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+
+using namespace avl;
+
+// CPU side of a streamed texture: the whole mip chain (level 0 first) in the layout it will be uploaded in
+struct StreamedImage
+{
+    std::string name;
+    std::string path;
+    bool flip{ false };
+
+    GLenum internalFormat{ 0 }, format{ 0 }, type{ 0 };
+    bool compressed{ false };
+    uint32_t blockBytes{ 0 };       // compressed: bytes per 4x4 block; otherwise bytes per pixel
+    std::vector<int2> extents;
+    std::vector<std::vector<uint8_t>> levels;
+    std::string error;
+
+    // Bytes in one upload row: a row of pixels, or a row of 4x4 blocks for compressed formats
+    size_t row_bytes(const int level) const
+    {
+        const int w = extents[level].x;
+        return compressed ? size_t((w + 3) / 4) * blockBytes : size_t(w) * blockBytes;
+    }
+
+    int row_count(const int level) const
+    {
+        const int h = extents[level].y;
+        return compressed ? (h + 3) / 4 : h;
+    }
+
+    size_t level_bytes(const int level) const { return row_bytes(level) * row_count(level); }
+};
+
+inline bool is_precompressed_image_path(const std::string & path)
+{
+    std::string ext = path.substr(path.find_last_of('.') + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == "ktx" || ext == "dds" || ext == "kmg";
+}
+
+// Halves an 8-bit-per-channel image with a box filter, clamping at odd edges
+inline std::vector<uint8_t> downsample_image(const std::vector<uint8_t> & src, const int2 srcSize, const int channels, int2 & dstSize)
+{
+    dstSize = int2(std::max(1, srcSize.x / 2), std::max(1, srcSize.y / 2));
+    std::vector<uint8_t> dst(size_t(dstSize.x) * dstSize.y * channels);
+    for (int y = 0; y < dstSize.y; ++y)
+    {
+        const int y0 = std::min(y * 2, srcSize.y - 1), y1 = std::min(y * 2 + 1, srcSize.y - 1);
+        for (int x = 0; x < dstSize.x; ++x)
+        {
+            const int x0 = std::min(x * 2, srcSize.x - 1), x1 = std::min(x * 2 + 1, srcSize.x - 1);
+            for (int c = 0; c < channels; ++c)
+            {
+                const int sum = src[(size_t(y0) * srcSize.x + x0) * channels + c] + src[(size_t(y0) * srcSize.x + x1) * channels + c]
+                    + src[(size_t(y1) * srcSize.x + x0) * channels + c] + src[(size_t(y1) * srcSize.x + x1) * channels + c];
+                dst[(size_t(y) * dstSize.x + x) * channels + c] = uint8_t((sum + 2) / 4);
+            }
+        }
+    }
+    return dst;
+}
+
+// Runs on a worker thread. Failures are reported through `image.error` rather than thrown across threads.
+inline void decode_streamed_image(StreamedImage & image)
+{
+    try
+    {
+        const std::vector<uint8_t> file = read_file_binary(image.path);
+
+        if (is_precompressed_image_path(image.path))
+        {
+            const gli::texture loaded = gli::load(reinterpret_cast<const char *>(file.data()), file.size());
+            if (loaded.empty()) throw std::runtime_error("gli could not load " + image.path);
+            if (loaded.target() != gli::TARGET_2D) throw std::runtime_error("only 2D textures can be streamed: " + image.path);
+            gli::texture2d tex(loaded);
+            if (image.flip) tex = gli::flip(tex);
+
+            gli::gl GL(gli::gl::PROFILE_GL33);
+            const gli::gl::format fmt = GL.translate(tex.format(), tex.swizzles());
+            image.internalFormat = fmt.Internal;
+            image.format = fmt.External;
+            image.type = fmt.Type;
+            image.compressed = gli::is_compressed(tex.format());
+            image.blockBytes = static_cast<uint32_t>(gli::block_size(tex.format()));
+
+            for (size_t level = 0; level < tex.levels(); ++level)
+            {
+                const uint8_t * data = reinterpret_cast<const uint8_t *>(tex[level].data());
+                image.extents.push_back(int2(tex[level].extent().x, tex[level].extent().y));
+                image.levels.emplace_back(data, data + tex[level].size());
+            }
+            return;
+        }
+
+        int width, height, channels;
+        uint8_t * data = stbi_load_from_memory(file.data(), (int)file.size(), &width, &height, &channels, 0);
+        if (!data) throw std::runtime_error("stb_image could not decode " + image.path);
+
+        std::vector<uint8_t> base(data, data + size_t(width) * height * channels);
+        stbi_image_free(data);
+
+        if (image.flip) flip_image_rows(base.data(), width, height, channels);
+
+        static const GLenum internalFormats[] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+        static const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+        if (channels < 1 || channels > 4) throw std::runtime_error("unsupported number of channels");
+        image.internalFormat = internalFormats[channels - 1];
+        image.format = formats[channels - 1];
+        image.type = GL_UNSIGNED_BYTE;
+        image.blockBytes = channels;
+
+        image.extents.push_back(int2(width, height));
+        image.levels.push_back(std::move(base));
+        while (image.extents.back().x > 1 || image.extents.back().y > 1)
+        {
+            int2 next;
+            std::vector<uint8_t> level = downsample_image(image.levels.back(), image.extents.back(), channels, next);
+            image.extents.push_back(next);
+            image.levels.push_back(std::move(level));
+        }
+    }
+    catch (const std::exception & e)
+    {
+        image.error = e.what();
+    }
+}
+
+class TextureStreamer : public Noncopyable
+{
+public:
+
+    // Receives every (re)allocated texture; typically `create_handle_for_asset(name, std::move(texture))`.
+    // The streamer keeps writing into the texture afterwards, so the receiver must keep it alive.
+    typedef std::function<void(const std::string & name, GlTexture2D && texture)> PublishCallback;
+
+    struct Stats
+    {
+        size_t residentBytes{ 0 };
+        size_t budgetBytes{ 0 };
+        size_t pendingDecodes{ 0 };
+        size_t streamingTextures{ 0 };
+        size_t uploadedBytesLastFrame{ 0 };
+        size_t stalledFrames{ 0 };      // frames skipped because the GPU still owned the next ring segment
+        size_t evictedLevels{ 0 };
+    };
+
+private:
+
+    constexpr static const int NUM_SEGMENTS = 3;
+    constexpr static const size_t UPLOAD_ALIGNMENT = 16;
+    constexpr static const int MIN_RESIDENT_EXTENT = 64;    // eviction never drops a texture below this size
+    constexpr static const size_t MIN_SEGMENT_SIZE = size_t(1) << 20; // a segment must hold at least one row of any level
+
+    struct Stream
+    {
+        std::string name;
+        std::unique_ptr<StreamedImage> image;   // released once every level is resident
+        GLuint texture{ 0 };
+        int levelCount{ 0 };
+        int firstLevel{ 0 };        // finest source level with storage (GL level 0)
+        int residentLevel{ 0 };     // finest source level fully uploaded (the coarsest is written on admission)
+        int uploadLevel{ 0 };       // next source level to upload, coarse to fine
+        int uploadRow{ 0 };
+        size_t storageBytes{ 0 };
+        std::vector<size_t> levelBytes;
+        std::vector<int2> extents;
+        GLenum internalFormat{ 0 };
+        uint64_t lastTouched{ 0 };
+
+        bool uploading() const { return image && uploadLevel >= firstLevel; }
+    };
+
+    struct DecodeRequest { std::string name, path; bool flip; };
+
+    PublishCallback publish;
+    size_t budgetBytes;
+    size_t segmentSize;
+
+    GlBuffer ring;
+    uint8_t * mapped{ nullptr };
+    GLsync fences[NUM_SEGMENTS] = {};
+    int segment{ 0 };
+
+    std::unordered_map<std::string, std::unique_ptr<Stream>> streams;
+    uint64_t frame{ 0 };
+    Stats stats;
+
+    std::vector<std::thread> workers;
+    MPMCBlockingQueue<DecodeRequest> requests;
+    MPSCQueue<StreamedImage *> decoded;
+    std::atomic<size_t> pendingDecodes{ 0 };
+
+    void worker_loop()
+    {
+        while (true)
+        {
+            DecodeRequest r;
+            requests.wait_and_consume(r);
+            if (r.name.empty()) return;
+
+            StreamedImage * image = new StreamedImage();
+            image->name = r.name;
+            image->path = r.path;
+            image->flip = r.flip;
+            decode_streamed_image(*image);
+            decoded.produce(image);
+        }
+    }
+
+    static size_t storage_bytes(const std::vector<size_t> & levelBytes, const int firstLevel)
+    {
+        size_t total = 0;
+        for (size_t l = firstLevel; l < levelBytes.size(); ++l) total += levelBytes[l];
+        return total;
+    }
+
+    GlTexture2D allocate(const Stream & s, const int firstLevel) const
+    {
+        GlTexture2D tex;
+        const int2 size = s.extents[firstLevel];
+        const int glLevels = s.levelCount - firstLevel;
+        glTextureStorage2DEXT(tex, GL_TEXTURE_2D, glLevels, s.internalFormat, size.x, size.y);
+        glTextureParameteriEXT(tex, GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteriEXT(tex, GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTextureParameteriEXT(tex, GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTextureParameteriEXT(tex, GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTextureParameteriEXT(tex, GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, glLevels - 1);
+        glTextureParameteriEXT(tex, GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, std::max(0, s.residentLevel - firstLevel));
+        tex.width = static_cast<float>(size.x);
+        tex.height = static_cast<float>(size.y);
+        return tex;
+    }
+
+    // Writes the coarsest level (a few bytes) straight from client memory, so the base level that allocate() set never
+    // points at uninitialised storage while the finer levels wait for the ring
+    void upload_coarsest_level(Stream & s, const GLuint texture, StreamedImage & image)
+    {
+        const int level = s.levelCount - 1;
+        const int2 extent = image.extents[level];
+        const std::vector<uint8_t> & data = image.levels[level];
+
+        GLint previousAlignment;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &previousAlignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (image.compressed)
+        {
+            glCompressedTextureSubImage2DEXT(texture, GL_TEXTURE_2D, level - s.firstLevel, 0, 0, extent.x, extent.y, image.internalFormat, (GLsizei)data.size(), data.data());
+        }
+        else
+        {
+            glTextureSubImage2DEXT(texture, GL_TEXTURE_2D, level - s.firstLevel, 0, 0, extent.x, extent.y, image.format, image.type, data.data());
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, previousAlignment);
+
+        stats.uploadedBytesLastFrame += data.size();
+        std::vector<uint8_t>().swap(image.levels[level]);
+    }
+
+    // Drops the finest levels of a fully streamed texture by copying what stays into smaller storage
+    void trim(Stream & s, const int newFirstLevel)
+    {
+        GlTexture2D tex = allocate(s, newFirstLevel);
+        for (int level = std::max(newFirstLevel, s.residentLevel); level < s.levelCount; ++level)
+        {
+            glCopyImageSubData(s.texture, GL_TEXTURE_2D, level - s.firstLevel, 0, 0, 0,
+                tex, GL_TEXTURE_2D, level - newFirstLevel, 0, 0, 0, s.extents[level].x, s.extents[level].y, 1);
+        }
+
+        stats.evictedLevels += newFirstLevel - s.firstLevel;
+        stats.residentBytes -= s.storageBytes;
+        s.firstLevel = newFirstLevel;
+        s.residentLevel = std::max(s.residentLevel, newFirstLevel);
+        s.storageBytes = storage_bytes(s.levelBytes, newFirstLevel);
+        stats.residentBytes += s.storageBytes;
+        s.texture = tex;
+        publish(s.name, std::move(tex));
+    }
+
+    // Evicts finest levels from least recently touched, fully streamed textures until `bytes` fit in the budget
+    void make_room(const size_t bytes, const Stream * except)
+    {
+        if (stats.residentBytes + bytes <= budgetBytes) return;
+
+        std::vector<Stream *> candidates;
+        for (auto & s : streams)
+        {
+            if (s.second.get() != except && !s.second->uploading()) candidates.push_back(s.second.get());
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Stream * a, const Stream * b) { return a->lastTouched < b->lastTouched; });
+
+        for (Stream * s : candidates)
+        {
+            int newFirst = s->firstLevel;
+            size_t freed = 0;
+            while (newFirst + 1 < s->levelCount && std::min(s->extents[newFirst + 1].x, s->extents[newFirst + 1].y) >= MIN_RESIDENT_EXTENT
+                && stats.residentBytes - freed + bytes > budgetBytes)
+            {
+                freed += s->levelBytes[newFirst++];
+            }
+            if (newFirst != s->firstLevel) trim(*s, newFirst);
+            if (stats.residentBytes + bytes <= budgetBytes) return;
+        }
+    }
+
+    void admit(std::unique_ptr<StreamedImage> image)
+    {
+        std::unique_ptr<Stream> s(new Stream());
+        s->name = image->name;
+        s->levelCount = static_cast<int>(image->levels.size());
+        s->extents = image->extents;
+        s->internalFormat = image->internalFormat;
+        for (int l = 0; l < s->levelCount; ++l) s->levelBytes.push_back(image->level_bytes(l));
+        s->lastTouched = frame;
+
+        // A re-request replaces the previous stream; its texture is released when the receiver drops it
+        auto existing = streams.find(image->name);
+        if (existing != streams.end())
+        {
+            stats.residentBytes -= existing->second->storageBytes;
+            streams.erase(existing);
+        }
+
+        make_room(storage_bytes(s->levelBytes, 0), s.get());
+        while (s->firstLevel + 1 < s->levelCount && stats.residentBytes + storage_bytes(s->levelBytes, s->firstLevel) > budgetBytes) s->firstLevel++;
+
+        s->residentLevel = s->levelCount - 1;
+        s->uploadLevel = s->levelCount - 2;
+        s->uploadRow = 0;
+        s->storageBytes = storage_bytes(s->levelBytes, s->firstLevel);
+        stats.residentBytes += s->storageBytes;
+
+        GlTexture2D tex = allocate(*s, s->firstLevel);
+        tex.set_name(image->path);
+        upload_coarsest_level(*s, tex, *image);
+        s->texture = tex;
+        s->image = std::move(image);
+        publish(s->name, std::move(tex));
+
+        const std::string name = s->name;
+        streams[name] = std::move(s);
+    }
+
+    // Copies as many rows of the stream's next level as fit into the current segment. False when the segment is full.
+    bool upload_some(Stream & s, size_t & offset, const size_t segmentBase)
+    {
+        StreamedImage & image = *s.image;
+        const int level = s.uploadLevel;
+        const size_t rowBytes = image.row_bytes(level);
+        const int rows = image.row_count(level);
+
+        const size_t aligned = (offset + UPLOAD_ALIGNMENT - 1) & ~(UPLOAD_ALIGNMENT - 1);
+        const size_t fit = aligned < segmentSize ? (segmentSize - aligned) / rowBytes : 0;
+        if (fit == 0) return false;
+
+        const int count = static_cast<int>(std::min<size_t>(fit, rows - s.uploadRow));
+        const size_t bytes = rowBytes * count;
+        std::memcpy(mapped + segmentBase + aligned, image.levels[level].data() + rowBytes * s.uploadRow, bytes);
+
+        const int glLevel = level - s.firstLevel;
+        const int2 extent = image.extents[level];
+        const GLvoid * pboOffset = reinterpret_cast<const GLvoid *>(segmentBase + aligned);
+        if (image.compressed)
+        {
+            const int y = s.uploadRow * 4, h = std::min(count * 4, extent.y - y);
+            glCompressedTextureSubImage2DEXT(s.texture, GL_TEXTURE_2D, glLevel, 0, y, extent.x, h, image.internalFormat, (GLsizei)bytes, pboOffset);
+        }
+        else
+        {
+            glTextureSubImage2DEXT(s.texture, GL_TEXTURE_2D, glLevel, 0, s.uploadRow, extent.x, count, image.format, image.type, pboOffset);
+        }
+
+        offset = aligned + bytes;
+        stats.uploadedBytesLastFrame += bytes;
+        s.uploadRow += count;
+
+        if (s.uploadRow == rows)
+        {
+            // The level is complete (in command order), so it can be sampled from the next draw onwards
+            s.residentLevel = level;
+            glTextureParameteriEXT(s.texture, GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, glLevel);
+            s.uploadLevel--;
+            s.uploadRow = 0;
+            std::vector<uint8_t>().swap(image.levels[level]);
+        }
+        return true;
+    }
+
+public:
+
+    TextureStreamer(PublishCallback publish, const size_t budgetBytes = size_t(512) << 20, const size_t uploadBytesPerFrame = size_t(8) << 20, const int numWorkers = 2)
+        : publish(publish), budgetBytes(budgetBytes), segmentSize(std::max(uploadBytesPerFrame, MIN_SEGMENT_SIZE))
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glNamedBufferStorageEXT(ring, segmentSize * NUM_SEGMENTS, nullptr, flags);
+        mapped = static_cast<uint8_t *>(glMapNamedBufferRangeEXT(ring, 0, segmentSize * NUM_SEGMENTS, flags));
+        ring.size = segmentSize * NUM_SEGMENTS;
+        stats.budgetBytes = budgetBytes;
+
+        for (int i = 0; i < std::max(1, numWorkers); ++i) workers.emplace_back(&TextureStreamer::worker_loop, this);
+    }
+
+    ~TextureStreamer()
+    {
+        for (size_t i = 0; i < workers.size(); ++i) requests.produce({ std::string(), std::string(), false });
+        for (auto & w : workers) w.join();
+
+        StreamedImage * image;
+        while (decoded.consume(image)) delete image;
+        for (auto & f : fences) if (f) glDeleteSync(f);
+        glUnmapNamedBufferEXT(ring);
+    }
+
+    // Queues `path` for decoding; the texture is published under `name` once decoded. Safe from any thread.
+    void request(const std::string & name, const std::string & path, const bool flip = false)
+    {
+        pendingDecodes++;
+        requests.produce({ name, path, flip });
+    }
+
+    // Marks a texture as used this frame so the budget evicts it last; call for every streamed texture a frame draws
+    // with (the editor touches the textures of each gathered material). Untouched textures age in admission order.
+    void touch(const std::string & name)
+    {
+        auto it = streams.find(name);
+        if (it != streams.end()) it->second->lastTouched = frame;
+    }
+
+    // Call once per frame on the GL thread: admits decoded images and spends one ring segment on uploads
+    void update()
+    {
+        frame++;
+        stats.uploadedBytesLastFrame = 0;
+
+        StreamedImage * result;
+        while (decoded.consume(result))
+        {
+            pendingDecodes--;
+            std::unique_ptr<StreamedImage> image(result);
+            if (!image->error.empty())
+            {
+                std::cout << "texture streaming failed for " << image->path << ": " << image->error << std::endl;
+                continue;
+            }
+            admit(std::move(image));
+        }
+
+        // Coarse-to-fine across all textures: the smallest pending level anywhere goes first
+        std::vector<Stream *> active;
+        for (auto & s : streams) if (s.second->uploading()) active.push_back(s.second.get());
+        stats.streamingTextures = active.size();
+        if (active.empty()) return;
+
+        if (fences[segment])
+        {
+            if (glClientWaitSync(fences[segment], 0, 0) == GL_TIMEOUT_EXPIRED)
+            {
+                stats.stalledFrames++;
+                return;
+            }
+            glDeleteSync(fences[segment]);
+            fences[segment] = nullptr;
+        }
+
+        std::sort(active.begin(), active.end(), [](const Stream * a, const Stream * b)
+        {
+            return a->levelBytes[a->uploadLevel] < b->levelBytes[b->uploadLevel];
+        });
+
+        GLint previousAlignment;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &previousAlignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring);
+
+        const size_t segmentBase = segment * segmentSize;
+        size_t offset = 0;
+        bool full = false;
+        while (!full && !active.empty())
+        {
+            // Upload one level per texture per round so coarse levels of every texture land before fine ones
+            for (Stream * s : active)
+            {
+                if (!s->uploading()) continue;
+                const int level = s->uploadLevel;
+                while (s->uploading() && s->uploadLevel == level)
+                {
+                    if (!upload_some(*s, offset, segmentBase)) { full = true; break; }
+                }
+                if (full) break;
+            }
+            active.erase(std::remove_if(active.begin(), active.end(), [](const Stream * s) { return !s->uploading(); }), active.end());
+        }
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, previousAlignment);
+
+        // Fully resident textures no longer need their CPU copy
+        for (auto & s : streams) if (s.second->image && !s.second->uploading()) s.second->image.reset();
+
+        fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        segment = (segment + 1) % NUM_SEGMENTS;
+    }
+
+    Stats get_stats() const
+    {
+        Stats s = stats;
+        s.pendingDecodes = pendingDecodes.load();
+        return s;
+    }
+};
+
+#endif // texture_streaming_hpp
@@ -11,6 +11,7 @@
 #include "util.hpp"
 #include "math-core.hpp"
 #include "solvers.hpp"
+#include "simd_lanes.hpp"
 
 using namespace avl;
 
@@ -116,8 +117,8 @@ inline int solve_ballistic_arc(const float3 proj_pos, const float proj_speed, co
 
     // Quartic Coeffecients
     double c0 = L*L;
-    double c1 = 2*Q*L;
-    double c2 = Q*Q + 2*K*L - S*S + P*P + R*R;
+    double c1 = -2*Q*L;
+    double c2 = Q*Q - 2*K*L - S*S + P*P + R*R;
     double c3 = 2*K*Q + 2*H*P + 2*J*R;
     double c4 = K*K + H*H + J*J;
 
@@ -125,8 +126,8 @@ inline int solve_ballistic_arc(const float3 proj_pos, const float proj_speed, co
     std::array<double, 4> times;
     int numTimes = solve_quartic(c0, c1, c2, c3, c4, times[0], times[1], times[2], times[3]);
 
-    // Sort so faster collision is found first
-    std::sort(times.begin(), times.end());
+    // Sort so faster collision is found first; unused entries are NaN and must stay out of the comparison
+    std::sort(times.begin(), times.begin() + numTimes);
 
     // Plug quartic solutions into base equations
     // There should never be more than 2 positive, real roots.
@@ -244,4 +245,492 @@ inline bool solve_ballistic_arc_lateral(const float3 proj_pos, const float later
     return true;
 }
 
+///////////////////////////////////////
+//   Batched (structure of arrays)   //
+///////////////////////////////////////
+
+// The solvers above, run over many turret/target pairs at once, W lanes at a time (see simd_lanes.hpp). Results
+// match the scalar versions, including their degenerate cases:
+//  - invalid input (origin == target, negative speed or gravity) throws before anything is solved
+//  - a target straight above or below the origin gives NaN horizontal components, as normalize() does
+//  - zero gravity has no moving-target solution, since the quartic's leading coefficient vanishes
+// The moving-target quartic is solved in single precision rather than double: it is rescaled so its constant term is
+// one, its four complex roots are found together by Durand-Kerner iteration (until every lane converges, with
+// denormals flushed), and real roots are polished with Newton's method. Near-tangent shots (a double root) may therefore differ in count from the scalar
+// solver, whose own answer there depends on a 1e-9 threshold.
+
+struct BallisticQueryStream
+{
+    std::vector<float> ox, oy, oz;      // projectile origin
+    std::vector<float> tx, ty, tz;      // target position
+    std::vector<float> vx, vy, vz;      // target velocity (moving-target solvers)
+    std::vector<float> speed;           // projectile speed, or lateral speed for the lateral solvers
+    std::vector<float> maxHeight;       // lateral solvers: peak height (fixed target) or offset above the higher end (moving)
+
+    BallisticQueryStream(const size_t count = 0) { resize(count); }
+
+    size_t size() const { return ox.size(); }
+
+    void resize(const size_t count)
+    {
+        for (auto * v : { &ox, &oy, &oz, &tx, &ty, &tz, &vx, &vy, &vz, &speed, &maxHeight }) v->resize(count, 0.f);
+    }
+
+    void set(const size_t i, const float3 & origin, const float3 & target, const float3 & targetVelocity, const float projectileSpeed, const float height = 0.f)
+    {
+        ox[i] = origin.x; oy[i] = origin.y; oz[i] = origin.z;
+        tx[i] = target.x; ty[i] = target.y; tz[i] = target.z;
+        vx[i] = targetVelocity.x; vy[i] = targetVelocity.y; vz[i] = targetVelocity.z;
+        speed[i] = projectileSpeed;
+        maxHeight[i] = height;
+    }
+
+    float3 origin(const size_t i) const { return{ ox[i], oy[i], oz[i] }; }
+    float3 target(const size_t i) const { return{ tx[i], ty[i], tz[i] }; }
+    float3 target_velocity(const size_t i) const { return{ vx[i], vy[i], vz[i] }; }
+};
+
+struct BallisticSolutionStream
+{
+    std::vector<float> x0, y0, z0;      // first firing velocity (low angle, or earliest impact)
+    std::vector<float> x1, y1, z1;      // second firing velocity, meaningful when count > 1
+    std::vector<float> gravity;         // lateral solvers: gravity the arc needs
+    std::vector<float> ix, iy, iz;      // moving lateral solver: impact point
+    std::vector<int> count;             // solutions per row: 0-2, or 0/1 for the lateral solvers
+
+    size_t size() const { return count.size(); }
+
+    void resize(const size_t n)
+    {
+        for (auto * v : { &x0, &y0, &z0, &x1, &y1, &z1, &gravity, &ix, &iy, &iz }) v->resize(n, 0.f);
+        count.resize(n, 0);
+    }
+
+    float3 solution(const size_t i, const int which) const { return which == 0 ? float3(x0[i], y0[i], z0[i]) : float3(x1[i], y1[i], z1[i]); }
+    float3 impact(const size_t i) const { return{ ix[i], iy[i], iz[i] }; }
+};
+
+namespace trajectory_impl
+{
+    template<typename T> struct complex_lanes { T re, im; };
+
+    template<typename T> inline complex_lanes<T> operator + (const complex_lanes<T> & a, const complex_lanes<T> & b) { return{ a.re + b.re, a.im + b.im }; }
+    template<typename T> inline complex_lanes<T> operator - (const complex_lanes<T> & a, const complex_lanes<T> & b) { return{ a.re - b.re, a.im - b.im }; }
+    template<typename T> inline complex_lanes<T> operator * (const complex_lanes<T> & a, const complex_lanes<T> & b) { return{ a.re * b.re - a.im * b.im, a.re * b.im + a.im * b.re }; }
+
+    template<typename T> inline complex_lanes<T> divide(const complex_lanes<T> & a, const complex_lanes<T> & b)
+    {
+        const T inv = T(1.f) / simd::max(b.re * b.re + b.im * b.im, T(1e-30f));
+        return{ (a.re * b.re + a.im * b.im) * inv, (a.im * b.re - a.re * b.im) * inv };
+    }
+
+    // z^4 + a z^3 + b z^2 + c z + e by Horner's rule
+    template<typename T> inline complex_lanes<T> quartic(const complex_lanes<T> & z, const T & a, const T & b, const T & c, const T & e)
+    {
+        complex_lanes<T> p = { z.re + a, z.im };
+        p = p * z; p.re = p.re + b;
+        p = p * z; p.re = p.re + c;
+        p = p * z; p.re = p.re + e;
+        return p;
+    }
+
+    template<typename T> inline void store_counts(int * out, const int bits0, const int bits1)
+    {
+        for (int lane = 0; lane < simd::lane_traits<T>::width; ++lane) out[lane] = ((bits0 >> lane) & 1) + ((bits1 >> lane) & 1);
+    }
+
+    // Runs `kernel` over [begin, end) W lanes at a time and finishes the remainder one row at a time
+    template<typename T, typename Kernel>
+    inline void run(const Kernel & kernel, const size_t begin, const size_t end)
+    {
+        const size_t W = simd::lane_traits<T>::width;
+        size_t i = begin;
+        for (; i + W <= end; i += W) kernel.template solve<T>(i);
+        for (; i < end; ++i) kernel.template solve<float>(i);
+    }
+
+    // Clamps `end` to the stream and sizes `out` to match; a range starting past the end is a caller error
+    inline size_t prepare(const BallisticQueryStream & q, BallisticSolutionStream & out, const size_t begin, size_t end)
+    {
+        end = std::min(end, q.size());
+        if (begin > end) throw std::range_error("query range begins past its end");
+        if (out.size() < q.size()) out.resize(q.size());
+        return end;
+    }
+
+    inline void validate(const BallisticQueryStream & q, const size_t begin, const size_t end, const bool checkHeight)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            const bool invalid = (q.origin(i) == q.target(i)) || q.speed[i] < 0.f || (checkHeight && q.maxHeight[i] < q.oy[i]);
+            if (invalid) throw std::range_error("invalid initial conditions");
+        }
+    }
+
+    struct arc_kernel
+    {
+        const BallisticQueryStream & q;
+        BallisticSolutionStream & out;
+        float gravity;
+
+        template<typename T>
+        void solve(const size_t i) const
+        {
+            using namespace simd;
+            const T dx = load<T>(&q.tx[i]) - load<T>(&q.ox[i]), dy = load<T>(&q.ty[i]) - load<T>(&q.oy[i]), dz = load<T>(&q.tz[i]) - load<T>(&q.oz[i]);
+            const T s = load<T>(&q.speed[i]), g(gravity);
+
+            const T x = simd::sqrt(dx * dx + dz * dz);
+            const T speed2 = s * s, gx = g * x;
+            const T root = speed2 * speed2 - g * (g * x * x + T(2.f) * dy * speed2);
+            const T r = simd::sqrt(simd::max(root, T(0.f)));
+
+            // cos and sin of atan2(y, gx) without the trig; atan2(0, 0) is 0
+            const T lowY = speed2 - r, highY = speed2 + r;
+            const T hl = simd::sqrt(lowY * lowY + gx * gx), hh = simd::sqrt(highY * highY + gx * gx);
+            const T cosLow = select(greater(hl, T(0.f)), gx / hl, T(1.f)), sinLow = select(greater(hl, T(0.f)), lowY / hl, T(0.f));
+            const T cosHigh = select(greater(hh, T(0.f)), gx / hh, T(1.f)), sinHigh = select(greater(hh, T(0.f)), highY / hh, T(0.f));
+
+            const T gdx = dx / x, gdz = dz / x;
+            store(&out.x0[i], gdx * cosLow * s); store(&out.y0[i], sinLow * s); store(&out.z0[i], gdz * cosLow * s);
+            store(&out.x1[i], gdx * cosHigh * s); store(&out.y1[i], sinHigh * s); store(&out.z1[i], gdz * cosHigh * s);
+
+            // One solution when both angles coincide: no discriminant, or straight up with both arcs climbing
+            const int any = movemask(greater_equal(root, T(0.f)));
+            const int coincide = movemask(less_equal(r, T(0.f)) | (less_equal(gx, T(0.f)) & greater(lowY, T(0.f))));
+            store_counts<T>(&out.count[i], any, any & ~coincide);
+        }
+    };
+
+    struct arc_moving_kernel
+    {
+        constexpr static const int ITERATIONS = 24;
+
+        const BallisticQueryStream & q;
+        BallisticSolutionStream & out;
+        float gravity;
+
+        template<typename T>
+        void solve(const size_t i) const
+        {
+            using namespace simd;
+            const T H = load<T>(&q.tx[i]) - load<T>(&q.ox[i]), K = load<T>(&q.ty[i]) - load<T>(&q.oy[i]), J = load<T>(&q.tz[i]) - load<T>(&q.oz[i]);
+            const T P = load<T>(&q.vx[i]), Q = load<T>(&q.vy[i]), R = load<T>(&q.vz[i]);
+            const T S = load<T>(&q.speed[i]);
+            const T L(-0.5f * gravity);
+
+            const T c0 = L * L, c1 = T(-2.f) * Q * L, c2 = Q * Q - T(2.f) * K * L - S * S + P * P + R * R;
+            const T c3 = T(2.f) * (K * Q + H * P + J * R), c4 = K * K + H * H + J * J;
+
+            // Substitute t = scale * z so the monic quartic has constant term 1 and roots of order one
+            const T lead = simd::max(c0, T(1e-30f));
+            const T scale = select(greater(c4, T(0.f)), simd::sqrt(simd::sqrt(c4 / lead)), T(1.f));
+            const T s2 = scale * scale;
+            const T a = c1 / (lead * scale), b = c2 / (lead * s2), c = c3 / (lead * s2 * scale), e = c4 / (lead * s2 * s2);
+
+            complex_lanes<T> z[4] = { { T(1.f), T(0.f) }, { T(0.4f), T(0.9f) }, { T(-0.65f), T(0.72f) }, { T(-0.908f), T(-0.297f) } };
+            // Stop once every lane has converged
+            for (int it = 0; it < ITERATIONS; ++it)
+            {
+                T change(0.f);
+                for (int k = 0; k < 4; ++k)
+                {
+                    complex_lanes<T> den = { T(1.f), T(0.f) };
+                    for (int j = 0; j < 4; ++j) if (j != k) den = den * (z[k] - z[j]);
+                    const complex_lanes<T> step = divide(quartic(z[k], a, b, c, e), den);
+                    z[k] = z[k] - step;
+                    change = simd::max(change, step.re * step.re + step.im * step.im);
+                }
+                if (!any(greater(change, T(1e-12f)))) break;
+            }
+
+            // Real roots, polished on the real polynomial; anything else sorts to infinity
+            const T inf(std::numeric_limits<float>::infinity());
+            T t[4];
+            for (int k = 0; k < 4; ++k)
+            {
+                T x = z[k].re;
+                const auto real = less_equal(simd::abs(z[k].im), T(1e-3f) * simd::max(T(1.f), simd::abs(x)));
+                for (int n = 0; n < 2; ++n)
+                {
+                    const T f = (((x + a) * x + b) * x + c) * x + e;
+                    const T d = ((T(4.f) * x + T(3.f) * a) * x + T(2.f) * b) * x + c;
+                    x = select(greater(simd::abs(d), T(1e-12f)), x - f / d, x);
+                }
+                const T time = x * scale;
+                t[k] = select(real & greater(time, T(0.f)), time, inf);
+            }
+
+            // Sorting network; only the two earliest impacts are kept
+            auto order = [](T & lo, T & hi) { const T m = simd::min(lo, hi); hi = simd::max(lo, hi); lo = m; };
+            order(t[0], t[1]); order(t[2], t[3]); order(t[0], t[2]); order(t[1], t[3]); order(t[1], t[2]);
+
+            const auto solvable = greater(c0, T(0.f));
+            const int first = movemask(solvable & less(t[0], inf)), second = movemask(solvable & less(t[1], inf));
+            store_counts<T>(&out.count[i], first, second);
+
+            T * times[2] = { &t[0], &t[1] };
+            float * xs[2] = { &out.x0[i], &out.x1[i] }, * ys[2] = { &out.y0[i], &out.y1[i] }, * zs[2] = { &out.z0[i], &out.z1[i] };
+            for (int k = 0; k < 2; ++k)
+            {
+                const T & time = *times[k];
+                const T inv = T(1.f) / time;
+                store(xs[k], H * inv + P);
+                store(ys[k], K * inv + Q - L * time);
+                store(zs[k], J * inv + R);
+            }
+        }
+    };
+
+    struct lateral_kernel
+    {
+        const BallisticQueryStream & q;
+        BallisticSolutionStream & out;
+
+        template<typename T>
+        void solve(const size_t i) const
+        {
+            using namespace simd;
+            const T oy = load<T>(&q.oy[i]), ty = load<T>(&q.ty[i]);
+            const T dx = load<T>(&q.tx[i]) - load<T>(&q.ox[i]), dz = load<T>(&q.tz[i]) - load<T>(&q.oz[i]);
+            const T s = load<T>(&q.speed[i]), peak = load<T>(&q.maxHeight[i]);
+
+            const T dist = simd::sqrt(dx * dx + dz * dz);
+            const T time = dist / s;
+
+            // Hit the peak at half the flight time and the target at the end
+            const T a = oy, b = peak, c = ty;
+            store(&out.x0[i], dx / dist * s);
+            store(&out.y0[i], -(T(3.f) * a - T(4.f) * b + c) / time);
+            store(&out.z0[i], dz / dist * s);
+            store(&out.gravity[i], T(-4.f) * (a - T(2.f) * b + c) / (time * time));
+            store(&out.ix[i], load<T>(&q.tx[i])); store(&out.iy[i], ty); store(&out.iz[i], load<T>(&q.tz[i]));
+            store_counts<T>(&out.count[i], movemask(greater(dist, T(0.f))), 0);
+        }
+    };
+
+    struct lateral_moving_kernel
+    {
+        const BallisticQueryStream & q;
+        BallisticSolutionStream & out;
+
+        template<typename T>
+        void solve(const size_t i) const
+        {
+            using namespace simd;
+            const T ox = load<T>(&q.ox[i]), oy = load<T>(&q.oy[i]), oz = load<T>(&q.oz[i]);
+            const T tx = load<T>(&q.tx[i]), ty = load<T>(&q.ty[i]), tz = load<T>(&q.tz[i]);
+            const T vx = load<T>(&q.vx[i]), vy = load<T>(&q.vy[i]), vz = load<T>(&q.vz[i]);
+            const T s = load<T>(&q.speed[i]), offset = load<T>(&q.maxHeight[i]);
+            const T dx = tx - ox, dz = tz - oz;
+
+            // Ground plane quadratic, in the same normal form as solve_quadratic
+            const T c0 = vx * vx + vz * vz - s * s, c1 = T(2.f) * (dx * vx + dz * vz), c2 = dx * dx + dz * dz;
+            const T p = c1 / (T(2.f) * c0), qq = c2 / c0;
+            const T D = p * p - qq;
+            const T sqrtD = simd::sqrt(simd::max(D, T(0.f)));
+
+            const auto single = less(simd::abs(D), T(1e-9f));
+            const auto two = greater_equal(D, T(1e-9f));
+            const T t0 = select(single, -p, sqrtD - p), t1 = -sqrtD - p;
+            const auto valid0 = (single | two) & greater(t0, T(0.f));
+            const auto valid1 = two & greater(t1, T(0.f));
+
+            // Smallest positive time
+            const T t = select(valid0, select(valid1, simd::min(t0, t1), t0), t1);
+
+            const T ix = tx + vx * t, iy = ty + vy * t, iz = tz + vz * t;
+            const T fx = ix - ox, fz = iz - oz;
+            const T invLen = T(1.f) / simd::sqrt(fx * fx + fz * fz);
+
+            const T a = oy, b = simd::max(oy, iy) + offset, c = iy;
+            store(&out.x0[i], fx * invLen * s);
+            store(&out.y0[i], -(T(3.f) * a - T(4.f) * b + c) / t);
+            store(&out.z0[i], fz * invLen * s);
+            store(&out.gravity[i], T(-4.f) * (a - T(2.f) * b + c) / (t * t));
+            store(&out.ix[i], ix); store(&out.iy[i], iy); store(&out.iz[i], iz);
+            store_counts<T>(&out.count[i], movemask(valid0 | valid1), 0);
+        }
+    };
+}
+
+// Batched solve_ballistic_arc for fixed targets; `count` is 0, 1 or 2
+template<typename T = simd::float_xN>
+inline void solve_ballistic_arcs(const BallisticQueryStream & queries, const float gravity, BallisticSolutionStream & out, const size_t begin = 0, size_t end = SIZE_MAX)
+{
+    end = trajectory_impl::prepare(queries, out, begin, end);
+    if (gravity < 0) throw std::range_error("invalid initial conditions");
+    trajectory_impl::validate(queries, begin, end, false);
+    trajectory_impl::run<T>(trajectory_impl::arc_kernel{ queries, out, gravity }, begin, end);
+}
+
+// Batched solve_ballistic_arc for targets moving with constant velocity; earliest impact first
+template<typename T = simd::float_xN>
+inline void solve_ballistic_arcs_moving(const BallisticQueryStream & queries, const float gravity, BallisticSolutionStream & out, const size_t begin = 0, size_t end = SIZE_MAX)
+{
+    end = trajectory_impl::prepare(queries, out, begin, end);
+    simd::scoped_flush_denormals ftz;
+    trajectory_impl::run<T>(trajectory_impl::arc_moving_kernel{ queries, out, gravity }, begin, end);
+}
+
+// Batched solve_ballistic_arc_lateral for fixed targets; maxHeight is the peak height
+template<typename T = simd::float_xN>
+inline void solve_ballistic_arcs_lateral(const BallisticQueryStream & queries, BallisticSolutionStream & out, const size_t begin = 0, size_t end = SIZE_MAX)
+{
+    end = trajectory_impl::prepare(queries, out, begin, end);
+    trajectory_impl::validate(queries, begin, end, true);
+    trajectory_impl::run<T>(trajectory_impl::lateral_kernel{ queries, out }, begin, end);
+}
+
+// Batched solve_ballistic_arc_lateral for moving targets; maxHeight is the offset above the higher end
+template<typename T = simd::float_xN>
+inline void solve_ballistic_arcs_lateral_moving(const BallisticQueryStream & queries, BallisticSolutionStream & out, const size_t begin = 0, size_t end = SIZE_MAX)
+{
+    end = trajectory_impl::prepare(queries, out, begin, end);
+    trajectory_impl::validate(queries, begin, end, false);
+    trajectory_impl::run<T>(trajectory_impl::lateral_moving_kernel{ queries, out }, begin, end);
+}
+
+namespace trajectory_tests
+{
+    inline BallisticQueryStream make_queries(const size_t count, const bool lateral, std::mt19937 & gen)
+    {
+        std::uniform_real_distribution<float> unit(-1.f, 1.f), range(10.f, 120.f), speed(15.f, 45.f);
+        BallisticQueryStream q(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const float3 origin(unit(gen) * 50.f, unit(gen) * 5.f, unit(gen) * 50.f);
+            const float angle = unit(gen) * float(ANVIL_PI);
+            const float3 target = origin + float3(std::cos(angle) * range(gen), unit(gen) * 10.f, std::sin(angle) * range(gen));
+            const float3 velocity(unit(gen) * 8.f, unit(gen) * 2.f, unit(gen) * 8.f);
+            q.set(i, origin, target, velocity, lateral ? speed(gen) * 0.5f : speed(gen), lateral ? std::max(origin.y, target.y) + 5.f + (unit(gen) + 1.f) * 5.f : 0.f);
+        }
+        return q;
+    }
+
+    inline bool close(const float3 & a, const float3 & b, const float tolerance)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            if (std::isnan(a[k]) != std::isnan(b[k])) return false;
+            if (!std::isnan(a[k]) && std::abs(a[k] - b[k]) > tolerance) return false;
+        }
+        return true;
+    }
+
+    // Compares every batched solver against its scalar version at the given lane width; returns the number of
+    // moving-target rows whose solution count differs (near-tangent shots, see above)
+    template<typename T>
+    inline size_t compare_with_scalar(const size_t count, const float gravity = 9.8f)
+    {
+        std::mt19937 gen(31337);
+        BallisticSolutionStream out;
+        size_t countMismatches = 0;
+
+        const BallisticQueryStream q = make_queries(count, false, gen);
+        solve_ballistic_arcs<T>(q, gravity, out);
+        for (size_t i = 0; i < count; ++i)
+        {
+            float3 s0, s1;
+            const int n = solve_ballistic_arc(q.origin(i), q.speed[i], q.target(i), gravity, s0, s1);
+            assert(n == out.count[i]);
+            if (n > 0) assert(close(s0, out.solution(i, 0), 1e-3f * q.speed[i]));
+            if (n > 1) assert(close(s1, out.solution(i, 1), 1e-3f * q.speed[i]));
+        }
+
+        solve_ballistic_arcs_moving<T>(q, gravity, out);
+        for (size_t i = 0; i < count; ++i)
+        {
+            float3 s0, s1;
+            const int n = solve_ballistic_arc(q.origin(i), q.speed[i], q.target(i), q.target_velocity(i), gravity, s0, s1);
+            if (n != out.count[i])
+            {
+                countMismatches++;
+                continue;
+            }
+            if (n > 0) assert(close(s0, out.solution(i, 0), 1e-2f * q.speed[i]));
+            if (n > 1) assert(close(s1, out.solution(i, 1), 1e-2f * q.speed[i]));
+        }
+
+        // Every batched moving-target solution flies at the requested speed
+        for (size_t i = 0; i < count; ++i)
+        {
+            for (int k = 0; k < out.count[i]; ++k) assert(std::abs(length(out.solution(i, k)) - q.speed[i]) < 1e-2f * q.speed[i]);
+        }
+
+        const BallisticQueryStream lq = make_queries(count, true, gen);
+        solve_ballistic_arcs_lateral<T>(lq, out);
+        for (size_t i = 0; i < count; ++i)
+        {
+            float3 v; float g;
+            const bool ok = solve_ballistic_arc_lateral(lq.origin(i), lq.speed[i], lq.target(i), lq.maxHeight[i], v, g);
+            assert(int(ok) == out.count[i]);
+            if (ok) assert(close(v, out.solution(i, 0), 1e-3f * length(v)) && std::abs(g - out.gravity[i]) < 1e-3f * std::abs(g));
+        }
+
+        solve_ballistic_arcs_lateral_moving<T>(lq, out);
+        for (size_t i = 0; i < count; ++i)
+        {
+            float3 v, impact; float g;
+            const bool ok = solve_ballistic_arc_lateral(lq.origin(i), lq.speed[i], lq.target(i), lq.target_velocity(i), lq.maxHeight[i], v, g, impact);
+            assert(int(ok) == out.count[i]);
+            if (ok) assert(close(v, out.solution(i, 0), 1e-3f * length(v)) && close(impact, out.impact(i), 1e-3f * length(impact) + 1e-3f));
+        }
+
+        return countMismatches;
+    }
+
+    inline void execute(const size_t count = 100000)
+    {
+        assert(compare_with_scalar<float>(count) < count / 1000);
+        assert(compare_with_scalar<simd::float_xN>(count) < count / 1000);
+
+        // Degenerate cases behave like the scalar solvers
+        BallisticQueryStream q(3);
+        BallisticSolutionStream out;
+        q.set(0, { 0, 0, 0 }, { 0, 10, 0 }, { 0, 0, 0 }, 20.f);      // straight up: one solution, NaN horizontal
+        q.set(1, { 0, 0, 0 }, { 500, 0, 0 }, { 0, 0, 0 }, 20.f);     // out of range
+        q.set(2, { 0, 0, 0 }, { 0, -10, 0 }, { 0, 0, 0 }, 20.f);     // straight down: two
+        solve_ballistic_arcs(q, 9.8f, out);
+        assert(out.count[0] == 1 && std::isnan(out.x0[0]) && out.count[1] == 0 && out.count[2] == 2);
+
+        solve_ballistic_arcs_moving(q, 0.f, out);
+        assert(out.count[0] == 0 && out.count[1] == 0 && out.count[2] == 0);
+
+        bool threw = false;
+        q.set(1, { 1, 2, 3 }, { 1, 2, 3 }, { 0, 0, 0 }, 20.f);
+        try { solve_ballistic_arcs(q, 9.8f, out); }
+        catch (const std::range_error &) { threw = true; }
+        assert(threw);
+
+        // An empty range at the end is fine, one starting past it is not
+        solve_ballistic_arcs_lateral(q, out, q.size(), q.size());
+        threw = false;
+        try { solve_ballistic_arcs_lateral(q, out, q.size() + 1); }
+        catch (const std::range_error &) { threw = true; }
+        assert(threw);
+    }
+
+    inline void benchmark(const size_t count = 1 << 16)
+    {
+        std::mt19937 gen(7);
+        const BallisticQueryStream q = make_queries(count, false, gen);
+        BallisticSolutionStream out;
+        out.resize(count);
+        float3 s0, s1;
+        size_t checksum = 0;
+        const std::string wide = std::to_string(simd::lane_traits<simd::float_xN>::width) + "-wide";
+
+        { AVL_SCOPED_TIMER("solve_ballistic_arc (per pair)"); for (size_t i = 0; i < count; ++i) checksum += solve_ballistic_arc(q.origin(i), q.speed[i], q.target(i), 9.8f, s0, s1); }
+        { AVL_SCOPED_TIMER("solve_ballistic_arcs (scalar)"); solve_ballistic_arcs<float>(q, 9.8f, out); checksum += out.count.back(); }
+        { AVL_SCOPED_TIMER("solve_ballistic_arcs (" + wide + ")"); solve_ballistic_arcs(q, 9.8f, out); checksum += out.count.back(); }
+
+        { AVL_SCOPED_TIMER("solve_ballistic_arc moving (per pair)"); for (size_t i = 0; i < count; ++i) checksum += solve_ballistic_arc(q.origin(i), q.speed[i], q.target(i), q.target_velocity(i), 9.8f, s0, s1); }
+        { AVL_SCOPED_TIMER("solve_ballistic_arcs_moving (scalar)"); solve_ballistic_arcs_moving<float>(q, 9.8f, out); checksum += out.count.back(); }
+        { AVL_SCOPED_TIMER("solve_ballistic_arcs_moving (" + wide + ")"); solve_ballistic_arcs_moving(q, 9.8f, out); checksum += out.count.back(); }
+
+        std::cout << "checksum: " << checksum << std::endl;
+    }
+}
+
 #endif // end trajectory_hpp
@@ -8,6 +8,10 @@
 #include <memory>
 #include <chrono>
 #include <mutex>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
 
 #if (defined(__linux) || defined(__unix) || defined(__posix) || defined(__LINUX__) || defined(__linux__))
     #define ANVIL_PLATFORM_LINUX 1
@@ -41,12 +45,63 @@
 
 #if defined(ANVIL_PLATFORM_WINDOWS)
     #define ALIGNED(n) __declspec(align(n))
+    #include <malloc.h>
 #else
     #define ALIGNED(n) alignas(n)
 #endif
 
 namespace avl
 {
+    // Before C++17, operator new and std::allocator only guarantee alignof(std::max_align_t). Heap instances of
+    // cache-line aligned types (alignas(64)) go through these instead.
+    inline void * aligned_malloc(size_t size, size_t alignment)
+    {
+    #if defined(ANVIL_PLATFORM_WINDOWS)
+        void * ptr = _aligned_malloc(size, alignment);
+    #else
+        void * ptr = nullptr;
+        if (posix_memalign(&ptr, std::max(alignment, sizeof(void *)), size) != 0) ptr = nullptr;
+    #endif
+        if (!ptr) throw std::bad_alloc();
+        return ptr;
+    }
+
+    inline void aligned_free(void * ptr)
+    {
+    #if defined(ANVIL_PLATFORM_WINDOWS)
+        _aligned_free(ptr);
+    #else
+        std::free(ptr);
+    #endif
+    }
+
+    template<typename T>
+    struct aligned_allocator
+    {
+        typedef T value_type;
+        aligned_allocator() = default;
+        template<typename U> aligned_allocator(const aligned_allocator<U> &) {}
+        T * allocate(size_t n) { return static_cast<T *>(aligned_malloc(n * sizeof(T), alignof(T))); }
+        void deallocate(T * ptr, size_t) { aligned_free(ptr); }
+        template<typename U> bool operator == (const aligned_allocator<U> &) const { return true; }
+        template<typename U> bool operator != (const aligned_allocator<U> &) const { return false; }
+    };
+
+    struct aligned_deleter
+    {
+        template<typename T> void operator()(T * ptr) const { ptr->~T(); aligned_free(ptr); }
+    };
+
+    template<typename T> using aligned_unique_ptr = std::unique_ptr<T, aligned_deleter>;
+
+    template<typename T, typename... Args>
+    inline aligned_unique_ptr<T> make_aligned_unique(Args &&... args)
+    {
+        void * ptr = aligned_malloc(sizeof(T), alignof(T));
+        try { return aligned_unique_ptr<T>(new (ptr) T(std::forward<Args>(args)...)); }
+        catch (...) { aligned_free(ptr); throw; }
+    }
+
     class try_locker
     {
         std::mutex & mutex;
@@ -79,6 +134,33 @@ namespace avl
         const double & get() { return timestamp; }
     };
 
+    // Invokes fn(begin, end) over contiguous ranges of [0, count) on up to hardware_concurrency threads.
+    // The calling thread processes the first range. Ranges are never smaller than minGrain.
+    template<typename F>
+    inline void parallel_ranges(size_t count, size_t minGrain, F && fn)
+    {
+        const size_t hardwareThreads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        const size_t numRanges = std::min(hardwareThreads, (count + minGrain - 1) / std::max<size_t>(1, minGrain));
+
+        if (numRanges <= 1)
+        {
+            if (count) fn(size_t(0), count);
+            return;
+        }
+
+        const size_t rangeSize = (count + numRanges - 1) / numRanges;
+        std::vector<std::thread> workers;
+        workers.reserve(numRanges - 1);
+        for (size_t r = 1; r < numRanges; ++r)
+        {
+            const size_t begin = std::min(count, r * rangeSize);
+            const size_t end = std::min(count, begin + rangeSize);
+            if (begin < end) workers.emplace_back([&fn, begin, end]() { fn(begin, end); });
+        }
+        fn(size_t(0), std::min(count, rangeSize));
+        for (auto & w : workers) w.join();
+    }
+
     #define AVL_SCOPED_TIMER(MESSAGE) scoped_timer scoped_timer ## __LINE__(MESSAGE)
 
     class UniformRandomGenerator
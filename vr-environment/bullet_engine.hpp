@@ -80,6 +80,12 @@ public:
         const int result = dynamicsWorld->stepSimulation(dt);
     }
 
+    // Advances exactly `dt` with no internal substepping, for callers that already run at a fixed rate
+    void step(const float dt)
+    {
+        dynamicsWorld->stepSimulation(dt, 0);
+    }
+
 };
 
 #endif // end bullet_engine_vr_hpp
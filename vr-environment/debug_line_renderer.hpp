@@ -5,108 +5,71 @@
 
 #include "math-core.hpp"
 #include "gl-api.hpp"
+#include "gl-polyline-batch.hpp"
 #include "procedural_mesh.hpp"
 
 using namespace avl;
 
 class DebugLineRenderer
 {
-    struct Vertex { float3 position; float3 color; };
-    std::vector<Vertex> vertices;
-    GlMesh debugMesh;
-    GlShader debugShader;
+    GlPolylineBatch lines;
 
     Geometry axis = make_axis();
     Geometry box = make_cube();
     Geometry sphere = make_sphere(0.1f);
 
-    constexpr static const char debugVertexShader[] = R"(#version 330 
-        layout(location = 0) in vec3 v; 
-        layout(location = 1) in vec3 c; 
-        uniform mat4 u_mvp; 
-        out vec3 oc; 
-        void main() { gl_Position = u_mvp * vec4(v.xyz, 1); oc = c; }
-    )";
-
-    constexpr static const char debugFragmentShader[] = R"(#version 330 
-        in vec3 oc; 
-        out vec4 f_color; 
-        void main() { f_color = vec4(oc.rgb, 1); }
-    )";
+    // The shapes below are drawn as independent segments between consecutive pairs of vertices
+    void add_segments(const std::vector<float3> & vertices, const Pose & pose, const float3 & scale, const float3 & color)
+    {
+        for (size_t i = 0; i + 1 < vertices.size(); i += 2)
+        {
+            lines.add_line(pose.transform_coord(vertices[i] * scale), pose.transform_coord(vertices[i + 1] * scale), lineWidth, float4(color, 1));
+        }
+    }
 
 public:
 
-    DebugLineRenderer()
-    {
-        debugShader = GlShader(debugVertexShader, debugFragmentShader);
-    }
+    float lineWidth = 2.f;      // in pixels
 
-    void draw(const float4x4 & viewProj)
+    // May be called once per eye; the lines are expanded on the GPU from points streamed on every call
+    void draw(const float4x4 & viewProj, const float2 & resolution)
     {
-        debugMesh.set_vertices(vertices.size(), vertices.data(), GL_DYNAMIC_DRAW);
-        debugMesh.set_attribute(0, &Vertex::position);
-        debugMesh.set_attribute(1, &Vertex::color);
-        debugMesh.set_non_indexed(GL_LINES);
-
-        auto model = Identity4x4;
-        auto modelViewProjectionMatrix = mul(viewProj, model);
-
-        debugShader.bind();
-        debugShader.uniform("u_mvp", modelViewProjectionMatrix);
-        debugMesh.draw_elements();
-        debugShader.unbind();
+        lines.draw(viewProj, resolution);
     }
 
     void clear()
     {
-        vertices.clear();
+        lines.clear();
     }
 
     // Coordinates should be provided pre-transformed to world-space
     void draw_line(const float3 & from, const float3 & to, const float3 color = float3(1, 1, 1))
     {
-        vertices.push_back({ from, color });
-        vertices.push_back({ to, color });
+        lines.add_line(from, to, lineWidth, float4(color, 1));
     }
 
     void draw_box(const Pose & pose, const float & half, const float3 color = float3(1, 1, 1))
     {
         // todo - apply exents
-        for (const auto v : box.vertices)
-        {
-            auto tV = pose.transform_coord(v);
-            vertices.push_back({ tV, color });
-        }
+        add_segments(box.vertices, pose, float3(1, 1, 1), color);
     }
 
     void draw_box(const Bounds3D & bounds, const float3 color = float3(1, 1, 1))
     {
-        Pose p = Pose(float4(0, 0, 0, 1), bounds.center());
-        for (auto v : box.vertices)
-        {
-            v *= bounds.size() / 2.f; // scale
-            auto tV = p.transform_coord(v); // translate
-            vertices.push_back({ tV, color });
-        }
+        add_segments(box.vertices, Pose(float4(0, 0, 0, 1), bounds.center()), bounds.size() / 2.f, color);
     }
 
     void draw_sphere(const Pose & pose, const float & radius, const float3 color = float3(1, 1, 1))
     {
         // todo - apply radius
-        for (const auto v : sphere.vertices)
-        {
-            auto tV = pose.transform_coord(v);
-            vertices.push_back({ tV, color });
-        }
+        add_segments(sphere.vertices, pose, float3(1, 1, 1), color);
     }
 
     void draw_axis(const Pose & pose, const float3 color = float3(1, 1, 1))
     {
-        for (int i = 0; i < axis.vertices.size(); ++i)
+        for (size_t i = 0; i + 1 < axis.vertices.size(); i += 2)
         {
-            auto v = axis.vertices[i];
-            v = pose.transform_coord(v);
-            vertices.push_back({ v, axis.colors[i].xyz() });
+            lines.add_line(pose.transform_coord(axis.vertices[i]), pose.transform_coord(axis.vertices[i + 1]), lineWidth, axis.colors[i]);
         }
     }
 
@@ -17,6 +17,10 @@ VirtualRealityApp::VirtualRealityApp() : GLFWApp(1280, 800, "VR Sandbox")
     // Initialize Bullet physics
     setup_physics();
 
+    FixedStepSettings fixedStepSettings;
+    fixedStepSettings.stepsPerSecond = 90.0;
+    enable_fixed_step(fixedStepSettings);
+
     try
     {
         hmd.reset(new OpenVR_HMD());
@@ -74,39 +78,21 @@ void VirtualRealityApp::on_input(const InputEvent & event)
 
 void VirtualRealityApp::on_update(const UpdateEvent & e) 
 {
+    lastUpdate = e;
     cameraController.update(e.timestep_ms);
 
     shaderMonitor.handle_recompile();
 
     if (hmd)
     {
-        scene.leftController->update(hmd->get_controller(vr::TrackedControllerRole_LeftHand)->get_pose(hmd->get_world_pose()));
-        scene.rightController->update(hmd->get_controller(vr::TrackedControllerRole_RightHand)->get_pose(hmd->get_world_pose()));
-
-        physicsEngine->update(e.timestep_ms);
-
-        btTransform leftTranslation;
-        scene.leftController->physicsObject->body->getMotionState()->getWorldTransform(leftTranslation);
-
-        btTransform rightTranslation;
-        scene.rightController->physicsObject->body->getMotionState()->getWorldTransform(rightTranslation);
-
-        // Workaround until a nicer system is in place
-        for (auto & obj : scene.physicsObjects)
-        {
-            /*
-            for (auto & model : scene.models)
-            {
-                if (model.get_physics_component() == obj.get())
-                {
-                    btTransform trans;
-                    obj->body->getMotionState()->getWorldTransform(trans);
-                    model.set_pose(make_pose(trans));
-                }
-            }
-            */
-        }
+        std::lock_guard<std::mutex> lock(physicsInputMutex);
+        physicsInput.hasControllers = true;
+        physicsInput.leftController = hmd->get_controller(vr::TrackedControllerRole_LeftHand)->get_pose(hmd->get_world_pose());
+        physicsInput.rightController = hmd->get_controller(vr::TrackedControllerRole_RightHand)->get_pose(hmd->get_world_pose());
+    }
 
+    if (hmd)
+    {
         // Update the the pose of the controller mesh we render
         // scene.controllers[0].set_pose(hmd->get_controller(vr::TrackedControllerRole_LeftHand).get_pose(hmd->get_world_pose()));
         // scene.controllers[1].set_pose(hmd->get_controller(vr::TrackedControllerRole_RightHand).get_pose(hmd->get_world_pose()));
@@ -166,6 +152,30 @@ void VirtualRealityApp::on_update(const UpdateEvent & e)
 
 }
 
+// Simulation thread. Bullet is only touched here, debug drawing included. Nothing in the scene renders a simulated
+// body yet; once something does, publish its poses through a SnapshotBuffer and interpolate them at e.renderTime_s.
+void VirtualRealityApp::on_fixed_update(const UpdateEvent & e)
+{
+    if (!hmd) return;
+
+    PhysicsInput input;
+    {
+        std::lock_guard<std::mutex> lock(physicsInputMutex);
+        input = physicsInput;
+    }
+
+    if (input.hasControllers)
+    {
+        scene.leftController->update(input.leftController);
+        scene.rightController->update(input.rightController);
+    }
+
+    physicsEngine->step(e.fixedTimestep_s);
+
+    physicsDebugRenderer->clear();
+    physicsEngine->get_world()->debugDrawWorld();
+}
+
 void VirtualRealityApp::on_draw()
 {
     glfwMakeContextCurrent(window);
@@ -176,8 +186,6 @@ void VirtualRealityApp::on_draw()
     glfwGetWindowSize(window, &width, &height);
     glViewport(0, 0, width, height);
 
-    physicsEngine->get_world()->debugDrawWorld();
-
     /*
     Bounds2D rect{ { 0.f, 0.f },{ (float)width,(float)height } };
     const float mid = (rect.min().x + rect.max().x) / 2.f;
@@ -210,9 +218,9 @@ void VirtualRealityApp::on_draw()
         glDisable(GL_TEXTURE_2D);
     }
 
-    physicsDebugRenderer->clear();
-
     ImGui::Text("Render Frame: %f", gpuTimer.elapsed_ms());
+    ImGui::Text("Update / Draw: %.2f / %.2f ms", lastUpdate.update_ms, lastUpdate.draw_ms);
+    ImGui::Text("Physics Step: %.2f ms (%llu steps, %llu dropped)", lastUpdate.simulation_ms, (unsigned long long)lastUpdate.simulationSteps, (unsigned long long)lastUpdate.droppedSteps);
 
     if (hmd)
     {
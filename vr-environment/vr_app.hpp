@@ -98,6 +98,13 @@ struct Scene
 
 };
 
+// Written by the render loop, read by the simulation thread before each step
+struct PhysicsInput
+{
+    bool hasControllers{ false };
+    Pose leftController, rightController;
+};
+
 struct VirtualRealityApp : public GLFWApp
 {
     uint64_t frameCount = 0;
@@ -120,6 +127,11 @@ struct VirtualRealityApp : public GLFWApp
 
     std::unique_ptr<gui::imgui_wrapper> igm;
 
+    // Physics runs on the fixed-step simulation thread and owns the Bullet world
+    std::mutex physicsInputMutex;
+    PhysicsInput physicsInput;
+    UpdateEvent lastUpdate;
+
     VirtualRealityApp();
     ~VirtualRealityApp();
 
@@ -128,5 +140,6 @@ struct VirtualRealityApp : public GLFWApp
     void on_window_resize(int2 size) override;
     void on_input(const InputEvent & event) override;
     void on_update(const UpdateEvent & e) override;
+    void on_fixed_update(const UpdateEvent & e) override;
     void on_draw() override;
 };
\ No newline at end of file